@@ -8,7 +8,7 @@
 AM_SplitLeaf(fileDesc,pageBuf,pageNum,attrLength,recId,value,status,index,key)
 int fileDesc; /* file descriptor */
 char *pageBuf; /* pointer to buffer */
-int *pageNum; /* pagenumber of new leaf created */
+long *pageNum; /* pagenumber of new leaf created */
 int attrLength; 
 int recId;
 char *value; /* attribute value for insert */
@@ -20,12 +20,20 @@ char *key; /* returns the key to be filled in the parent */
 
 	AM_LEAFHEADER head,temphead; /* local header */
 	AM_LEAFHEADER *header,*tempheader;
-	char tempPage[PF_PAGE_SIZE]; /* temporary page for manipulation on the 
-								         page */
+	char tempPage[AM_MAX_PAGE_SIZE]; /* temporary page for manipulation
+								  on the page */
 	char *tempPageBuf,*tempPageBuf1;/* buffers for new pages to be
 								    allocated */
 	int errVal; 
-	int tempPageNum,tempPageNum1;/* pagenumbers for pages to be allocated */
+	long tempPageNum,tempPageNum1;/* pagenumbers for pages to be allocated */
+	int pageSize; /* page size of the index */
+
+	pageSize = PF_GetPageSize(fileDesc);
+	if (pageSize < 0)
+		{
+		 AM_Errno = AME_PF;
+		 return(AME_PF);
+		}
 
 	/* initialise pointers to headers */
 	header = &head;
@@ -35,36 +43,37 @@ char *key; /* returns the key to be filled in the parent */
 	bcopy(pageBuf,header,AM_sl);
 
 	/* compact half the keys into temporary page */
-	AM_Compact(1,(header->numKeys)/2,pageBuf,tempPage,header);
+	AM_Compact(1,(header->numKeys)/2,pageBuf,tempPage,header,pageSize);
 
-	/* Allocate a new page for the other half of the leaf*/
-	errVal = PF_AllocPage(fileDesc,&tempPageNum,&tempPageBuf);
+	/* Allocate a new page for the other half of the leaf, next to it
+	in the file so that the leaf chain can be read sequentially */
+	errVal = PF_AllocPageNear(fileDesc,*pageNum,&tempPageNum,&tempPageBuf);
 	AM_Check;
 
 	/* compact the other half keys */
 	AM_Compact((header->numKeys)/2 + 1,header->numKeys
-			      ,pageBuf,tempPageBuf,header);
+			      ,pageBuf,tempPageBuf,header,pageSize);
 
 	/*check where key has to be inserted */
 	if (index <= ((header->numKeys)/2))
 	{
 		/*value to be inserted is in first half */
 		errVal = AM_InsertintoLeaf(tempPage,attrLength,value,recId,
-					   index,status);
+					   index,status,pageSize);
 	}
 	else
 	{
 		/* value to be inserted in second half */
 		index = index - ((header->numKeys)/2);
 		errVal = AM_InsertintoLeaf(tempPageBuf,attrLength,value,
-					   recId,index,status);
+					   recId,index,status,pageSize);
 	}
 
 	/* change the next leafpage of first half of leaf to second half */
 	bcopy(tempPage,tempheader,AM_sl);
 	tempheader->nextLeafPage = tempPageNum;
 	bcopy(tempheader,tempPage,AM_sl);
-	bcopy(tempPage,pageBuf,PF_PAGE_SIZE);
+	bcopy(tempPage,pageBuf,pageSize);
 
 	/* copy the value of key to be written onto the parent */
 
@@ -77,14 +86,15 @@ char *key; /* returns the key to be filled in the parent */
 		/* the page being split is the root*/
 		/* Allocate a new page for another leaf as a new root has 
 		to be created*/
-		errVal = PF_AllocPage(fileDesc,&tempPageNum1,&tempPageBuf1);
+		errVal = PF_AllocPageNear(fileDesc,tempPageNum,&tempPageNum1,
+							&tempPageBuf1);
 		AM_Check;
 
 		AM_LeftPageNum = tempPageNum1; /* this will remain the 
 							   leftmost page hence*/
 
 		/* copy the old first half(actually the root) into a new page */ 
-		bcopy(pageBuf,tempPageBuf1,PF_PAGE_SIZE);
+		bcopy(pageBuf,tempPageBuf1,pageSize);
 		/* Initialise the new root page */ 
 
 		AM_FillRootPage(pageBuf,tempPageNum1,tempPageNum,key,
@@ -111,33 +121,41 @@ char *key; /* returns the key to be filled in the parent */
 /* Adds to the parent(on top of the path stack) attribute value and page Number*/
 AM_AddtoParent(fileDesc,pageNum,value,attrLength)
 int fileDesc;
-int pageNum; /* page Number to be added to parent */
+long pageNum; /* page Number to be added to parent */
 char *value; /*  pointer to attribute value to be added - 
                  gives back the attribute value to be added to it's parent*/
 int attrLength;
 
 {
-	char tempPage[PF_PAGE_SIZE];/* temporary page for manipulating page */
-	int pageNumber; /* pageNumber of parent to which key is to be added- 
+	char tempPage[AM_MAX_PAGE_SIZE];/* temporary page for manipulating
+									page */
+	long pageNumber; /* pageNumber of parent to which key is to be added- 
 			                                        got from stack*/
 	int offset; /* Place in parent where key is to be added - 
 								got from stack*/
 	int errVal; 
-	int pageNum1,pageNum2; /* pagenumber of new pages to be allocated */
+	long pageNum1,pageNum2; /* pagenumber of new pages to be allocated */
 
 	char *pageBuf,*pageBuf1,*pageBuf2;
 	AM_INTHEADER head,*header;
+	int pageSize; /* page size of the index */
 
 
 	/* initialise header */
 	header = &head;
+	pageSize = PF_GetPageSize(fileDesc);
+	if (pageSize < 0)
+		{
+		 AM_Errno = AME_PF;
+		 return(AME_PF);
+		}
 	/* Get the top of stack values for the page number of the parent 
 						 and offset of the key */
 	AM_topofStack(&pageNumber,&offset);
 	AM_PopStack();
 
-	/* Get the parent node */
-	errVal = PF_GetThisPage(fileDesc,pageNumber,&pageBuf);
+	/* Get the parent node, an internal node: keep it in the buffer */
+	errVal = PF_GetThisPageHint(fileDesc,pageNumber,&pageBuf,PF_PRIO_HIGH);
 	AM_Check;
 
 	/* copy the header from buffer */
@@ -158,8 +176,10 @@ int attrLength;
 	}
 	else
 	{
-		/* not enough room for another key */ 
-		errVal = PF_AllocPage(fileDesc,&pageNum1,&pageBuf1);
+		/* not enough room for another key: the new node goes
+		next to its sibling */ 
+		errVal = PF_AllocPageNear(fileDesc,pageNumber,&pageNum1,
+							&pageBuf1);
 		AM_Check;
 
 		/* split the internal node */
@@ -170,11 +190,12 @@ int attrLength;
 		if (pageNumber == AM_RootPageNum)
 		{
 			/* allocate a new page for a new root */
-			errVal = PF_AllocPage(fileDesc,&pageNum2,&pageBuf2);
+			errVal = PF_AllocPageNear(fileDesc,pageNumber,&pageNum2,
+							&pageBuf2);
 			AM_Check;
 
 			/* copy the first half into another buffer */
-			bcopy(tempPage,pageBuf2,PF_PAGE_SIZE);
+			bcopy(tempPage,pageBuf2,pageSize);
 
 			/* fill the header of new root page and the 
 			attribute value */
@@ -194,7 +215,7 @@ int attrLength;
 		}
 		else
 		{
-			bcopy(tempPage,pageBuf,PF_PAGE_SIZE);
+			bcopy(tempPage,pageBuf,pageSize);
 
 			errVal = PF_UnfixPage(fileDesc,pageNumber,TRUE);
 			AM_Check;
@@ -218,7 +239,7 @@ int attrLength;
 AM_AddtoIntPage(pageBuf,value,pageNum,header,offset)
 char *pageBuf;
 char *value; /* value to be added to the node */
-int pageNum; /* page number of child to be inserted */
+long pageNum; /* page number of child to be inserted */
 int offset; /* place where key is to be inserted */
 AM_INTHEADER *header;
 
@@ -226,20 +247,20 @@ AM_INTHEADER *header;
 	int recSize;
 	int i;
 
-	recSize = header->attrLength + AM_si;
+	recSize = header->attrLength + AM_sp;
 
 	/* shift all the keys greater than the one to be added to the right to
 	make way for new key */
 	for(i = header->numKeys; i > offset;i--)
-		bcopy(pageBuf + AM_sint + (i-1)*recSize + AM_si,pageBuf + 
-		      AM_sint +i*recSize + AM_si,recSize);
+		bcopy(pageBuf + AM_sint + (i-1)*recSize + AM_sp,pageBuf + 
+		      AM_sint +i*recSize + AM_sp,recSize);
 
 	/* copy the attribute value into the appropriate place */
 	bcopy(value,pageBuf + AM_sint + offset*recSize + 
-	      AM_si,header->attrLength);
+	      AM_sp,header->attrLength);
 
 	/* copy the pagenumber of the child */
-	bcopy((char *)&pageNum,pageBuf + AM_sint + (offset+1)*recSize,AM_si);
+	bcopy((char *)&pageNum,pageBuf + AM_sint + (offset+1)*recSize,AM_sp);
 
 	/* one more key added*/
 	header->numKeys++;
@@ -250,7 +271,7 @@ AM_INTHEADER *header;
 /* Fills the header and inserts a key into a new root */
 AM_FillRootPage(pageBuf,pageNum1,pageNum2,value,attrLength,maxKeys)
 char *pageBuf;/* buffer to new root */
-int pageNum1,pageNum2;/* pagenumbers of it;s two children*/
+long pageNum1,pageNum2;/* pagenumbers of it;s two children*/
 char *value; /* attr value to be inserted */
 short attrLength,maxKeys; /* some info about the header */
 
@@ -264,9 +285,9 @@ short attrLength,maxKeys; /* some info about the header */
 	tempheader->attrLength = attrLength;
 	tempheader->maxKeys = maxKeys;
 	tempheader->numKeys = 1;
-	bcopy((char *)&pageNum1,pageBuf + AM_sint ,AM_si);
-	bcopy(value,pageBuf + AM_sint + AM_si ,attrLength);
-	bcopy((char *)&pageNum2,pageBuf + AM_sint + AM_si + attrLength,AM_si);
+	bcopy((char *)&pageNum1,pageBuf + AM_sint ,AM_sp);
+	bcopy(value,pageBuf + AM_sint + AM_sp ,attrLength);
+	bcopy((char *)&pageNum2,pageBuf + AM_sint + AM_sp + attrLength,AM_sp);
 	bcopy(tempheader,pageBuf,AM_sint);
 
 }
@@ -278,23 +299,24 @@ char *pageBuf;/* internal node to be split */
 char *pbuf1,*pbuf2; /* the buffers for the two halves */
 char *value; /*  pointer to key to be added and to be returned to parent*/
 AM_INTHEADER *header;
-int pageNum,offset;
+long pageNum;
+int offset;
 
 {
 	AM_INTHEADER temphead,*tempheader;
 	int recSize;
-	char tempPage[PF_PAGE_SIZE + AM_MAXATTRLENGTH];/* temp page for 
+	char tempPage[AM_MAX_PAGE_SIZE + AM_MAXATTRLENGTH];/* temp page for 
 	                                               manipulating pageBuf */
 	int length1,length2;
 
 	tempheader = &temphead;
-	recSize = header->attrLength + AM_si;
+	recSize = header->attrLength + AM_sp;
 
 	tempheader->pageType = header->pageType;
 	tempheader->attrLength = header->attrLength;
 	tempheader->maxKeys = header->maxKeys;
 
-	length1 = AM_si + (offset*recSize);
+	length1 = AM_sp + (offset*recSize);
 	/* copy the keys to the left of the key to be added */
 	bcopy(pageBuf + AM_sint,tempPage,length1);
 
@@ -302,18 +324,18 @@ int pageNum,offset;
 	bcopy(value,tempPage + length1,header->attrLength);
 
 	/* copy the pagenumber of the child node */
-	bcopy((char *)&pageNum,tempPage + length1 + header->attrLength ,AM_si);
+	bcopy((char *)&pageNum,tempPage + length1 + header->attrLength ,AM_sp);
 
 	length2 = (header->maxKeys - offset)*recSize;
 
 	/* copy the rest of the keys */
 	bcopy(pageBuf + AM_sint + length1,tempPage + length1 + header->attrLength 
-	    + AM_si,length2);
+	    + AM_sp,length2);
 
 	/* number of keys in each half */
 	length1 = (header->maxKeys)/2;
 
-	length2 = AM_si + length1*recSize;
+	length2 = AM_sp + length1*recSize;
 	/* copy the first half into pbuf1 */
 	bcopy(tempPage,pbuf1 + AM_sint,length2);
 	tempheader->numKeys = length1;
@@ -322,10 +344,10 @@ int pageNum,offset;
 	bcopy(tempheader,pbuf1,AM_sint);
 
 	/* copy the middle key into value to be passed back to parent */
-	bcopy(tempPage + AM_si + length1 * recSize,value,header->attrLength);
+	bcopy(tempPage + AM_sp + length1 * recSize,value,header->attrLength);
 
 	/* copy the second half into pbuf2*/
-	bcopy(tempPage + AM_si + length1 * recSize + header->attrLength,
+	bcopy(tempPage + AM_sp + length1 * recSize + header->attrLength,
 	      pbuf2 + AM_sint,length2); 
 	bcopy(tempheader,pbuf2,AM_sint);
 
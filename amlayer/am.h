@@ -1,10 +1,11 @@
 typedef struct am_leafheader
 	{
 		char pageType;
-		int nextLeafPage;
-		short recIdPtr;
-		short keyPtr;
-		short freeListPtr;
+		long nextLeafPage;
+		int recIdPtr; /* offsets in the page: int, as a page may
+				 have up to AM_MAX_PAGE_SIZE bytes */
+		int keyPtr;
+		int freeListPtr;
 		short numinfreeList;
 		short attrLength;
 		short numKeys;
@@ -19,14 +20,18 @@ typedef struct am_intheader
 		short attrLength;
 	}	AM_INTHEADER ; /* Header for an internal node */
 
-extern int AM_RootPageNum; /* The page number of the root */
-extern int AM_LeftPageNum; /* The page Number of the leftmost leaf */
+extern long AM_RootPageNum; /* The page number of the root */
+extern long AM_LeftPageNum; /* The page Number of the leftmost leaf */
 extern int AM_Errno; /* last error in AM layer */
+extern long AM_BinSearch(); /* child of an internal node to follow */
+extern AM_CreateIndexSized(); /* AM_CreateIndex() with a page size */
+extern AM_CheckLayout(); /* AME_OLDLAYOUT for an index of an older layout */
 extern char *calloc();
 extern char *malloc();
 
 # define AM_Check if (errVal != PFE_OK) {AM_Errno = AME_PF; return(AME_PF) ;}
 # define AM_si sizeof(int)
+# define AM_sp sizeof(long) /* a page number in an internal node */
 # define AM_ss sizeof(short)
 # define AM_sl sizeof(AM_LEAFHEADER)
 # define AM_sint sizeof(AM_INTHEADER)
@@ -52,6 +57,8 @@ extern char *malloc();
 # define NOT_EQUAL 6
 # define MAXSCANS 20
 # define AM_MAXATTRLENGTH 256
+# define AM_MAX_PAGE_SIZE 65536 /* largest page size of the PF layer; the
+		lists of recIds in a leaf link them by unsigned short offsets */
 
 
 # define AME_OK 0
@@ -66,3 +73,5 @@ extern char *malloc();
 # define AME_INVALIDATTRTYPE -9
 # define AME_FD -10
 # define AME_INVALIDVALUE -11
+# define AME_OLDLAYOUT -12 /* index built with int page numbers, in a paged
+		file older than PF_FORMAT_V3: it must be built again */
@@ -12,11 +12,28 @@ char attrType;/* 'c' for char ,'i' for int ,'f' for float */
 int attrLength; /* 4 for 'i' or 'f', 1-255 for 'c' */
 
 
+{
+	return(AM_CreateIndexSized(fileName,indexNo,attrType,attrLength,
+				   PF_PAGE_SIZE));
+}
+
+
+/* Creates a secondary index file called fileName.indexNo whose pages
+have pageSize bytes, from PF_PAGE_SIZE to PF_MAX_PAGE_SIZE: larger pages
+hold more keys, and make the tree shallower */
+AM_CreateIndexSized(fileName,indexNo,attrType,attrLength,pageSize)
+char *fileName;/* Name of indexed file */
+int indexNo;/*number of this index for file */
+char attrType;/* 'c' for char ,'i' for int ,'f' for float */
+int attrLength; /* 4 for 'i' or 'f', 1-255 for 'c' */
+int pageSize; /* page size of the index file */
+
+
 {
 	char *pageBuf; /* buffer for holding a page */
 	char indexfName[AM_MAX_FNAME_LENGTH]; /* String to store the indexed
 					 files name with extension           */
-	int pageNum; /* page number of the root page(also the first page) */
+	long pageNum; /* page number of the root page(also the first page) */
 	int fileDesc; /* file Descriptor */
 	int errVal;
 	int maxKeys;/* Maximum keys that can be held on one internal page */
@@ -44,13 +61,14 @@ int attrLength; /* 4 for 'i' or 'f', 1-255 for 'c' */
 	
 	header = &head;
 	
-	/* Get the filename with extension and create a paged file by that name*/
+	/* Get the filename with extension and create a paged file by that name.
+	The aligned layout lets new nodes be placed next to their siblings */
 	sprintf(indexfName,"%s.%d",fileName,indexNo);
-	errVal = PF_CreateFile(indexfName);
+	errVal = PF_CreateFileSized(indexfName,PF_CREATE_ALIGNED,pageSize);
 	AM_Check;
 
 	/* open the new file */
-	fileDesc = PF_OpenFile(indexfName);
+	fileDesc = PF_OpenFile(indexfName,NULL);
 	if (fileDesc < 0) 
 	  {
 	   AM_Errno = AME_PF;
@@ -64,14 +82,14 @@ int attrLength; /* 4 for 'i' or 'f', 1-255 for 'c' */
 	/* initialise the header */
 	header->pageType = 'l';
 	header->nextLeafPage = AM_NULL_PAGE;
-	header->recIdPtr = PF_PAGE_SIZE;
+	header->recIdPtr = pageSize;
 	header->keyPtr = AM_sl;
 	header->freeListPtr = AM_NULL;
 	header->numinfreeList = 0;
 	header->attrLength = attrLength;
 	header->numKeys = 0;
 	/* the maximum keys in an internal node- has to be even always*/
-	maxKeys = (PF_PAGE_SIZE - AM_sint - AM_si)/(AM_si + attrLength);
+	maxKeys = (pageSize - AM_sint - AM_sp)/(AM_sp + attrLength);
 	if (( maxKeys % 2) != 0) 
 		header->maxKeys = maxKeys - 1;
 	else 
@@ -119,12 +137,12 @@ int recId; /* id of the record to delete */
 
 {
 	char *pageBuf;/* buffer to hold the page */
-	int pageNum; /* page Number of the page in buffer */
+	long pageNum; /* page Number of the page in buffer */
 	int index;/* index where key is present */
 	int status; /* whether key is in tree or not */
-	short nextRec;/* contains the next record on the list */
-	short oldhead; /* contains the old head of the list */
-	short temp; 
+	unsigned short nextRec;/* contains the next record on the list */
+	unsigned short oldhead; /* contains the old head of the list */
+	unsigned short temp; 
 	char *currRecPtr;/* pointer to the current record in the list */
 	AM_LEAFHEADER head,*header;/* header of the page */
 	int recSize; /* length of key,ptr pair for a leaf */
@@ -253,7 +271,7 @@ int recId; /* recId to be inserted */
 
 {
 	char *pageBuf; /* buffer to hold page */
-	int pageNum; /* page number of the page in buffer */
+	long pageNum; /* page number of the page in buffer */
 	int index; /* index where key can be found or can be inserted */
 	int status; /* whether key is old or new */
 	int inserted; /* Whether key has been inserted into the leaf or 
@@ -262,6 +280,7 @@ int recId; /* recId to be inserted */
 	int errVal; /* return value of functions within this function */
 	char key[AM_MAXATTRLENGTH]; /* holds the attribute to be passed 
 						  back to the parent */
+	int pageSize; /* page size of the index */
 
 	
 	/* check the parameters */
@@ -299,8 +318,9 @@ int recId; /* recId to be inserted */
 	}
 	
 	/* Insert into leaf the key,recId pair */
+	pageSize = PF_GetPageSize(fileDesc);
 	inserted = AM_InsertintoLeaf(pageBuf,attrLength,value,recId,index,
-				     status);
+				     status,pageSize);
 
 	/* if key has been inserted then done */
 	if (inserted == TRUE) 
@@ -366,7 +386,8 @@ static char *AMerrormsg[] = {
 "Scan Table is full",
 "Invalid Attribute Type",
 "Invalid file Descriptor",
-"Invalid value to Delete or Insert Entry"
+"Invalid value to Delete or Insert Entry",
+"Index of an older layout - build it again"
 };
 
 
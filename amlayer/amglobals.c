@@ -1,6 +1,6 @@
 # include "am.h"
 
-int AM_RootPageNum = 0;
-int AM_LeftPageNum = 0;
+long AM_RootPageNum = 0;
+long AM_LeftPageNum = 0;
 int AM_Errno;
 
@@ -3,17 +3,18 @@
 # include "pf.h"
 
 /* Inserts a key into a leaf node */
-AM_InsertintoLeaf(pageBuf,attrLength,value,recId,index,status)
+AM_InsertintoLeaf(pageBuf,attrLength,value,recId,index,status,pageSize)
 char *pageBuf;/* buffer where the leaf page resides */
 int attrLength;
 char *value;/* attribute value to be inserted*/
 int recId;/* recid of the attribute to be inserted */
 int index;/* index where key is to be inserted */
 int status;/* Whether key is a new key or an old key */
+int pageSize;/* page size of the index */
 
 {
 	int recSize;
-	char tempPage[PF_PAGE_SIZE];
+	char tempPage[AM_MAX_PAGE_SIZE];
 	AM_LEAFHEADER head,*header;
 	int errVal;
 
@@ -66,9 +67,9 @@ int status;/* Whether key is a new key or an old key */
 	/*there is enough space in the freelist and in the middle put together */
 	{
 		/* Compact the freelist so that we get enough space in the middle                   so that the new key can be inserted */
-		AM_Compact(1,header->numKeys,pageBuf,tempPage,header);
+		AM_Compact(1,header->numKeys,pageBuf,tempPage,header,pageSize);
 		
-		bcopy(tempPage,pageBuf,PF_PAGE_SIZE);
+		bcopy(tempPage,pageBuf,pageSize);
 		bcopy(pageBuf,header,AM_sl);
 		/* Insert into leaf a new key - no need to split */
 		AM_InsertToLeafNotFound(pageBuf,value,recId,index,header);
@@ -90,8 +91,8 @@ AM_LEAFHEADER *header;
 
 {
 	int recSize;
-	short tempPtr;
-	short oldhead;
+	unsigned short tempPtr;
+	unsigned short oldhead;
 
 	recSize = header->attrLength + AM_ss;
 	if ((header->freeListPtr) == 0)
@@ -103,8 +104,8 @@ AM_LEAFHEADER *header;
 	{
 		tempPtr = header->freeListPtr;
 		header->numinfreeList--;
-		bcopy(pageBuf + tempPtr + AM_si,(char *)&(header->freeListPtr)
-		      ,AM_ss);
+		bcopy(pageBuf + tempPtr + AM_si,(char *)&oldhead,AM_ss);
+		header->freeListPtr = oldhead;
 	}
 	
 	/* save  the old head of recId list */
@@ -160,19 +161,20 @@ AM_LEAFHEADER *header;
 /* There may be quite a few entries in the freelist but there may not 
 be space in the middle for a new key. This compacts all the recid's to the right
 so that there is enough space in the middle */
-AM_Compact(low,high,pageBuf,tempPage,header)
+AM_Compact(low,high,pageBuf,tempPage,header,pageSize)
 
 int low;
 int high;
 char *pageBuf;
 char *tempPage;
 AM_LEAFHEADER *header;
+int pageSize; /* page size of the index */
 
 {
 
-	short nextRec;
+	unsigned short nextRec;
 	AM_LEAFHEADER temphead,*tempheader;
-	short recIdPtr;
+	unsigned short recIdPtr;
 	int recSize;
 	int i,j;
 	int offset1,offset2;
@@ -181,7 +183,7 @@ AM_LEAFHEADER *header;
 	bcopy(header,tempheader,AM_sl);
 	
 	recSize = header->attrLength + AM_ss;
-	recIdPtr = PF_PAGE_SIZE - AM_si - AM_ss ;
+	recIdPtr = pageSize - AM_si - AM_ss ;
 
 	for (i = low, j = 1; i <= high; i++,j++)
 	{
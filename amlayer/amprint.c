@@ -6,7 +6,7 @@ AM_PrintIntNode(pageBuf,attrType)
 char *pageBuf;
 char attrType;
 {
-int tempPageint;
+long tempPageint;
 int i;
 int recSize;
 AM_INTHEADER *header;
@@ -14,19 +14,19 @@ AM_INTHEADER *header;
 
 header = (AM_INTHEADER *) calloc(1,AM_sint);
 bcopy(pageBuf,header,AM_sint);
-recSize = header->attrLength + AM_si;
+recSize = header->attrLength + AM_sp;
 printf("PAGETYPE %c\n",header->pageType);
 printf("NUMKEYS %d\n",header->numKeys);
 printf("MAXKEYS %d\n",header->maxKeys);
 printf("ATTRLENGTH %d\n",header->attrLength);
-bcopy(pageBuf + AM_sint,&tempPageint,AM_si);
-printf("FIRSTPAGE is %d\n",tempPageint);
+bcopy(pageBuf + AM_sint,&tempPageint,AM_sp);
+printf("FIRSTPAGE is %ld\n",tempPageint);
 for(i = 1 ; i <= (header->numKeys);i++)
   {
-   AM_PrintAttr(pageBuf + (i-1)*recSize + AM_sint + AM_si,attrType,
+   AM_PrintAttr(pageBuf + (i-1)*recSize + AM_sint + AM_sp,attrType,
                  header->attrLength);
-   bcopy(pageBuf + i*recSize + AM_sint,&tempPageint,AM_si);
-   printf("NEXTPAGE is %d\n",tempPageint);
+   bcopy(pageBuf + i*recSize + AM_sint,&tempPageint,AM_sp);
+   printf("NEXTPAGE is %ld\n",tempPageint);
   }
 }
 
@@ -36,7 +36,7 @@ char *pageBuf;
 char attrType;
 
 {
-short nextRec;
+unsigned short nextRec;
 int i;
 int recSize;
 int recId;
@@ -47,7 +47,7 @@ header = (AM_LEAFHEADER *) calloc(1,AM_sl);
 bcopy(pageBuf,header,AM_sl);
 recSize = header->attrLength + AM_ss;
 printf("PAGETYPE %c\n",header->pageType);
-printf("NEXTLEAFPAGE %d\n",header->nextLeafPage);
+printf("NEXTLEAFPAGE %ld\n",header->nextLeafPage);
 /*printf("RECIDPTR %d\n",header->recIdPtr);
 printf("KEYPTR %d\n",header->keyPtr);
 printf("FREELISTPTR %d\n",header->freeListPtr);
@@ -79,7 +79,7 @@ char attrType;
 
 
 {
-int pageNum;
+long pageNum;
 char *value;
 char *pageBuf;
 int index;
@@ -89,13 +89,13 @@ AM_LEAFHEADER *header;
 
 value = malloc(AM_si);
 bcopy(&min,value,AM_si);
-printf("%d PAGE \n",AM_LeftPageNum);
+printf("%ld PAGE \n",AM_LeftPageNum);
 PF_GetThisPage(fileDesc,AM_LeftPageNum,&pageBuf);
 header = (AM_LEAFHEADER *) calloc(1,AM_sl);
 bcopy(pageBuf,header,AM_sl);
 while(header->nextLeafPage != -1)
   {
-   printf("PAGENUMBER = %d\n",pageNum);   
+   printf("PAGENUMBER = %ld\n",pageNum);   
    AM_PrintLeafKeys(pageBuf,attrType);
    errVal = PF_UnfixPage(fileDesc,pageNum,FALSE);
    AM_Check;
@@ -104,7 +104,7 @@ while(header->nextLeafPage != -1)
    AM_Check;
    bcopy(pageBuf,header,AM_sl);
   }
-printf("PAGENUMBER = %d\n",pageNum);
+printf("PAGENUMBER = %ld\n",pageNum);
 AM_PrintLeafKeys(pageBuf,attrType);
 errVal = PF_UnfixPage(fileDesc,pageNum,FALSE);
 AM_Check;
@@ -117,7 +117,7 @@ char *pageBuf;
 char attrType;
 
 {
-short nextRec;
+unsigned short nextRec;
 int i;
 int recSize;
 int recId;
@@ -177,12 +177,12 @@ switch(attrType)
 
 
 AM_PrintTree(fileDesc,pageNum,attrType)
-int pageNum;
+long pageNum;
 int fileDesc;
 char attrType;
 
 {
-int nextPage;
+long nextPage;
 int errVal;
 AM_INTHEADER *header;
 char *tempPage;
@@ -190,26 +190,26 @@ char *pageBuf;
 int recSize;
 int i;
 
-printf("GETTING PAGE = %d\n",pageNum);
+printf("GETTING PAGE = %ld\n",pageNum);
 errVal = PF_GetThisPage(fileDesc,pageNum,&pageBuf);
-tempPage = malloc(PF_PAGE_SIZE);
-bcopy(pageBuf,tempPage,PF_PAGE_SIZE);
+tempPage = malloc(PF_GetPageSize(fileDesc));
+bcopy(pageBuf,tempPage,PF_GetPageSize(fileDesc));
 errVal = PF_UnfixPage(fileDesc,pageNum,FALSE);
 if (*tempPage == 'l')
   {
-   printf("PAGENUM = %d\n",pageNum);
+   printf("PAGENUM = %ld\n",pageNum);
    AM_PrintLeafKeys(tempPage,attrType);
    return;
   }
 header = (AM_INTHEADER *)calloc(1,AM_sint);
 bcopy(tempPage,header,AM_sint);
-recSize = header->attrLength + AM_si;
+recSize = header->attrLength + AM_sp;
 for(i = 1; i <= (header->numKeys + 1); i++)
   {
-   bcopy(tempPage + AM_sint + (i-1)*recSize,&nextPage,AM_si);
+   bcopy(tempPage + AM_sint + (i-1)*recSize,&nextPage,AM_sp);
    AM_PrintTree(fileDesc,nextPage,attrType);
   }
-printf("PAGENUM = %d",pageNum);
+printf("PAGENUM = %ld",pageNum);
 AM_PrintIntNode(tempPage,attrType);
 }
 
@@ -8,18 +8,23 @@ struct {
          int fileDesc;
          int op;
          int attrType;
-         int pageNum;
+         long pageNum;
          short index;
          short actindex;
-         int nextpageNum;
+         long nextpageNum;
          char nextvalue[AM_MAXATTRLENGTH];
          short nextIndex;
-         short nextRecIdPtr;
-         int lastpageNum;
+         unsigned short nextRecIdPtr;
+         long lastpageNum;
          short lastIndex;
          int status;
+         long pinnedpageNum; /* leaf kept pinned between calls, or
+                               AM_NULL_PAGE */
+         char *pinnedBuf;   /* its data */
        } AM_scanTable[MAXSCANS];
 
+long GetLeftPageNum();
+
 
 /* Opens an index scan */
 AM_OpenIndexScan(fileDesc,attrType,attrLength,op,value)
@@ -34,12 +39,12 @@ char *value; /* value for comparison */
 int scanDesc; /* index into scan table */
 int status; /* whether value is found or not in the tree */
 int index; /* index of value in leaf */
-int pageNum;/* page number of leaf page where value is found */
+long pageNum;/* page number of leaf page where value is found */
 int recSize; /* size of key,ptr pair in leaf */
 char *pageBuf; /* buffer for page */
 int errVal; /* return value of functions */
 AM_LEAFHEADER head,*header; /* local header */
-int searchpageNum;
+long searchpageNum;
 
 
 
@@ -56,6 +61,13 @@ if ((attrType != 'i') && (attrType != 'c') && (attrType != 'f'))
   return(AME_INVALIDATTRTYPE);
   }
 
+/* check the layout of the index */
+if ((status = AM_CheckLayout(fileDesc)) != AME_OK)
+  {
+  AM_Errno = status;
+  return(status);
+  }
+
 /* initialise header */
 header = &head;
 
@@ -72,6 +84,7 @@ if (scanDesc > MAXSCANS - 1)
 
 /* there is room */
 AM_scanTable[scanDesc].status = FIRST;
+AM_scanTable[scanDesc].pinnedpageNum = AM_NULL_PAGE;
 AM_scanTable[scanDesc].attrType = attrType;
 
 /* initialise AM_LeftPageNum */
@@ -275,6 +288,52 @@ AM_Check;
 return(scanDesc);
 }
 
+/* releases the leaf kept pinned by the scan, if any */
+static AM_ScanUnpin(scanDesc)
+int scanDesc;/* index scan descriptor */
+
+{
+int errVal;/* return value for functions */
+long pageNum;
+
+pageNum = AM_scanTable[scanDesc].pinnedpageNum;
+if (pageNum == AM_NULL_PAGE)
+  return(AME_OK);
+AM_scanTable[scanDesc].pinnedpageNum = AM_NULL_PAGE;
+errVal = PF_UnfixPage(AM_scanTable[scanDesc].fileDesc,pageNum,FALSE);
+AM_Check;
+return(AME_OK);
+}
+
+
+/* makes pageNum the leaf kept pinned by the scan, releasing the previous
+one, and sets pageBuf to its data. The leaf stays pinned across calls
+of AM_FindNextEntry, so it is not fetched again on every call; inserts
+and deletes can still get the page since pins are shared */
+static AM_ScanPin(scanDesc,pageNum,pageBuf)
+int scanDesc;/* index scan descriptor */
+long pageNum;/* leaf page to pin */
+char **pageBuf;/* buffer for page */
+
+{
+int errVal;/* return value for functions */
+
+if (AM_scanTable[scanDesc].pinnedpageNum == pageNum)
+  {
+   *pageBuf = AM_scanTable[scanDesc].pinnedBuf;
+   return(AME_OK);
+  }
+errVal = AM_ScanUnpin(scanDesc);
+if (errVal != AME_OK)
+  return(errVal);
+errVal = PF_GetThisPage(AM_scanTable[scanDesc].fileDesc,pageNum,pageBuf);
+AM_Check;
+AM_scanTable[scanDesc].pinnedpageNum = pageNum;
+AM_scanTable[scanDesc].pinnedBuf = *pageBuf;
+return(AME_OK);
+}
+
+
 /* returns the record id of the next record that satisfies the conditions
 specified for index scan associated with scanDesc */
 AM_FindNextEntry(scanDesc)
@@ -298,39 +357,39 @@ if ((scanDesc < 0) || (scanDesc > MAXSCANS - 1))
 
 /* check if scan is over */
 if (AM_scanTable[scanDesc].status == OVER)
+     {
+      AM_ScanUnpin(scanDesc);
       return(AME_EOF);
+     }
 
 if (AM_scanTable[scanDesc].nextpageNum == AM_NULL_PAGE)
  {
   AM_scanTable[scanDesc].status = OVER;
+  AM_ScanUnpin(scanDesc);
   return(AME_EOF);
  }
 
 header = &head;
-errVal = PF_GetThisPage(AM_scanTable[scanDesc].fileDesc
-                        ,AM_scanTable[scanDesc].nextpageNum,&pageBuf);
-AM_Check;
+errVal = AM_ScanPin(scanDesc,AM_scanTable[scanDesc].nextpageNum,&pageBuf);
+if (errVal != AME_OK)
+  return(errVal);
 
 bcopy(pageBuf,header,AM_sl);
 recSize = header->attrLength + AM_ss;
 
-errVal = PF_UnfixPage(AM_scanTable[scanDesc].fileDesc
-           ,AM_scanTable[scanDesc].nextpageNum,FALSE);
-AM_Check;
-
 /* Get next non empty leaf page */
 while(header->numKeys == 0)
   if(header->nextLeafPage == AM_NULL_PAGE)
    {
     AM_scanTable[scanDesc].status = OVER; 
+    AM_ScanUnpin(scanDesc);
     return(AME_EOF);
    }
   else
    {
-    errVal = PF_GetThisPage(AM_scanTable[scanDesc].fileDesc,header->nextLeafPage,&pageBuf);
-    AM_Check;
-    errVal = PF_UnfixPage(AM_scanTable[scanDesc].fileDesc,header->nextLeafPage,FALSE);
-    AM_Check;
+    errVal = AM_ScanPin(scanDesc,header->nextLeafPage,&pageBuf);
+    if (errVal != AME_OK)
+      return(errVal);
     AM_scanTable[scanDesc].nextpageNum = header->nextLeafPage;
     AM_scanTable[scanDesc].nextIndex = 1;
     AM_scanTable[scanDesc].actindex = 1;
@@ -348,6 +407,7 @@ if ((AM_scanTable[scanDesc].op == LESS_THAN) ||
  && (AM_scanTable[scanDesc].lastIndex == 0))
  {
   AM_scanTable[scanDesc].status = OVER;
+  AM_ScanUnpin(scanDesc);
   return(AME_EOF);
  }
 
@@ -366,21 +426,21 @@ if (AM_scanTable[scanDesc].op == NOT_EQUAL)
          }
        else
           if (header->nextLeafPage == AM_NULL_PAGE)
+           {
+            AM_ScanUnpin(scanDesc);
             return(AME_EOF); 
+           }
           else
            {
             AM_scanTable[scanDesc].nextpageNum = header->nextLeafPage;
             AM_scanTable[scanDesc].nextIndex =  1;
             AM_scanTable[scanDesc].actindex = 1;
-            errVal =PF_GetThisPage(AM_scanTable[scanDesc].fileDesc,
-                  header->nextLeafPage,&pageBuf);
-            AM_Check;
+            errVal = AM_ScanPin(scanDesc,header->nextLeafPage,&pageBuf);
+            if (errVal != AME_OK)
+              return(errVal);
             bcopy(pageBuf + AM_sl + header->attrLength,
                &AM_scanTable[scanDesc].nextRecIdPtr,AM_ss);
             bcopy(pageBuf,header,AM_sl);
-            errVal = PF_UnfixPage(AM_scanTable[scanDesc].fileDesc
-                ,header->nextLeafPage,FALSE);
-            AM_Check;
            }
 /* if not the first call to findnextentry , check if previous record has 
 been deleted */
@@ -413,7 +473,7 @@ bcopy(pageBuf + AM_scanTable[scanDesc].nextRecIdPtr + AM_si,
 
 
 /* check if this keys list is over */
-if (AM_scanTable[scanDesc].nextRecIdPtr == (short)0)
+if (AM_scanTable[scanDesc].nextRecIdPtr == 0)
    if ((AM_scanTable[scanDesc].nextIndex + 1) <= (header->numKeys))
     {
      AM_scanTable[scanDesc].nextIndex++;
@@ -432,14 +492,11 @@ if (AM_scanTable[scanDesc].nextRecIdPtr == (short)0)
       AM_scanTable[scanDesc].nextpageNum = header->nextLeafPage;
       AM_scanTable[scanDesc].nextIndex =  1;
       AM_scanTable[scanDesc].actindex = 1;
-      errVal =PF_GetThisPage(AM_scanTable[scanDesc].fileDesc,
-        header->nextLeafPage,&pageBuf);
-      AM_Check;
+      errVal = AM_ScanPin(scanDesc,header->nextLeafPage,&pageBuf);
+      if (errVal != AME_OK)
+        return(errVal);
       bcopy(pageBuf + AM_sl + header->attrLength,
          &AM_scanTable[scanDesc].nextRecIdPtr,AM_ss);
-      errVal = PF_UnfixPage(AM_scanTable[scanDesc].fileDesc
-                ,header->nextLeafPage,FALSE);
-      AM_Check;
       bcopy(pageBuf + AM_sl + (AM_scanTable[scanDesc].nextIndex -1 )*recSize,
       AM_scanTable[scanDesc].nextvalue,header->attrLength); 
       bcopy(pageBuf,header,AM_sl);
@@ -479,25 +536,37 @@ if ((scanDesc < 0) || (scanDesc > MAXSCANS - 1))
    AM_Errno = AME_INVALID_SCANDESC;
    return(AME_INVALID_SCANDESC);
   }
+if (AM_scanTable[scanDesc].status != FREE)
+  AM_ScanUnpin(scanDesc);
 AM_scanTable[scanDesc].status = FREE;
 return(AME_OK);
 }
 
 
-GetLeftPageNum(fileDesc)
+long GetLeftPageNum(fileDesc)
 int fileDesc;
 
 {
 char *pageBuf;
-int pageNum;
+long pageNum;
+long childNum; /* leftmost child of pageNum */
 int errVal;
 
 errVal = PF_GetFirstPage(fileDesc,&pageNum,&pageBuf);
 AM_Check;
-if (*pageBuf == 'l')
-  AM_LeftPageNum = pageNum;
-else
-  AM_LeftPageNum = 2;
+/* follow the leftmost child down from the root: where the leftmost leaf
+is depends on where the pages were allocated */
+while (*pageBuf != 'l')
+  {
+   /* the page may be reused once unfixed: read the child first */
+   bcopy(pageBuf + AM_sint,(char *)&childNum,AM_sp);
+   errVal = PF_UnfixPage(fileDesc,pageNum,FALSE);
+   AM_Check;
+   pageNum = childNum;
+   errVal = PF_GetThisPage(fileDesc,pageNum,&pageBuf);
+   AM_Check;
+  }
+AM_LeftPageNum = pageNum;
 errVal = PF_UnfixPage(fileDesc,pageNum,FALSE);
 AM_Check;
 return(AM_LeftPageNum);
@@ -2,6 +2,27 @@
 # include "am.h"
 # include "pf.h"
 
+/* AME_OK if the index in file fileDesc has the layout of this AM layer.
+Page numbers in the nodes became long along with those of the PF layer,
+whose files are PF_FORMAT_V3 since, or PF_FORMAT_COMPRESSED. An index in
+a file of an older format has int ones: reading it would follow the
+wrong pages. An old index converted by pfconvert is not told apart:
+build it again instead */
+AM_CheckLayout(fileDesc)
+int fileDesc; /* file Descriptor */
+
+{
+	int format; /* PF_FORMAT_xxx of the file */
+
+	format = PF_GetFormat(fileDesc);
+	if (format < 0)
+		return(AME_PF);
+	if ((format != PF_FORMAT_V3) && (format != PF_FORMAT_COMPRESSED))
+		return(AME_OLDLAYOUT);
+	return(AME_OK);
+}
+
+
 /* searches for a key in a binary tree - returns FOUND or NOTFOUND and
 returns the pagenumber and the offset where key is present or could 
 be inserted */
@@ -10,14 +31,14 @@ int fileDesc;
 char attrType;
 int attrLength;
 char *value;
-int *pageNum; /* page number of page where key is present or can be inserted*/
+long *pageNum; /* page number of page where key is present or can be inserted*/
 char **pageBuf; /* pointer to buffer in memory where leaf page corresponding                                                        to pageNum can be found */
 int *indexPtr; /* pointer to index in leaf where key is present or 
                                                             can be inserted */
 
 {
 	int errVal;
-	int nextPage; /* next page to be followed on the path from root to leaf*/
+	long nextPage; /* next page to be followed on the path from root to leaf*/
 	int retval; /* return value */
 	AM_LEAFHEADER lhead,*lheader; /* local pointer to leaf header */
 	AM_INTHEADER ihead,*iheader; /* local pointer to internal node header */
@@ -26,6 +47,10 @@ int *indexPtr; /* pointer to index in leaf where key is present or
 	lheader = &lhead;
 	iheader = &ihead;
 
+	/* the tree must have the layout read here */
+	if ((retval=AM_CheckLayout(fileDesc)) != AME_OK)
+		return(retval);
+
         /* get the root of the B+ tree */
 
 	errVal = PF_GetFirstPage(fileDesc,pageNum,pageBuf);
@@ -43,6 +68,10 @@ int *indexPtr; /* pointer to index in leaf where key is present or
 		bcopy(*pageBuf,iheader,AM_sint);
 		if (iheader->attrLength != attrLength)
 			return(AME_INVALIDATTRLENGTH);
+
+		/* internal nodes are on every path: keep them in the buffer */
+		errVal = PF_SetPagePriority(fileDesc,*pageNum,PF_PRIO_HIGH);
+		AM_Check;
 	}
 	/* find the leaf at which key is present or can be inserted */
 	while ((**pageBuf) != 'l')
@@ -78,6 +107,9 @@ int *indexPtr; /* pointer to index in leaf where key is present or
 			bcopy(*pageBuf,iheader,AM_sint);
 			if (iheader->attrLength != attrLength)
 				return(AME_INVALIDATTRLENGTH);
+			errVal = PF_SetPagePriority(fileDesc,*pageNum,
+							PF_PRIO_HIGH);
+			AM_Check;
 		}
 	}
 	/* find whether key is in leaf or not */
@@ -86,7 +118,7 @@ int *indexPtr; /* pointer to index in leaf where key is present or
 
 
 /* Finds the place (index) from where the next page to be followed is got*/
-AM_BinSearch(pageBuf,attrType,attrLength,value,indexPtr,header)
+long AM_BinSearch(pageBuf,attrType,attrLength,value,indexPtr,header)
 char *pageBuf; /* buffer where the page is found */
 char attrType; 
 int attrLength;
@@ -98,9 +130,9 @@ AM_INTHEADER *header;
 	int low,high,mid; /* for binary search */
 	int compareVal; /* result of comparison of key with value */
 	int recSize; /* size in bytes of a key,ptr pair */
-	int pageNum; /* page number of node to be followed along the B+ tree */
+	long pageNum; /* page number of node to be followed along the B+ tree */
 
-	recSize = AM_si  + attrLength;
+	recSize = AM_sp  + attrLength;
 	low = 1;
 	high = header->numKeys;
 
@@ -110,7 +142,7 @@ AM_INTHEADER *header;
 		mid = (low + high) / 2;
 
 		/* compare the value with the middle key */
-		compareVal = AM_Compare(pageBuf + AM_sint + AM_si + 
+		compareVal = AM_Compare(pageBuf + AM_sint + AM_sp + 
 		(mid - 1)*recSize,attrType,attrLength,value); 
 		
 		if (compareVal < 0) 
@@ -121,7 +153,7 @@ AM_INTHEADER *header;
 	        {   
 			/* value = middle key */
 			bcopy(pageBuf + AM_sint + mid*recSize,(char *)&pageNum,
-			      AM_si);
+			      AM_sp);
 			*indexPtr = mid;
 			return(pageNum);
 	        }
@@ -130,44 +162,44 @@ AM_INTHEADER *header;
 	
 	/* check the border cases */
 	if ((high - low) == 0)
-		if(AM_Compare(pageBuf+AM_sint+AM_si +(low - 1)*recSize,attrType,
+		if(AM_Compare(pageBuf+AM_sint+AM_sp +(low - 1)*recSize,attrType,
 		attrLength, value) < 0)
 		{
 			bcopy(pageBuf+AM_sint+(low-1)*recSize,(char *)&pageNum,
-			      AM_si);
+			      AM_sp);
 			*indexPtr = low -1;
 			return(pageNum);
 		}
 		else
 		{
 			bcopy(pageBuf+AM_sint+low*recSize,(char *)&pageNum,
-			      AM_si);
+			      AM_sp);
 			*indexPtr = low;
 			return(pageNum);
 		}
 
 	if ((high - low) == 1)
-		if(AM_Compare(pageBuf+AM_sint+AM_si +(low - 1)*recSize,attrType,
+		if(AM_Compare(pageBuf+AM_sint+AM_sp +(low - 1)*recSize,attrType,
 		attrLength, value) < 0)
 		{
 			bcopy(pageBuf+AM_sint+(low-1)*recSize,(char *)&pageNum,
-		              AM_si);
+		              AM_sp);
 			*indexPtr = low -1;
 			return(pageNum);
 		}
 		else
-			if(AM_Compare(pageBuf+AM_sint+AM_si +low*recSize,
+			if(AM_Compare(pageBuf+AM_sint+AM_sp +low*recSize,
 			attrType,attrLength, value) < 0)
 			{
 				bcopy(pageBuf+AM_sint+low*recSize,
-				      (char *)&pageNum,AM_si);
+				      (char *)&pageNum,AM_sp);
 				*indexPtr = low;
 				return(pageNum);
 			}
 			else 
 		        {
 			bcopy(pageBuf+AM_sint+(low+1)*recSize,(char *)&pageNum,
-			      AM_si);
+			      AM_sp);
 			*indexPtr = low + 1;
 			return(pageNum);
 		        }
@@ -6,14 +6,14 @@
 
 struct
     {
-     int pageNumber;
+     long pageNumber;
      int offset;
     } AM_Stack[AM_MAXSTACK];
 
 int AM_topofStackPtr = -1;
 
 AM_PushStack(pageNum,offset)
-int pageNum;
+long pageNum;
 int offset;
 
 {
@@ -29,7 +29,7 @@ AM_topofStackPtr--;
 }
 
 AM_topofStack(pageNum,offset)
-int *pageNum;
+long *pageNum;
 int *offset;
 {
 *pageNum = AM_Stack[AM_topofStackPtr].pageNumber ;
@@ -0,0 +1,120 @@
+/* benchpagesize.c: height of the B+ tree and AM_Search() latency for each
+page size of the index, with the same amount of buffer memory. */
+#include <stdio.h>
+#include <time.h>
+#include <sys/stat.h>
+#include "am.h"
+#include "pf.h"
+#include "testam.h"
+
+#define RELNAME		"benchrel"	/* name of the relation */
+#define NUMKEYS		200000	/* # of keys in the index */
+#define NUMLOOKUPS	200000	/* # of lookups per run */
+#define BUFBYTES	(1024*1024)	/* buffer memory, whatever the page size */
+#define FNAME_LENGTH	80	/* file name size */
+
+static double now()
+{
+struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC,&ts);
+	return(ts.tv_sec + ts.tv_nsec/1e9);
+}
+
+/* # of levels of the tree in file fd, following the leftmost child
+pointers from the root down to a leaf */
+static height(fd)
+int fd;
+{
+long pageNum;	/* page on the way down */
+char *pageBuf;	/* its data */
+long child;	/* its leftmost child */
+int levels;
+
+	if (PF_GetFirstPage(fd,&pageNum,&pageBuf) != PFE_OK){
+		PF_PrintError("root");
+		exit(1);
+	}
+	for (levels=1; *pageBuf != 'l'; levels++){
+		bcopy(pageBuf + AM_sint,(char *)&child,AM_sp);
+		PF_UnfixPage(fd,pageNum,FALSE);
+		pageNum = child;
+		if (PF_GetThisPage(fd,pageNum,&pageBuf) != PFE_OK){
+			PF_PrintError("child");
+			exit(1);
+		}
+	}
+	PF_UnfixPage(fd,pageNum,FALSE);
+	return(levels);
+}
+
+main()
+{
+char fname[FNAME_LENGTH];	/* file name */
+int fd;		/* file descriptor for the index */
+int pageSize;	/* page size of the index */
+int key;	/* key value */
+int found;	/* # of keys found */
+long pageNum;	/* leaf page of a key */
+char *pageBuf;	/* leaf page data */
+int index;	/* index of a key in its leaf */
+struct stat st;	/* to tell the size of the index */
+int i;
+double start, secs;
+
+	PF_Init();
+	sprintf(fname,"%s.0",RELNAME);
+
+	printf("pageSize,buffers,height,fileKB,lookups,found,seconds,usPerLookup\n");
+	for (pageSize=PF_PAGE_SIZE; pageSize <= PF_MAX_PAGE_SIZE; pageSize*=2){
+		set_buffer_size(BUFBYTES/pageSize);
+
+		/* an index with NUMKEYS keys, inserted in random order */
+		if (AM_CreateIndexSized(RELNAME,0,INT_TYPE,sizeof(int),
+						pageSize) != AME_OK){
+			AM_PrintError("create");
+			exit(1);
+		}
+		if ((fd=PF_OpenFile(fname,"LRU")) < 0){
+			PF_PrintError(fname);
+			exit(1);
+		}
+		srand(1);
+		for (i=0; i < NUMKEYS; i++){
+			key = rand() % (4*NUMKEYS);
+			if (AM_InsertEntry(fd,INT_TYPE,sizeof(int),
+						(char *)&key,i) != AME_OK){
+				AM_PrintError("insert");
+				exit(1);
+			}
+		}
+		PF_CloseFile(fd);
+
+		if ((fd=PF_OpenFile(fname,"LRU")) < 0){
+			PF_PrintError(fname);
+			exit(1);
+		}
+		srand(2);
+		found = 0;
+		start = now();
+		for (i=0; i < NUMLOOKUPS; i++){
+			key = rand() % (4*NUMKEYS);
+			if (AM_Search(fd,INT_TYPE,sizeof(int),(char *)&key,
+				&pageNum,&pageBuf,&index) == AM_FOUND)
+				found++;
+			AM_EmptyStack();
+			if (PF_UnfixPage(fd,pageNum,FALSE) != PFE_OK){
+				PF_PrintError("unfix");
+				exit(1);
+			}
+		}
+		secs = now() - start;
+		stat(fname,&st);
+		printf("%d,%d,%d,%ld,%d,%d,%.3f,%.2f\n",pageSize,
+			BUFBYTES/pageSize,height(fd),(long)st.st_size/1024,
+			NUMLOOKUPS,found,secs,secs*1e6/NUMLOOKUPS);
+		PF_CloseFile(fd);
+		AM_DestroyIndex(RELNAME,0);
+	}
+	return(0);
+}
@@ -0,0 +1,87 @@
+/* benchsearch.c: AM_Search() latency on an index much larger than the
+buffer, through the buffer and with the index file mapped (PF_OPEN_MMAP). */
+#include <stdio.h>
+#include <time.h>
+#include "am.h"
+#include "pf.h"
+#include "testam.h"
+
+#define RELNAME		"benchrel"	/* name of the relation */
+#define NUMKEYS		200000	/* # of keys in the index */
+#define NUMLOOKUPS	200000	/* # of lookups per run */
+#define NUMBUFS		64	/* # of buffers */
+#define FNAME_LENGTH	80	/* file name size */
+
+static double now()
+{
+struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC,&ts);
+	return(ts.tv_sec + ts.tv_nsec/1e9);
+}
+
+main()
+{
+static char *modes[] = {"buffered","mmap"};
+char fname[FNAME_LENGTH];	/* file name */
+int fd;		/* file descriptor for the index */
+int key;	/* key value */
+int found;	/* # of keys found */
+long pageNum;	/* leaf page of a key */
+char *pageBuf;	/* leaf page data */
+int index;	/* index of a key in its leaf */
+int mode;
+int i;
+double start, secs;
+
+	PF_Init();
+	set_buffer_size(NUMBUFS);
+
+	/* an index with NUMKEYS keys, inserted in random order */
+	AM_CreateIndex(RELNAME,0,INT_TYPE,sizeof(int));
+	sprintf(fname,"%s.0",RELNAME);
+	if ((fd=PF_OpenFile(fname,"LRU")) < 0){
+		PF_PrintError(fname);
+		exit(1);
+	}
+	srand(1);
+	for (i=0; i < NUMKEYS; i++){
+		key = rand() % (4*NUMKEYS);
+		if (AM_InsertEntry(fd,INT_TYPE,sizeof(int),(char *)&key,i)
+								!= AME_OK){
+			AM_PrintError("insert");
+			exit(1);
+		}
+	}
+	PF_CloseFile(fd);
+
+	printf("mode,lookups,found,seconds,usPerLookup\n");
+	for (mode=0; mode < 2; mode++){
+		if ((fd=PF_OpenFileFlags(fname,"LRU",
+				mode? PF_OPEN_MMAP: 0)) < 0){
+			PF_PrintError(fname);
+			exit(1);
+		}
+		srand(2);
+		found = 0;
+		start = now();
+		for (i=0; i < NUMLOOKUPS; i++){
+			key = rand() % (4*NUMKEYS);
+			if (AM_Search(fd,INT_TYPE,sizeof(int),(char *)&key,
+				&pageNum,&pageBuf,&index) == AM_FOUND)
+				found++;
+			AM_EmptyStack();
+			if (PF_UnfixPage(fd,pageNum,FALSE) != PFE_OK){
+				PF_PrintError("unfix");
+				exit(1);
+			}
+		}
+		secs = now() - start;
+		printf("%s,%d,%d,%.3f,%.2f\n",modes[mode],NUMLOOKUPS,found,
+					secs,secs*1e6/NUMLOOKUPS);
+		PF_CloseFile(fd);
+	}
+
+	AM_DestroyIndex(RELNAME,0);
+	return(0);
+}
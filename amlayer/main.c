@@ -27,7 +27,7 @@ int testval;
 	/* open the index */
 	printf("opening index\n");
 	sprintf(fname,"%s.0",RELNAME);
-	fd = PF_OpenFile(fname);
+	fd = PF_OpenFile(fname,NULL);
 
 	/* first, make sure that simple deletions work */
 	printf("inserting into index\n");
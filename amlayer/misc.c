@@ -1,4 +1,5 @@
 /* misc.c */
+#include <stdio.h>
 #include "pf.h"
 #include "testam.h"
 #include "am.h"
@@ -132,7 +133,7 @@ char *fname;
 {
 int errval;
 
-	if ((errval=PF_OpenFile(fname))<0){
+	if ((errval=PF_OpenFile(fname,NULL))<0){
 		printf("PF_OpenFile(%s) failed: %d\n",errval);
 		exit(1);
 	}
@@ -30,11 +30,60 @@
 #define PFE_HASHNOTFOUND -18	/* hash table entry not found */
 #define PFE_HASHPAGEEXIST -19	/* page already exist in hash table */
 
+#define PFE_FILEFULL	-26	/* file has as many pages as its format can
+				count */
+#define PFE_COMPRESSED	-27	/* file is compressed: no PF_OPEN_DIRECT nor
+				PF_OPEN_MMAP */
 
-/* page size */
-#define PF_PAGE_SIZE	1020
+/* page size, and the largest page size of PF_CreateFileSized() */
+#define PF_PAGE_SIZE	4096
+#define PF_MAX_PAGE_SIZE 65536
+
+/* flags of PF_CreateFileFlags() */
+#define PF_CREATE_ALIGNED 0x1	/* page-aligned layout, allocation bitmap */
+#define PF_CREATE_COMPRESSED 0x2 /* pages compressed on disk */
+
+/* formats of paged files, see PF_GetFormat() */
+#define PF_FORMAT_PACKED  1	/* 8 byte header, pages sizeof(PFfpage) apart */
+#define PF_FORMAT_ALIGNED 2	/* header block, pages PF_SLOT_SIZE apart */
+#define PF_FORMAT_MAPPED  3	/* aligned, with an allocation bitmap */
+#define PF_FORMAT_V2	  4	/* whole pages, bitmap in map blocks */
+#define PF_FORMAT_V3	  5	/* PF_FORMAT_V2 with 64 bit page numbers */
+#define PF_FORMAT_COMPRESSED 6	/* compressed pages in slots, page map */
+
+/* flags of PF_OpenFileFlags() */
+#define PF_OPEN_DIRECT	0x1	/* O_DIRECT: no double caching in the kernel */
+#define PF_OPEN_MMAP	0x2	/* read-only, pages straight from a mapping */
+
+/* page priorities, see PF_GetThisPageHint() */
+#define PF_PRIO_LOW	0	/* replaced first (the default) */
+#define PF_PRIO_HIGH	1	/* replaced once no low priority page can be */
 
 /* externs from the PF layer */
-extern int PFerrno;		/* error number of last error */
+extern __thread int PFerrno;	/* error number of last error, per thread */
 extern void PF_Init();
 extern void PF_PrintError();
+
+/* page numbers are long */
+int PF_CreateFile(char *);
+int PF_CreateFileFlags(char *, int);
+int PF_CreateFileSized(char *, int, int);
+int PF_DestroyFile(char *);
+int PF_OpenFile(char *, char *);
+int PF_OpenFileFlags(char *, char *, int);
+int PF_CloseFile(int);
+int PF_GetPageSize(int);
+int PF_GetFormat(int);
+int PF_GetFirstPage(int, long *, char **);
+int PF_GetNextPage(int, long *, char **);
+int PF_GetThisPage(int, long, char **);
+int PF_GetThisPageHint(int, long, char **, int);
+int PF_SetPagePriority(int, long, int);
+int PF_AllocPage(int, long *, char **);
+int PF_AllocPageNear(int, long, long *, char **);
+int PF_UnfixPage(int, long, int);
+int PF_DisposePage(int, long);
+int PF_MarkDirty(int, long);
+
+/* max # of buffers, see pflayer/pf.h */
+int set_buffer_size(int);
@@ -0,0 +1,131 @@
+/* test4.c: tests an index larger than 4 GB. The first 4 GB of the file
+are pages that are never written: a hole, which takes no room on disk,
+as room is only reserved for pages that are written (see
+PF_EXTENT_PAGES). */
+#include <stdio.h>
+#include <sys/stat.h>
+#include "am.h"
+#include "pf.h"
+#include "testam.h"
+
+#define PAGESIZE	PF_MAX_PAGE_SIZE	/* page size of the index */
+#define GAPPAGES	66000	/* # of pages to skip: 4 GB and a bit */
+#define KEEPPAGES	128	/* pages kept in use at both ends of the gap */
+#define MAXRECS		20000	/* # of records to insert */
+#define FNAME_LENGTH	80	/* file name size */
+#define FOURGB		(4L*1024*1024*1024)
+
+long GetLeftPageNum();
+
+main()
+{
+int fd;	/* file descriptor for the index */
+char fname[FNAME_LENGTH];	/* file name */
+long pageNum;	/* page number */
+char *pageBuf;	/* page data */
+int index;	/* index of a key in its leaf */
+int recnum;	/* record number */
+int sd;	/* scan descriptor */
+int numrec;	/* # of records retrieved */
+struct stat st;	/* to tell the size of the index */
+
+	/* init: enough buffer to hold a gap page until it is disposed of */
+	printf("initializing\n");
+	PF_Init();
+	set_buffer_size(2*KEEPPAGES);
+
+	/* create index */
+	printf("creating index\n");
+	if (AM_CreateIndexSized(RELNAME,0,INT_TYPE,sizeof(int),
+					PAGESIZE) != AME_OK){
+		AM_PrintError("create");
+		exit(1);
+	}
+
+	/* open the index */
+	printf("opening index\n");
+	sprintf(fname,"%s.0",RELNAME);
+	if ((fd=PF_OpenFile(fname,NULL)) < 0){
+		PF_PrintError(fname);
+		exit(1);
+	}
+
+	/* skip the first 4 GB of the file: allocate the pages of the gap,
+	each next to the one before, and dispose of each one while it is
+	still in the buffer, so that it is never written. The pages at both
+	ends of the gap stay in use, or the tree would take its new nodes
+	from the gap */
+	printf("skipping %d pages\n",GAPPAGES);
+	pageNum = 0;
+	while (pageNum < GAPPAGES){
+		if (PF_AllocPageNear(fd,pageNum,&pageNum,&pageBuf) != PFE_OK ||
+			PF_UnfixPage(fd,pageNum,FALSE) != PFE_OK){
+			PF_PrintError("gap");
+			exit(1);
+		}
+		if (pageNum - KEEPPAGES > KEEPPAGES &&
+			PF_DisposePage(fd,pageNum - KEEPPAGES) != PFE_OK){
+			PF_PrintError("gap");
+			exit(1);
+		}
+	}
+
+	/* insert into index */
+	printf("inserting into index\n");
+	for (recnum=0; recnum < MAXRECS; recnum++){
+		if (AM_InsertEntry(fd,INT_TYPE,sizeof(int),(char *)&recnum,
+					IntToRecId(recnum)) != AME_OK){
+			AM_PrintError("insert");
+			exit(1);
+		}
+	}
+	PF_CloseFile(fd);
+
+	/* the tree is past the gap */
+	if ((fd=PF_OpenFile(fname,NULL)) < 0){
+		PF_PrintError(fname);
+		exit(1);
+	}
+	stat(fname,&st);
+	printf("index larger than 4 GB: %s\n",
+		(st.st_size > FOURGB)? "yes": "no");
+	if (st.st_blocks*512 > st.st_size/16){
+		printf("gap takes %ld bytes on disk\n",(long)st.st_blocks*512);
+		exit(1);
+	}
+	printf("leftmost leaf past the gap: %s\n",
+		(GetLeftPageNum(fd) > GAPPAGES)? "yes": "no");
+
+	/* look every record up */
+	printf("searching index\n");
+	numrec = 0;
+	for (recnum=0; recnum < MAXRECS; recnum++){
+		if (AM_Search(fd,INT_TYPE,sizeof(int),(char *)&recnum,
+				&pageNum,&pageBuf,&index) == AM_FOUND)
+			numrec++;
+		AM_EmptyStack();
+		PF_UnfixPage(fd,pageNum,FALSE);
+	}
+	printf("found %d records\n",numrec);
+
+	/* scan them all */
+	printf("retrieving all records\n");
+	numrec = 0;
+	sd = AM_OpenIndexScan(fd,INT_TYPE,sizeof(int),EQ_OP,NULL);
+	while((recnum=RecIdToInt(AM_FindNextEntry(sd)))>= 0){
+		if (recnum != numrec){
+			printf("record %d out of order\n",recnum);
+			exit(1);
+		}
+		numrec++;
+	}
+	printf("retrieved %d records\n",numrec);
+	AM_CloseIndexScan(sd);
+
+	/* destroy everything */
+	printf("closing down\n");
+	PF_CloseFile(fd);
+	AM_DestroyIndex(RELNAME,0);
+
+	printf("test4 done!\n");
+}
@@ -0,0 +1,78 @@
+/* test5.c: tests that an index laid out before page numbers became long
+is refused. Such an index lives in a paged file of a format older than
+PF_FORMAT_V3; a PF_FORMAT_PACKED file with a leaf for a root stands in
+for one here. */
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "am.h"
+#include "pf.h"
+#include "testam.h"
+
+#define FNAME_LENGTH	80	/* file name size */
+
+main()
+{
+int fd;	/* file descriptor for the index */
+char fname[FNAME_LENGTH];	/* file name */
+long pageNum;	/* page number */
+char *pageBuf;	/* page data */
+int recnum;	/* record number */
+int sd;	/* scan descriptor */
+int value;	/* key to look for */
+
+	/* init */
+	printf("initializing\n");
+	PF_Init();
+
+	/* an index in a file of the old format, its root an empty leaf */
+	printf("creating old index\n");
+	sprintf(fname,"%s.0",RELNAME);
+	unlink(fname);
+	if (PF_CreateFile(fname) != PFE_OK ||
+		(fd=PF_OpenFile(fname,NULL)) < 0 ||
+		PF_AllocPage(fd,&pageNum,&pageBuf) != PFE_OK){
+		PF_PrintError(fname);
+		exit(1);
+	}
+	pageBuf[0] = 'l';
+	PF_UnfixPage(fd,pageNum,TRUE);
+
+	/* every way into the tree is refused */
+	recnum = 1;
+	printf("insert refused: %s\n",
+		(AM_InsertEntry(fd,INT_TYPE,sizeof(int),(char *)&recnum,
+			IntToRecId(recnum)) == AME_OLDLAYOUT)? "yes": "no");
+	printf("delete refused: %s\n",
+		(AM_DeleteEntry(fd,INT_TYPE,sizeof(int),(char *)&recnum,
+			IntToRecId(recnum)) == AME_OLDLAYOUT)? "yes": "no");
+	value = 1;
+	sd = AM_OpenIndexScan(fd,INT_TYPE,sizeof(int),EQ_OP,(char *)&value);
+	printf("scan refused: %s\n",(sd == AME_OLDLAYOUT)? "yes": "no");
+	sd = AM_OpenIndexScan(fd,INT_TYPE,sizeof(int),EQ_OP,NULL);
+	printf("full scan refused: %s\n",(sd == AME_OLDLAYOUT)? "yes": "no");
+	AM_PrintError("full scan: ");
+
+	/* a new index is taken */
+	printf("creating new index\n");
+	PF_CloseFile(fd);
+	PF_DestroyFile(fname);
+	if (AM_CreateIndex(RELNAME,0,INT_TYPE,sizeof(int)) != AME_OK){
+		AM_PrintError("create");
+		exit(1);
+	}
+	if ((fd=PF_OpenFile(fname,NULL)) < 0){
+		PF_PrintError(fname);
+		exit(1);
+	}
+	printf("insert taken: %s\n",
+		(AM_InsertEntry(fd,INT_TYPE,sizeof(int),(char *)&recnum,
+			IntToRecId(recnum)) == AME_OK)? "yes": "no");
+
+	/* destroy everything */
+	printf("closing down\n");
+	PF_CloseFile(fd);
+	AM_DestroyIndex(RELNAME,0);
+
+	printf("test5 done!\n");
+}
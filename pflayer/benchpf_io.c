@@ -0,0 +1,83 @@
+/* benchpf_io.c: random-read IOPS of the I/O backends. For each backend and
+queue depth qd, PF_GetPages() fetches qd random pages of a file much larger
+than the buffer, and the pages are unfixed again. The page cache of the
+file is dropped before each run, so that the reads go to the device. */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "pf.h"
+#include "pftypes.h"
+#include "benchpf_util.h"
+
+#define BENCH_FILE	"benchio.db"
+#define BENCH_PAGES	8192		/* # of pages in the file */
+#define BENCH_BUFS	128		/* # of buffers */
+#define BENCH_READS	4096		/* # of pages read per run */
+
+int main(int argc, char *argv[])
+{
+    static int backends[] = {PF_IO_SYNC, PF_IO_THREADS, PF_IO_URING};
+    static char *names[] = {"sync", "threads", "uring"};
+    long pagenums[64];
+    char *pagebufs[64];
+    unsigned seed = 1;
+    double start, secs;
+    char *pagebuf;
+    int b, qd, i, done, fd, inuse;
+    long pagenum;
+
+    PF_Init();
+    set_buffer_size(BENCH_BUFS);
+
+    /* a file with BENCH_PAGES pages */
+    unlink(BENCH_FILE);
+    if (PF_CreateFile(BENCH_FILE) != PFE_OK ||
+        (fd = PF_OpenFile(BENCH_FILE, argc > 1 ? argv[1] : "LRU")) < 0) {
+        PF_PrintError(BENCH_FILE);
+        exit(1);
+    }
+    for (i = 0; i < BENCH_PAGES; i++) {
+        if (PF_AllocPage(fd, &pagenum, &pagebuf) != PFE_OK) {
+            PF_PrintError("alloc");
+            exit(1);
+        }
+        sprintf(pagebuf, "page %ld", pagenum);
+        PF_UnfixPage(fd, pagenum, TRUE);
+    }
+    PF_FlushFile(fd);
+
+    printf("backend,inuse,qd,reads,seconds,iops\n");
+    for (b = 0; b < sizeof(backends) / sizeof(backends[0]); b++) {
+        inuse = PF_SetIOBackend(backends[b]);
+        for (qd = 1; qd <= 64; qd *= 2) {
+            dropcache(BENCH_FILE);
+            start = now();
+            for (done = 0; done < BENCH_READS; done += qd) {
+                for (i = 0; i < qd; i++) {
+                    seed = seed * 1103515245u + 12345u;
+                    pagenums[i] = (seed >> 8) % BENCH_PAGES;
+                }
+                if (PF_GetPages(fd, pagenums, qd, pagebufs) != PFE_OK) {
+                    PF_PrintError("getpages");
+                    exit(1);
+                }
+                for (i = 0; i < qd; i++) {
+                    if (atoi(pagebufs[i] + 5) != pagenums[i]) {
+                        fprintf(stderr, "page %ld: bad data\n", pagenums[i]);
+                        exit(1);
+                    }
+                    PF_UnfixPage(fd, pagenums[i], FALSE);
+                }
+            }
+            secs = now() - start;
+            printf("%s,%s,%d,%d,%.3f,%.0f\n", names[b],
+                   names[inuse], qd, done, secs, done / secs);
+        }
+    }
+
+    PF_CloseFile(fd);
+    PF_DestroyFile(BENCH_FILE);
+    return 0;
+}
@@ -0,0 +1,135 @@
+/* benchpf_mt.c: read throughput of the buffer manager with several threads.
+Each thread fixes and unfixes random pages of a file. In the "hit" case the
+pages all fit in the buffer, so that every access after the warm up is a
+buffer hit. In the "miss" case the file is 16 times the buffer and opened
+with PF_OPEN_DIRECT, so that most accesses read a page from the device,
+and one unfix in BENCH_DIRTY makes its page dirty, so that many victims
+are written out first: it shows how well misses overlap. */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+#include "pf.h"
+#include "pftypes.h"
+#include "benchpf_util.h"
+
+#define BENCH_FILE	"benchmt.db"
+#define BENCH_PAGES	512		/* # of pages in the file */
+#define BENCH_OPS	400000		/* # of fix/unfix pairs per thread */
+#define MISS_FILE	"benchmtmiss.db"
+#define MISS_PAGES	(32 * BENCH_PAGES) /* # of pages, "miss" case */
+#define MISS_OPS	20000		/* # of fix/unfix pairs per thread */
+#define BENCH_DIRTY	4		/* one unfix in this many is dirty */
+
+static int fd;			/* file read by the threads */
+static long npages;		/* # of pages in it */
+static int nops;		/* # of fix/unfix pairs per thread */
+static int dirtyevery;		/* one unfix in this many is dirty, or 0 */
+
+static void *reader(void *arg)
+{
+    unsigned seed = (unsigned)(long)arg * 2654435761u + 1;
+    char *pagebuf;
+    volatile char tmp;
+    int i;
+    long pagenum;
+
+    for (i = 0; i < nops; i++) {
+        seed = seed * 1103515245u + 12345u;
+        pagenum = (seed >> 8) % npages;
+        if (PF_GetThisPage(fd, pagenum, &pagebuf) != PFE_OK) {
+            PF_PrintError("get");
+            exit(1);
+        }
+        tmp = pagebuf[0];
+        if (PF_UnfixPage(fd, pagenum,
+                         dirtyevery > 0 && i % dirtyevery == 0) != PFE_OK) {
+            PF_PrintError("unfix");
+            exit(1);
+        }
+    }
+    return NULL;
+}
+
+/* create file "fname" with "n" pages, aligned if "flags" says so */
+static void create(char *fname, long n, int flags)
+{
+    char *pagebuf;
+    long pagenum;
+    int i;
+
+    unlink(fname);
+    if (PF_CreateFileFlags(fname, flags) != PFE_OK ||
+        (fd = PF_OpenFile(fname, "LRU")) < 0) {
+        PF_PrintError(fname);
+        exit(1);
+    }
+    for (i = 0; i < n; i++) {
+        if (PF_AllocPage(fd, &pagenum, &pagebuf) != PFE_OK) {
+            PF_PrintError("alloc");
+            exit(1);
+        }
+        sprintf(pagebuf, "page %ld", pagenum);
+        PF_UnfixPage(fd, pagenum, TRUE);
+    }
+    PF_CloseFile(fd);
+}
+
+/* run each # of threads on file "fname", "n" pages, with policy "policy" */
+static void run(char *name, char *fname, long n, int ops, int dirty,
+                int flags, char *policy)
+{
+    static int nthreads[] = {1, 2, 4, 8, 16};
+    pthread_t tid[16];
+    double start, secs, base = 0;
+    int i, t, k;
+    PF_Stats st;
+
+    /* O_DIRECT may not be there: the page cache then plays the device */
+    if ((fd = PF_OpenFileFlags(fname, policy, flags)) < 0 &&
+        (fd = PF_OpenFile(fname, policy)) < 0) {
+        PF_PrintError(fname);
+        exit(1);
+    }
+    npages = n;
+    nops = ops;
+    dirtyevery = dirty;
+    for (k = 0; k < sizeof(nthreads) / sizeof(nthreads[0]); k++) {
+        t = nthreads[k];
+        PF_ResetStats();
+        start = now();
+        for (i = 0; i < t; i++)
+            pthread_create(&tid[i], NULL, reader, (void *)(long)i);
+        for (i = 0; i < t; i++)
+            pthread_join(tid[i], NULL);
+        secs = now() - start;
+
+        PF_GetStats(&st);
+        if (t == 1)
+            base = ops / secs;
+        printf("%s,%d,%ld,%.3f,%.0f,%.2f,%.4f\n", name, t, (long)t * ops,
+               secs, t * ops / secs, t * ops / secs / base, st.hitRatio);
+    }
+    PF_CloseFile(fd);
+}
+
+int main(int argc, char *argv[])
+{
+    char *policy = argc > 1 ? argv[1] : "LRU";
+
+    PF_Init();
+    set_buffer_size(2 * BENCH_PAGES);
+
+    create(BENCH_FILE, BENCH_PAGES, 0);
+    create(MISS_FILE, MISS_PAGES, PF_CREATE_ALIGNED);
+
+    printf("case,threads,ops,seconds,opsPerSec,speedup,hitRatio\n");
+    run("hit", BENCH_FILE, BENCH_PAGES, BENCH_OPS, 0, 0, policy);
+    run("miss", MISS_FILE, MISS_PAGES, MISS_OPS, BENCH_DIRTY,
+        PF_OPEN_DIRECT, policy);
+
+    PF_DestroyFile(BENCH_FILE);
+    PF_DestroyFile(MISS_FILE);
+    return 0;
+}
@@ -0,0 +1,98 @@
+/* benchpf_stats.c: the replacement policies side by side, with the per
+policy counters. A file of BENCH_PAGES pages is made for each policy,
+and each file gets the same accesses, interleaved: a loop over a range a
+little larger than its share of the buffer, and random gets in a small
+hot set, a tenth of which make the page dirty. After each of BENCH_ROUNDS
+rounds PF_GetPolicyStats() is sampled, and PF_DiffFileStats() against the
+sample before gives the rates over the round: the round, the policy, the
+gets and evictions per second, the hit ratio over the round and the dirty
+evictions are printed. */
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "pf.h"
+
+#define NPOLICIES	5
+#define BENCH_PAGES	1024		/* # of pages in each file */
+#define BENCH_BUFS	200		/* # of buffers, shared by the files */
+#define LOOP_PAGES	48		/* pages of the loop of a file */
+#define HOT_PAGES	16		/* pages of the hot set of a file */
+#define BENCH_ROUNDS	5		/* # of samples */
+#define ROUND_GETS	20000		/* # of gets per file in a round */
+
+static char *policies[NPOLICIES] = { "LRU", "MRU", "CLOCK", "2Q", "ARC" };
+static long pages[NPOLICIES][BENCH_PAGES];	/* page numbers of the files */
+
+int main()
+{
+    PF_FileStats before[NPOLICIES], after, delta;
+    char fname[32], *pagebuf;
+    int fd[NPOLICIES], i, p, r, dirty;
+    long pagenum, loop;
+
+    PF_Init();
+    set_buffer_size(BENCH_BUFS);
+
+    for (p = 0; p < NPOLICIES; p++) {
+        sprintf(fname, "benchstats%d.db", p);
+        unlink(fname);
+        if (PF_CreateFileFlags(fname, PF_CREATE_ALIGNED) != PFE_OK ||
+            (fd[p] = PF_OpenFile(fname, policies[p])) < 0) {
+            PF_PrintError(fname);
+            exit(1);
+        }
+        for (i = 0; i < BENCH_PAGES; i++) {
+            if (PF_AllocPage(fd[p], &pages[p][i], &pagebuf) != PFE_OK) {
+                PF_PrintError("alloc");
+                exit(1);
+            }
+            PF_UnfixPage(fd[p], pages[p][i], TRUE);
+        }
+        PF_FlushFile(fd[p]);
+    }
+    PF_ResetStats();
+    for (p = 0; p < NPOLICIES; p++)
+        PF_GetPolicyStats(policies[p], &before[p]);
+
+    printf("round,policy,getsPerSec,evictionsPerSec,hitRatio,"
+           "dirtyEvictions\n");
+    srandom(564);
+    loop = 0;
+    for (r = 1; r <= BENCH_ROUNDS; r++) {
+        for (i = 0; i < ROUND_GETS; i++) {
+            /* every other get goes on with the loop, the others are
+            in the hot set, past the loop */
+            if (i % 2 == 0) {
+                pagenum = loop++ % LOOP_PAGES;
+                dirty = FALSE;
+            } else {
+                pagenum = LOOP_PAGES + random() % HOT_PAGES;
+                dirty = random() % 10 == 0;
+            }
+            for (p = 0; p < NPOLICIES; p++) {
+                if (PF_GetThisPage(fd[p], pages[p][pagenum], &pagebuf)
+                                                        != PFE_OK) {
+                    PF_PrintError("get");
+                    exit(1);
+                }
+                PF_UnfixPage(fd[p], pages[p][pagenum], dirty);
+            }
+        }
+        for (p = 0; p < NPOLICIES; p++) {
+            PF_GetPolicyStats(policies[p], &after);
+            PF_DiffFileStats(&after, &before[p], &delta);
+            printf("%d,%s,%.0f,%.0f,%.3f,%ld\n", r, policies[p],
+                   (delta.bufferHits + delta.bufferMisses) / delta.seconds,
+                   delta.evictions / delta.seconds, delta.hitRatio,
+                   delta.dirtyEvictions);
+            before[p] = after;
+        }
+    }
+
+    for (p = 0; p < NPOLICIES; p++) {
+        PF_CloseFile(fd[p]);
+        sprintf(fname, "benchstats%d.db", p);
+        PF_DestroyFile(fname);
+    }
+    return 0;
+}
@@ -0,0 +1,80 @@
+/* benchpf_util.c: helpers shared by the benchmarks (benchpf_*.c) */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include "pf.h"
+#include "benchpf_util.h"
+
+#define KEY_LENGTH	20		/* length of a char key */
+
+double now()
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* bytes read from the device by this process so far (read_bytes of
+/proc/self/io), or -1 where it can't be told */
+long readbytes()
+{
+    char line[128];
+    long n = -1;
+    FILE *f;
+
+    if ((f = fopen("/proc/self/io", "r")) == NULL)
+        return -1;
+    while (fgets(line, sizeof(line), f) != NULL)
+        if (sscanf(line, "read_bytes: %ld", &n) == 1)
+            break;
+    fclose(f);
+    return n;
+}
+
+/* drop the page cache of a file */
+void dropcache(char *fname)
+{
+    int unixfd;
+
+    if ((unixfd = open(fname, O_RDONLY)) < 0) {
+        perror(fname);
+        exit(1);
+    }
+    fdatasync(unixfd);
+    posix_fadvise(unixfd, 0, 0, POSIX_FADV_DONTNEED);
+    close(unixfd);
+}
+
+/* fill page "pagenum" as a leaf: a small header, then as many keys and
+record ids as fit, sorted int keys or blank padded char keys */
+void fillpage(char *pagebuf, long pagenum, int charkeys)
+{
+    int key, recid, n, off;
+
+    memset(pagebuf, 0, PF_PAGE_SIZE);
+    pagebuf[0] = 'l';
+    off = 16;
+    if (!charkeys) {
+        key = (int)pagenum * 1000;
+        for (n = 0; off + 2 * sizeof(int) <= PF_PAGE_SIZE; n++) {
+            recid = key + n * 3;
+            memcpy(pagebuf + off, &recid, sizeof(int));
+            memcpy(pagebuf + off + sizeof(int), &recid, sizeof(int));
+            off += 2 * sizeof(int);
+        }
+    } else {
+        for (n = 0; off + KEY_LENGTH + sizeof(int) <= PF_PAGE_SIZE; n++) {
+            memset(pagebuf + off, ' ', KEY_LENGTH);
+            sprintf(pagebuf + off, "name%07ld%03d", pagenum, n);
+            pagebuf[off + strlen(pagebuf + off)] = ' ';
+            recid = (int)pagenum * 1000 + n;
+            memcpy(pagebuf + off + KEY_LENGTH, &recid, sizeof(int));
+            off += KEY_LENGTH + sizeof(int);
+        }
+    }
+    memcpy(pagebuf + 4, &n, sizeof(int));
+}
@@ -0,0 +1,7 @@
+/* benchpf_util.h: helpers shared by the benchmarks (benchpf_*.c) */
+
+double now();			/* seconds, CLOCK_MONOTONIC */
+long readbytes();		/* bytes read from the device so far */
+void dropcache(char *fname);	/* drop the page cache of a file */
+void fillpage(char *pagebuf, long pagenum, int charkeys);
+				/* fill a page as an index leaf */
@@ -0,0 +1,133 @@
+/* benchpf_v2.c: I/O amplification of the packed format and of format v2.
+A packed file of BENCH_PAGES pages is converted with PF_ConvertFile(). For
+each of the two files the page cache is dropped, random pages are read
+through a small buffer, and the bytes the kernel read from the device
+(read_bytes of /proc/self/io) and the page cache the file then takes
+(mincore()) are divided by the number of pages read. A packed page spans
+two OS pages, a v2 page exactly one. */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "pf.h"
+#include "pftypes.h"
+#include "benchpf_util.h"
+
+#define PACKED_FILE	"benchpacked.db"
+#define V2_FILE		"benchv2.db"
+#define BENCH_PAGES	16384		/* # of pages in the file */
+#define BENCH_BUFS	64		/* # of buffers */
+#define BENCH_READS	2048		/* # of pages read per run */
+
+/* bytes of a file in the page cache */
+static long cached(char *fname)
+{
+    struct stat st;
+    unsigned char *vec;
+    long ospage, npages, i, n = 0;
+    void *addr;
+    int unixfd;
+
+    if ((unixfd = open(fname, O_RDONLY)) < 0 || fstat(unixfd, &st) < 0) {
+        perror(fname);
+        exit(1);
+    }
+    ospage = sysconf(_SC_PAGESIZE);
+    npages = (st.st_size + ospage - 1) / ospage;
+    addr = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, unixfd, 0);
+    vec = malloc(npages);
+    if (addr == MAP_FAILED || vec == NULL || mincore(addr, st.st_size, vec) < 0) {
+        perror("mincore");
+        exit(1);
+    }
+    for (i = 0; i < npages; i++)
+        n += vec[i] & 1;
+    munmap(addr, st.st_size);
+    free(vec);
+    close(unixfd);
+    return n * ospage;
+}
+
+static void run(char *name, char *fname)
+{
+    unsigned seed = 1;
+    PF_Stats st;
+    long before, bytes, incache;
+    char *pagebuf;
+    int fd, i;
+    long pagenum;
+
+    if ((fd = PF_OpenFile(fname, "LRU")) < 0) {
+        PF_PrintError(fname);
+        exit(1);
+    }
+    dropcache(fname);
+    PF_ResetStats();
+    before = readbytes();
+    for (i = 0; i < BENCH_READS; i++) {
+        seed = seed * 1103515245u + 12345u;
+        pagenum = (seed >> 8) % BENCH_PAGES;
+        if (PF_GetThisPage(fd, pagenum, &pagebuf) != PFE_OK) {
+            PF_PrintError("get");
+            exit(1);
+        }
+        if (atoi(pagebuf + 5) != pagenum) {
+            fprintf(stderr, "%s: page %ld: bad data\n", fname, pagenum);
+            exit(1);
+        }
+        PF_UnfixPage(fd, pagenum, FALSE);
+    }
+    bytes = readbytes() - before;
+    incache = cached(fname);
+    PF_GetStats(&st);
+    printf("%s,%ld,%ld,%.0f,%ld,%.0f\n", name, st.physicalReads,
+           bytes / 1024, (double)bytes / st.physicalReads,
+           incache / 1024, (double)incache / st.physicalReads);
+    PF_CloseFile(fd);
+}
+
+int main()
+{
+    char *pagebuf;
+    int i, fd;
+    long pagenum;
+
+    PF_Init();
+    set_buffer_size(BENCH_BUFS);
+
+    /* a packed file with BENCH_PAGES pages, and its v2 copy */
+    unlink(PACKED_FILE);
+    unlink(V2_FILE);
+    if (PF_CreateFile(PACKED_FILE) != PFE_OK ||
+        (fd = PF_OpenFile(PACKED_FILE, "LRU")) < 0) {
+        PF_PrintError(PACKED_FILE);
+        exit(1);
+    }
+    for (i = 0; i < BENCH_PAGES; i++) {
+        if (PF_AllocPage(fd, &pagenum, &pagebuf) != PFE_OK) {
+            PF_PrintError("alloc");
+            exit(1);
+        }
+        sprintf(pagebuf, "page %ld", pagenum);
+        PF_UnfixPage(fd, pagenum, TRUE);
+    }
+    PF_CloseFile(fd);
+    if (PF_ConvertFile(PACKED_FILE, V2_FILE) != PFE_OK) {
+        PF_PrintError("convert");
+        exit(1);
+    }
+    if (readbytes() < 0)
+        fprintf(stderr, "no /proc/self/io: read_bytes not counted\n");
+
+    printf("format,pagesRead,readKB,bytesPerPage,cachedKB,cachedPerPage\n");
+    run("packed", PACKED_FILE);
+    run("v2", V2_FILE);
+
+    PF_DestroyFile(PACKED_FILE);
+    PF_DestroyFile(V2_FILE);
+    return 0;
+}
@@ -0,0 +1,111 @@
+/* benchpf_z.c: disk bytes against CPU for compressed files. A file of
+BENCH_PAGES pages laid out as index leaves, half of them sorted int keys
+with their record ids and half blank padded char keys, is copied with
+PF_ConvertFileFlags() into a compressed file. For each of the two files
+the page cache is dropped and every page is read through a small buffer:
+the size of the file, the bytes the kernel read from the device
+(read_bytes of /proc/self/io), the time taken and the decompression time
+per page from PF_Stats are printed, after the compression ratio of the
+copy. */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "pf.h"
+#include "benchpf_util.h"
+
+#define PLAIN_FILE	"benchplain.db"
+#define Z_FILE		"benchz.db"
+#define BENCH_PAGES	16384		/* # of pages in the file */
+#define BENCH_BUFS	64		/* # of buffers */
+
+static void run(char *name, char *fname)
+{
+    char check[PF_PAGE_SIZE];
+    struct stat st;
+    PF_Stats stats;
+    long before, bytes, pagenum;
+    char *pagebuf;
+    double start, secs;
+    int fd, error;
+
+    if ((fd = PF_OpenFile(fname, "LRU")) < 0) {
+        PF_PrintError(fname);
+        exit(1);
+    }
+    dropcache(fname);
+    PF_ResetStats();
+    before = readbytes();
+    start = now();
+    pagenum = -1;
+    while ((error = PF_GetNextPage(fd, &pagenum, &pagebuf)) == PFE_OK) {
+        fillpage(check, pagenum, pagenum % 2 != 0);
+        if (memcmp(check, pagebuf, PF_PAGE_SIZE) != 0) {
+            fprintf(stderr, "%s: page %ld: bad data\n", fname, pagenum);
+            exit(1);
+        }
+        PF_UnfixPage(fd, pagenum, FALSE);
+    }
+    if (error != PFE_EOF) {
+        PF_PrintError("scan");
+        exit(1);
+    }
+    secs = now() - start;
+    bytes = readbytes() - before;
+    PF_GetStats(&stats);
+    stat(fname, &st);
+    printf("%s,%ld,%ld,%ld,%.3f,%.0f\n", name, stats.physicalReads,
+           (long)st.st_size / 1024, bytes / 1024, secs,
+           stats.decompressNsPerPage);
+    PF_CloseFile(fd);
+}
+
+int main()
+{
+    PF_Stats stats;
+    char *pagebuf;
+    int i, fd;
+    long pagenum;
+
+    PF_Init();
+    set_buffer_size(BENCH_BUFS);
+
+    /* a file with BENCH_PAGES leaves, and its compressed copy */
+    unlink(PLAIN_FILE);
+    unlink(Z_FILE);
+    if (PF_CreateFileFlags(PLAIN_FILE, PF_CREATE_ALIGNED) != PFE_OK ||
+        (fd = PF_OpenFile(PLAIN_FILE, "LRU")) < 0) {
+        PF_PrintError(PLAIN_FILE);
+        exit(1);
+    }
+    for (i = 0; i < BENCH_PAGES; i++) {
+        if (PF_AllocPage(fd, &pagenum, &pagebuf) != PFE_OK) {
+            PF_PrintError("alloc");
+            exit(1);
+        }
+        fillpage(pagebuf, pagenum, pagenum % 2 != 0);
+        PF_UnfixPage(fd, pagenum, TRUE);
+    }
+    PF_CloseFile(fd);
+    PF_ResetStats();
+    if (PF_ConvertFileFlags(PLAIN_FILE, Z_FILE, PF_CREATE_COMPRESSED)
+                                                        != PFE_OK) {
+        PF_PrintError("convert");
+        exit(1);
+    }
+    PF_GetStats(&stats);
+    printf("compressed %ld pages: ratio %.2f\n", stats.compressWrites,
+           stats.compressRatio);
+    if (readbytes() < 0)
+        fprintf(stderr, "no /proc/self/io: read_bytes not counted\n");
+
+    printf("format,pagesRead,fileKB,readKB,seconds,nsPerPage\n");
+    run("v3", PLAIN_FILE);
+    run("compressed", Z_FILE);
+
+    PF_DestroyFile(PLAIN_FILE);
+    PF_DestroyFile(Z_FILE);
+    return 0;
+}
@@ -0,0 +1,98 @@
+/* benchpf_zc.c: miss latency of recently evicted pages. A file of
+BENCH_PAGES pages laid out as index leaves is read at random through a
+buffer of BENCH_BUFS frames, a small part of it, so that most gets miss.
+The run is done with the compressed page cache off, then with a budget
+large enough for the whole file compressed. The file is opened with
+PF_OPEN_DIRECT, so that a read is a read from the device. For each
+run the # of misses, of pages read from the file, the cache hits and the
+time per miss are printed. */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "pf.h"
+#include "benchpf_util.h"
+
+#define FILE_NAME	"benchzc.db"
+#define BENCH_PAGES	4096		/* # of pages in the file */
+#define BENCH_BUFS	64		/* # of buffers */
+#define BENCH_GETS	100000		/* # of pages read */
+#define CACHE_BYTES	(BENCH_PAGES * (long)PF_PAGE_SIZE)	/* budget */
+
+static long pages[BENCH_PAGES];	/* page numbers of the file */
+
+static void run(char *name, long cachebytes)
+{
+    char check[PF_PAGE_SIZE];
+    PF_Stats stats;
+    long pagenum;
+    char *pagebuf;
+    double start, secs;
+    int fd, i;
+
+    if (PF_SetCompressedCache(cachebytes) != PFE_OK ||
+        (fd = PF_OpenFileFlags(FILE_NAME, "LRU", PF_OPEN_DIRECT)) < 0) {
+        PF_PrintError(FILE_NAME);
+        exit(1);
+    }
+    PF_ResetStats();
+    srandom(564);
+    start = now();
+    for (i = 0; i < BENCH_GETS; i++) {
+        pagenum = pages[random() % BENCH_PAGES];
+        if (PF_GetThisPage(fd, pagenum, &pagebuf) != PFE_OK) {
+            PF_PrintError("get");
+            exit(1);
+        }
+        if (i % 64 == 0) {
+            fillpage(check, pagenum, TRUE);
+            if (memcmp(check, pagebuf, PF_PAGE_SIZE) != 0) {
+                fprintf(stderr, "page %ld: bad data\n", pagenum);
+                exit(1);
+            }
+        }
+        PF_UnfixPage(fd, pagenum, FALSE);
+    }
+    secs = now() - start;
+    PF_GetStats(&stats);
+    printf("%s,%ld,%ld,%ld,%.2f\n", name, stats.bufferMisses,
+           stats.physicalReads, stats.zcacheHits,
+           secs * 1e6 / (stats.bufferMisses > 0 ? stats.bufferMisses : 1));
+    PF_CloseFile(fd);
+}
+
+int main()
+{
+    char *pagebuf;
+    int i, fd;
+    long pagenum;
+
+    PF_Init();
+    set_buffer_size(BENCH_BUFS);
+
+    unlink(FILE_NAME);
+    if (PF_CreateFileFlags(FILE_NAME, PF_CREATE_ALIGNED) != PFE_OK ||
+        (fd = PF_OpenFile(FILE_NAME, "LRU")) < 0) {
+        PF_PrintError(FILE_NAME);
+        exit(1);
+    }
+    for (i = 0; i < BENCH_PAGES; i++) {
+        if (PF_AllocPage(fd, &pagenum, &pagebuf) != PFE_OK) {
+            PF_PrintError("alloc");
+            exit(1);
+        }
+        fillpage(pagebuf, pagenum, TRUE);
+        pages[i] = pagenum;
+        PF_UnfixPage(fd, pagenum, TRUE);
+    }
+    PF_CloseFile(fd);
+
+    printf("cache,misses,pagesRead,zcacheHits,usPerMiss\n");
+    run("off", 0);
+    run("on", CACHE_BYTES);
+    PF_SetCompressedCache(0);
+
+    PF_DestroyFile(FILE_NAME);
+    return 0;
+}
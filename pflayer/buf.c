@@ -1,38 +1,302 @@
 /* buf.c: buffer management routines. The interface routines are:
-PFbufGet(), PFbufUnfix(), PFbufAlloc(), PFbufReleaseFile(), PFbufUsed() and
-PFbufPrint() */
+PFbufGet(), PFbufUnfix(), PFbufAlloc(), PFbufReleaseFile(), PFbufFlushFile(),
+PFbufReadAhead(), PFbufGetPages(), PFbufUsed(), PFbufPrint(),
+PFbufStartCleaner(), PFbufStopCleaner(), PFbufSetQuota(),
+PFbufFileFrames(), PFbufSetPriority(), PFbufDiscard(), PFbufSetFiles(),
+PFbufSetFrameSize() and PFbufSetCacheSize().
+The routines may be called from several threads. A page that is in the
+buffer is found and pinned with only the latch of its hash table shard
+held, and pin counts and frame flags are changed with atomic operations.
+Everything else (the used and free lists, the choice of victims, ghost
+lists and scan rings) is protected by the pool latch PFbuflatch. It is
+not held while pages are read or written: a missing page is put into
+the hash table before it is read in, flagged PF_FRAME_READING, and the
+threads that find it meanwhile wait on the condition of its frame (see
+PFbufWaitRead()); a dirty victim is flagged PF_FRAME_WRITING while it
+is written out (see PFbufEvict()).
+An optional cleaner thread writes out dirty pages ahead of the victim
+choice (see PFbufCleaner()). */
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <time.h>
+#include <sys/mman.h>
 #include "pf.h"
 #include "pftypes.h"
 
+int PF_MAX_BUFS = 20;		/* max # of buffers */
 static int PFnumbpage = 0;	/* # of buffer pages in memory */
-static PFbpage *PFfirstbpage= NULL;	/* ptr to first buffer page, or NULL */
-static PFbpage *PFlastbpage = NULL;	/* ptr to last buffer page, or NULL */
-static PFbpage *PFfreebpage= NULL;	/* list of free buffer pages */
-extern char *malloc();
+static int PFnumhot = 0;	/* # of hot buffer pages (2Q A1m, ARC T2) */
+static int PFarcp = 0;		/* ARC target size of T1 */
+static int PFfirstbpage= PF_FRAME_NONE;	/* first buffer page, or none */
+static int PFlastbpage = PF_FRAME_NONE;	/* last buffer page, or none */
+static int PFfreebpage= PF_FRAME_NONE;	/* list of free buffer pages */
+static int PFclockhand = 0;	/* next frame the CLOCK hand looks at */
+static pthread_mutex_t PFbuflatch = PTHREAD_MUTEX_INITIALIZER; /* pool latch */
+static int PFnumdirty = 0;	/* # of dirty buffer pages */
+
+/* the page cleaner */
+static int PFcleanrun = FALSE;	/* TRUE while the cleaner should run */
+static int PFcleanwanted = FALSE; /* TRUE if a miss met a dirty victim */
+static int PFcleanlow, PFcleanhigh; /* water marks, % of PF_MAX_BUFS dirty */
+static int (*PFcleanwrite)();	/* function to write a page */
+static pthread_t PFcleantid;	/* the cleaner thread */
+static pthread_cond_t PFcleancond = PTHREAD_COND_INITIALIZER;
+				/* wakes up the cleaner, with PFbuflatch */
+static pthread_mutex_t PFcleanlatch = PTHREAD_MUTEX_INITIALIZER;
+				/* held by the cleaner while it writes
+				pages; taken before PFbuflatch */
+
+/* the frames. PFnumframes frames have been set up so far, the page
+bodies live in the arena, everything else in the arrays below, all
+indexed by frame number. A free frame has fd -1. */
+static int PFnumframes = 0;	/* # of frames set up */
+static PFfpage **PFframebody;	/* page body of each frame */
+static char **PFframebase;	/* memory of the body: the body starts
+				there, or a little after (see PFbufFit()) */
+static int *PFframesize;	/* # of bytes of the memory */
+static int *PFframefd;		/* file desciptor of the page */
+static long *PFframepage;	/* page number of the page */
+static int *PFframenext;	/* next in the used or free list */
+static int *PFframeprev;	/* previous in the used list */
+static int *PFframering;	/* file whose scan ring holds the page, or -1 */
+static int *PFframepin;		/* # of pins on the page; it cannot be
+				evicted while this is not 0 */
+static unsigned short *PFframeflags; /* PF_FRAME_xxx flags */
+static pthread_cond_t *PFframecond; /* signalled, with PFbuflatch, when
+				the I/O on the page is over */
+
+#define PFflagIs(f,b)	(__atomic_load_n(&PFframeflags[f],__ATOMIC_ACQUIRE) & (b))
+#define PFflagSet(f,b)	__atomic_fetch_or(&PFframeflags[f],(b),__ATOMIC_ACQ_REL)
+#define PFflagClr(f,b)	__atomic_fetch_and(&PFframeflags[f],~(b),__ATOMIC_ACQ_REL)
+
+/* pin count of a frame, add a pin, drop a pin */
+#define PFpinCount(f)	__atomic_load_n(&PFframepin[f],__ATOMIC_ACQUIRE)
+#define PFpin(f)	__atomic_add_fetch(&PFframepin[f],1,__ATOMIC_ACQ_REL)
+#define PFunpin(f)	__atomic_sub_fetch(&PFframepin[f],1,__ATOMIC_ACQ_REL)
+
+/* pin a frame of file fd, or drop a pin, keeping count of the frames of
+the file that are pinned (see PFbufPinned()) */
+#define PFpinFile(fd,f)	(PFpin(f) == 1? PFbufPinned(fd,1): 0)
+#define PFunpinFile(fd,f) (PFunpin(f) == 0? PFbufPinned(fd,-1): 0)
+
+/* TRUE if the frame can't be evicted: pinned, being cleaned or written
+out, or on its way back to the free list after a failed read */
+#define PFbusy(f)	(PFpinCount(f) > 0 || PFflagIs(f,PF_FRAME_CLEANING| \
+				PF_FRAME_WRITING|PF_FRAME_IOERROR))
+
+/* set or clear the dirty flag of a frame, keeping count of the dirty
+frames. TRUE if the flag changed. A dirty page is not what the compressed
+page cache holds any more */
+#define PFdirtySet(f)	(PFflagClr(f,PF_FRAME_ZCACHED), \
+			(PFflagSet(f,PF_FRAME_DIRTY) & PF_FRAME_DIRTY)? FALSE: \
+			(__atomic_add_fetch(&PFnumdirty,1,__ATOMIC_RELAXED), TRUE))
+#define PFdirtyClr(f)	((PFflagClr(f,PF_FRAME_DIRTY) & PF_FRAME_DIRTY)? \
+			(__atomic_sub_fetch(&PFnumdirty,1,__ATOMIC_RELAXED), TRUE): FALSE)
+
+/* # of dirty frames above which the cleaner starts, and at which it stops */
+#define PFcleanHighMark()	(PFcleanhigh*PF_MAX_BUFS/100)
+#define PFcleanLowMark()	(PFcleanlow*PF_MAX_BUFS/100)
+
+/* buffer quotas of the files, set with PFbufSetQuota(), and the # of
+frames holding pages of each file (see PFbufSetFd()). A file's reserved
+frames are not taken by the other files, and a file at its cap only
+takes its own frames. These arrays, and PFbufring[], have an entry for
+each of the PFnumfiles entries of the file table (see PFbufSetFiles()) */
+static int PFnumfiles = 0;	/* # of files the arrays are set up for */
+static int *PFfileframes;	/* # of frames of the file */
+static int *PFfilemin;		/* reserved # of frames, or 0 */
+static int *PFfilemax;		/* max # of frames, or 0 for none */
+static int *PFfilebody;		/* # of bytes a frame of the file needs,
+				or 0 for PF_FRAME_SIZE */
+static int *PFfileoffset;	/* where the body starts in the memory of
+				a frame of the file */
+static int PFnumquotas = 0;	/* # of files with a quota */
+
+/* # of bytes of the body of a page of file fd in a frame */
+#define PFbodySize(fd)	((PFfilebody[fd] > 0? PFfilebody[fd]: PF_FRAME_SIZE) \
+				- PFfileoffset[fd])
+
+/* set the file of frame f, keeping count of the frames of each file.
+With the pool latch held */
+#define PFbufSetFd(f,fd) { if (PFframefd[f] >= 0) PFfileframes[PFframefd[f]]--; \
+			if ((PFframefd[f]=(fd)) >= 0) PFfileframes[fd]++; }
+
+/* the victim choice under way, with the pool latch held: the frames
+of file PFallocfd's victims may be taken as long as PFquotaon is FALSE,
+or the quotas allow it (see PFbufPickVictim()) */
+static int PFquotaon = FALSE;	/* TRUE if the quotas are obeyed */
+static int PFallocfd;		/* file the frame is for */
+static int PFalloccapped;	/* TRUE if PFallocfd is at its cap */
+#define PFquotaOK(f)	(!PFquotaon || PFframefd[f] < 0 || \
+			PFframefd[f] == PFallocfd || (!PFalloccapped && \
+			PFfileframes[PFframefd[f]] > PFfilemin[PFframefd[f]]))
+
+/* while PFprioon is TRUE, high priority pages are passed over by the
+victim choice (see PFbufPickVictim()) */
+static int PFprioon = FALSE;
+#define PFprioOK(f)	(!PFprioon || !PFflagIs(f,PF_FRAME_PRIO))
+
+/* TRUE if the page of frame f can be the victim */
+#define PFevictable(f)	(!PFbusy(f) && PFquotaOK(f) && PFprioOK(f))
+
+/* give the page of frame f the priority asked for by "hint" */
+#define PFprioHint(f,hint) { if ((hint) & PF_HINT_HIGH) \
+				PFflagSet(f,PF_FRAME_PRIO); \
+			else if ((hint) & PF_HINT_LOW) \
+				PFflagClr(f,PF_FRAME_PRIO); }
+
+/* TRUE if file fd has as many frames as its quota allows */
+#define PFcapped(fd)	(PFfilemax[fd] > 0 && PFfileframes[fd] >= PFfilemax[fd])
+
+/* scan rings: frames recycled by the sequential readers of each file */
+typedef struct PFbuf_ring {
+	int frame[PF_RING_SIZE];	/* frames of the ring */
+	int n;				/* # of frames in the ring */
+	int next;			/* next frame to recycle */
+} PFbuf_ring;
+static PFbuf_ring *PFbufring;
+
+/* max # of frames in a scan ring: PF_RING_SIZE, but no more than a
+quarter of the buffer */
+#define PFbufRingSize()	((PF_MAX_BUFS/4 >= PF_RING_SIZE)? PF_RING_SIZE: \
+			(PF_MAX_BUFS/4 > 0)? PF_MAX_BUFS/4: 1)
+
+
+static PFbufPinned(fd,n)
+int fd;		/* file descriptor */
+int n;		/* 1 if a frame of the file got its first pin, -1 if one
+		lost its last */
+/****************************************************************************
+SPECIFICATIONS:
+	Keep count of the frames of file "fd" that the calling thread
+	pinned less those it unpinned, and of the most it had pinned at
+	once: PF_GetFileStats() adds them up for all the threads.
+
+RETURN VALUE:
+	The # of frames of the file pinned by the thread.
+*****************************************************************************/
+{
+PF_FileStats *st;
 
+	st = PFfileStats(fd);
+	st->pinnedFrames += n;
+	if (st->pinnedFrames > st->pinnedHighWater)
+		st->pinnedHighWater = st->pinnedFrames;
+	return(st->pinnedFrames);
+}
 
-static void PFbufInsertFree(bpage)
-PFbpage *bpage;
+static void PFbufInsertFree(frame)
+int frame;
 /****************************************************************************
 SPECIFICATIONS:
-	Insert the buffer page pointed by "bpage" into the free list.
+	Insert the buffer frame "frame" into the free list.
 
 AUTHOR: clc
 *****************************************************************************/
 {
-	bpage->nextpage = PFfreebpage;
-	PFfreebpage = bpage;
+	PFbufSetFd(frame,-1);
+	PFframering[frame] = -1;
+	PFframepin[frame] = 0;
+	PFframeflags[frame] = 0;
+	PFframenext[frame] = PFfreebpage;
+	PFfreebpage = frame;
 }
 
+static PFbufGrow()
+/****************************************************************************
+SPECIFICATIONS:
+	Set up frames until there are PF_MAX_BUFS of them, and put the new
+	frames into the free list. The first call reserves room for the
+	arrays of frame bookkeeping of PF_MAX_FRAMES frames, which are
+	thus never moved: other threads pin frames, and change their
+	flags, without the pool latch. Each call allocates a page-aligned
+	arena holding the page bodies of the new frames, PF_FRAME_SIZE
+	bytes apart; the bodies already handed out do not move either.
+	The caller holds the pool latch.
+
+RETURN VALUE:
+	PFE_OK	if OK
+	PFE_NOMEM	if no memory.
+
+GLOBAL VARIABLES MODIFIED:
+	PFnumframes, the frame arrays, PFfreebpage
 
-static void PFbufLinkHead(bpage)
-PFbpage *bpage;		/* pointer to buffer page to be linked */
+IMPLEMENTATION NOTES:
+	The room for the arrays is only address space: the memory is
+	given to them as the frames are used.
+*****************************************************************************/
+{
+void *block;	/* new arena */
+char *arena;
+char *p;
+int n;		/* # of frames to add */
+int total;	/* # of frames afterwards */
+int old;	/* # of frames before */
+int i;
+
+	old = PFnumframes;
+	total = (PF_MAX_BUFS < PF_MAX_FRAMES)? PF_MAX_BUFS: PF_MAX_FRAMES;
+	n = total - old;
+
+	if (old == 0){
+		/* the arrays, for as many frames as there can be */
+		if ((p=(char *)mmap(NULL,PF_MAX_FRAMES*(sizeof(pthread_cond_t)
+			+ sizeof(PFfpage *) + sizeof(char *) + sizeof(long) +
+			7*sizeof(int) + sizeof(short)),
+			PROT_READ|PROT_WRITE,MAP_PRIVATE|MAP_ANONYMOUS|
+			MAP_NORESERVE,-1,(off_t)0)) == (char *)MAP_FAILED){
+			PFerrno = PFE_NOMEM;
+			return(PFerrno);
+		}
+#define PFcarve(a,t) { (a) = (t *)p; p += PF_MAX_FRAMES*sizeof(t); }
+		PFcarve(PFframecond,pthread_cond_t);
+		PFcarve(PFframebody,PFfpage *);
+		PFcarve(PFframebase,char *);
+		PFcarve(PFframepage,long);
+		PFcarve(PFframesize,int);
+		PFcarve(PFframefd,int);
+		PFcarve(PFframenext,int);
+		PFcarve(PFframeprev,int);
+		PFcarve(PFframering,int);
+		PFcarve(PFframepin,int);
+		PFcarve(PFframeflags,unsigned short);
+#undef PFcarve
+	}
+
+	if (posix_memalign(&block,PF_ARENA_ALIGN,n*PF_FRAME_SIZE) != 0){
+		PFerrno = PFE_NOMEM;
+		return(PFerrno);
+	}
+	arena = (char *)block;
+
+	/* the padding of a frame is written into aligned files along with
+	the page: keep it clean */
+	memset(arena,0,n*PF_FRAME_SIZE);
+
+	/* new frames go into the free list, lowest one first */
+	for (i=total-1; i >= old; i--){
+		PFframebase[i] = arena + (i-old)*PF_FRAME_SIZE;
+		PFframebody[i] = (PFfpage *)PFframebase[i];
+		PFframesize[i] = PF_FRAME_SIZE;
+		PFframeprev[i] = PF_FRAME_NONE;
+		PFframefd[i] = -1;
+		pthread_cond_init(&PFframecond[i],NULL);
+		PFbufInsertFree(i);
+	}
+	PFnumframes = total;
+	return(PFE_OK);
+}
+
+
+static void PFbufLinkHead(frame)
+int frame;		/* buffer frame to be linked */
 /****************************************************************************
 SPECIFICATIONS:
 
-	Link the buffer page pointed by "bpage" as the head
-	of the used buffer list. No other field of bpage is modified.
+	Link the buffer frame "frame" as the head
+	of the used buffer list. Nothing else about the frame is modified.
 
 AUTHOR: clc
 
@@ -45,23 +309,45 @@ GLOBAL VARIABLES MODIFIED:
 *****************************************************************************/
 {
 
-	bpage->nextpage = PFfirstbpage;
-	bpage->prevpage = NULL;
-	if (PFfirstbpage != NULL)
-		PFfirstbpage->prevpage = bpage;
-	PFfirstbpage = bpage;
-	if (PFlastbpage == NULL)
-		PFlastbpage = bpage;
+	PFframenext[frame] = PFfirstbpage;
+	PFframeprev[frame] = PF_FRAME_NONE;
+	if (PFfirstbpage != PF_FRAME_NONE)
+		PFframeprev[PFfirstbpage] = frame;
+	PFfirstbpage = frame;
+	if (PFlastbpage == PF_FRAME_NONE)
+		PFlastbpage = frame;
 }
-	
-void PFbufUnlink(bpage)
-PFbpage *bpage;		/* buffer page to be unlinked from the used list */
+
+static void PFbufLinkTail(frame)
+int frame;		/* buffer frame to be linked */
+/****************************************************************************
+SPECIFICATIONS:
+	Link the buffer frame "frame" as the tail
+	of the used buffer list, where the LRU walk looks first.
+	Nothing else about the frame is modified.
+
+GLOBAL VARIABLES MODIFIED:
+	PFfirstbpage, PFlastbpage.
+*****************************************************************************/
+{
+
+	PFframeprev[frame] = PFlastbpage;
+	PFframenext[frame] = PF_FRAME_NONE;
+	if (PFlastbpage != PF_FRAME_NONE)
+		PFframenext[PFlastbpage] = frame;
+	PFlastbpage = frame;
+	if (PFfirstbpage == PF_FRAME_NONE)
+		PFfirstbpage = frame;
+}
+
+void PFbufUnlink(frame)
+int frame;		/* buffer frame to be unlinked from the used list */
 /****************************************************************************
 SPECIFICATIONS:
-	Unlink the page pointed by bpage from the buffer list. Assume
-	that bpage is a valid pointer.  Set the "prevpage" and "nextpage"
-	fields to NULL. The caller is responsible to either place
-	the unlinked page into the free list, or insert it back
+	Unlink the frame "frame" from the buffer list. Assume
+	that frame is a valid frame.  Set its list links to
+	PF_FRAME_NONE. The caller is responsible to either place
+	the unlinked frame into the free list, or insert it back
 	into the used list.
 
 AUTHOR: clc
@@ -73,44 +359,598 @@ GLOBAL VARIABLES MODIFIED:
 	PFfirstbpage,PFlastbpage.
 *****************************************************************************/
 {
+int next,prev;
 
-	if (PFfirstbpage == bpage)
-		PFfirstbpage = bpage->nextpage;
-	
-	if (PFlastbpage == bpage)
-		PFlastbpage = bpage->prevpage;
-	
-	if (bpage->nextpage != NULL)
-		bpage->nextpage->prevpage = bpage->prevpage;
-	
-	if (bpage->prevpage != NULL)
-		bpage->prevpage->nextpage = bpage->nextpage;
+	next = PFframenext[frame];
+	prev = PFframeprev[frame];
 
-	bpage->prevpage = bpage->nextpage = NULL;
+	if (PFfirstbpage == frame)
+		PFfirstbpage = next;
 
+	if (PFlastbpage == frame)
+		PFlastbpage = prev;
+
+	if (next != PF_FRAME_NONE)
+		PFframeprev[next] = prev;
+
+	if (prev != PF_FRAME_NONE)
+		PFframenext[prev] = next;
+
+	PFframeprev[frame] = PFframenext[frame] = PF_FRAME_NONE;
+
+}
+
+static int PFbufClockVictim()
+/****************************************************************************
+SPECIFICATIONS:
+	Choose a victim with the CLOCK (second chance) algorithm.
+	The frames are swept in index order, as a circle, starting at
+	PFclockhand. A page whose reference bit is set gets its bit cleared
+	and is passed over; the first unpinned page found with the bit
+	clear is the victim. The victim stays where it is in the used
+	list and the hand is left just past it. Pages the buffer quotas
+	keep (see PFquotaOK()) are passed over as if they were fixed.
+
+RETURN VALUE:
+	The victim, or PF_FRAME_NONE if every page is fixed.
+
+GLOBAL VARIABLES MODIFIED:
+	PFclockhand
+*****************************************************************************/
+{
+int frame;	/* frame under the hand */
+int i;
+
+	/* two full turns: the first may only clear reference bits */
+	for (i=0; i < 2*PFnumframes; i++){
+		frame = PFclockhand;
+		PFclockhand = (PFclockhand+1 < PFnumframes)? PFclockhand+1: 0;
+		if (PFframefd[frame] == -1 || !PFevictable(frame))
+			continue;
+		if (!PFflagIs(frame,PF_FRAME_REF))
+			/* found a page that can be swapped out */
+			return(frame);
+		PFflagClr(frame,PF_FRAME_REF);
+	}
+
+	return(PF_FRAME_NONE);
+}
+
+static int PFbufQueueVictim(wanthot)
+int wanthot;		/* TRUE if we look for a hot page first */
+/****************************************************************************
+SPECIFICATIONS:
+	Choose a victim for the policies that split the buffer into a
+	queue of pages seen once and a queue of hot pages (2Q and ARC).
+	The pages that are not hot are kept in the order they were read
+	in, the hot ones in LRU order, so the victim is the unfixed page
+	nearest to the tail of the used list that is in the wanted queue.
+	If the wanted queue has no unfixed page, the other one is used.
+
+RETURN VALUE:
+	The victim, or PF_FRAME_NONE if every page is fixed.
+*****************************************************************************/
+{
+int frame;	/* temporary frame */
+int pass;
+
+	for (pass=0; pass < 2; pass++){
+		for (frame=PFlastbpage; frame != PF_FRAME_NONE;
+						frame=PFframeprev[frame]){
+			if (PFevictable(frame) &&
+				(PFflagIs(frame,PF_FRAME_HOT) != 0) == wanthot)
+				/* found a page that can be swapped out */
+				return(frame);
+		}
+		wanthot = !wanthot;
+	}
+	return(PF_FRAME_NONE);
+}
+
+static int PFbuf2QVictim()
+/****************************************************************************
+SPECIFICATIONS:
+	Choose a victim with the 2Q algorithm. Pages that are not hot
+	form the probationary queue (A1in), hot pages form the A1m queue.
+	While the probationary queue is longer than PF_2Q_KIN its oldest
+	unfixed page is the victim, so that a page touched only once never
+	pushes out a hot page. Otherwise the least recently used hot page
+	is chosen.
+
+RETURN VALUE:
+	The victim, or PF_FRAME_NONE if every page is fixed.
+*****************************************************************************/
+{
+	return(PFbufQueueVictim(PFnumbpage - PFnumhot <= PF_2Q_KIN));
+}
+
+static int PFbufArcVictim(ghost)
+int ghost;		/* ghost list of the page being read in, or -1 */
+/****************************************************************************
+SPECIFICATIONS:
+	Choose a victim with the ARC algorithm (REPLACE in Megiddo and
+	Modha). Pages that are not hot form T1, hot pages form T2.
+	The oldest page of T1 is chosen when T1 is larger than the
+	target PFarcp, or as large as the target and the page being read
+	in comes from ghost list B2. Otherwise the LRU page of T2 is
+	chosen.
+
+RETURN VALUE:
+	The victim, or PF_FRAME_NONE if every page is fixed.
+*****************************************************************************/
+{
+int nt1;		/* # of pages in T1 */
+
+	nt1 = PFnumbpage - PFnumhot;
+	return(PFbufQueueVictim(!(nt1 > 0 && (nt1 > PFarcp ||
+				(ghost == PF_GHOST_B2 && nt1 == PFarcp)))));
+}
+
+static void PFbufArcAdapt(ghost)
+int ghost;		/* ghost list the missed page was found on */
+/****************************************************************************
+SPECIFICATIONS:
+	Adapt the ARC target size of T1 after a miss on a page remembered
+	in ghost list "ghost": a hit in B1 means T1 was too small and
+	grows the target, a hit in B2 shrinks it. The step is the ratio
+	of the sizes of the two ghost lists, but at least 1.
+
+GLOBAL VARIABLES MODIFIED:
+	PFarcp, PFstats
+*****************************************************************************/
+{
+int nb1,nb2;		/* # of entries in B1 and B2 */
+int delta;
+
+	nb1 = PFghostCount(PF_GHOST_B1);
+	nb2 = PFghostCount(PF_GHOST_B2);
+	if (ghost == PF_GHOST_B1){
+		PFstat(arcGhostRecentHits)++;
+		delta = (nb1 > 0 && nb2/nb1 > 1)? nb2/nb1: 1;
+		PFarcp = (PFarcp+delta < PF_MAX_BUFS)? PFarcp+delta: PF_MAX_BUFS;
+	}
+	else if (ghost == PF_GHOST_B2){
+		PFstat(arcGhostFrequentHits)++;
+		delta = (nb2 > 0 && nb1/nb2 > 1)? nb1/nb2: 1;
+		PFarcp = (PFarcp-delta > 0)? PFarcp-delta: 0;
+	}
+	PFstats.arcTarget = PFarcp;
+}
+
+static void PFbufCleanCheck()
+/****************************************************************************
+SPECIFICATIONS:
+	Called when a page has become dirty: wake up the page cleaner if
+	it runs and the dirty pages are above its high-water mark.
+*****************************************************************************/
+{
+	if (PFcleanrun && __atomic_load_n(&PFnumdirty,__ATOMIC_RELAXED) >
+							PFcleanHighMark())
+		pthread_cond_signal(&PFcleancond);
+}
+
+static void PFbufIODone(frame,flag)
+int frame;	/* buffer frame */
+int flag;	/* PF_FRAME_READING, PF_FRAME_WRITING or PF_FRAME_CLEANING */
+/****************************************************************************
+SPECIFICATIONS:
+	The read or write of the page of "frame" is over: clear "flag",
+	and wake up the threads waiting for it. The caller holds the pool
+	latch.
+*****************************************************************************/
+{
+	PFflagClr(frame,flag);
+	pthread_cond_broadcast(&PFframecond[frame]);
+}
+
+static void PFbufIOWait(frame,flag)
+int frame;	/* buffer frame */
+int flag;	/* PF_FRAME_READING, PF_FRAME_WRITING or PF_FRAME_CLEANING */
+/****************************************************************************
+SPECIFICATIONS:
+	Wait until the read or write of the page of "frame" that "flag"
+	tells of is over (any of them, if "flag" has several). The caller
+	holds the pool latch, which is released while waiting.
+*****************************************************************************/
+{
+	while (PFflagIs(frame,flag))
+		pthread_cond_wait(&PFframecond[frame],&PFbuflatch);
+}
+
+static int PFbufCleanPick(frame,batch,n)
+int frame;		/* frame to look at */
+int *batch;		/* frames picked so far */
+int n;			/* # of frames in batch */
+/****************************************************************************
+SPECIFICATIONS:
+	Add "frame" to the batch of the page cleaner if it holds a dirty
+	page that can be evicted, and mark it PF_FRAME_CLEANING so that it
+	stays in the buffer while it is written out. The caller holds the
+	pool latch.
+
+RETURN VALUE:
+	The new # of frames in batch.
+*****************************************************************************/
+{
+	if (PFframefd[frame] == -1 || PFbusy(frame) ||
+					!PFflagIs(frame,PF_FRAME_DIRTY))
+		return(n);
+	PFflagSet(frame,PF_FRAME_CLEANING);
+	batch[n] = frame;
+	return(n+1);
+}
+
+static void *PFbufCleaner(arg)
+void *arg;		/* not used */
+/****************************************************************************
+SPECIFICATIONS:
+	Body of the page cleaner thread, started by PFbufStartCleaner().
+	Sleep until the dirty pages go above the high-water mark, or a
+	miss had to write out a dirty victim. Then write out dirty pages
+	that can be evicted, PF_CLEAN_BATCH at a time, until the dirty
+	pages are down to the low-water mark (after at least one batch),
+	and go back to sleep.
+
+ALGORITHM:
+	The pages are picked in the order victims would be chosen: from
+	the tail of the used list, where LRU, 2Q and ARC take their
+	victims, for the files that do not use CLOCK, then from the
+	clock hand onwards for the files that do. (The MRU victim is the
+	most recently used page, which is not worth cleaning ahead of
+	time: MRU files are cleaned from the tail like the others.)
+	The pages of a batch are picked with the pool latch held, and
+	written out with only PFcleanlatch held, so that misses and hits
+	go on meanwhile. A page changed while it is written out is marked
+	dirty again by the one who changed it (see PFbufUnfix()).
+
+GLOBAL VARIABLES MODIFIED:
+	PFcleanwanted, the frame flags
+*****************************************************************************/
+{
+int batch[PF_CLEAN_BATCH];	/* frames being cleaned */
+int n;			/* # of frames in batch */
+int frame,i;
+struct timespec until;	/* when to look again anyway */
+
+	pthread_mutex_lock(&PFbuflatch);
+	while (PFcleanrun){
+		if (!PFcleanwanted && PFnumdirty <= PFcleanHighMark()){
+			/* nothing to do: sleep */
+			clock_gettime(CLOCK_REALTIME,&until);
+			until.tv_sec++;
+			pthread_cond_timedwait(&PFcleancond,&PFbuflatch,&until);
+			continue;
+		}
+		PFcleanwanted = FALSE;
+		pthread_mutex_unlock(&PFbuflatch);
+
+		do {
+			/* pick a batch */
+			pthread_mutex_lock(&PFcleanlatch);
+			pthread_mutex_lock(&PFbuflatch);
+			n = 0;
+			for (frame=PFlastbpage; frame != PF_FRAME_NONE &&
+					n < PF_CLEAN_BATCH; frame=PFframeprev[frame])
+				if (PFfilePolicy(PFframefd[frame]) !=
+							PF_POLICY_CLOCK)
+					n = PFbufCleanPick(frame,batch,n);
+			for (i=0; i < PFnumframes && n < PF_CLEAN_BATCH; i++){
+				frame = (PFclockhand+i) % PFnumframes;
+				if (PFframefd[frame] != -1 &&
+					PFfilePolicy(PFframefd[frame]) ==
+							PF_POLICY_CLOCK)
+					n = PFbufCleanPick(frame,batch,n);
+			}
+			pthread_mutex_unlock(&PFbuflatch);
+
+			/* write it out */
+			for (i=0; i < n; i++){
+				frame = batch[i];
+				if (PFdirtyClr(frame)){
+					if ((*PFcleanwrite)(PFframefd[frame],
+						PFframepage[frame],
+						PFframebody[frame]) != PFE_OK)
+						/* leave it to the next miss */
+						PFdirtySet(frame);
+					else {
+						PFfstat(PFframefd[frame],
+							physicalWrites,1);
+						PFstat(backgroundCleans)++;
+					}
+				}
+			}
+			pthread_mutex_lock(&PFbuflatch);
+			for (i=0; i < n; i++)
+				PFbufIODone(batch[i],PF_FRAME_CLEANING);
+			pthread_mutex_unlock(&PFbuflatch);
+			pthread_mutex_unlock(&PFcleanlatch);
+		} while (n > 0 && PFcleanrun &&
+			__atomic_load_n(&PFnumdirty,__ATOMIC_RELAXED) >
+							PFcleanLowMark());
+
+		pthread_mutex_lock(&PFbuflatch);
+	}
+	pthread_mutex_unlock(&PFbuflatch);
+	return(NULL);
+}
+
+static void PFbufUnpinFailed(fd,frame)
+int fd;		/* file descriptor */
+int frame;	/* buffer frame, PF_FRAME_IOERROR */
+/****************************************************************************
+SPECIFICATIONS:
+	Drop a pin on "frame", whose page could not be read in and is no
+	longer in the hash table. The last pin gives the frame back to the
+	free list. The caller holds the pool latch, so that no victim
+	choice sees the frame unpinned before that.
+*****************************************************************************/
+{
+	if (PFunpin(frame) > 0)
+		return;
+	PFbufPinned(fd,-1);
+	if (PFflagIs(frame,PF_FRAME_HOT))
+		PFnumhot--;
+	PFbufUnlink(frame);
+	PFbufInsertFree(frame);
+	PFnumbpage--;
+}
+
+static PFbufEvict(frame,writefcn,miss)
+int frame;		/* victim */
+int (*writefcn)();
+int miss;		/* TRUE if room is made for a page being read in */
+/****************************************************************************
+SPECIFICATIONS:
+	Take the page of victim "frame" out of the buffer: write it out
+	if it is dirty, and delete it from the hash table. The caller
+	holds the pool latch; it is released while the page is written,
+	so the caller must expect the lists to have changed when this
+	returns. If "miss" is TRUE, writing the page counts as a
+	foreground dirty eviction and wakes up the page cleaner.
+
+RETURN VALUE:
+	PFE_OK	if the frame can be reused.
+	PFE_PAGEFIXED	if another thread found the page in the hash table
+		while it was being written out: it has been pinned, or made
+		dirty again. The caller chooses another victim.
+	PF error code if error writing the page.
+
+IMPLEMENTATION NOTES:
+	The dirty flag is cleared before the write, so a change made while
+	the write is going on leaves the page dirty. The frame is flagged
+	PF_FRAME_WRITING meanwhile, so that no other thread takes it, and
+	PFbufReleaseFile() waits for it. The page is only deleted once no
+	thread can be pinning it, that is with the latch of its hash table
+	shard held.
+*****************************************************************************/
+{
+int fd;
+long page;
+int error;
+
+	fd = PFframefd[frame];
+	page = PFframepage[frame];
+
+	/* write out the dirty page, without the pool latch */
+	if (PFdirtyClr(frame)){
+		PFflagSet(frame,PF_FRAME_WRITING);
+		pthread_mutex_unlock(&PFbuflatch);
+		error = (*writefcn)(fd,page,PFframebody[frame]);
+		pthread_mutex_lock(&PFbuflatch);
+		PFbufIODone(frame,PF_FRAME_WRITING);
+		if (error != PFE_OK){
+			PFdirtySet(frame);
+			return(error);
+		}
+		PFfstat(fd,physicalWrites,1);
+		if (miss){
+			PFstat(foregroundDirtyEvictions)++;
+			PFfcount(fd,dirtyEvictions,1);
+			if (PFcleanrun){
+				PFcleanwanted = TRUE;
+				pthread_cond_signal(&PFcleancond);
+			}
+		}
+	}
+
+	/* unlink from hash table, unless someone got to the page */
+	PFhashLatch(fd,page);
+	if (PFpinCount(frame) > 0 || PFflagIs(frame,PF_FRAME_DIRTY)){
+		PFhashUnlatch(fd,page);
+		return(PFE_PAGEFIXED);
+	}
+	error = PFhashDelete(fd,page);
+	PFhashUnlatch(fd,page);
+
+	/* a copy of the page in the compressed page cache, but for the
+	one the frame was read from, is older than the page */
+	if (!PFflagIs(frame,PF_FRAME_ZCACHED))
+		PFzcacheDelete(fd,page);
+	if (error == PFE_OK && miss)
+		PFfcount(fd,evictions,1);
+	if (error == PFE_OK &&
+		(PFflagClr(frame,PF_FRAME_READAHEAD) & PF_FRAME_READAHEAD))
+		/* read ahead for nothing */
+		PFfstat(fd,readAheadWasted,1);
+	return(error);
+}
+
+static int PFbufIOFrame()
+/****************************************************************************
+SPECIFICATIONS:
+	Find a frame that is not pinned, but is busy being written out
+	by the page cleaner, a flush or another miss. The caller holds
+	the pool latch.
+
+RETURN VALUE:
+	The frame, or PF_FRAME_NONE if there is none.
+*****************************************************************************/
+{
+int frame;
+
+	for (frame=PFlastbpage; frame != PF_FRAME_NONE;
+					frame=PFframeprev[frame])
+		if (PFpinCount(frame) == 0 && !PFflagIs(frame,PF_FRAME_IOERROR)
+			&& PFflagIs(frame,PF_FRAME_CLEANING|PF_FRAME_WRITING))
+			return(frame);
+	return(PF_FRAME_NONE);
+}
+
+static PFbufPickVictim(frame,policy,fd,ghost,writefcn,quotaonly)
+int *frame;	/* set to the victim, or PF_FRAME_NONE */
+int policy;	/* replacement policy, PF_POLICY_xxx */
+int fd;		/* file the frame is for */
+int ghost;	/* ghost list of the page to be read in, or -1 */
+int (*writefcn)();
+int quotaonly;	/* TRUE if the buffer quotas must be obeyed */
+/****************************************************************************
+SPECIFICATIONS:
+	Choose a victim according to "policy" for a page of file "fd",
+	write it out if it is dirty, and take it out of the hash table
+	(see PFbufInternalAlloc()). The caller holds the pool latch.
+	The victim is chosen among the low priority pages the buffer
+	quotas allow (see PFquotaOK()); if there is none, among all the
+	pages the quotas allow. Then, if "quotaonly" is FALSE, the same
+	over all the pages, so that the quotas never make a page miss
+	fail. High priority pages (see PFbufSetPriority()) are thus
+	replaced only once no low priority page can be. If the only pages
+	that could be replaced are being written out, the write of one of
+	them is waited for, and the victim chosen again.
+
+RETURN VALUE:
+	PFE_OK	if no error. *frame is PF_FRAME_NONE if "quotaonly" is
+		TRUE and the quotas allow no victim.
+	PFE_NOBUF	if all pages are fixed.
+	PF error code if error writing the page.
+
+GLOBAL VARIABLES MODIFIED:
+	PFquotaon, PFprioon, PFallocfd, PFalloccapped
+
+IMPLEMENTATION NOTES:
+	The globals of the victim choice are set again for each try:
+	another thread may have made a choice of its own while the pool
+	latch was released to write out a victim.
+*****************************************************************************/
+{
+int tframe;		/* temporary frame */
+int error;		/* error value returned*/
+int quotaon;		/* TRUE while the quotas are obeyed */
+int prioon;		/* TRUE while high priority pages are passed over */
+
+	quotaon = (PFnumquotas > 0);
+	prioon = TRUE;
+	for (;;){
+		PFallocfd = fd;
+		PFalloccapped = PFcapped(fd);
+		PFquotaon = quotaon;
+		PFprioon = prioon;
+		///
+		if(policy == PF_POLICY_CLOCK){
+			tframe = PFbufClockVictim();
+		}
+		else if(policy == PF_POLICY_2Q){
+			tframe = PFbuf2QVictim();
+		}
+		else if(policy == PF_POLICY_ARC){
+			tframe = PFbufArcVictim(ghost);
+		}
+		else if(policy == PF_POLICY_MRU){
+			// MRU
+			for (tframe=PFfirstbpage; tframe != PF_FRAME_NONE;
+						tframe=PFframenext[tframe]){
+				if (PFevictable(tframe))
+					/* found a page that can be swapped out */
+					break;
+			}
+		}
+		else{
+			// LRU
+			for (tframe=PFlastbpage; tframe != PF_FRAME_NONE;
+						tframe=PFframeprev[tframe]){
+				if (PFevictable(tframe))
+					/* found a page that can be swapped out */
+					break;
+			}
+		}
+
+		if (tframe == PF_FRAME_NONE && prioon){
+			/* try again with the high priority pages */
+			prioon = FALSE;
+			continue;
+		}
+		if (tframe == PF_FRAME_NONE && quotaon && !quotaonly){
+			/* try again without the quotas */
+			quotaon = FALSE;
+			prioon = TRUE;
+			continue;
+		}
+		if (tframe == PF_FRAME_NONE && !quotaonly &&
+				(tframe=PFbufIOFrame()) != PF_FRAME_NONE){
+			/* wait for a page being written out, and try again */
+			PFbufIOWait(tframe,PF_FRAME_CLEANING|PF_FRAME_WRITING);
+			quotaon = (PFnumquotas > 0);
+			prioon = TRUE;
+			continue;
+		}
+		if (tframe == PF_FRAME_NONE){
+			PFquotaon = PFprioon = FALSE;
+			*frame = PF_FRAME_NONE;
+			if (quotaonly)
+				return(PFE_OK);
+			/* couldn't find a free page */
+			PFerrno = PFE_NOBUF;
+			return(PFerrno);
+		}
+
+		/* write out the dirty page, and unlink from hash table */
+		if ((error=PFbufEvict(tframe,writefcn,TRUE)) != PFE_PAGEFIXED)
+			break;
+	}
+	PFquotaon = PFprioon = FALSE;
+	*frame = tframe;
+	return(error);
 }
 
 ///
-static PFbufInternalAlloc(bpage,writefcn,fdd)
-PFbpage **bpage;	/* pointer to pointer to buffer bpage to be allocated*/
+static PFbufPickFrame(frame,writefcn,fdd,ghost)
+int *frame;	/* pointer to buffer frame to be allocated*/
 int (*writefcn)();
 int fdd; // file descriptor
+int ghost;	/* ghost list of the page to be read in, or -1 */
 /****************************************************************************
 SPECIFICATIONS:
-	Allocate a buffer page and set *bpage to point to it. *bpage
-	is set to NULL if one can not be allocated.
-	The "nextpage" and "prevpage" fields of *bpage are linked as
-	the head of the list of used buffers.All the other fields are undefined.
+	Allocate a buffer frame and set *frame to it. *frame
+	is set to PF_FRAME_NONE if one can not be allocated.
+	The frame is linked as the head of the list of used buffers.
+	Its page, fd and flags are undefined.
 	writefcn() is used to write pages. (See PFbufGet()).
 
 ALGORITHM:
 	If there is something on the free list, then use it.
-	If free list is empty, and there are less than PF_MAX_BUFS 
-	number of pages allocated, then malloc() one.
+	If free list is empty, and there are less than PF_MAX_BUFS
+	frames set up (the first time, or after set_buffer_size()),
+	then set up more with PFbufGrow().
 	Otherwise, choose a victim to write out, and then use that
-	page as the page to be used.
+	page as the page to be used; the victim is put into the
+	compressed page cache (see zcache.c). The victim is chosen according to
+	the replacement policy of file "fdd": LRU and MRU walk the used
+	list from its tail or head, CLOCK sweeps the frames with the clock
+	hand (see PFbufClockVictim()) and leaves the victim in place, 2Q
+	takes the victim from the probationary or the hot queue (see
+	PFbuf2QVictim()), ARC takes it from T1 or T2 depending on its
+	adaptive target (see PFbufArcVictim()). A probationary page
+	evicted under 2Q is remembered in the A1out ghost list; a page
+	evicted under ARC in ghost list B1 or B2, whose lengths are
+	kept to |T1|+|B1| <= PF_MAX_BUFS and |B1|+|B2| <= PF_MAX_BUFS.
 	If a victim cannot be chosen (because all the pages are fixed),
-	then return error.
+	then return error. A victim that another thread pins while it
+	is being written out (see PFbufEvict()) is passed over and the
+	choice is made again. The caller holds the pool latch, which is
+	released while a victim is written out.
+	The victim is chosen with the buffer quotas of the files in mind
+	(see PFbufPickVictim()). A file that has as many frames as its
+	cap allows replaces one of its own pages even if the free list is
+	not empty; the free list is used when it has none to give up.
 
 AUTHOR: clc
 
@@ -124,190 +964,933 @@ GLOBAL VARIABLES MODIFIED:
 	PFnumbpage, PFfirstbpage, PFlastbpage, PFfreebpage
 *****************************************************************************/
 {
-PFbpage *tbpage;	/* temporary pointer to buffer page */
+int tframe;		/* temporary frame */
 int error;		/* error value returned*/
 
 ///
-int pr_strategy = get_PFftab(fdd).mru; // page replacement strategy : 0 = LRU or 1 = MRU
-// int pr_strategy = 1;
+int pr_strategy = PFfilePolicy(fdd); // page replacement strategy : PF_POLICY_xxx
+
+	*frame = PF_FRAME_NONE;		/* set initial return value */
+
+	do {
+		if (PFfreebpage == PF_FRAME_NONE &&
+				PFnumframes < PF_MAX_BUFS &&
+				PFnumframes < PF_MAX_FRAMES &&
+				(error=PFbufGrow()) != PFE_OK)
+			/* no mem */
+			return(error);
+
+		/* a file at its cap takes one of its own pages rather
+		than a free frame, if it can */
+		tframe = PF_FRAME_NONE;
+		if ((PFfreebpage == PF_FRAME_NONE || PFcapped(fdd)) &&
+			(error=PFbufPickVictim(&tframe,pr_strategy,fdd,ghost,
+				writefcn,PFfreebpage != PF_FRAME_NONE)) != PFE_OK)
+			return(error);
 
-	/* Set *bpage to the buffer page to be returned */
-	if (PFfreebpage != NULL){
+		/* the free list may have been emptied by another thread
+		while the pool latch was released to write out a victim */
+	} while (tframe == PF_FRAME_NONE && PFfreebpage == PF_FRAME_NONE);
+
+	/* Set *frame to the buffer frame to be returned */
+	if (tframe == PF_FRAME_NONE){
 		/* Free list not empty, use the one from the free list. */
-		*bpage = PFfreebpage;
-		PFfreebpage = (*bpage)->nextpage;
+		*frame = PFfreebpage;
+		PFfreebpage = PFframenext[*frame];
+		/* increment # of pages in use */
+		PFnumbpage++;
 	}
-	else if (PFnumbpage < PF_MAX_BUFS){
-		/* We have not reached max buffer limit, so
-		malloc() a new one */
-		if ((*bpage=(PFbpage *)malloc(sizeof(PFbpage)))==NULL){
-			/* no mem */
-			*bpage = NULL;
-			PFerrno = PFE_NOMEM;
-			return(PFerrno);
+	else {
+		/* the victim has been written out, and is no longer in
+		the hash table */
+
+		if (pr_strategy == PF_POLICY_2Q &&
+					!PFflagIs(tframe,PF_FRAME_HOT)){
+			/* remember the probationary page in A1out */
+			if (PFghostInsert(PF_GHOST_A1OUT,PFframefd[tframe],
+					PFframepage[tframe]) == PFE_OK &&
+				PFghostCount(PF_GHOST_A1OUT) > PF_2Q_KOUT)
+				PFghostDropOldest(PF_GHOST_A1OUT);
 		}
-		/* increment # of pages allocated */
-		PFnumbpage++;
+		else if (pr_strategy == PF_POLICY_ARC){
+			/* remember the page in B1 or B2 */
+			if (PFghostInsert(PFflagIs(tframe,PF_FRAME_HOT)?
+					PF_GHOST_B2: PF_GHOST_B1,
+					PFframefd[tframe],
+					PFframepage[tframe]) == PFE_OK){
+				if (PFnumbpage-PFnumhot-
+					!PFflagIs(tframe,PF_FRAME_HOT) +
+					PFghostCount(PF_GHOST_B1) > PF_MAX_BUFS)
+					PFghostDropOldest(PF_GHOST_B1);
+				if (PFghostCount(PF_GHOST_B1) +
+					PFghostCount(PF_GHOST_B2) > PF_MAX_BUFS)
+					PFghostDropOldest(PF_GHOST_B2);
+			}
+		}
+
+		if (PFflagIs(tframe,PF_FRAME_HOT)){
+			PFflagClr(tframe,PF_FRAME_HOT);
+			PFnumhot--;
+		}
+
+		/* keep the page, clean now, in the compressed page cache.
+		It may be there already, as it was read in */
+		if (!PFflagIs(tframe,PF_FRAME_ZCACHED) ||
+			!PFzcacheTouch(PFframefd[tframe],PFframepage[tframe]))
+			PFzcachePut(PFframefd[tframe],PFframepage[tframe],
+					(char *)PFframebody[tframe],
+					PFbodySize(PFframefd[tframe]));
+
+		/* the frame leaves any scan ring it was in */
+		PFframering[tframe] = -1;
+
+		*frame = tframe;
+
+		if (pr_strategy == PF_POLICY_CLOCK)
+			/* the clock victim keeps its place in the list */
+			return(PFE_OK);
+
+		/* unlink from buffer list */
+		PFbufUnlink(tframe);
+
+	}
+
+	/* Link the page as the head of the used list */
+	PFbufLinkHead(*frame);
+	return(PFE_OK);
+}
+
+static PFbufFit(frame,fd)
+int frame;	/* buffer frame */
+int fd;		/* file descriptor of the page to be put in it */
+/****************************************************************************
+SPECIFICATIONS:
+	Make sure buffer frame "frame" is set up for a page of file "fd"
+	(see PFbufSetFrameSize()): its memory must be large enough, as
+	the pages may be larger than PF_PAGE_SIZE, and the body starts
+	where the file wants it. A frame whose memory is too small gets
+	new memory, PF_ARENA_ALIGN aligned and zeroed, in place of its
+	slot of the arena. Memory that has once been enlarged stays so.
+
+RETURN VALUE:
+	PFE_OK	if OK
+	PFE_NOMEM	if no memory.
+
+GLOBAL VARIABLES MODIFIED:
+	PFframebody, PFframebase, PFframesize
+*****************************************************************************/
+{
+void *body;
+int size;
+
+	size = PFfilebody[fd];
+	if (size <= PFframesize[frame]){
+		PFframebody[frame] = (PFfpage *)(PFframebase[frame] +
+							PFfileoffset[fd]);
+		return(PFE_OK);
+	}
+
+	if (posix_memalign(&body,PF_ARENA_ALIGN,size) != 0){
+		PFerrno = PFE_NOMEM;
+		return(PFerrno);
+	}
+	memset((char *)body,0,size);
+
+	/* the slot of the arena is lost until the buffer is freed */
+	if (PFframesize[frame] > PF_FRAME_SIZE)
+		free(PFframebase[frame]);
+	PFframebase[frame] = (char *)body;
+	PFframebody[frame] = (PFfpage *)(PFframebase[frame] +
+							PFfileoffset[fd]);
+	PFframesize[frame] = size;
+	return(PFE_OK);
+}
+
+static PFbufInternalAlloc(frame,writefcn,fdd,ghost)
+int *frame;	/* pointer to buffer frame to be allocated*/
+int (*writefcn)();
+int fdd;	/* file descriptor */
+int ghost;	/* ghost list of the page to be read in, or -1 */
+/****************************************************************************
+SPECIFICATIONS:
+	Allocate a buffer frame for a page of file "fdd" with
+	PFbufPickFrame(), and see that it is large enough for the page
+	(see PFbufFit()). A frame that can not be made large enough is
+	put back into the free list.
+
+RETURN VALUE:
+	PFE_OK	if no error.
+	PF error code if error.
+
+GLOBAL VARIABLES MODIFIED:
+	PFnumbpage, PFfirstbpage, PFlastbpage, PFfreebpage
+*****************************************************************************/
+{
+int error;
+
+	if ((error=PFbufPickFrame(frame,writefcn,fdd,ghost)) != PFE_OK)
+		return(error);
+	if ((error=PFbufFit(*frame,fdd)) != PFE_OK){
+		PFbufUnlink(*frame);
+		PFbufInsertFree(*frame);
+		PFnumbpage--;
+		*frame = PF_FRAME_NONE;
+		return(error);
+	}
+	return(PFE_OK);
+}
+
+static PFbufRingAlloc(frame,writefcn,fd)
+int *frame;		/* pointer to buffer frame allocated */
+int (*writefcn)();
+int fd;			/* file descriptor of the sequential reader */
+/****************************************************************************
+SPECIFICATIONS:
+	Allocate a buffer frame for a sequential read of file "fd", the
+	way PFbufInternalAlloc() does, but from the scan ring of the file:
+	a small set of frames (at most PF_RING_SIZE, and no more than a
+	quarter of the buffer) that the sequential readers of the file
+	recycle among themselves. A full scan thus goes through the ring
+	instead of pushing the rest of the buffer out.
+	The frame is linked at the tail of the used list.
+
+ALGORITHM:
+	Frames that were taken away from the ring (evicted by someone
+	else, or adopted by a random access, see PFbufGet()) are
+	dropped from it first. If the ring is not full, a frame is
+	allocated with PFbufInternalAlloc() and added to the ring.
+	Otherwise the oldest unfixed frame of the ring is written out
+	if dirty and reused. If all the frames of the ring are fixed,
+	the frame is allocated with PFbufInternalAlloc() outside the ring.
+
+RETURN VALUE:
+	PFE_OK	if no error.
+	PF error code if error.
+
+GLOBAL VARIABLES MODIFIED:
+	PFbufring
+*****************************************************************************/
+{
+PFbuf_ring *ring;	/* ring of the file */
+int tframe;		/* temporary frame */
+int size;		/* max # of frames in the ring */
+int error;
+int i,slot;
+
+	ring = &PFbufring[fd];
+	size = PFbufRingSize();
+
+	/* drop the frames that have left the ring */
+	for (i=0; i < ring->n; )
+		if (PFframering[ring->frame[i]] != fd)
+			ring->frame[i] = ring->frame[--ring->n];
+		else	i++;
+	if (ring->next >= ring->n)
+		ring->next = 0;
+
+	if (ring->n < size){
+		/* ring not full yet: take one more frame */
+		if ((error=PFbufInternalAlloc(frame,writefcn,fd,-1))!= PFE_OK)
+			return(error);
+
+		/* the victim may have been a frame of the ring itself, and
+		other scans may have filled the ring while the pool latch
+		was released to write out a victim: the frame then stays
+		out of it */
+		for (i=0; i < ring->n && ring->frame[i] != *frame; i++);
+		if (i == ring->n && ring->n >= size)
+			return(PFE_OK);
+		if (i == ring->n)
+			ring->frame[ring->n++] = *frame;
+		PFframering[*frame] = fd;
+		PFbufUnlink(*frame);
+		PFbufLinkTail(*frame);
+		return(PFE_OK);
+	}
+
+	/* recycle the oldest unfixed frame of the ring */
+	for (i=0; i < ring->n; i++){
+		slot = (ring->next + i) % ring->n;
+		tframe = ring->frame[slot];
+		if (PFbusy(tframe))
+			continue;
+
+		/* write out the dirty page, and unlink from hash table */
+		if ((error=PFbufEvict(tframe,writefcn,TRUE)) == PFE_PAGEFIXED)
+			continue;
+		if (error != PFE_OK)
+			return(error);
+
+		/* the ring may have changed while the page was written */
+		ring->next = (ring->n > 0)? (slot+1) % ring->n: 0;
+		PFbufUnlink(tframe);
+		PFbufLinkTail(tframe);
+		*frame = tframe;
+		return(PFE_OK);
+	}
+
+	/* every frame of the ring is fixed */
+	return(PFbufInternalAlloc(frame,writefcn,fd,-1));
+}
+
+static PFbufLookupPin(fd,pagenum,excl,frame)
+int fd;		/* file descriptor */
+long pagenum;	/* page number */
+int excl;	/* TRUE if the page must not be fixed already */
+int *frame;	/* set to the buffer frame of the page */
+/****************************************************************************
+SPECIFICATIONS:
+	Look up page "pagenum" of file "fd" in the hash table and, if it
+	is there, pin it. Only the latch of the hash table shard of the
+	page is taken, so that the page can't be evicted in between.
+
+RETURN VALUE:
+	PFE_OK	if the page was found and pinned.
+	PFE_PAGEFIXED	if "excl" is TRUE and the page is already fixed.
+		*frame is set, the page is not pinned.
+	PFE_HASHNOTFOUND	if the page is not in the buffer.
+*****************************************************************************/
+{
+int error;
+
+	PFhashLatch(fd,pagenum);
+	if ((*frame=PFhashFind(fd,pagenum)) == PF_FRAME_NONE)
+		error = PFE_HASHNOTFOUND;
+	else if (excl && PFpinCount(*frame) > 0)
+		error = PFE_PAGEFIXED;
+	else {
+		PFpinFile(fd,*frame);
+		error = PFE_OK;
+	}
+	PFhashUnlatch(fd,pagenum);
+	return(error);
+}
+
+static void PFbufReadDone(fd,frame,error)
+int fd;		/* file descriptor */
+int frame;	/* buffer frame, PF_FRAME_READING, pinned by the caller */
+int error;	/* what reading the page returned */
+/****************************************************************************
+SPECIFICATIONS:
+	The page of "frame", in the hash table while it was read in, is
+	there if "error" is PFE_OK: let the threads waiting for it go on.
+	Otherwise take it out of the hash table, so that nobody else finds
+	it, and flag the frame PF_FRAME_IOERROR for the waiting threads to
+	give up their pins, and drop the caller's pin (see
+	PFbufUnpinFailed()). The caller does not hold the pool latch.
+*****************************************************************************/
+{
+	pthread_mutex_lock(&PFbuflatch);
+	if (error != PFE_OK){
+		PFhashLatch(fd,PFframepage[frame]);
+		PFhashDelete(fd,PFframepage[frame]);
+		PFhashUnlatch(fd,PFframepage[frame]);
+		PFflagSet(frame,PF_FRAME_IOERROR);
+	}
+	PFbufIODone(frame,PF_FRAME_READING);
+	if (error != PFE_OK)
+		PFbufUnpinFailed(fd,frame);
+	pthread_mutex_unlock(&PFbuflatch);
+}
+
+static int PFbufWaitRead(fd,frame)
+int fd;		/* file descriptor */
+int frame;	/* buffer frame found in the hash table, pinned by the caller */
+/****************************************************************************
+SPECIFICATIONS:
+	Wait until the page of "frame" is there, if another thread is
+	still reading it in. If the read failed, the caller's pin is
+	dropped (see PFbufUnpinFailed()).
+
+RETURN VALUE:
+	TRUE if the page is there, FALSE if it could not be read.
+*****************************************************************************/
+{
+int ok;
+
+	if (!PFflagIs(frame,PF_FRAME_READING|PF_FRAME_IOERROR))
+		/* most of the time */
+		return(TRUE);
+	pthread_mutex_lock(&PFbuflatch);
+	PFbufIOWait(frame,PF_FRAME_READING);
+	ok = !PFflagIs(frame,PF_FRAME_IOERROR);
+	if (!ok)
+		PFbufUnpinFailed(fd,frame);
+	pthread_mutex_unlock(&PFbuflatch);
+	return(ok);
+}
+
+static void PFbufTouch(fd,frame)
+int fd;		/* file descriptor */
+int frame;	/* buffer frame, pinned by the caller */
+/****************************************************************************
+SPECIFICATIONS:
+	Make the page in "frame" the most recently used one; for a file
+	using the CLOCK policy only its reference bit is set, and a page
+	in the 2Q probationary queue or in a scan ring keeps its place.
+
+IMPLEMENTATION NOTES:
+	The used list is only reordered if the pool latch is free. When
+	another thread holds it (it may be reading a page in) the reference
+	bit is set instead, and the page keeps its place: an approximation
+	of LRU that keeps buffer hits from waiting on I/O.
+*****************************************************************************/
+{
+int policy;	/* replacement policy of the file */
+
+	if (__atomic_load_n(&PFframering[frame],__ATOMIC_RELAXED) != -1)
+		/* pages of a scan ring never become recently used */
+		return;
+
+	policy = PFfilePolicy(fd);
+	if (policy == PF_POLICY_CLOCK || pthread_mutex_trylock(&PFbuflatch) != 0){
+		PFflagSet(frame,PF_FRAME_REF);
+		return;
+	}
+
+	if (policy != PF_POLICY_2Q || PFflagIs(frame,PF_FRAME_HOT)){
+		/* unlink this page, and insert it as head of the list */
+		PFbufUnlink(frame);
+		PFbufLinkHead(frame);
+	}
+	pthread_mutex_unlock(&PFbuflatch);
+}
+
+static void PFbufHit(frame,policy,hint)
+int frame;	/* frame of the page, pinned by the caller */
+int policy;	/* replacement policy of the file */
+int hint;	/* how the page is accessed, PF_HINT_xxx flags */
+/****************************************************************************
+SPECIFICATIONS:
+	Account for a buffer hit on the page in "frame" (see PFbufGet()).
+	The caller does not hold the pool latch.
+*****************************************************************************/
+{
+	PFfstat(PFframefd[frame],bufferHits,1);
+	PFprioHint(frame,hint);
+	if (PFflagIs(frame,PF_FRAME_READAHEAD) &&
+		(PFflagClr(frame,PF_FRAME_READAHEAD) & PF_FRAME_READAHEAD))
+		PFfstat(PFframefd[frame],readAheadHits,1);
+
+	/* a random access takes the page out of its scan ring */
+	if (!(hint & PF_HINT_SEQ))
+		__atomic_store_n(&PFframering[frame],-1,__ATOMIC_RELAXED);
+
+	/* ARC: a hit moves the page from T1 to T2 */
+	if (policy == PF_POLICY_ARC && !PFflagIs(frame,PF_FRAME_HOT) &&
+				PFframering[frame] == -1){
+		pthread_mutex_lock(&PFbuflatch);
+		if (!(PFflagSet(frame,PF_FRAME_HOT) & PF_FRAME_HOT))
+			PFnumhot++;
+		pthread_mutex_unlock(&PFbuflatch);
+	}
+}
+
+
+/************************* Interface to the Outside World ****************/
+
+PFbufGet(fd,pagenum,fpage,readfcn,writefcn,hint)
+int fd;	/* file descriptor */
+long pagenum;	/* page number */
+PFfpage **fpage;	/* pointer to pointer to file page */
+int (*readfcn)();	/* function to read a page */
+int (*writefcn)();	/* function to write a page */
+int hint;	/* how the page is accessed, PF_HINT_xxx flags */
+/****************************************************************************
+SPECIFICATIONS:
+	Get a page whose number is "pagenum" from the file pointed
+	by "fd". Set *fpage to point to the data for that page.
+	This function requires two functions:
+		readfcn(fd,pagenum,fpage)
+		int fd;
+		long pagenum;
+		PFfpage *fpage;
+	which will read one page whose number is "pagenum" from the file "fd"
+	into the buffer area pointed by "fpage".
+		writefcn(fd,pagenum,fpage)
+		int fd;
+		long pagenum;
+		PFpage *fpage;
+	which will write one page into the file.
+	The page gets one more pin; a page already fixed in the buffer
+	is shared, unless "hint" has PF_HINT_EXCL.
+	If "hint" has PF_HINT_SEQ the page is part of a sequential scan:
+	on a miss it is read into the scan ring of the file (see
+	PFbufRingAlloc()) and it is not made recently used. A page of a
+	scan ring that is accessed without PF_HINT_SEQ leaves the ring
+	and is treated like any other page from then on.
+	A page found in the buffer is pinned under the latch of its hash
+	table shard only. A missing page is given a frame with the pool
+	latch held, and put into the hash table flagged PF_FRAME_READING
+	before it is read in with the latch released: two threads never
+	read in the same page, and a thread that finds the page meanwhile
+	waits for it (see PFbufWaitRead()). It is taken from the
+	compressed page cache instead if it is there.
+
+RETURN VALUE:
+	PFE_OK	if no error.
+	PF error code if error.
+	PFE_PAGEFIXED if "hint" has PF_HINT_EXCL and the page is already
+	fixed. *fpage is still set to point to the buffer page of the
+	page in memory.
+
+GLOBAL VARIABLES MODIFIED:
+*****************************************************************************/
+{
+int frame;	/* buffer frame */
+int error;
+int policy;	/* replacement policy of the file */
+int ghost;	/* ghost list the page is remembered in, or -1 */
+int latched;	/* TRUE if we hold the pool latch */
+int zhit;	/* TRUE if the page came from the compressed page cache */
+
+	policy = PFfilePolicy(fd);
+
+again:
+	/* most of the time the page is in the buffer already */
+	error = PFbufLookupPin(fd,pagenum,hint & PF_HINT_EXCL,&frame);
+	latched = (error == PFE_HASHNOTFOUND);
+	if (latched){
+		/* page not in buffer: latch the pool, and look again in
+		case another thread has just read it in. */
+		pthread_mutex_lock(&PFbuflatch);
+		error = PFbufLookupPin(fd,pagenum,hint & PF_HINT_EXCL,&frame);
+	}
+
+	if (error == PFE_HASHNOTFOUND){
+		/* see if the page was evicted not long ago */
+		ghost = (!(hint & PF_HINT_SEQ) && (policy == PF_POLICY_2Q ||
+				policy == PF_POLICY_ARC))?
+				PFghostFind(fd,pagenum): -1;
+		if (policy == PF_POLICY_ARC && !(hint & PF_HINT_SEQ))
+			PFbufArcAdapt(ghost);
+
+		/* allocate an empty page */
+		/// (added fd)
+		if (hint & PF_HINT_SEQ)
+			error = PFbufRingAlloc(&frame,writefcn,fd);
+		else	error = PFbufInternalAlloc(&frame,writefcn,fd,ghost);
+		if (error != PFE_OK){
+			/* error */
+			pthread_mutex_unlock(&PFbuflatch);
+			*fpage = NULL;
+			return(error);
+		}
+
+		/* the page may have been evicted not long ago, and still
+		be in the compressed page cache */
+		zhit = PFzcacheGet(fd,pagenum,(char *)PFframebody[frame],
+							PFbodySize(fd));
+
+		/* set the fields for this page, and fix it */
+		PFbufSetFd(frame,fd);
+		PFframepage[frame] = pagenum;
+		PFframeflags[frame] = ((hint & PF_HINT_SEQ)? 0: PF_FRAME_REF) |
+				(zhit? PF_FRAME_ZCACHED: PF_FRAME_READING);
+		PFprioHint(frame,hint);
+		PFframepin[frame] = 1;
+
+		/* insert new page into hash table */
+		PFhashLatch(fd,pagenum);
+		error = PFhashInsert(fd,pagenum,frame);
+		PFhashUnlatch(fd,pagenum);
+		if (error != PFE_OK){
+			/* failed to insert into hash table */
+			/* put page into free list */
+			PFbufUnlink(frame);
+			PFbufInsertFree(frame);
+			PFnumbpage--;
+			pthread_mutex_unlock(&PFbuflatch);
+			if (error == PFE_HASHPAGEEXIST)
+				/* read in by another thread while the pool
+				latch was released to write out a victim */
+				goto again;
+			*fpage = NULL;
+			return(error);
+		}
+		PFbufPinned(fd,1);
+		PFfstat(fd,bufferMisses,1);
+
+		/* a page seen again while still remembered in a ghost
+		list (2Q A1out, ARC B1 or B2) goes straight to the hot queue */
+		if (ghost != -1){
+			PFghostDelete(fd,pagenum);
+			PFflagSet(frame,PF_FRAME_HOT);
+			PFnumhot++;
+		}
+		pthread_mutex_unlock(&PFbuflatch);
+
+		/* read the page, without the pool latch */
+		if (!zhit){
+			error = (*readfcn)(fd,pagenum,PFframebody[frame]);
+			PFbufReadDone(fd,frame,error);
+			if (error != PFE_OK){
+				*fpage = NULL;
+				return(error);
+			}
+			PFfstat(fd,physicalReads,1);
+		}
+		*fpage = PFframebody[frame];
+		return(PFE_OK);
+	}
+
+	/* the page was found */
+	if (latched)
+		pthread_mutex_unlock(&PFbuflatch);
+
+	if (error == PFE_PAGEFIXED){
+		/* page already in memory, and is fixed, so we can't
+		get it for ourselves only. */
+		*fpage = PFframebody[frame];
+		PFerrno = PFE_PAGEFIXED;
+		return(PFerrno);
+	}
+
+	if (!PFbufWaitRead(fd,frame))
+		/* another thread could not read it in: try it ourselves */
+		goto again;
+	PFbufHit(frame,policy,hint);
+	*fpage = PFframebody[frame];
+	return(PFE_OK);
+}
+
+PFbufGetPages(fd,pagenums,n,fpages,readrunsfcn,writefcn)
+int fd;		/* file descriptor */
+long *pagenums;	/* numbers of the pages to get */
+int n;		/* # of pages */
+PFfpage **fpages;	/* set to the pages */
+int (*readrunsfcn)();	/* function to read runs of adjacent pages */
+int (*writefcn)();	/* function to write a page */
+/****************************************************************************
+SPECIFICATIONS:
+	Get the "n" pages numbered pagenums[0..n-1] of file "fd", the way
+	PFbufGet() gets one page without hint, and set fpages[i] to point
+	to page pagenums[i]. Each page gets one more pin, a page asked
+	for twice gets two. The pages missing from the buffer and from
+	the compressed page cache are all read with one call to
+	readrunsfcn() (see PFbufReadAhead()), so that the I/O backend can
+	do the reads together.
+
+RETURN VALUE:
+	PFE_OK	if no error.
+	PF error code if error. No page is pinned then.
+
+IMPLEMENTATION NOTES:
+	The frames of the missing pages are allocated, and the pages put
+	into the hash table flagged PF_FRAME_READING, with the pool latch
+	held, as for a single miss; they are read with the latch released.
+	If a page that another thread was reading in could not be read,
+	the pins are given back and it all starts over.
+*****************************************************************************/
+{
+int *frames;		/* frame of each page */
+int *state;		/* how each page was found: PF_GET_xxx */
+PFpage_run *runs;	/* pages to read, one per run */
+PFfpage **bodies;	/* and their buffers */
+int nmiss;		/* # of pages to read */
+int nalloc;		/* # of frames allocated for missing pages */
+int policy;		/* replacement policy of the file */
+int ghost;		/* ghost list the page is remembered in, or -1 */
+int retry;		/* TRUE if a page another thread read is missing */
+int error;
+int i,j;
+
+#define PF_GET_HIT	0	/* found in the buffer */
+#define PF_GET_MISS	1	/* read in */
+#define PF_GET_DUP	2	/* asked for before in pagenums */
+#define PF_GET_NONE	3	/* not in the buffer, not pinned */
+
+	policy = PFfilePolicy(fd);
+	frames = (int *)malloc(n*sizeof(int));
+	state = (int *)malloc(n*sizeof(int));
+	runs = (PFpage_run *)malloc(n*sizeof(PFpage_run));
+	bodies = (PFfpage **)malloc(n*sizeof(PFfpage *));
+	if (frames == NULL || state == NULL || runs == NULL || bodies == NULL){
+		error = PFerrno = PFE_NOMEM;
+		goto out;
 	}
-	else {
-		/* we have reached max buffer limit */
-		/* choose a victim from the buffer*/
 
-		*bpage = NULL;		/* set initial return value */
+again:
+	/* the pages in the buffer are pinned right away */
+	nmiss = nalloc = 0;
+	for (i=0; i < n; i++)
+		if (PFbufLookupPin(fd,pagenums[i],FALSE,&frames[i]) == PFE_OK)
+			state[i] = PF_GET_HIT;
+		else {
+			state[i] = PF_GET_NONE;
+			nmiss++;
+		}
 
-		/// 
-		if(pr_strategy){
-			// MRU
-			for (tbpage=PFfirstbpage;tbpage!=NULL;tbpage=tbpage->nextpage){
-				if (!tbpage->fixed)
-					/* found a page that can be swapped out */
-					break;
+	error = PFE_OK;
+	if (nmiss > 0){
+		pthread_mutex_lock(&PFbuflatch);
+
+		/* allocate frames for the pages still missing, and make
+		them known */
+		nmiss = 0;
+		for (i=0; i < n; i++){
+			if (state[i] != PF_GET_NONE)
+				continue;
+			for (j=0; j < i && (state[j] != PF_GET_MISS ||
+					pagenums[j] != pagenums[i]); j++);
+			if (j < i){
+				/* pinned below, once it is read */
+				state[i] = PF_GET_DUP;
+				continue;
 			}
-		}
-		else{
-			// LRU
-			for (tbpage=PFlastbpage;tbpage!=NULL;tbpage=tbpage->prevpage){
-				if (!tbpage->fixed)
-					/* found a page that can be swapped out */
+			if (PFbufLookupPin(fd,pagenums[i],FALSE,&frames[i])
+								== PFE_OK){
+				/* read in by another thread meanwhile */
+				state[i] = PF_GET_HIT;
+				continue;
+			}
+
+			ghost = (policy == PF_POLICY_2Q ||
+					policy == PF_POLICY_ARC)?
+					PFghostFind(fd,pagenums[i]): -1;
+			if (policy == PF_POLICY_ARC)
+				PFbufArcAdapt(ghost);
+			if ((error=PFbufInternalAlloc(&frames[i],writefcn,fd,
+							ghost)) != PFE_OK)
+				break;
+			PFbufSetFd(frames[i],fd);
+			PFframepage[frames[i]] = pagenums[i];
+			PFframeflags[frames[i]] = PF_FRAME_REF |
+				(PFzcacheGet(fd,pagenums[i],
+					(char *)PFframebody[frames[i]],
+					PFbodySize(fd))?
+				PF_FRAME_ZCACHED: PF_FRAME_READING);
+			PFframepin[frames[i]] = 1;
+
+			PFhashLatch(fd,pagenums[i]);
+			error = PFhashInsert(fd,pagenums[i],frames[i]);
+			PFhashUnlatch(fd,pagenums[i]);
+			if (error != PFE_OK){
+				PFbufUnlink(frames[i]);
+				PFbufInsertFree(frames[i]);
+				PFnumbpage--;
+				if (error != PFE_HASHPAGEEXIST ||
+					(error=PFbufLookupPin(fd,pagenums[i],
+					FALSE,&frames[i])) != PFE_OK)
 					break;
+				/* read in by another thread while the pool
+				latch was released to write out a victim */
+				state[i] = PF_GET_HIT;
+				continue;
 			}
+			state[i] = PF_GET_MISS;
+			nalloc++;
+			PFbufPinned(fd,1);
+			if (ghost != -1){
+				PFghostDelete(fd,pagenums[i]);
+				PFflagSet(frames[i],PF_FRAME_HOT);
+				PFnumhot++;
+			}
+			if (!PFflagIs(frames[i],PF_FRAME_READING))
+				/* no need to read it */
+				continue;
+			bodies[nmiss] = PFframebody[frames[i]];
+			runs[nmiss].pagenum = pagenums[i];
+			runs[nmiss].n = 1;
+			runs[nmiss].fpages = &bodies[nmiss];
+			nmiss++;
 		}
-		
+		pthread_mutex_unlock(&PFbuflatch);
+		PFfstat(fd,bufferMisses,nalloc);
+	}
 
-		if (tbpage == NULL){
-			/* couldn't find a free page */
-			PFerrno = PFE_NOBUF;
-			return(PFerrno);
+	/* read them, all at once, without the pool latch */
+	if (error == PFE_OK && nmiss > 0 &&
+			(error=(*readrunsfcn)(fd,runs,nmiss)) == PFE_OK)
+		PFfstat(fd,physicalReads,nmiss);
+	for (i=0; i < n; i++)
+		if (state[i] == PF_GET_MISS &&
+				PFflagIs(frames[i],PF_FRAME_READING)){
+			PFbufReadDone(fd,frames[i],error);
+			if (error != PFE_OK)
+				/* its pin is gone */
+				state[i] = PF_GET_NONE;
 		}
 
-		/* write out the dirty page */
-		if (tbpage->dirty&&((error=(*writefcn)(tbpage->fd,
-				tbpage->page,&tbpage->fpage))!= PFE_OK))
-			return(error);
-		///
-		if(tbpage->dirty){
-			PFstats.physicalWrites++;
+	/* wait for the pages other threads are reading */
+	retry = FALSE;
+	for (i=0; i < n; i++)
+		if (state[i] == PF_GET_HIT && !PFbufWaitRead(fd,frames[i])){
+			state[i] = PF_GET_NONE;
+			retry = TRUE;
 		}
 
+	if (error != PFE_OK || retry){
+		/* give back the pins */
+		for (i=0; i < n; i++)
+			if (state[i] == PF_GET_HIT || state[i] == PF_GET_MISS)
+				PFunpinFile(fd,frames[i]);
+		if (error == PFE_OK)
+			/* another thread could not read a page in: try it
+			ourselves */
+			goto again;
+		goto out;
+	}
 
-		tbpage->dirty = FALSE;
-
-		/* unlink from hash table */
-		if ((error=PFhashDelete(tbpage->fd,tbpage->page))!= PFE_OK)
-			return(error);
-		
-		/* unlink from buffer list */
-		PFbufUnlink(tbpage);
-
-		*bpage = tbpage;
+	/* pages asked for twice */
+	for (i=0; i < n; i++)
+		if (state[i] == PF_GET_DUP){
+			for (j=0; pagenums[j] != pagenums[i]; j++);
+			frames[i] = frames[j];
+			PFpin(frames[i]);
+		}
 
+	for (i=0; i < n; i++){
+		if (state[i] == PF_GET_HIT)
+			PFbufHit(frames[i],policy,PF_HINT_NONE);
+		fpages[i] = PFframebody[frames[i]];
 	}
 
-	/* Link the page as the head of the used list */
-	PFbufLinkHead(*bpage);
-	return(PFE_OK);
+out:
+	if (frames != NULL)
+		free((char *)frames);
+	if (state != NULL)
+		free((char *)state);
+	if (runs != NULL)
+		free((char *)runs);
+	if (bodies != NULL)
+		free((char *)bodies);
+	return(error);
 }
 
+static int PFbufResident(fd,pagenum)
+int fd;		/* file descriptor */
+long pagenum;	/* page number */
+/****************************************************************************
+SPECIFICATIONS:
+	Tell whether page "pagenum" of file "fd" is in the buffer.
+*****************************************************************************/
+{
+int frame;
 
-/************************* Interface to the Outside World ****************/
+	PFhashLatch(fd,pagenum);
+	frame = PFhashFind(fd,pagenum);
+	PFhashUnlatch(fd,pagenum);
+	return(frame != PF_FRAME_NONE);
+}
 
-PFbufGet(fd,pagenum,fpage,readfcn,writefcn)
-int fd;	/* file descriptor */
-int pagenum;	/* page number */
-PFfpage **fpage;	/* pointer to pointer to file page */
-int (*readfcn)();	/* function to read a page */
+PFbufReadAhead(fd,pagenum,n,readrunsfcn,writefcn)
+int fd;		/* file descriptor */
+long pagenum;	/* first page to read ahead */
+int n;		/* # of pages to read ahead */
+int (*readrunsfcn)();	/* function to read runs of adjacent pages */
 int (*writefcn)();	/* function to write a page */
 /****************************************************************************
 SPECIFICATIONS:
-	Get a page whose number is "pagenum" from the file pointed
-	by "fd". Set *fpage to point to the data for that page.
-	This function requires two functions:
-		readfcn(fd,pagenum,fpage) 
-		int fd;
-		int pagenum;
-		PFfpage *fpage;
-	which will read one page whose number is "pagenum" from the file "fd"
-	into the buffer area pointed by "fpage".
-		writefcn(fd,pagenum,fpage)
+	Read pages "pagenum" to "pagenum"+"n"-1 of file "fd" into the
+	scan ring of the file, without fixing them, so that a sequential
+	scan finds them in the buffer. "n" is cut down to half the ring,
+	and to PF_READAHEAD_MAX. The pages already in the buffer at the
+	start of the range are passed over; the run of missing pages
+	that follows is read as one run with
+		readrunsfcn(fd,runs,nruns)
 		int fd;
-		in pagenum;
-		PFpage *fpage;
-	which will write one page into the file.
-	It is an error to read a page already fixed in the buffer.
+		PFpage_run *runs;
+		int nruns;
+	which reads the "nruns" runs of adjacent pages "runs", each with
+	one vectored read, and waits until they are all read.
+	"writefcn" writes out victims (see PFbufGet()).
+	The pages read are flagged PF_FRAME_READAHEAD until they are
+	asked for, to count read-ahead hits and wasted read-aheads.
 
 RETURN VALUE:
-	PFE_OK	if no error.
+	# of pages from "pagenum" on that are now in the buffer, or
+	were skipped: the scan should call again from there.
 	PF error code if error.
-	If error code is PFE_PAGEFIXED, *fpage is still set to point to the buffer
-	page of the page in memory.
 
-GLOBAL VARIABLES MODIFIED:
+IMPLEMENTATION NOTES:
+	The frames are pinned while the pages are read, so that the
+	allocation of the next frame does not take one of them. They are
+	put into the hash table flagged PF_FRAME_READING as they are
+	allocated, and read with the pool latch released, as for a miss
+	(see PFbufGet()): a scan that gets to them first waits for them.
 *****************************************************************************/
 {
-PFbpage *bpage;	/* pointer to buffer */
+int frames[PF_READAHEAD_MAX];	/* frames allocated */
+PFfpage *fpages[PF_READAHEAD_MAX]; /* and their pages */
+PFpage_run run;		/* the pages to read */
+long first;		/* first page to read */
+int cnt;		/* # of pages to read */
+int size;		/* max # of pages to read ahead */
 int error;
-
-	if ((bpage=PFhashFind(fd,pagenum)) == NULL){
-		/* page not in buffer. */
-		
-		/* allocate an empty page */
-		/// (added fd)
-		if ((error=PFbufInternalAlloc(&bpage,writefcn,fd))!= PFE_OK){
-			/* error */
-			*fpage = NULL;
-			return(error);
-		}
-		
-		/* read the page */
-		if ((error=(*readfcn)(fd,pagenum,&bpage->fpage))!= PFE_OK){
-			/* error reading the page. put buffer back into 
-			the free list, and return gracefully */
-			PFbufUnlink(bpage);
-			PFbufInsertFree(bpage);
-			*fpage = NULL;
-			return(error);
-		}
-
-		///
-		PFstats.physicalReads++;
-
-		/* insert new page into hash table */
-		if ((error=PFhashInsert(fd,pagenum,bpage))!=PFE_OK){
-			/* failed to insert into hash table */
-			/* put page into free list */
-			PFbufUnlink(bpage);
-			PFbufInsertFree(bpage);
-			return(error);
+int i;
+
+	size = PFbufRingSize()/2;
+	if (size > PF_READAHEAD_MAX)
+		size = PF_READAHEAD_MAX;
+	if (n > size)
+		n = (size > 0)? size: 1;
+
+	pthread_mutex_lock(&PFbuflatch);
+
+	/* pass over the pages already in the buffer */
+	for (first=pagenum; first < pagenum+n && PFbufResident(fd,first);
+								first++);
+
+	/* allocate frames for the missing pages, and make them known.
+	A copy in the compressed page cache is not needed any more */
+	error = PFE_OK;
+	for (cnt=0; first+cnt < pagenum+n && !PFbufResident(fd,first+cnt);
+									cnt++){
+		if ((error=PFbufRingAlloc(&frames[cnt],writefcn,fd))!= PFE_OK)
+			break;
+		PFbufSetFd(frames[cnt],fd);
+		PFframepage[frames[cnt]] = first+cnt;
+		PFframeflags[frames[cnt]] = PF_FRAME_READAHEAD|PF_FRAME_READING;
+		PFframepin[frames[cnt]] = 1;
+		fpages[cnt] = PFframebody[frames[cnt]];
+		PFzcacheDelete(fd,first+cnt);
+		PFhashLatch(fd,first+cnt);
+		error = PFhashInsert(fd,first+cnt,frames[cnt]);
+		PFhashUnlatch(fd,first+cnt);
+		if (error != PFE_OK){
+			/* read in by another thread while the pool latch was
+			released to write out a victim, or no memory: the
+			run ends here */
+			PFbufUnlink(frames[cnt]);
+			PFbufInsertFree(frames[cnt]);
+			PFnumbpage--;
+			break;
 		}
-
-		/* set the fields for this page*/
-		bpage->fd = fd;
-		bpage->page = pagenum;
-		bpage->dirty = FALSE;
+		PFbufPinned(fd,1);
 	}
-	else if (bpage->fixed){
-		/* page already in memory, and is fixed, so we can't
-		get it again. */
-		*fpage = &bpage->fpage;
-		PFerrno = PFE_PAGEFIXED;
-		return(PFerrno);
+	pthread_mutex_unlock(&PFbuflatch);
+
+	/* read the pages, without the pool latch. Having no frame for
+	more of them is no error */
+	run.pagenum = first;
+	run.n = cnt;
+	run.fpages = fpages;
+	error = PFE_OK;
+	if (cnt > 0 && (error=(*readrunsfcn)(fd,&run,1)) == PFE_OK)
+		PFfstat(fd,physicalReads,cnt);
+	for (i=0; i < cnt; i++){
+		PFbufReadDone(fd,frames[i],error);
+		if (error == PFE_OK)
+			PFunpinFile(fd,frames[i]);
 	}
-
-	/* Fix the page in the buffer then return*/
-	bpage->fixed = TRUE;
-	*fpage = &bpage->fpage;
-	return(PFE_OK);
+	if (error != PFE_OK)
+		return(error);
+	return(first+cnt-pagenum);
 }
 
 PFbufUnfix(fd,pagenum,dirty)
 int fd;		/* file descriptor */
-int pagenum;	/* page number */
+long pagenum;	/* page number */
 int dirty;	/* TRUE if page is dirty */
 /****************************************************************************
 SPECIFICATIONS:
-	Unfix the file page whose number is "pagenum" from the buffer.
+	Unfix the file page whose number is "pagenum" from the buffer,
+	that is drop one of its pins.
 	If dirty is TRUE, then mark the buffer as having been modified.
 	Otherwise, the dirty flag is left unchanged.
+	When the last pin is dropped the page becomes the most recently
+	used one (see PFbufTouch()).
 
 AUTHOR: clc
 
@@ -317,39 +1900,40 @@ RETURN VALUE:
 
 *****************************************************************************/
 {
-PFbpage *bpage;
+int frame;
 
-	if ((bpage= PFhashFind(fd,pagenum))==NULL){
+	PFhashLatch(fd,pagenum);
+	frame = PFhashFind(fd,pagenum);
+	PFhashUnlatch(fd,pagenum);
+	if (frame == PF_FRAME_NONE){
 		/* page not in buffer */
 		PFerrno = PFE_PAGENOTINBUF;
 		return(PFerrno);
 	}
 
-	if (!bpage->fixed){
+	if (PFpinCount(frame) == 0){
 		/* page already unfixed */
 		PFerrno = PFE_PAGEUNFIXED;
 		return(PFerrno);
 	}
 
-	if (dirty)
-		/* mark this page dirty */
-		bpage->dirty = TRUE;
-	
-	/* unfix the page */
-	bpage->fixed = FALSE;
-	
-	/* unlink this page */
-	PFbufUnlink(bpage);
+	if (dirty && PFdirtySet(frame))
+		/* this page became dirty */
+		PFbufCleanCheck();
 
-	/* insert it as head of linked list to make it most recently used*/
-	PFbufLinkHead(bpage);
+	/* make it most recently used while it is still pinned, see
+	PFbufTouch(), unless it is still used by someone else */
+	if (PFpinCount(frame) == 1)
+		PFbufTouch(fd,frame);
 
+	/* unfix the page */
+	PFunpinFile(fd,frame);
 	return(PFE_OK);
 }
 
 PFbufAlloc(fd,pagenum,fpage,writefcn)
 int fd;		/* file descriptor */
-int pagenum;	/* page number */
+long pagenum;	/* page number */
 PFfpage **fpage;	/* pointer to file page */
 int (*writefcn)();
 /****************************************************************************
@@ -365,49 +1949,244 @@ RETURN VALUE:
 	PF error codes if unsuccessful
 *****************************************************************************/
 {
-PFbpage *bpage;
+int frame;
 int error;
 
 	*fpage = NULL;	/* initial value of fpage */
 
-	if ((bpage=PFhashFind(fd,pagenum))!= NULL){
+	pthread_mutex_lock(&PFbuflatch);
+	PFhashLatch(fd,pagenum);
+	frame = PFhashFind(fd,pagenum);
+	PFhashUnlatch(fd,pagenum);
+	if (frame != PF_FRAME_NONE){
 		/* page already in buffer*/
+		pthread_mutex_unlock(&PFbuflatch);
 		PFerrno = PFE_PAGEINBUF;
 		return(PFerrno);
 	}
 
 	/// (added fd)
-	if ((error=PFbufInternalAlloc(&bpage,writefcn,fd))!= PFE_OK)
+	if ((error=PFbufInternalAlloc(&frame,writefcn,fd,-1))!= PFE_OK){
 		/* can't get any buffer */
+		pthread_mutex_unlock(&PFbuflatch);
 		return(error);
-	
+	}
+
+	/* init the fields of the frame. The page is new: what the
+	compressed page cache may have of it is not */
+	PFbufSetFd(frame,fd);
+	PFframepage[frame] = pagenum;
+	PFframeflags[frame] = PF_FRAME_REF;
+	PFframepin[frame] = 1;
+	PFzcacheDelete(fd,pagenum);
+
 	/* put ourselves into the hash table */
-	if ((error=PFhashInsert(fd,pagenum,bpage))!= PFE_OK){
+	PFhashLatch(fd,pagenum);
+	error = PFhashInsert(fd,pagenum,frame);
+	PFhashUnlatch(fd,pagenum);
+	if (error != PFE_OK){
 		/* can't insert into the hash table */
-		/* unlink bpage, and put it into the free list */
-		PFbufUnlink(bpage);
-		PFbufInsertFree(bpage);
+		/* unlink frame, and put it into the free list */
+		PFbufUnlink(frame);
+		PFbufInsertFree(frame);
+		PFnumbpage--;
+		pthread_mutex_unlock(&PFbuflatch);
+		if (error == PFE_HASHPAGEEXIST){
+			/* brought in by another thread while the pool latch
+			was released to write out a victim */
+			PFerrno = PFE_PAGEINBUF;
+			return(PFerrno);
+		}
 		return(error);
 	}
+	PFbufPinned(fd,1);
 
-	/* init the fields of bpage and return */
-	bpage->fd = fd;
-	bpage->page = pagenum;
-	bpage->fixed = TRUE;
-	bpage->dirty = FALSE;
+	pthread_mutex_unlock(&PFbuflatch);
+	*fpage = PFframebody[frame];
+	return(PFE_OK);
+}
+
+PFbufDiscard(fd,pagenum)
+int fd;		/* file descriptor */
+long pagenum;	/* page number */
+/****************************************************************************
+SPECIFICATIONS:
+	Take page "pagenum" of file "fd" out of the buffer without
+	writing it out, if it is there: the page has been freed, and
+	what it holds no longer matters. A page the cleaner, or another
+	thread making room, is writing out is left in the buffer, clean.
 
-	*fpage = &bpage->fpage;
+RETURN VALUE:
+	PFE_OK	if the page is not in the buffer any more.
+	PFE_PAGEFIXED	if the page is fixed.
+*****************************************************************************/
+{
+int frame;
+
+	pthread_mutex_lock(&PFbuflatch);
+	PFzcacheDelete(fd,pagenum);
+	PFhashLatch(fd,pagenum);
+	if ((frame=PFhashFind(fd,pagenum)) == PF_FRAME_NONE){
+		PFhashUnlatch(fd,pagenum);
+		pthread_mutex_unlock(&PFbuflatch);
+		return(PFE_OK);
+	}
+	if (PFpinCount(frame) > 0){
+		PFhashUnlatch(fd,pagenum);
+		pthread_mutex_unlock(&PFbuflatch);
+		PFerrno = PFE_PAGEFIXED;
+		return(PFerrno);
+	}
+	PFdirtyClr(frame);
+	if (PFflagIs(frame,PF_FRAME_CLEANING|PF_FRAME_WRITING)){
+		PFhashUnlatch(fd,pagenum);
+		pthread_mutex_unlock(&PFbuflatch);
+		return(PFE_OK);
+	}
+	PFhashDelete(fd,pagenum);
+	PFhashUnlatch(fd,pagenum);
+
+	if (PFflagIs(frame,PF_FRAME_HOT))
+		PFnumhot--;
+	PFbufUnlink(frame);
+	PFbufInsertFree(frame);
+	PFnumbpage--;
+	pthread_mutex_unlock(&PFbuflatch);
 	return(PFE_OK);
 }
 
+static int PFbufPageCmp(a,b)
+int *a,*b;	/* frames to compare */
+/****************************************************************************
+SPECIFICATIONS:
+	Compare the page numbers of two frames, for qsort().
+*****************************************************************************/
+{
+	return((PFframepage[*a] > PFframepage[*b]) -
+			(PFframepage[*a] < PFframepage[*b]));
+}
+
+PFbufFlushFile(fd,writerunsfcn)
+int fd;		/* file descriptor */
+int (*writerunsfcn)();	/* function to write runs of adjacent pages */
+/****************************************************************************
+SPECIFICATIONS:
+	Write out all the dirty pages of file "fd", in order of page
+	number. The pages stay in the buffer. This function requires
+		writerunsfcn(fd,runs,nruns)
+		int fd;
+		PFpage_run *runs;
+		int nruns;
+	which writes the "nruns" runs of adjacent pages "runs", each with
+	one vectored write, and waits until they are all written.
+
+RETURN VALUE:
+	PFE_OK	if no error.
+	PFE_NOMEM	if no memory.
+	PF error code if error writing. The pages not written out are
+	left dirty.
+
+IMPLEMENTATION NOTES:
+	The dirty pages are found with a linear scan of the frames and
+	sorted by page number, so that each run of adjacent pages (up to
+	PF_FLUSH_MAXRUN of them) goes out with one vectored write; the
+	runs are handed to the I/O backend all at once. The pages are
+	marked PF_FRAME_CLEANING
+	while they are written, with the pool latch released; a fixed
+	page is written too, it becomes dirty again if it is changed
+	meanwhile (see PFbufUnfix()). A page of the file that another
+	thread is writing out as a victim is waited for. A miss that
+	finds no other victim meanwhile waits for the write (see
+	PFbufPickVictim() and PFbufIOWait()).
+*****************************************************************************/
+{
+int *batch;		/* dirty frames of the file */
+int n;			/* # of frames in batch */
+PFfpage **fpages;	/* their pages, in order */
+PFpage_run *runs;	/* runs of adjacent pages */
+int nruns;		/* # of runs */
+int error;
+int frame,i;
+
+	/* keep the cleaner out, and pick the dirty pages */
+	pthread_mutex_lock(&PFcleanlatch);
+	pthread_mutex_lock(&PFbuflatch);
+	if (PFnumframes == 0){
+		pthread_mutex_unlock(&PFbuflatch);
+		pthread_mutex_unlock(&PFcleanlatch);
+		return(PFE_OK);
+	}
+	batch = (int *)malloc(PFnumframes*sizeof(int));
+	fpages = (PFfpage **)malloc(PFnumframes*sizeof(PFfpage *));
+	runs = (PFpage_run *)malloc(PFnumframes*sizeof(PFpage_run));
+	if (batch == NULL || fpages == NULL || runs == NULL){
+		if (batch != NULL)
+			free((char *)batch);
+		if (fpages != NULL)
+			free((char *)fpages);
+		pthread_mutex_unlock(&PFbuflatch);
+		pthread_mutex_unlock(&PFcleanlatch);
+		PFerrno = PFE_NOMEM;
+		return(PFerrno);
+	}
+	n = 0;
+	for (frame=0; frame < PFnumframes; frame++){
+		if (PFframefd[frame] == fd)
+			PFbufIOWait(frame,PF_FRAME_WRITING);
+		if (PFframefd[frame] == fd && PFflagIs(frame,PF_FRAME_DIRTY)){
+			PFflagSet(frame,PF_FRAME_CLEANING);
+			batch[n++] = frame;
+		}
+	}
+	pthread_mutex_unlock(&PFbuflatch);
+
+	qsort((char *)batch,n,sizeof(int),PFbufPageCmp);
+
+	/* cut the pages into runs of adjacent pages */
+	nruns = 0;
+	for (i=0; i < n; i++){
+		if (nruns == 0 || runs[nruns-1].n == PF_FLUSH_MAXRUN ||
+			PFframepage[batch[i]] != runs[nruns-1].pagenum +
+							runs[nruns-1].n){
+			runs[nruns].pagenum = PFframepage[batch[i]];
+			runs[nruns].n = 0;
+			runs[nruns].fpages = &fpages[i];
+			nruns++;
+		}
+		runs[nruns-1].n++;
+		PFdirtyClr(batch[i]);
+		fpages[i] = PFframebody[batch[i]];
+	}
+
+	/* and write them out */
+	error = PFE_OK;
+	if (nruns > 0 && (error=(*writerunsfcn)(fd,runs,nruns)) == PFE_OK)
+		PFfstat(fd,physicalWrites,n);
+	pthread_mutex_lock(&PFbuflatch);
+	for (i=0; i < n; i++){
+		if (error != PFE_OK)
+			/* may not be written out */
+			PFdirtySet(batch[i]);
+		PFbufIODone(batch[i],PF_FRAME_CLEANING);
+	}
+	pthread_mutex_unlock(&PFbuflatch);
+
+	free((char *)batch);
+	free((char *)fpages);
+	free((char *)runs);
+	pthread_mutex_unlock(&PFcleanlatch);
+	return(error);
+}
 
-PFbufReleaseFile(fd,writefcn)
+PFbufReleaseFile(fd,writefcn,writerunsfcn)
 int fd;		/* file descriptor */
 int (*writefcn)();	/* function to write a page of file */
+int (*writerunsfcn)();	/* function to write runs of adjacent pages */
 /****************************************************************************
 SPECIFICATIONS:
 	Release all pages of file "fd" from the buffer and
-	put them into the free list 
+	put them into the free list. The dirty pages are first written
+	out in order with PFbufFlushFile().
 
 AUTHOR: clc
 
@@ -416,61 +2195,87 @@ RETURN VALUE:
 	PF error code if error.
 
 IMPLEMENTATION NOTES:
-	A linear search of the buffer is performed.
-	A better method is not needed because # of buffers are small.
+	A linear scan of the frame fd array is performed, which only
+	touches a few cache lines.
 *****************************************************************************/
 {
-PFbpage *bpage;	/* ptr to buffer pages to search */
-PFbpage *temppage;
+int frame;	/* frame to look at */
 int error;		/* error code */
 
-	/* Do linear scan of the buffer to find pages belonging to the file */
-	bpage = PFfirstbpage;
-	while (bpage != NULL){
-		if (bpage->fd == fd){
-			/* The file descriptor matches*/
-			if (bpage->fixed){
-				PFerrno = PFE_PAGEFIXED;
-				return(PFerrno);
-			}
-
-			/* write out dirty page */
-			if (bpage->dirty&&((error=(*writefcn)(fd,bpage->page,
-					&bpage->fpage))!= PFE_OK))
-				/* error writing file */
-				return(error);
-			///
-			if(bpage->dirty){
-				PFstats.physicalWrites++;
-			}
-			// PFstats.pagesAccessed++;
+	/* write out the dirty pages */
+	if ((error=PFbufFlushFile(fd,writerunsfcn)) != PFE_OK)
+		return(error);
 
+	/* wait for the cleaner to be done with the pages it is writing */
+	pthread_mutex_lock(&PFcleanlatch);
+	pthread_mutex_lock(&PFbuflatch);
 
-			bpage->dirty = FALSE;
+	/* Do linear scan of the buffer to find pages belonging to the file */
+	for (frame=0; frame < PFnumframes; frame++){
+		if (PFframefd[frame] != fd)
+			continue;
+
+		/* another thread may be writing it out as a victim */
+		PFbufIOWait(frame,PF_FRAME_WRITING);
+		if (PFframefd[frame] != fd)
+			continue;
+
+		/* The file descriptor matches*/
+		if (PFpinCount(frame) > 0){
+			pthread_mutex_unlock(&PFbuflatch);
+			pthread_mutex_unlock(&PFcleanlatch);
+			PFerrno = PFE_PAGEFIXED;
+			return(PFerrno);
+		}
 
-			/* get rid of it from the hash table */
-			if ((error=PFhashDelete(fd,bpage->page))!= PFE_OK){
-				/* internal error */
-				printf("Internal error:PFbufReleaseFile()\n");
-				exit(1);
-			}
+		/* write out dirty page, and get rid of it from the hash
+		table */
+		if ((error=PFbufEvict(frame,writefcn,FALSE)) == PFE_PAGEFIXED){
+			/* fixed by another thread meanwhile */
+			pthread_mutex_unlock(&PFbuflatch);
+			pthread_mutex_unlock(&PFcleanlatch);
+			PFerrno = PFE_PAGEFIXED;
+			return(PFerrno);
+		}
+		if (error == PFE_HASHNOTFOUND){
+			/* internal error */
+			printf("Internal error:PFbufReleaseFile()\n");
+			exit(1);
+		}
+		if (error != PFE_OK){
+			/* error writing file */
+			pthread_mutex_unlock(&PFbuflatch);
+			pthread_mutex_unlock(&PFcleanlatch);
+			return(error);
+		}
 
-			/* put the page into free list */
-			temppage = bpage;
-			bpage = bpage->nextpage;
-			PFbufUnlink(temppage);
-			PFbufInsertFree(temppage);
+		if (PFflagIs(frame,PF_FRAME_HOT))
+			PFnumhot--;
 
-		}
-		else	bpage = bpage->nextpage;
+		/* put the page into free list */
+		PFbufUnlink(frame);
+		PFbufInsertFree(frame);
+		PFnumbpage--;
 	}
+
+	/* the file descriptor may be reused: forget its ghosts, its pages
+	in the compressed page cache and its quota */
+	PFghostReleaseFile(fd);
+	PFzcacheReleaseFile(fd);
+	PFbufring[fd].n = PFbufring[fd].next = 0;
+	if (PFfilemin[fd] > 0 || PFfilemax[fd] > 0)
+		PFnumquotas--;
+	PFfilemin[fd] = PFfilemax[fd] = 0;
+	PFfilebody[fd] = PFfileoffset[fd] = 0;
+	pthread_mutex_unlock(&PFbuflatch);
+	pthread_mutex_unlock(&PFcleanlatch);
 	return(PFE_OK);
 }
 
 
 PFbufUsed(fd,pagenum)
 int fd;		/* file descriptor */
-int pagenum;	/* page number */
+long pagenum;	/* page number */
 /****************************************************************************
 SPECIFICATIONS:
 	Mark page numbered "pagenum" of file descriptor "fd" as used.
@@ -483,28 +2288,298 @@ RETURN VALUE: PF error codes.
 
 *****************************************************************************/
 {
-PFbpage *bpage;	/* pointer to the bpage we are looking for */
+int frame;	/* the frame we are looking for */
 
 	/* Find page in the buffer */
-	if ((bpage=PFhashFind(fd,pagenum))==NULL){
+	PFhashLatch(fd,pagenum);
+	frame = PFhashFind(fd,pagenum);
+	PFhashUnlatch(fd,pagenum);
+	if (frame == PF_FRAME_NONE){
 		/* page not in the buffer */
 		PFerrno = PFE_PAGENOTINBUF;
 		return(PFerrno);
 	}
 
-	if (!(bpage->fixed)){
+	if (PFpinCount(frame) == 0){
 		/* page not fixed */
 		PFerrno = PFE_PAGEUNFIXED;
 		return(PFerrno);
 	}
 
 	/* mark this page dirty */
-	bpage->dirty = TRUE;
+	if (PFdirtySet(frame))
+		PFbufCleanCheck();
 
 	/* make this page head of the list of buffers*/
-	PFbufUnlink(bpage);
-	PFbufLinkHead(bpage);
+	PFbufTouch(fd,frame);
+
+	return(PFE_OK);
+}
+
+PFbufStartCleaner(writefcn,lowwater,highwater)
+int (*writefcn)();	/* function to write a page */
+int lowwater;		/* % of PF_MAX_BUFS dirty at which the cleaner stops */
+int highwater;		/* % of PF_MAX_BUFS dirty at which the cleaner starts */
+/****************************************************************************
+SPECIFICATIONS:
+	Start the page cleaner thread (see PFbufCleaner()), which writes
+	out pages with "writefcn" (see PFbufGet()).
+
+RETURN VALUE:
+	PFE_OK	if no error.
+	PFE_CLEANER	if the cleaner is already running or can't be
+		started, or unless 0 <= lowwater < highwater <= 100.
+*****************************************************************************/
+{
+	if (lowwater < 0 || lowwater >= highwater || highwater > 100){
+		PFerrno = PFE_CLEANER;
+		return(PFerrno);
+	}
+
+	pthread_mutex_lock(&PFbuflatch);
+	if (PFcleanrun){
+		/* already running */
+		pthread_mutex_unlock(&PFbuflatch);
+		PFerrno = PFE_CLEANER;
+		return(PFerrno);
+	}
+	PFcleanwrite = writefcn;
+	PFcleanlow = lowwater;
+	PFcleanhigh = highwater;
+	PFcleanwanted = FALSE;
+	PFcleanrun = TRUE;
+	if (pthread_create(&PFcleantid,NULL,PFbufCleaner,NULL) != 0){
+		PFcleanrun = FALSE;
+		pthread_mutex_unlock(&PFbuflatch);
+		PFerrno = PFE_CLEANER;
+		return(PFerrno);
+	}
+	pthread_mutex_unlock(&PFbuflatch);
+	return(PFE_OK);
+}
+
+PFbufStopCleaner()
+/****************************************************************************
+SPECIFICATIONS:
+	Stop the page cleaner thread and wait until it is gone.
+
+RETURN VALUE:
+	PFE_OK	if no error.
+	PFE_CLEANER	if the cleaner is not running.
+*****************************************************************************/
+{
+	pthread_mutex_lock(&PFbuflatch);
+	if (!PFcleanrun){
+		pthread_mutex_unlock(&PFbuflatch);
+		PFerrno = PFE_CLEANER;
+		return(PFerrno);
+	}
+	PFcleanrun = FALSE;
+	pthread_cond_signal(&PFcleancond);
+	pthread_mutex_unlock(&PFbuflatch);
+
+	pthread_join(PFcleantid,NULL);
+	return(PFE_OK);
+}
+
+PFbufSetPriority(fd,pagenum,high)
+int fd;		/* file descriptor */
+long pagenum;	/* page number */
+int high;	/* TRUE for high priority, FALSE for low */
+/****************************************************************************
+SPECIFICATIONS:
+	Give page "pagenum" of file "fd", which must be fixed in the
+	buffer, high or low priority. A high priority page is replaced
+	only when no low priority page can be, whatever the replacement
+	policy. The priority goes with the page when it leaves the buffer.
+
+RETURN VALUE:
+	PFE_OK	if no error.
+	PFE_PAGENOTINBUF	if the page is not in the buffer.
+	PFE_PAGEUNFIXED	if the page is not fixed.
+*****************************************************************************/
+{
+int frame;	/* the frame we are looking for */
+
+	PFhashLatch(fd,pagenum);
+	frame = PFhashFind(fd,pagenum);
+	PFhashUnlatch(fd,pagenum);
+	if (frame == PF_FRAME_NONE){
+		PFerrno = PFE_PAGENOTINBUF;
+		return(PFerrno);
+	}
+	if (PFpinCount(frame) == 0){
+		PFerrno = PFE_PAGEUNFIXED;
+		return(PFerrno);
+	}
+
+	PFprioHint(frame,high? PF_HINT_HIGH: PF_HINT_LOW);
+	return(PFE_OK);
+}
+
+PFbufSetQuota(fd,minframes,maxframes)
+int fd;		/* file descriptor */
+int minframes;	/* # of frames reserved for the file, or 0 */
+int maxframes;	/* max # of frames of the file, or 0 for no cap */
+/****************************************************************************
+SPECIFICATIONS:
+	Set the buffer quota of file "fd". The other files do not take
+	the frames of file "fd" while it has no more than "minframes" of
+	them, and file "fd" replaces its own pages once it has
+	"maxframes" frames. Frames the file already has beyond its cap
+	are given up as it replaces pages. The quota is a preference:
+	a page miss that would fail because of it takes any page instead.
+	The quota goes when the file is closed.
+
+RETURN VALUE:
+	PFE_OK	if no error.
+	PFE_QUOTA	unless 0 <= minframes <= maxframes (or maxframes
+		is 0), and the frames reserved for all the files fit in
+		PF_MAX_BUFS.
+
+GLOBAL VARIABLES MODIFIED:
+	PFfilemin, PFfilemax, PFnumquotas
+*****************************************************************************/
+{
+int reserved;	/* # of frames reserved for the other files */
+int i;
+
+	if (minframes < 0 || maxframes < 0 ||
+				(maxframes > 0 && minframes > maxframes)){
+		PFerrno = PFE_QUOTA;
+		return(PFerrno);
+	}
+
+	pthread_mutex_lock(&PFbuflatch);
+	for (reserved=0, i=0; i < PFnumfiles; i++)
+		if (i != fd)
+			reserved += PFfilemin[i];
+	if (reserved + minframes > PF_MAX_BUFS){
+		pthread_mutex_unlock(&PFbuflatch);
+		PFerrno = PFE_QUOTA;
+		return(PFerrno);
+	}
+
+	if (PFfilemin[fd] > 0 || PFfilemax[fd] > 0)
+		PFnumquotas--;
+	PFfilemin[fd] = minframes;
+	PFfilemax[fd] = maxframes;
+	if (minframes > 0 || maxframes > 0)
+		PFnumquotas++;
+	pthread_mutex_unlock(&PFbuflatch);
+	return(PFE_OK);
+}
+
+PFbufFileFrames(fd)
+int fd;		/* file descriptor */
+/****************************************************************************
+SPECIFICATIONS:
+	Tell how many buffer frames hold pages of file "fd".
+
+RETURN VALUE:
+	The # of frames.
+*****************************************************************************/
+{
+int n;
+
+	/* the array may be moved by PFbufSetFiles() */
+	pthread_mutex_lock(&PFbuflatch);
+	n = PFfileframes[fd];
+	pthread_mutex_unlock(&PFbuflatch);
+	return(n);
+}
+
+void PFbufSetFrameSize(fd,size,offset)
+int fd;		/* file descriptor */
+int size;	/* # of bytes a page of the file takes in a frame */
+int offset;	/* where the body of a page starts in the frame */
+/****************************************************************************
+SPECIFICATIONS:
+	Tell the buffer manager how large the pages of file "fd" are:
+	a frame needs "size" bytes, and the body (the PFfpage) starts
+	"offset" bytes into it. The offset lets the pagebuf of a file
+	that reads and writes it alone be aligned for O_DIRECT. Frames
+	are set up as the pages of the file are put in them (see
+	PFbufFit()). The size is forgotten when the file is released.
+
+GLOBAL VARIABLES MODIFIED:
+	PFfilebody, PFfileoffset
+*****************************************************************************/
+{
+	pthread_mutex_lock(&PFbuflatch);
+	PFfilebody[fd] = size > PF_FRAME_SIZE? size: 0;
+	PFfileoffset[fd] = offset;
+	pthread_mutex_unlock(&PFbuflatch);
+}
+
+PFbufSetCacheSize(bytes)
+long bytes;	/* memory budget, 0 to turn the cache off */
+/****************************************************************************
+SPECIFICATIONS:
+	Give the compressed page cache below the buffer a budget of
+	"bytes" bytes (see PFzcacheSetSize()).
+
+RETURN VALUE:
+	PFE_OK	if OK
+	PFE_NOMEM	if no memory.
+*****************************************************************************/
+{
+int error;
+
+	pthread_mutex_lock(&PFbuflatch);
+	error = PFzcacheSetSize(bytes);
+	pthread_mutex_unlock(&PFbuflatch);
+	return(error);
+}
+
+PFbufSetFiles(nfiles)
+int nfiles;	/* # of entries of the file table */
+/****************************************************************************
+SPECIFICATIONS:
+	Make room in the per file arrays for file descriptors up to
+	nfiles-1, after the file table has grown. The new files have no
+	frames, no quota and an empty scan ring.
+
+RETURN VALUE:
+	PFE_OK	if OK
+	PFE_NOMEM	if no memory.
 
+GLOBAL VARIABLES MODIFIED:
+	PFnumfiles, PFfileframes, PFfilemin, PFfilemax, PFfilebody,
+	PFfileoffset, PFbufring
+*****************************************************************************/
+{
+char *block;	/* new block holding all the arrays */
+char *oldblock;	/* the block it replaces */
+char *p;
+int old;	/* # of files before */
+
+	if (nfiles <= PFnumfiles)
+		return(PFE_OK);
+	if ((block=malloc(nfiles*(5*sizeof(int) + sizeof(PFbuf_ring))))
+								== NULL){
+		PFerrno = PFE_NOMEM;
+		return(PFerrno);
+	}
+	memset(block,0,nfiles*(5*sizeof(int) + sizeof(PFbuf_ring)));
+
+	pthread_mutex_lock(&PFbuflatch);
+	old = PFnumfiles;
+	p = block;
+#define PFcarve(a,t) { if (old > 0) memcpy(p,(char *)(a),old*sizeof(t)); \
+				(a) = (t *)p; p += nfiles*sizeof(t); }
+	oldblock = (char *)PFbufring;	/* the old block starts with it */
+	PFcarve(PFbufring,PFbuf_ring);
+	PFcarve(PFfileframes,int);
+	PFcarve(PFfilemin,int);
+	PFcarve(PFfilemax,int);
+	PFcarve(PFfilebody,int);
+	PFcarve(PFfileoffset,int);
+#undef PFcarve
+	PFnumfiles = nfiles;
+	if (old > 0)
+		free(oldblock);
+	pthread_mutex_unlock(&PFbuflatch);
 	return(PFE_OK);
 }
 
@@ -517,16 +2592,22 @@ AUTHOR: clc
 
 *****************************************************************************/
 {
-PFbpage *bpage;
+int frame;
 
+	pthread_mutex_lock(&PFbuflatch);
 	printf("buffer content:\n");
-	if (PFfirstbpage == NULL)
+	if (PFfirstbpage == PF_FRAME_NONE)
 		printf("empty\n");
 	else {
-		printf("fd\tpage\tfixed\tdirty\tfpage\n");
-		for(bpage = PFfirstbpage; bpage != NULL; bpage= bpage->nextpage)
-			printf("%d\t%d\t%d\t%d\t%d\n",
-				bpage->fd,bpage->page,(int)bpage->fixed,
-				(int)bpage->dirty,(int)&bpage->fpage);
+		printf("fd\tpage\tpins\tdirty\tref\tframe\n");
+		for(frame = PFfirstbpage; frame != PF_FRAME_NONE;
+						frame = PFframenext[frame])
+			printf("%d\t%ld\t%d\t%d\t%d\t%d\n",
+				PFframefd[frame],PFframepage[frame],
+				PFpinCount(frame),
+				PFflagIs(frame,PF_FRAME_DIRTY) != 0,
+				PFflagIs(frame,PF_FRAME_REF) != 0,
+				frame);
 	}
+	pthread_mutex_unlock(&PFbuflatch);
 }
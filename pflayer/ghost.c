@@ -0,0 +1,292 @@
+/* ghost.c: history of pages recently evicted from the buffer.
+The replacement policies that look at more than the resident pages
+(2Q, ARC) remember the (fd,page) of some evicted pages in "ghost" lists.
+A ghost entry holds no page data. Each list is kept in eviction order,
+newest first, and all entries are also reachable through a small hash
+table so that a miss can ask cheaply whether the page was seen before.
+The interface routines are:
+PFghostFind(), PFghostInsert(), PFghostDelete(), PFghostDropOldest(),
+PFghostCount() and PFghostReleaseFile(). */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "pf.h"
+#include "pftypes.h"
+
+/* ghost entry. Entries are kept in arrays and linked by index,
+-1 is the end of a list */
+typedef struct PFghost_entry {
+	long page;	/* page number */
+	int fd;		/* file descriptor, or -1 if entry not used */
+	int list;	/* ghost list this entry is on */
+	int next;	/* next (older) entry on the same list */
+	int prev;	/* previous (newer) entry on the same list */
+	int hnext;	/* next entry in the same hash bucket, or free list */
+} PFghost_entry;
+
+static PFghost_entry *PFghosttbl = NULL; /* all entries */
+static int PFghostsize = 0;	/* # of entries allocated in PFghosttbl */
+static int *PFghostbucket = NULL; /* hash buckets, PFghostsize of them */
+static int PFghostfree = -1;	/* list of free entries, linked by hnext */
+
+/* newest and oldest entry, and # of entries, of each ghost list */
+static int PFghosthead[PF_GHOST_NLISTS];
+static int PFghosttail[PF_GHOST_NLISTS];
+static int PFghostcnt[PF_GHOST_NLISTS];
+
+#define PFghostHash(fd,page) ((unsigned long)((fd)*31+(page)) % PFghostsize)
+
+
+static PFghostGrow()
+/****************************************************************************
+SPECIFICATIONS:
+	Double the number of ghost entries (start with 2*PF_MAX_BUFS),
+	rehash the entries in use and put the new ones into the free list.
+
+RETURN VALUE:
+	PFE_OK	if OK
+	PFE_NOMEM	if no memory.
+
+GLOBAL VARIABLES MODIFIED:
+	PFghosttbl, PFghostbucket, PFghostsize, PFghostfree
+*****************************************************************************/
+{
+PFghost_entry *tbl;	/* new table of entries */
+int *bucket;		/* new hash buckets */
+int size;		/* new # of entries */
+int i,l,b;
+
+	size = (PFghostsize == 0)? 2*PF_MAX_BUFS: 2*PFghostsize;
+	if ((tbl=(PFghost_entry *)malloc(size*sizeof(PFghost_entry)))==NULL ||
+		(bucket=(int *)malloc(size*sizeof(int)))==NULL){
+		if (tbl != NULL)
+			free((char *)tbl);
+		PFerrno = PFE_NOMEM;
+		return(PFerrno);
+	}
+
+	if (PFghostsize == 0){
+		/* first time: all the lists are empty */
+		for (l=0; l < PF_GHOST_NLISTS; l++){
+			PFghosthead[l] = PFghosttail[l] = -1;
+			PFghostcnt[l] = 0;
+		}
+	}
+	else {
+		memcpy((char *)tbl,(char *)PFghosttbl,
+				PFghostsize*sizeof(PFghost_entry));
+		free((char *)PFghosttbl);
+		free((char *)PFghostbucket);
+	}
+
+	PFghosttbl = tbl;
+	PFghostbucket = bucket;
+	for (i=0; i < size; i++)
+		bucket[i] = -1;
+
+	/* new entries go into the free list */
+	for (i=PFghostsize; i < size; i++){
+		tbl[i].fd = -1;
+		tbl[i].hnext = PFghostfree;
+		PFghostfree = i;
+	}
+
+	/* rehash the old entries that are in use */
+	i = PFghostsize;
+	PFghostsize = size;
+	while (--i >= 0)
+		if (tbl[i].fd >= 0){
+			b = PFghostHash(tbl[i].fd,tbl[i].page);
+			tbl[i].hnext = bucket[b];
+			bucket[b] = i;
+		}
+
+	return(PFE_OK);
+}
+
+static int PFghostLookup(fd,page)
+int fd;		/* file descriptor */
+long page;	/* page number */
+/****************************************************************************
+SPECIFICATIONS:
+	Find the ghost entry of page "page" of file "fd".
+
+RETURN VALUE:
+	index of the entry, or -1 if not found.
+*****************************************************************************/
+{
+int e;
+
+	if (PFghostsize == 0)
+		return(-1);
+	for (e=PFghostbucket[PFghostHash(fd,page)]; e != -1;
+						e=PFghosttbl[e].hnext)
+		if (PFghosttbl[e].fd == fd && PFghosttbl[e].page == page)
+			return(e);
+	return(-1);
+}
+
+static void PFghostRemove(e)
+int e;		/* entry to remove */
+/****************************************************************************
+SPECIFICATIONS:
+	Take entry "e" off its ghost list and its hash bucket, and put
+	it into the free list.
+
+GLOBAL VARIABLES MODIFIED:
+	PFghosttbl, PFghostbucket, PFghostfree, the list heads
+*****************************************************************************/
+{
+PFghost_entry *ent;
+int *link;	/* link in the hash chain pointing to e */
+int l;
+
+	ent = &PFghosttbl[e];
+	l = ent->list;
+
+	/* unlink from the ghost list */
+	if (ent->prev != -1)
+		PFghosttbl[ent->prev].next = ent->next;
+	else	PFghosthead[l] = ent->next;
+	if (ent->next != -1)
+		PFghosttbl[ent->next].prev = ent->prev;
+	else	PFghosttail[l] = ent->prev;
+	PFghostcnt[l]--;
+
+	/* unlink from the hash chain */
+	for (link= &PFghostbucket[PFghostHash(ent->fd,ent->page)];
+				*link != e; link= &PFghosttbl[*link].hnext);
+	*link = ent->hnext;
+
+	ent->fd = -1;
+	ent->hnext = PFghostfree;
+	PFghostfree = e;
+}
+
+
+/************************* Interface to the Buffer Manager ***************/
+
+PFghostFind(fd,page)
+int fd;		/* file descriptor */
+long page;	/* page number */
+/****************************************************************************
+SPECIFICATIONS:
+	Tell whether page "page" of file "fd" is remembered in a ghost list.
+
+RETURN VALUE:
+	The ghost list (PF_GHOST_xxx) the page is on, or
+	-1	if the page is not remembered.
+*****************************************************************************/
+{
+int e;
+
+	if ((e=PFghostLookup(fd,page)) == -1)
+		return(-1);
+	return(PFghosttbl[e].list);
+}
+
+PFghostInsert(list,fd,page)
+int list;	/* ghost list, PF_GHOST_xxx */
+int fd;		/* file descriptor */
+long page;	/* page number */
+/****************************************************************************
+SPECIFICATIONS:
+	Remember page "page" of file "fd" as the newest entry of ghost
+	list "list". If the page is already remembered, it is moved.
+	The caller keeps the length of the lists in check with
+	PFghostCount() and PFghostDropOldest().
+
+RETURN VALUE:
+	PFE_OK	if OK
+	PFE_NOMEM	if no memory.
+*****************************************************************************/
+{
+PFghost_entry *ent;
+int e,b;
+
+	if ((e=PFghostLookup(fd,page)) != -1)
+		PFghostRemove(e);
+
+	if (PFghostfree == -1 && PFghostGrow() != PFE_OK)
+		return(PFerrno);
+
+	/* take an entry from the free list */
+	e = PFghostfree;
+	ent = &PFghosttbl[e];
+	PFghostfree = ent->hnext;
+
+	ent->fd = fd;
+	ent->page = page;
+	ent->list = list;
+
+	/* link as newest entry of the list */
+	ent->prev = -1;
+	ent->next = PFghosthead[list];
+	if (PFghosthead[list] != -1)
+		PFghosttbl[PFghosthead[list]].prev = e;
+	PFghosthead[list] = e;
+	if (PFghosttail[list] == -1)
+		PFghosttail[list] = e;
+	PFghostcnt[list]++;
+
+	/* and into the hash table */
+	b = PFghostHash(fd,page);
+	ent->hnext = PFghostbucket[b];
+	PFghostbucket[b] = e;
+
+	return(PFE_OK);
+}
+
+void PFghostDelete(fd,page)
+int fd;		/* file descriptor */
+long page;	/* page number */
+/****************************************************************************
+SPECIFICATIONS:
+	Forget page "page" of file "fd", if it is remembered.
+*****************************************************************************/
+{
+int e;
+
+	if ((e=PFghostLookup(fd,page)) != -1)
+		PFghostRemove(e);
+}
+
+void PFghostDropOldest(list)
+int list;	/* ghost list, PF_GHOST_xxx */
+/****************************************************************************
+SPECIFICATIONS:
+	Forget the oldest entry of ghost list "list", if any.
+*****************************************************************************/
+{
+	if (PFghostsize != 0 && PFghosttail[list] != -1)
+		PFghostRemove(PFghosttail[list]);
+}
+
+PFghostCount(list)
+int list;	/* ghost list, PF_GHOST_xxx */
+/****************************************************************************
+SPECIFICATIONS:
+	Return the # of entries on ghost list "list".
+*****************************************************************************/
+{
+	return((PFghostsize == 0)? 0: PFghostcnt[list]);
+}
+
+void PFghostReleaseFile(fd)
+int fd;		/* file descriptor */
+/****************************************************************************
+SPECIFICATIONS:
+	Forget all the pages of file "fd". Called when the file is
+	closed, since its file descriptor may be reused by another file.
+
+IMPLEMENTATION NOTES:
+	A linear scan of the entries is performed. This is only done
+	when a file is closed.
+*****************************************************************************/
+{
+int e;
+
+	for (e=0; e < PFghostsize; e++)
+		if (PFghosttbl[e].fd == fd)
+			PFghostRemove(e);
+}
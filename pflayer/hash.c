@@ -1,193 +1,304 @@
-/* hash.c: Functions to facilitate finding the buffer page given
-a file descriptor and a page number */
-#include <stdio.h>
-#include "pf.h"
-#include "pftypes.h"
-
-/* hash table */
-static PFhash_entry *PFhashtbl[PF_HASH_TBL_SIZE];
-
-extern char *malloc();
-
-void PFhashInit()
-/****************************************************************************
-SPECIFICATIONS:
-	Init the hash table entries. Must be called before any of the other
-	hash functions are used.
-
-AUTHOR: clc
-
-RETURN VALUE: none
-
-GLOBAL VARIABLES MODIFIED:
-	PFhashtbl
-*****************************************************************************/
-{
-int i;
-
-	for (i=0; i < PF_HASH_TBL_SIZE; i++)
-		PFhashtbl[i] = NULL;
-}
-
-
-PFbpage *PFhashFind(fd,page)
-int fd;		/* file descriptor */
-int page;	/* page number */
-/****************************************************************************
-SPECIFICATIONS:
-	Given the file descriptor "fd", and page number "page",
-	find the buffer address of this particular page.
-
-AUTHOR: clc
-
-RETURN VALUE:
-	NULL	if not found.
-	Buffer address, if found.
-
-*****************************************************************************/
-{
-int bucket;	/* bucket to look for the page*/
-PFhash_entry *entry; /* ptr to entries to search */
-
-
-	/* See which bucket it is in */
-	bucket = PFhash(fd,page);
-
-	/* go through the linked list of this bucket */
-	for (entry=PFhashtbl[bucket]; entry != NULL; 
-				entry = entry->nextentry){
-		if (entry->fd == fd && entry->page == page )
-			/* found it */
-			return(entry->bpage);
-	}
-
-	/* not found */
-	return(NULL);
-}
-
-PFhashInsert(fd,page,bpage)
-int fd;		/* file descriptor */
-int page;	/* page number */
-PFbpage *bpage;	/* buffer address for this page */
-/*****************************************************************************
-SPECIFICATIONS:
-	Insert the file descriptor "fd", page number "page", and the
-	buffer address "bpage" into the hash table. 
-
-AUTHOR: clc
-
-RETURN VALUE:
-	PFE_OK	if OK
-	PFE_NOMEM	if nomem
-	PFE_HASHPAGEEXIST if the page already exists.
-	
-GLOBAL VARIABLES MODIFIED:
-	PFhashtbl
-*****************************************************************************/
-{
-int bucket;	/* bucket to insert the page */
-PFhash_entry *entry; /* pointer to new entry */
-
-
-	if (PFhashFind(fd,page) != NULL){
-		/* page already inserted */
-		PFerrno = PFE_HASHPAGEEXIST;
-		return(PFerrno);
-	}
-
-	/* find the bucket for this page */
-	bucket = PFhash(fd,page);
-	
-	/* allocate mem for new entry */
-	if ((entry=(PFhash_entry *)malloc(sizeof(PFhash_entry)))== NULL){
-		/* no mem */
-		PFerrno = PFE_NOMEM;
-		return(PFerrno);
-	}
-
-	/* Insert entry as head of list for this bucket */
-	entry->fd = fd;
-	entry->page = page;
-	entry->bpage = bpage;
-	entry->nextentry = PFhashtbl[bucket];
-	entry->preventry = NULL;
-	if (PFhashtbl[bucket] != NULL)
-		PFhashtbl[bucket]->preventry = entry;
-	PFhashtbl[bucket] = entry;
-
-	return(PFE_OK);
-}
-
-PFhashDelete(fd,page)
-int fd;		/* file descriptor */
-int page;	/* page number */
-/****************************************************************************
-SPECIFICATIONS:
-	Delete the entry whose file descriptor is "fd", and whose page number
-	is "page" from the hash table.
-
-AUTHOR: clc
-
-RETURN VALUE:
-	PFE_OK	if OK
-	PFE_HASHNOTFOUND if can't find the entry
-
-GLOBAL VARIABLES MODIFIED:
-	PFhashtbl
-*****************************************************************************/
-{
-int bucket;	/* bucket for this page */
-PFhash_entry *entry;	/* entry to look for */
-
-	/* find the bucket */
-	bucket = PFhash(fd,page);
-
-	/* See if the entry is in this bucket */
-	for (entry=PFhashtbl[bucket]; entry != NULL; entry = entry->nextentry)
-		if (entry->fd == fd && entry->page == page)
-			break;
-
-	if (entry == NULL){
-		/* not found */
-		PFerrno = PFE_HASHNOTFOUND;
-		return(PFerrno);
-	}
-
-	/* get rid of this entry */
-	if (entry == PFhashtbl[bucket])
-		PFhashtbl[bucket] = entry->nextentry;
-	if (entry->preventry != NULL)
-		entry->preventry->nextentry = entry->nextentry;
-	if (entry->nextentry != NULL)
-		entry->nextentry->preventry = entry->preventry;
-	free((char *)entry);
-
-	return(PFE_OK);
-}
-
-
-PFhashPrint()
-/****************************************************************************
-SPECIFICATIONS:
-	Print the hash table entries.
-
-AUTHOR: clc
-
-RETURN VALUE: None
-*****************************************************************************/
-{
-int i;
-PFhash_entry *entry;
-
-	for (i=0; i < PF_HASH_TBL_SIZE; i++){
-		printf("bucket %d\n",i);
-		if (PFhashtbl[i] == NULL)
-			printf("\tempty\n");
-		else{
-			for (entry = PFhashtbl[i]; entry != NULL;
-					entry = entry->nextentry)
-				printf("\tfd: %d, page: %d %d\n",
-					entry->fd, entry->page,entry->bpage);
-		}
-	}
-}
+/* hash.c: Functions to facilitate finding the buffer page given
+a file descriptor and a page number.
+The table is split into PF_HASH_NSHARDS shards, each with its own latch,
+so that threads looking up different pages seldom wait for each other.
+The caller latches the shard of a page with PFhashLatch() around
+PFhashFind(), PFhashInsert() and PFhashDelete() on that page. */
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include "pf.h"
+#include "pftypes.h"
+
+/* hash table shard */
+typedef struct PFhash_shard {
+	pthread_mutex_t latch;	/* latch of the shard */
+	PFhash_entry *tbl;	/* the entries */
+	int size;		/* # of entries in tbl, a power of 2 */
+	int shift;		/* 32 - log2(size) */
+	int count;		/* # of entries in use */
+	char pad[PF_CACHE_LINE]; /* keep shards on separate cache lines */
+} PFhash_shard;
+
+static PFhash_shard PFhashtbl[PF_HASH_NSHARDS];
+
+/* shard of (fd,page), entry where the search for (fd,page) starts in
+it, and the entry after entry i */
+#define PFhashShard(fd,page)	(&PFhashtbl[PFhash(fd,page) & (PF_HASH_NSHARDS-1)])
+#define PFhashSlot(sh,fd,page)	((int)(PFhash(fd,page) >> (sh)->shift))
+#define PFhashNext(sh,i)	(((i)+1) & ((sh)->size-1))
+
+void PFhashInit()
+/****************************************************************************
+SPECIFICATIONS:
+	Init the hash table entries. Must be called before any of the other
+	hash functions are used.
+
+AUTHOR: clc
+
+RETURN VALUE: none
+
+GLOBAL VARIABLES MODIFIED:
+	PFhashtbl
+*****************************************************************************/
+{
+static int initdone = FALSE;	/* TRUE once the latches are set up */
+PFhash_shard *sh;
+int i;
+
+	for (sh=PFhashtbl; sh < &PFhashtbl[PF_HASH_NSHARDS]; sh++){
+		if (!initdone)
+			pthread_mutex_init(&sh->latch,NULL);
+		for (i=0; i < sh->size; i++)
+			sh->tbl[i].frame = PF_FRAME_NONE;
+		sh->count = 0;
+	}
+	initdone = TRUE;
+}
+
+void PFhashLatch(fd,page)
+int fd;		/* file descriptor */
+long page;	/* page number */
+/****************************************************************************
+SPECIFICATIONS:
+	Latch the shard of the hash table that holds page "page" of
+	file "fd".
+*****************************************************************************/
+{
+	pthread_mutex_lock(&PFhashShard(fd,page)->latch);
+}
+
+void PFhashUnlatch(fd,page)
+int fd;		/* file descriptor */
+long page;	/* page number */
+/****************************************************************************
+SPECIFICATIONS:
+	Release the latch taken by PFhashLatch(fd,page).
+*****************************************************************************/
+{
+	pthread_mutex_unlock(&PFhashShard(fd,page)->latch);
+}
+
+static PFhashGrow(sh)
+PFhash_shard *sh;	/* shard to grow */
+/****************************************************************************
+SPECIFICATIONS:
+	Make shard "sh" large enough for one more entry: at least its
+	share of twice the number of buffers (PF_MAX_BUFS may have been
+	raised by set_buffer_size()) and twice the number of entries in
+	use. The entries in use are moved into the new table.
+
+RETURN VALUE:
+	PFE_OK	if OK
+	PFE_NOMEM	if no memory.
+*****************************************************************************/
+{
+PFhash_entry *oldtbl;	/* old table */
+int oldsize;		/* # of entries in old table */
+int size,shift;		/* new size, and its shift */
+int i,j;
+
+	for (size=PF_HASH_MIN_SIZE, shift=32-6;
+			size < 2*PF_MAX_BUFS/PF_HASH_NSHARDS ||
+			size < 2*(sh->count+1); size <<= 1, shift--);
+	if (size <= sh->size)
+		return(PFE_OK);
+
+	oldtbl = sh->tbl;
+	oldsize = sh->size;
+	if ((sh->tbl=(PFhash_entry *)malloc(size*sizeof(PFhash_entry)))
+								== NULL){
+		/* no mem: keep the old table */
+		sh->tbl = oldtbl;
+		PFerrno = PFE_NOMEM;
+		return(PFerrno);
+	}
+	sh->size = size;
+	sh->shift = shift;
+	for (i=0; i < size; i++)
+		sh->tbl[i].frame = PF_FRAME_NONE;
+
+	/* move the entries in use */
+	for (i=0; i < oldsize; i++)
+		if (oldtbl[i].frame != PF_FRAME_NONE){
+			for (j=PFhashSlot(sh,oldtbl[i].fd,oldtbl[i].page);
+					sh->tbl[j].frame != PF_FRAME_NONE;
+					j=PFhashNext(sh,j));
+			sh->tbl[j] = oldtbl[i];
+		}
+	if (oldtbl != NULL)
+		free((char *)oldtbl);
+
+	return(PFE_OK);
+}
+
+
+PFhashFind(fd,page)
+int fd;		/* file descriptor */
+long page;	/* page number */
+/****************************************************************************
+SPECIFICATIONS:
+	Given the file descriptor "fd", and page number "page",
+	find the buffer frame of this particular page.
+
+AUTHOR: clc
+
+RETURN VALUE:
+	PF_FRAME_NONE	if not found.
+	Buffer frame, if found.
+
+*****************************************************************************/
+{
+PFhash_shard *sh;	/* shard of the page */
+int i;		/* entry to look at */
+
+	sh = PFhashShard(fd,page);
+	if (sh->size == 0)
+		return(PF_FRAME_NONE);
+
+	/* go through the run of entries starting at the hashed one */
+	for (i=PFhashSlot(sh,fd,page); sh->tbl[i].frame != PF_FRAME_NONE;
+						i=PFhashNext(sh,i)){
+		if (sh->tbl[i].fd == fd && sh->tbl[i].page == page )
+			/* found it */
+			return(sh->tbl[i].frame);
+	}
+
+	/* not found */
+	return(PF_FRAME_NONE);
+}
+
+PFhashInsert(fd,page,frame)
+int fd;		/* file descriptor */
+long page;	/* page number */
+int frame;	/* buffer frame for this page */
+/*****************************************************************************
+SPECIFICATIONS:
+	Insert the file descriptor "fd", page number "page", and the
+	buffer frame "frame" into the hash table.
+
+AUTHOR: clc
+
+RETURN VALUE:
+	PFE_OK	if OK
+	PFE_NOMEM	if nomem
+	PFE_HASHPAGEEXIST if the page already exists.
+
+GLOBAL VARIABLES MODIFIED:
+	PFhashtbl
+*****************************************************************************/
+{
+PFhash_shard *sh;	/* shard of the page */
+int i;		/* entry to look at */
+
+	sh = PFhashShard(fd,page);
+
+	/* keep the shard at most half full. If it cannot grow, go on
+	as long as one entry stays empty */
+	if ((2*(sh->count+1) > sh->size ||
+			2*PF_MAX_BUFS/PF_HASH_NSHARDS > sh->size) &&
+			PFhashGrow(sh) != PFE_OK && sh->count+1 >= sh->size)
+		return(PFerrno);
+
+	/* one probe sequence finds either the page or an empty entry */
+	for (i=PFhashSlot(sh,fd,page); sh->tbl[i].frame != PF_FRAME_NONE;
+						i=PFhashNext(sh,i))
+		if (sh->tbl[i].fd == fd && sh->tbl[i].page == page){
+			/* page already inserted */
+			PFerrno = PFE_HASHPAGEEXIST;
+			return(PFerrno);
+		}
+
+	sh->tbl[i].fd = fd;
+	sh->tbl[i].page = page;
+	sh->tbl[i].frame = frame;
+	sh->count++;
+
+	return(PFE_OK);
+}
+
+PFhashDelete(fd,page)
+int fd;		/* file descriptor */
+long page;	/* page number */
+/****************************************************************************
+SPECIFICATIONS:
+	Delete the entry whose file descriptor is "fd", and whose page number
+	is "page" from the hash table.
+
+AUTHOR: clc
+
+RETURN VALUE:
+	PFE_OK	if OK
+	PFE_HASHNOTFOUND if can't find the entry
+
+GLOBAL VARIABLES MODIFIED:
+	PFhashtbl
+
+IMPLEMENTATION NOTES:
+	No tombstone is left behind: the entries that follow in the same
+	run are shifted back into the hole when their search would
+	otherwise pass over it.
+*****************************************************************************/
+{
+PFhash_shard *sh;	/* shard of the page */
+int i;		/* entry to delete, then the hole */
+int j;		/* entry after the hole */
+int home;	/* where the search for entry j starts */
+
+	/* find the entry */
+	sh = PFhashShard(fd,page);
+	if (sh->size == 0)
+		i = -1;
+	else for (i=PFhashSlot(sh,fd,page); sh->tbl[i].frame != PF_FRAME_NONE;
+						i=PFhashNext(sh,i))
+		if (sh->tbl[i].fd == fd && sh->tbl[i].page == page)
+			break;
+
+	if (i == -1 || sh->tbl[i].frame == PF_FRAME_NONE){
+		/* not found */
+		PFerrno = PFE_HASHNOTFOUND;
+		return(PFerrno);
+	}
+
+	/* get rid of this entry, moving back the ones after it */
+	for (j=PFhashNext(sh,i); sh->tbl[j].frame != PF_FRAME_NONE;
+						j=PFhashNext(sh,j)){
+		home = PFhashSlot(sh,sh->tbl[j].fd,sh->tbl[j].page);
+		/* entry j can move to the hole if its home is not
+		in the cyclic range (i,j] */
+		if ((j > i && (home <= i || home > j)) ||
+				(j < i && (home <= i && home > j))){
+			sh->tbl[i] = sh->tbl[j];
+			i = j;
+		}
+	}
+	sh->tbl[i].frame = PF_FRAME_NONE;
+	sh->count--;
+
+	return(PFE_OK);
+}
+
+
+PFhashPrint()
+/****************************************************************************
+SPECIFICATIONS:
+	Print the hash table entries.
+
+AUTHOR: clc
+
+RETURN VALUE: None
+*****************************************************************************/
+{
+PFhash_shard *sh;
+int i;
+
+	for (sh=PFhashtbl; sh < &PFhashtbl[PF_HASH_NSHARDS]; sh++){
+		printf("shard %d: %d of %d entries used\n",(int)(sh-PFhashtbl),
+			sh->count,sh->size);
+		for (i=0; i < sh->size; i++)
+			if (sh->tbl[i].frame != PF_FRAME_NONE)
+				printf("entry %d\tfd: %d, page: %ld %d\n",i,
+					sh->tbl[i].fd, sh->tbl[i].page,
+					sh->tbl[i].frame);
+	}
+}
@@ -1,8 +1,18 @@
 /* pf.c: Paged File Interface Routines+ support routines */
+#define _GNU_SOURCE	/* for O_DIRECT */
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
 #include <sys/types.h>
 #include <fcntl.h>
 #include <sys/file.h>
+#include <sys/uio.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <time.h>
+#include <pthread.h>
 #include "pf.h"
 #include "pftypes.h"
 
@@ -11,23 +21,112 @@
 #define L_SET 0
 #endif
 
-int PFerrno = PFE_OK;	/* last error message */
+__thread int PFerrno = PFE_OK;	/* last error message of the thread */
 
-static PFftab_ele PFftab[PF_FTAB_SIZE]; /* table of opened files */
+/* the table of opened files, PFftabsize entries in chunks (see
+pftypes.h). Entries are looked at without the file table latch by the
+threads using them, so a chunk never moves */
+static PFftab_ele *PFftabchunk[PF_FTAB_MAXCHUNKS];
+static int PFftabsize = 0;	/* # of entries set up */
+static int PFftabfree = -1;	/* first free entry, or -1 */
+static int PFftabhash[PF_FTAB_NBUCKETS]; /* first file entry of each
+				bucket of the file hash, or -1 */
+#define PFftab(fd)	(PFftabchunk[(fd)/PF_FTAB_CHUNK][(fd)%PF_FTAB_CHUNK])
+#define PFftabBucket(dev,ino)	((int)(((unsigned)(ino)*2654435761u ^ \
+				(unsigned)(dev)) & (PF_FTAB_NBUCKETS-1)))
 
-/// statistics
-PF_Stats PFstats;
+/* latch of the file table: taken to open and close files, and to
+change a file header (page allocation and disposal) */
+static pthread_mutex_t PFftablatch = PTHREAD_MUTEX_INITIALIZER;
 
-/* true if file descriptor fd is invaild */
-#define PFinvalidFd(fd) ((fd) < 0 || (fd) >= PF_FTAB_SIZE \
-				|| PFftab[fd].fname == NULL)
+/// statistics
+PF_Stats PFstats;	/* snapshot of the sum of all the threads' counters */
+
+/* counters of one thread */
+typedef struct PFstats_slot {
+	PF_Stats st;			/* the counters */
+	PF_FileStats *files[PF_FTAB_MAXCHUNKS]; /* its counters of each
+				file entry, by chunk of the file table: NULL
+				until it counts for a file of the chunk */
+	struct PFstats_slot *next;	/* next thread's counters */
+} PFstats_slot;
+static PFstats_slot *PFstatslots = NULL; /* all the threads' counters */
+static pthread_mutex_t PFstatlatch = PTHREAD_MUTEX_INITIALIZER;
+__thread PF_Stats *PFmystats = NULL;	/* counters of this thread */
+__thread PF_FileStats **PFmyfiles = NULL; /* its file counters (files) */
+
+/* counters of the files closed since the last PF_ResetStats(), by policy.
+Those of an open file are summed up from the threads' (see PFfstat()) */
+static PF_FileStats PFpolicystats[PF_NUM_POLICIES];
+
+/* true if file descriptor fd is invaild: not an open handle */
+#define PFinvalidFd(fd) ((fd) < 0 || \
+			(fd) >= __atomic_load_n(&PFftabsize,__ATOMIC_ACQUIRE) \
+			|| !PFftab(fd).isopen)
+
+/* the file entry of handle fd, which holds the state of its file */
+#define PFfileOf(fd)	(PFftab(fd).file)
+
+/* TRUE if file "fd" is laid out in whole pages: PF_FORMAT_V2 or V3 */
+#define PFv2(fd)	PFwholePages(PFftab(fd).hdr.format)
+
+/* TRUE if the pages of file "fd" are compressed: PF_FORMAT_COMPRESSED */
+#define PFcompressed(fd) (PFftab(fd).hdr.format == PF_FORMAT_COMPRESSED)
+
+/* where page "pagenum" of file "fd" starts in the file, how much of it
+is read or written, and from where in its body "fpage". The pages of a
+PF_FORMAT_V2 file come after the map block of their group */
+#define PFpageOffset(fd,pagenum) (((off_t)(pagenum) + (PFv2(fd)? \
+			(pagenum)/PF_MAP_BITS + 1: 0))*PFpageIOSize(fd) + \
+			PFhdrSize(fd))
+#define PFpageIOSize(fd)	PF_SLOT_SIZE(PFftab(fd).hdr.format, \
+						PFftab(fd).hdr.pagesize)
+#define PFpageIOBase(fd,fpage)	(PFv2(fd)? (fpage)->pagebuf: (char *)(fpage))
+#define PFhdrSize(fd)	PF_HDR_SIZE(PFftab(fd).hdr.format, \
+						PFftab(fd).hdr.pagesize)
+
+/* where map block "group" of a PF_FORMAT_V2 file "fd" starts */
+#define PFmapOffset(fd,group) ((off_t)(group)*(PF_MAP_BITS+1)* \
+				PFpageIOSize(fd) + PFhdrSize(fd))
+
+/* TRUE if page "pagenum" of file "fd" is a map page (PF_FORMAT_MAPPED) */
+#define PFisMapPage(fd,pagenum) (PFftab(fd).hdr.format == PF_FORMAT_MAPPED \
+					&& PFmapPage(pagenum))
+
+/* true if file "fd" was opened with PF_OPEN_MMAP: its pages are read
+straight from the mapping, and never go through the buffer */
+#define PFmapped(fd)	(PFftab(fd).flags & PF_OPEN_MMAP)
+
+/* TRUE if bit "pagenum" of the allocation bitmap of file "fd" is set */
+#define PFbitIsSet(fd,pagenum)	(PFftab(fd).usedmap[(pagenum)>>3] & \
+						(1 << ((pagenum)&7)))
+
+/* TRUE if page "pagenum" of file "fd", whose body is "fpage" if it has
+been read, is used: a user page, not free nor a map page. The pages of a
+file with an allocation bitmap need not be read to tell */
+#define PFbitmapUsed(fd,pagenum) (!PFisMapPage(fd,pagenum) && \
+					PFbitIsSet(fd,pagenum))
+#define PFpageUsed(fd,pagenum,fpage) (PFftab(fd).usedmap != NULL? \
+			PFbitmapUsed(fd,pagenum): \
+			(fpage)->nextfree == PF_PAGE_USED)
+
+/* a file header as it is written into an aligned file: a whole block,
+aligned for O_DIRECT */
+typedef union PFhdr_blk {
+	PFhdr_str hdr;
+	char blk[PF_DIRECT_ALIGN];
+} __attribute__((aligned(PF_DIRECT_ALIGN))) PFhdr_blk;
 
 /* true if page number "pagenum" of file "fd" is invalid in the
 sense that it's <0 or >= # of pages in the file */
 #define PFinvalidPagenum(fd,pagenum) ((pagenum)<0 || (pagenum) >= \
-				PFftab[fd].hdr.numpages)
+				PFftab(fd).hdr.numpages)
+
+/* true if "size" is not a page size a file can have: a power of 2 from
+PF_PAGE_SIZE to PF_MAX_PAGE_SIZE */
+#define PFbadPageSize(size) ((size) < PF_PAGE_SIZE || \
+			(size) > PF_MAX_PAGE_SIZE || ((size) & ((size)-1)))
 
-extern char *malloc();
 
 /****************** Internal Support Functions *****************************/
 static char *savestr(str)
@@ -45,521 +144,2954 @@ char *s;
 	return(s);
 }
 
+PF_Stats *PFstatsSlot()
+/****************************************************************************
+SPECIFICATIONS:
+	Set up the statistics counters of the calling thread, the first
+	time it counts something (see PFstat()). The counters of a thread
+	are never freed, so that they still count after it exits.
+
+RETURN VALUE:
+	Pointer to the counters of the thread.
+*****************************************************************************/
+{
+PFstats_slot *slot;
+static PF_Stats dummy;	/* counts when there is no memory left */
+
+	if ((slot=(PFstats_slot *)malloc(sizeof(PFstats_slot))) == NULL)
+		return(&dummy);
+	memset((char *)slot,0,sizeof(PFstats_slot));
+	pthread_mutex_lock(&PFstatlatch);
+	slot->next = PFstatslots;
+	PFstatslots = slot;
+	pthread_mutex_unlock(&PFstatlatch);
+	PFmyfiles = slot->files;
+	PFmystats = &slot->st;
+	return(PFmystats);
+}
+
+PF_FileStats *PFfileStatsSlot(fd)
+int fd;		/* file entry */
+/****************************************************************************
+SPECIFICATIONS:
+	Set up the counters of the calling thread for file "fd", the
+	first time it counts something for a file of its chunk of the
+	file table (see PFfileStats()). They are never freed, as the
+	counters of the thread.
+
+RETURN VALUE:
+	Pointer to the counters of the thread for the file.
+*****************************************************************************/
+{
+PF_FileStats *chunk;
+static PF_FileStats dummy; /* counts when there is no memory left */
+
+	if (PFmyfiles == NULL && (PFstatsSlot(), PFmyfiles == NULL))
+		return(&dummy);
+	if ((chunk=PFmyfiles[fd/PF_FTAB_CHUNK]) == NULL){
+		if ((chunk=(PF_FileStats *)calloc(PF_FTAB_CHUNK,
+					sizeof(PF_FileStats))) == NULL)
+			return(&dummy);
+		/* seen by PFfileStatsSum() once it is zeroed */
+		__atomic_store_n(&PFmyfiles[fd/PF_FTAB_CHUNK],chunk,
+							__ATOMIC_RELEASE);
+	}
+	return(&chunk[fd%PF_FTAB_CHUNK]);
+}
+
+static double PFstatsNow()
+/****************************************************************************
+SPECIFICATIONS:
+	The time a snapshot of the counters is taken, in seconds.
+*****************************************************************************/
+{
+struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC,&ts);
+	return(ts.tv_sec + ts.tv_nsec/1e9);
+}
+
+static void PFfileStatsAdd(to,from)
+PF_FileStats *to;	/* counters added to */
+PF_FileStats *from;	/* counters to add */
+/****************************************************************************
+SPECIFICATIONS:
+	Add the counters of a file to those of its policy. The pinned
+	frames add up, and the high water mark is the highest one.
+*****************************************************************************/
+{
+	to->logicalReads += from->logicalReads;
+	to->logicalWrites += from->logicalWrites;
+	to->physicalReads += from->physicalReads;
+	to->physicalWrites += from->physicalWrites;
+	to->bufferHits += from->bufferHits;
+	to->bufferMisses += from->bufferMisses;
+	to->evictions += from->evictions;
+	to->dirtyEvictions += from->dirtyEvictions;
+	to->readAheadHits += from->readAheadHits;
+	to->readAheadWasted += from->readAheadWasted;
+	to->pinnedFrames += from->pinnedFrames;
+	if (from->pinnedHighWater > to->pinnedHighWater)
+		to->pinnedHighWater = from->pinnedHighWater;
+}
+
+static void PFfileStatsRatio(st)
+PF_FileStats *st;	/* counters */
+/****************************************************************************
+SPECIFICATIONS:
+	Work out the hit ratio of "st" from its counters.
+*****************************************************************************/
+{
+	st->hitRatio = (st->bufferHits + st->bufferMisses > 0)?
+		(double)st->bufferHits / (st->bufferHits + st->bufferMisses):
+		0.0;
+}
+
+static void PFfileStatsSum(fd,out)
+int fd;			/* file entry */
+PF_FileStats *out;	/* set to the counters of the file */
+/****************************************************************************
+SPECIFICATIONS:
+	Add up the counters of file "fd" of all the threads. The frames a
+	thread pinned and those it unpinned add up to the frames pinned
+	now. A thread's high water mark is that of its own pins, so their
+	sum is exact for a file used by one thread, and the most it can
+	be when several pin its pages. The caller holds PFstatlatch.
+*****************************************************************************/
+{
+PFstats_slot *slot;
+PF_FileStats *st;	/* counters of a thread */
+long high;		/* sum of the high water marks */
+
+	memset((char *)out,0,sizeof(PF_FileStats));
+	high = 0;
+	for (slot=PFstatslots; slot != NULL; slot=slot->next){
+		st = __atomic_load_n(&slot->files[fd/PF_FTAB_CHUNK],
+							__ATOMIC_ACQUIRE);
+		if (st == NULL)
+			continue;
+		st += fd%PF_FTAB_CHUNK;
+		PFfileStatsAdd(out,st);
+		high += st->pinnedHighWater;
+	}
+	out->pinnedHighWater = (high > out->pinnedFrames)? high:
+							out->pinnedFrames;
+}
+
+static void PFfileStatsClear(fd,all)
+int fd;		/* file entry */
+int all;	/* FALSE to keep the frames pinned now */
+/****************************************************************************
+SPECIFICATIONS:
+	Set the counters of file "fd" of all the threads back to 0, or
+	all but the frames pinned now, which then are the high water
+	mark. The caller holds PFstatlatch.
+*****************************************************************************/
+{
+PFstats_slot *slot;
+PF_FileStats *st;	/* counters of a thread */
+long pinned;
+
+	for (slot=PFstatslots; slot != NULL; slot=slot->next){
+		st = __atomic_load_n(&slot->files[fd/PF_FTAB_CHUNK],
+							__ATOMIC_ACQUIRE);
+		if (st == NULL)
+			continue;
+		st += fd%PF_FTAB_CHUNK;
+		pinned = all? 0: st->pinnedFrames;
+		memset((char *)st,0,sizeof(PF_FileStats));
+		st->pinnedFrames = pinned;
+		st->pinnedHighWater = (pinned > 0)? pinned: 0;
+	}
+}
+
+static PFpolicyOf(rep_policy)
+char *rep_policy;	/* name of a page replacement policy, or NULL */
+/****************************************************************************
+SPECIFICATIONS:
+	Tell which policy "rep_policy" names: "MRU", "CLOCK", "2Q" or
+	"ARC". Anything else is LRU.
+
+RETURN VALUE:
+	PF_POLICY_xxx
+*****************************************************************************/
+{
+	if (rep_policy == NULL)
+		return(PF_POLICY_LRU);
+	if (strcmp(rep_policy,"MRU") == 0)
+		return(PF_POLICY_MRU);
+	if (strcmp(rep_policy,"CLOCK") == 0)
+		return(PF_POLICY_CLOCK);
+	if (strcmp(rep_policy,"2Q") == 0)
+		return(PF_POLICY_2Q);
+	if (strcmp(rep_policy,"ARC") == 0)
+		return(PF_POLICY_ARC);
+	return(PF_POLICY_LRU);
+}
+
 /// returns requested file table entry
 PFftab_ele get_PFftab(int fd){
-    return PFftab[fd];
+    return PFftab(fd);
+}
+/// returns the page replacement policy of a file, PF_POLICY_xxx: set when
+/// the file is opened, so it can be read without a latch
+int PFfilePolicy(int fd){
+    return PFftab(fd).policy;
 }
 ///
 // If new size is >20 and >previously set buffer size then updates buffer size and returns 1
-// else return 0
+// else return 0. The size can't go past PF_MAX_FRAMES.
+// The buffer grows into the new size on a later miss; the frames already
+// set up stay where they are.
 int set_buffer_size(int siz){
-	if(siz > PF_MAX_BUFS){
+	if(siz > PF_MAX_BUFS && siz <= PF_MAX_FRAMES){
 		PF_MAX_BUFS = siz;
 		return 1;
 	}
 	else
 		return 0;
 }
-/// get statistics
+/// get statistics: sum of the counters of all the threads
 void PF_GetStats(PF_Stats *out){
+PFstats_slot *slot;
+
     if(out){
+		pthread_mutex_lock(&PFstatlatch);
+		PFstats.logicalReads = PFstats.logicalWrites = 0;
+		PFstats.physicalReads = PFstats.physicalWrites = 0;
+		PFstats.bufferHits = PFstats.bufferMisses = 0;
+		PFstats.arcGhostRecentHits = PFstats.arcGhostFrequentHits = 0;
+		PFstats.foregroundDirtyEvictions = PFstats.backgroundCleans = 0;
+		PFstats.readAheadHits = PFstats.readAheadWasted = 0;
+		PFstats.compressWrites = PFstats.compressRawBytes = 0;
+		PFstats.compressStoredBytes = 0;
+		PFstats.decompressReads = PFstats.decompressNanos = 0;
+		PFstats.zcacheHits = PFstats.zcacheMisses = 0;
+		PFstats.zcacheInserts = PFstats.zcacheEvictions = 0;
+		for (slot=PFstatslots; slot != NULL; slot=slot->next){
+			PFstats.logicalReads += slot->st.logicalReads;
+			PFstats.logicalWrites += slot->st.logicalWrites;
+			PFstats.physicalReads += slot->st.physicalReads;
+			PFstats.physicalWrites += slot->st.physicalWrites;
+			PFstats.bufferHits += slot->st.bufferHits;
+			PFstats.bufferMisses += slot->st.bufferMisses;
+			PFstats.arcGhostRecentHits +=
+					slot->st.arcGhostRecentHits;
+			PFstats.arcGhostFrequentHits +=
+					slot->st.arcGhostFrequentHits;
+			PFstats.foregroundDirtyEvictions +=
+					slot->st.foregroundDirtyEvictions;
+			PFstats.backgroundCleans += slot->st.backgroundCleans;
+			PFstats.readAheadHits += slot->st.readAheadHits;
+			PFstats.readAheadWasted += slot->st.readAheadWasted;
+			PFstats.compressWrites += slot->st.compressWrites;
+			PFstats.compressRawBytes += slot->st.compressRawBytes;
+			PFstats.compressStoredBytes +=
+					slot->st.compressStoredBytes;
+			PFstats.decompressReads += slot->st.decompressReads;
+			PFstats.decompressNanos += slot->st.decompressNanos;
+			PFstats.zcacheHits += slot->st.zcacheHits;
+			PFstats.zcacheMisses += slot->st.zcacheMisses;
+			PFstats.zcacheInserts += slot->st.zcacheInserts;
+			PFstats.zcacheEvictions += slot->st.zcacheEvictions;
+		}
 		PFstats.pagesAccessed = PFstats.logicalReads + PFstats.logicalWrites;
+		PFstats.hitRatio = (PFstats.bufferHits + PFstats.bufferMisses > 0)?
+			(double)PFstats.bufferHits /
+			(PFstats.bufferHits + PFstats.bufferMisses): 0.0;
+		PFstats.compressRatio = (PFstats.compressStoredBytes > 0)?
+			(double)PFstats.compressRawBytes /
+			PFstats.compressStoredBytes: 0.0;
+		PFstats.decompressNsPerPage = (PFstats.decompressReads > 0)?
+			(double)PFstats.decompressNanos /
+			PFstats.decompressReads: 0.0;
+		PFstats.seconds = PFstatsNow();
         *out = PFstats;
+		pthread_mutex_unlock(&PFstatlatch);
 	}
 }
-/// reset statistics
+/// reset statistics of all the threads, and of the files and policies
 void PF_ResetStats(){
+PFstats_slot *slot;
+int fd;
+
+	pthread_mutex_lock(&PFftablatch);
+	pthread_mutex_lock(&PFstatlatch);
+	for (slot=PFstatslots; slot != NULL; slot=slot->next)
+		memset(&slot->st, 0, sizeof(PF_Stats));
     memset(&PFstats, 0, sizeof(PFstats));
+	memset((char *)PFpolicystats,0,sizeof(PFpolicystats));
+	for (fd=0; fd < PFftabsize; fd++)
+		if (PFftab(fd).isopen && PFfileOf(fd) == fd)
+			/* the frames pinned now stay pinned */
+			PFfileStatsClear(fd,FALSE);
+	pthread_mutex_unlock(&PFstatlatch);
+	pthread_mutex_unlock(&PFftablatch);
+}
+
+void PF_DiffStats(now,then,delta)
+PF_Stats *now;		/* a snapshot from PF_GetStats() */
+PF_Stats *then;		/* an earlier one */
+PF_Stats *delta;	/* set to what was counted in between */
+/****************************************************************************
+SPECIFICATIONS:
+	Set "delta" to the counters of "now" less those of "then", with
+	the ratios of the counts in between and "seconds" the time between
+	the snapshots, so that the counters divided by it are rates. The
+	ARC target is the one of "now". "delta" may be "now" or "then".
+*****************************************************************************/
+{
+PF_Stats d;
+
+	d.logicalReads = now->logicalReads - then->logicalReads;
+	d.logicalWrites = now->logicalWrites - then->logicalWrites;
+	d.physicalReads = now->physicalReads - then->physicalReads;
+	d.physicalWrites = now->physicalWrites - then->physicalWrites;
+	d.pagesAccessed = now->pagesAccessed - then->pagesAccessed;
+	d.bufferHits = now->bufferHits - then->bufferHits;
+	d.bufferMisses = now->bufferMisses - then->bufferMisses;
+	d.hitRatio = (d.bufferHits + d.bufferMisses > 0)?
+		(double)d.bufferHits / (d.bufferHits + d.bufferMisses): 0.0;
+	d.arcGhostRecentHits = now->arcGhostRecentHits -
+					then->arcGhostRecentHits;
+	d.arcGhostFrequentHits = now->arcGhostFrequentHits -
+					then->arcGhostFrequentHits;
+	d.arcTarget = now->arcTarget;
+	d.foregroundDirtyEvictions = now->foregroundDirtyEvictions -
+					then->foregroundDirtyEvictions;
+	d.backgroundCleans = now->backgroundCleans - then->backgroundCleans;
+	d.readAheadHits = now->readAheadHits - then->readAheadHits;
+	d.readAheadWasted = now->readAheadWasted - then->readAheadWasted;
+	d.compressWrites = now->compressWrites - then->compressWrites;
+	d.compressRawBytes = now->compressRawBytes - then->compressRawBytes;
+	d.compressStoredBytes = now->compressStoredBytes -
+					then->compressStoredBytes;
+	d.compressRatio = (d.compressStoredBytes > 0)?
+		(double)d.compressRawBytes / d.compressStoredBytes: 0.0;
+	d.decompressReads = now->decompressReads - then->decompressReads;
+	d.decompressNanos = now->decompressNanos - then->decompressNanos;
+	d.decompressNsPerPage = (d.decompressReads > 0)?
+		(double)d.decompressNanos / d.decompressReads: 0.0;
+	d.zcacheHits = now->zcacheHits - then->zcacheHits;
+	d.zcacheMisses = now->zcacheMisses - then->zcacheMisses;
+	d.zcacheInserts = now->zcacheInserts - then->zcacheInserts;
+	d.zcacheEvictions = now->zcacheEvictions - then->zcacheEvictions;
+	d.seconds = now->seconds - then->seconds;
+	*delta = d;
+}
+
+PF_GetFileStats(fd,out)
+int fd;			/* file descriptor */
+PF_FileStats *out;	/* set to the counters of the file */
+/****************************************************************************
+SPECIFICATIONS:
+	Take a snapshot of the counters of the file open as "fd", since it
+	was opened or since the last PF_ResetStats(). The handles open on
+	the same file share its counters. The counters of all the files
+	add up to those of PF_GetStats(), but for the pages read and
+	written by files closed since. Each thread counts on its own,
+	and the snapshot adds the threads' counters up: "pinnedHighWater"
+	is then the sum of the most frames each thread had pinned at
+	once, which is more than the file ever had if several threads
+	pinned its pages at different times.
+
+RETURN VALUE:
+	PFE_OK	if OK
+	PFE_FD	if "fd" is not an open file descriptor.
+*****************************************************************************/
+{
+	if (PFinvalidFd(fd)){
+		PFerrno = PFE_FD;
+		return(PFerrno);
+	}
+	pthread_mutex_lock(&PFstatlatch);
+	PFfileStatsSum(PFfileOf(fd),out);
+	pthread_mutex_unlock(&PFstatlatch);
+	PFfileStatsRatio(out);
+	out->seconds = PFstatsNow();
+	return(PFE_OK);
+}
+
+PF_GetPolicyStats(rep_policy,out)
+char *rep_policy;	/* page replacement policy, as for PF_OpenFile() */
+PF_FileStats *out;	/* set to the counters of the files using it */
+/****************************************************************************
+SPECIFICATIONS:
+	Take a snapshot of the counters of the files that use policy
+	"rep_policy", open or closed since the last PF_ResetStats(), so
+	that the policies can be compared. "pinnedFrames" is the # of
+	frames pinned now, and "pinnedHighWater" the highest mark of a
+	file.
+
+RETURN VALUE:
+	PFE_OK	always.
+*****************************************************************************/
+{
+int policy;
+int fd;
+PF_FileStats st;	/* counters of an open file */
+
+	policy = PFpolicyOf(rep_policy);
+	pthread_mutex_lock(&PFftablatch);
+	pthread_mutex_lock(&PFstatlatch);
+	*out = PFpolicystats[policy];
+	for (fd=0; fd < PFftabsize; fd++)
+		if (PFftab(fd).isopen && PFfileOf(fd) == fd &&
+					PFftab(fd).policy == policy){
+			PFfileStatsSum(fd,&st);
+			PFfileStatsAdd(out,&st);
+		}
+	pthread_mutex_unlock(&PFstatlatch);
+	pthread_mutex_unlock(&PFftablatch);
+	PFfileStatsRatio(out);
+	out->seconds = PFstatsNow();
+	return(PFE_OK);
+}
+
+void PF_DiffFileStats(now,then,delta)
+PF_FileStats *now;	/* a snapshot of the counters of a file or policy */
+PF_FileStats *then;	/* an earlier one of the same */
+PF_FileStats *delta;	/* set to what was counted in between */
+/****************************************************************************
+SPECIFICATIONS:
+	PF_DiffStats() for the counters of a file or a policy. The pinned
+	frames and their high water mark are those of "now".
+*****************************************************************************/
+{
+PF_FileStats d;
+
+	d.logicalReads = now->logicalReads - then->logicalReads;
+	d.logicalWrites = now->logicalWrites - then->logicalWrites;
+	d.physicalReads = now->physicalReads - then->physicalReads;
+	d.physicalWrites = now->physicalWrites - then->physicalWrites;
+	d.bufferHits = now->bufferHits - then->bufferHits;
+	d.bufferMisses = now->bufferMisses - then->bufferMisses;
+	d.evictions = now->evictions - then->evictions;
+	d.dirtyEvictions = now->dirtyEvictions - then->dirtyEvictions;
+	d.readAheadHits = now->readAheadHits - then->readAheadHits;
+	d.readAheadWasted = now->readAheadWasted - then->readAheadWasted;
+	d.pinnedFrames = now->pinnedFrames;
+	d.pinnedHighWater = now->pinnedHighWater;
+	PFfileStatsRatio(&d);
+	d.seconds = now->seconds - then->seconds;
+	*delta = d;
 }
 /// marks page dirty
-int PF_MarkDirty(int fd, int pagenum) {
+int PF_MarkDirty(int fd, long pagenum) {
+    if (PFinvalidFd(fd)) {
+        PFerrno = PFE_FD;
+        return PFerrno;
+    }
+    fd = PFfileOf(fd);
+    if (PFmapped(fd)) {
+        PFerrno = PFE_READONLY;
+        return PFerrno;
+    }
     return PFbufUsed(fd, pagenum);
 }
 
-static PFtabFindFname(fname)
-char *fname;		/* file name to find */
+static PFftabFindFile(dev,ino)
+dev_t dev;	/* device of the file */
+ino_t ino;	/* inode of the file */
 /****************************************************************************
 SPECIFICATIONS:
-	Find the index to PFftab[] entry whose "fname" field is the
-	same as "fname". 
-
-AUTHOR: clc
+	Find the file entry of the file "ino" of device "dev". The caller
+	holds the file table latch.
 
 RETURN VALUE:
 	The desired index, or 
 	-1	if not found
-
 *****************************************************************************/
 {
 int i;
 
-	for (i=0; i < PF_FTAB_SIZE; i++){
-		if(PFftab[i].fname != NULL&& strcmp(PFftab[i].fname,fname) == 0)
+	for (i=PFftabhash[PFftabBucket(dev,ino)]; i >= 0; i=PFftab(i).next)
+		if (PFftab(i).dev == dev && PFftab(i).ino == ino)
 			/* found it */
 			return(i);
-	}
 	return(-1);
 }
 
-static PFftabFindFree()
+static void PFftabHashInsert(fd)
+int fd;		/* file entry */
 /****************************************************************************
 SPECIFICATIONS:
-	Find a free entry in the open file table "PFtab", and return its
-	index.
-
-AUTHOR: clc
+	Put file entry "fd" into the file hash.
+*****************************************************************************/
+{
+int b;
 
-RETURN VALUE:
-	If >=0, the index of the free entry.
-	Otherwise, none can be found.
+	b = PFftabBucket(PFftab(fd).dev,PFftab(fd).ino);
+	PFftab(fd).next = PFftabhash[b];
+	PFftabhash[b] = fd;
+}
 
+static void PFftabHashDelete(fd)
+int fd;		/* file entry */
+/****************************************************************************
+SPECIFICATIONS:
+	Take file entry "fd" out of the file hash.
 *****************************************************************************/
 {
-int i;
+int *link;	/* link to the entry */
 
-	for (i=0; i < PF_FTAB_SIZE; i++)
-		if (PFftab[i].fname == NULL)
-			return(i);
-	return(-1);
+	for (link= &PFftabhash[PFftabBucket(PFftab(fd).dev,PFftab(fd).ino)];
+			*link != fd; link= &PFftab(*link).next);
+	*link = PFftab(fd).next;
 }
 
-PFreadfcn(fd,pagenum,buf)
-int fd;	/* file descriptor */
-int pagenum; /* page number */
-PFfpage *buf;
+static PFftabFindFree()
 /****************************************************************************
 SPECIFICATIONS:
-	Read the paged numbered "pagenum" from the file indexed by "fd"
-	into the page buffer "buf".
-
-AUTHOR: clc
+	Take a free entry of the open file table, growing the table by
+	a chunk if there is none. The caller holds the file table latch.
 
 RETURN VALUE:
-	PFE_OK	if ok
-	PF error code if not OK.
+	If >=0, the index of the free entry.
+	Otherwise, none can be found: PFerrno is PFE_FTABFULL, or
+	PFE_NOMEM.
 *****************************************************************************/
 {
-int error;
-
-	/* seek to the appropriate place */
-	if ((error=lseek(PFftab[fd].unixfd,pagenum*sizeof(PFfpage)+PF_HDR_SIZE,
-				L_SET)) == -1){
-		PFerrno = PFE_UNIX;
-		return(PFerrno);
-	}
+PFftab_ele *chunk;
+int fd;
+int i;
 
-	/* read the data */
-	if((error=read(PFftab[fd].unixfd,(char *)buf,sizeof(PFfpage)))
-			!=sizeof(PFfpage)){
-		if (error <0)
-			PFerrno = PFE_UNIX;
-		else	PFerrno = PFE_INCOMPLETEREAD;
-		return(PFerrno);
+	if (PFftabfree < 0){
+		/* grow the table by a chunk */
+		if (PFftabsize >= PF_FTAB_MAXCHUNKS*PF_FTAB_CHUNK){
+			PFerrno = PFE_FTABFULL;
+			return(-1);
+		}
+		if ((chunk=(PFftab_ele *)calloc(PF_FTAB_CHUNK,
+					sizeof(PFftab_ele))) == NULL){
+			PFerrno = PFE_NOMEM;
+			return(-1);
+		}
+		if (PFbufSetFiles(PFftabsize+PF_FTAB_CHUNK) != PFE_OK){
+			free((char *)chunk);
+			return(-1);
+		}
+		PFftabchunk[PFftabsize/PF_FTAB_CHUNK] = chunk;
+		for (i=PF_FTAB_CHUNK-1; i >= 0; i--){
+			chunk[i].next = PFftabfree;
+			PFftabfree = PFftabsize + i;
+		}
+		__atomic_store_n(&PFftabsize,PFftabsize+PF_FTAB_CHUNK,
+							__ATOMIC_RELEASE);
 	}
 
-	return(PFE_OK);
+	fd = PFftabfree;
+	PFftabfree = PFftab(fd).next;
+	PFftab(fd).next = -1;
+	return(fd);
 }
 
-PFwritefcn(fd,pagenum,buf)
-int fd;		/* file descriptor */
-int pagenum;	/* page to read */
-PFfpage *buf;	/* buffer where to read the page */
+static void PFftabRelease(fd)
+int fd;		/* entry taken by PFftabFindFree() */
 /****************************************************************************
 SPECIFICATIONS:
-	Write the page numbered "pagenum" from the buffer indexed
-	by "buf" into the file indexed by "fd".
+	Put entry "fd" of the open file table back into the free list.
+	The caller holds the file table latch.
+*****************************************************************************/
+{
+	if (PFftab(fd).fname != NULL)
+		free((char *)PFftab(fd).fname);
+	PFftab(fd).fname = NULL;
+	PFftab(fd).isopen = FALSE;
+	PFftab(fd).next = PFftabfree;
+	PFftabfree = fd;
+}
 
-AUTHOR: clc
+static PFzmapGrow(fd,npages)
+int fd;		/* file descriptor, PF_FORMAT_COMPRESSED */
+long npages;	/* # of pages to cover */
+/****************************************************************************
+SPECIFICATIONS:
+	Make the page map of file "fd" large enough for "npages" pages,
+	doubling its size as many times as needed. The new entries are
+	for pages never written. The caller holds the file table latch,
+	or has the file to itself.
 
 RETURN VALUE:
 	PFE_OK	if ok.
-	PF errod code if not OK.
-
+	PFE_NOMEM	if no memory.
 *****************************************************************************/
 {
-int error;
+PFzslot *zmap;	/* new page map */
+char *fresh;	/* new zfresh */
+long size;	/* its # of entries */
 
-	/* seek to the right place */
-	if ((error=lseek(PFftab[fd].unixfd,pagenum*sizeof(PFfpage)+PF_HDR_SIZE,
-				L_SET)) == -1){
-		PFerrno = PFE_UNIX;
+	if (npages <= PFftab(fd).zmapsize)
+		return(PFE_OK);
+	for (size=PFftab(fd).zmapsize > 0? PFftab(fd).zmapsize:
+				PF_EXTENT_PAGES; size < npages; size *= 2);
+	if ((zmap=(PFzslot *)calloc(size,sizeof(PFzslot))) == NULL ||
+			(fresh=calloc(size,1)) == NULL){
+		if (zmap != NULL)
+			free((char *)zmap);
+		PFerrno = PFE_NOMEM;
 		return(PFerrno);
 	}
 
-	/* write out the page */
-	if((error=write(PFftab[fd].unixfd,(char *)buf,sizeof(PFfpage)))
-			!=sizeof(PFfpage)){
-		if (error <0)
-			PFerrno = PFE_UNIX;
-		else	PFerrno = PFE_INCOMPLETEWRITE;
-		return(PFerrno);
+	/* the page cleaner may be writing pages of the file */
+	pthread_mutex_lock(&PFftab(fd).zlatch);
+	if (PFftab(fd).zmap != NULL){
+		memcpy((char *)zmap,(char *)PFftab(fd).zmap,
+				PFftab(fd).zmapsize*sizeof(PFzslot));
+		memcpy(fresh,PFftab(fd).zfresh,PFftab(fd).zmapsize);
+		free((char *)PFftab(fd).zmap);
+		free(PFftab(fd).zfresh);
 	}
-
+	PFftab(fd).zmap = zmap;
+	PFftab(fd).zfresh = fresh;
+	PFftab(fd).zmapsize = size;
+	pthread_mutex_unlock(&PFftab(fd).zlatch);
 	return(PFE_OK);
-
 }
 
+static void PFzPut(list,offset,room)
+PFzlist *list;	/* list of slots */
+off_t offset;	/* where the slot is */
+int room;	/* # of bytes of it */
+/****************************************************************************
+SPECIFICATIONS:
+	Add the slot of "room" bytes at "offset" to "list", doubling the
+	list if it is full. If there is no memory for that the slot is
+	left unused: the file is still right, only larger.
+*****************************************************************************/
+{
+PFzslot *slot;	/* new entries */
+long size;	/* their # */
+
+	if (list->n == list->size){
+		size = list->size > 0? 2*list->size: PF_EXTENT_PAGES;
+		if ((slot=(PFzslot *)realloc((char *)list->slot,
+					size*sizeof(PFzslot))) == NULL)
+			return;
+		list->slot = slot;
+		list->size = size;
+	}
+	list->slot[list->n].offset = offset;
+	list->slot[list->n].length = 0;
+	list->slot[list->n].room = room;
+	list->n++;
+}
 
-/************************* Interface Routines ****************************/
-
-void PF_Init()
+static void PFzFree(fd,offset,room)
+int fd;		/* file descriptor, PF_FORMAT_COMPRESSED */
+off_t offset;	/* where the room is */
+off_t room;	/* # of bytes of it */
 /****************************************************************************
 SPECIFICATIONS:
-	Initialize the PF interface. Must be the first function called
-	in order to use the PF ADT.
+	Make the "room" bytes at "offset" in file "fd" free slots, cut
+	into slots no larger than a page. Less than PF_Z_GRAIN bytes are
+	not worth keeping. The caller holds the latch of the page map, or
+	has the file to itself.
+*****************************************************************************/
+{
+int pagesize;	/* # of bytes of a page */
+int n;		/* # of bytes of the next slot */
 
-AUTHOR: clc
+	pagesize = PFpageSize(PFftab(fd).hdr.pagesize);
+	for (; room >= PF_Z_GRAIN; offset += n, room -= n){
+		n = room < pagesize? room: pagesize;
+		PFzPut(&PFftab(fd).zfree[n/PF_Z_GRAIN],offset,n);
+	}
+}
 
-RETURN VALUE: none
+static off_t PFzTake(fd,room)
+int fd;		/* file descriptor, PF_FORMAT_COMPRESSED */
+int room;	/* # of bytes needed, a multiple of PF_Z_GRAIN */
+/****************************************************************************
+SPECIFICATIONS:
+	Find a slot of "room" bytes in file "fd": the free slot of the
+	smallest room that is large enough, whose bytes past "room" are
+	free again, or else new room at the end of the file. The caller
+	holds the latch of the page map.
 
-GLOBAL VARIABLES MODIFIED:
-	PFftab
+RETURN VALUE:
+	Where the slot is.
 *****************************************************************************/
 {
-int i;
-	/* init the hash table */
-	PFhashInit();
-
-	/* init the file table to be not used*/
-	for (i=0; i < PF_FTAB_SIZE; i++){
-		PFftab[i].fname = NULL;
+PFzlist *list;	/* free slots of a room */
+PFzslot slot;	/* the one taken */
+off_t offset;
+int c;
+
+	for (c=room/PF_Z_GRAIN; c < PFftab(fd).zclasses; c++){
+		list = &PFftab(fd).zfree[c];
+		if (list->n > 0){
+			slot = list->slot[--list->n];
+			PFzFree(fd,slot.offset+room,(off_t)slot.room-room);
+			return(slot.offset);
+		}
 	}
-
-	memset(&PFstats, 0, sizeof(PFstats));
+	offset = PFftab(fd).zend;
+	PFftab(fd).zend += room;
+	return(offset);
 }
 
-PF_CreateFile(fname)
-char *fname;	/* name of file to create */
+static PFzRead(fd,pagenum,fpage)
+int fd;		/* file descriptor, PF_FORMAT_COMPRESSED */
+long pagenum;	/* page number */
+PFfpage *fpage;	/* where to read the page */
 /****************************************************************************
 SPECIFICATIONS:
-	Create a paged file called "fname". The file should not have
-	already existed before.
-
-AUTHOR: clc
+	Read page "pagenum" of the compressed file "fd" from its slot,
+	and decompress it into "fpage". A page kept uncompressed is read
+	straight into "fpage", and a page never written is all zeros.
+	The time spent decompressing is added to the statistics.
 
 RETURN VALUE:
-	PFE_OK	if OK
-	PF error code if error.
+	PFE_OK	if ok.
+	PF error code if not OK: PFE_INCOMPLETEREAD if the slot is short
+	or does not decompress to a whole page.
 *****************************************************************************/
 {
-int fd;	/* unix file descripotr */
-PFhdr_str hdr;	/* file header */
-int error;
+char zbuf[PF_MAX_PAGE_SIZE];	/* the compressed page */
+PFzslot slot;	/* where the page is */
+int pagesize;	/* # of bytes of the page */
+struct timespec start,end;
+int count;
+
+	pagesize = PFpageSize(PFftab(fd).hdr.pagesize);
+	pthread_mutex_lock(&PFftab(fd).zlatch);
+	slot = PFftab(fd).zmap[pagenum];
+	pthread_mutex_unlock(&PFftab(fd).zlatch);
+	PFstat(decompressReads)++;
+	if (slot.length == 0){
+		memset(fpage->pagebuf,0,pagesize);
+		return(PFE_OK);
+	}
 
-	/* create file for exclusive use */
-	if ((fd=open(fname,O_CREAT|O_EXCL|O_WRONLY,0664))<0){
-		/* unix error on open */
+	if ((count=pread(PFftab(fd).unixfd,slot.length == pagesize?
+			fpage->pagebuf: zbuf,slot.length,slot.offset)) < 0){
 		PFerrno = PFE_UNIX;
-		return(PFE_UNIX);
+		return(PFerrno);
 	}
-
-	/* write out the file header */
-	hdr.firstfree = PF_PAGE_LIST_END;	/* no free pag yet */
-	hdr.numpages = 0;
-	if ((error=write(fd,(char *)&hdr,sizeof(hdr))) != sizeof(hdr)){
-		/* error while writing. Abort everything. */
-		if (error < 0)
-			PFerrno = PFE_UNIX;
-		else PFerrno = PFE_HDRWRITE;
-		close(fd);
-		unlink(fname);
+	if (count != slot.length){
+		PFerrno = PFE_INCOMPLETEREAD;
 		return(PFerrno);
 	}
+	if (slot.length == pagesize)
+		return(PFE_OK);
 
-	if ((error=close(fd)) == -1){
-		PFerrno = PFE_UNIX;
+	clock_gettime(CLOCK_MONOTONIC,&start);
+	count = PFlzDecompress(zbuf,slot.length,fpage->pagebuf,pagesize);
+	clock_gettime(CLOCK_MONOTONIC,&end);
+	PFstat(decompressNanos) += (end.tv_sec - start.tv_sec)*1000000000L +
+					end.tv_nsec - start.tv_nsec;
+	if (count != pagesize){
+		PFerrno = PFE_INCOMPLETEREAD;
 		return(PFerrno);
 	}
-
 	return(PFE_OK);
 }
 
-
-PF_DestroyFile(fname)
-char *fname;		/* file name to destroy */
+static PFzWrite(fd,pagenum,fpage)
+int fd;		/* file descriptor, PF_FORMAT_COMPRESSED */
+long pagenum;	/* page number */
+PFfpage *fpage;	/* the page */
 /****************************************************************************
 SPECIFICATIONS:
-	Destroy the paged file whose name is "fname". The file should
-	exist, and should not be already open.
-
-AUTHOR:
-	clc
+	Compress page "pagenum" of file "fd" from "fpage", and write it
+	into its slot. A page that does not compress is written as it is.
+	A page that no longer fits in its slot, or needs less than half of
+	it, gets a new one (see PFzTake()). The old one is free right away
+	if it was taken since the page map was last written, and otherwise
+	once a page map that no longer points at it is (see PFzmapSave()).
 
 RETURN VALUE:
-	PFE_OK 	if success
-	PF error codes if error
+	PFE_OK	if ok.
+	PF error code if not OK.
 *****************************************************************************/
 {
-int error;
+char zbuf[PF_MAX_PAGE_SIZE];	/* the compressed page */
+char *data;	/* what to write */
+int length;	/* # of bytes of it */
+int pagesize;	/* # of bytes of the page */
+PFzslot *slot;	/* where the page goes */
+off_t offset;
+int count;
+
+	pagesize = PFpageSize(PFftab(fd).hdr.pagesize);
+	if ((length=PFlzCompress(fpage->pagebuf,pagesize,zbuf,pagesize-1))
+									> 0)
+		data = zbuf;
+	else {
+		data = fpage->pagebuf;
+		length = pagesize;
+	}
 
-	if (PFtabFindFname(fname)!= -1){
-		/* file is open */
-		PFerrno = PFE_FILEOPEN;
-		return(PFerrno);
+	pthread_mutex_lock(&PFftab(fd).zlatch);
+	slot = &PFftab(fd).zmap[pagenum];
+	if (length > slot->room || PFzRoom(length,pagesize) < slot->room/2){
+		if (PFftab(fd).zfresh[pagenum])
+			/* no page map on disk points at it */
+			PFzFree(fd,slot->offset,(off_t)slot->room);
+		else if (slot->room > 0)
+			PFzPut(&PFftab(fd).zpending,slot->offset,slot->room);
+		slot->room = PFzRoom(length,pagesize);
+		slot->offset = PFzTake(fd,slot->room);
+		PFftab(fd).zfresh[pagenum] = TRUE;
 	}
+	slot->length = length;
+	offset = slot->offset;
+	PFftab(fd).zchanged = TRUE;
+	pthread_mutex_unlock(&PFftab(fd).zlatch);
 
-	if ((error =unlink(fname))!= 0){
-		/* unix error */
+	if ((count=pwrite(PFftab(fd).unixfd,data,length,offset)) < 0){
 		PFerrno = PFE_UNIX;
 		return(PFerrno);
 	}
-
-	/* success */
+	if (count != length){
+		PFerrno = PFE_INCOMPLETEWRITE;
+		return(PFerrno);
+	}
+	PFstat(compressWrites)++;
+	PFstat(compressRawBytes) += pagesize;
+	PFstat(compressStoredBytes) += length;
 	return(PFE_OK);
 }
 
-///
-PF_OpenFile(fname,rep_policy)
-char *fname;		/* name of the file to open */
-char *rep_policy; // Page replacement policy
-// PF_OpenFile(fname)
-// char *fname;		/* name of the file to open */
+static void PFpreallocate(fd,pagenum)
+int fd;		/* file descriptor */
+long pagenum;	/* page number */
 /****************************************************************************
 SPECIFICATIONS:
-	Open the paged file whose name is fname.  It is possible to open
-	a file more than once. Warning: Openinging a file more than once for 
-	write operations is not prevented. The possible consequence is
-	the corruption of the file structure, which will crash
-	the Paged File functions. On the other hand, opening a file
-	more than once for reading is OK.
+	Make sure that the room of page "pagenum" of file "fd" is
+	reserved on disk, by reserving the extent of PF_EXTENT_PAGES pages
+	from there on if it is not. The file system can then lay out the
+	pages of the file next to each other, however they are written.
+	The size of the file is left alone. Called as pages are written,
+	so that pages freed before they are ever written take no room.
+
+IMPLEMENTATION NOTES:
+	This is only a hint: if the file system can't fallocate(), the
+	pages get their room when written, as before. The pages of a
+	PF_FORMAT_COMPRESSED file have no room of their own to reserve.
+	A page more than an extent past the room reserved so far starts
+	an extent of its own, and the pages skipped over are left as a
+	hole. Threads writing pages agree on the new end of the room
+	with a compare and swap, and each reserves its own part.
+*****************************************************************************/
+{
+long allocend;	/* pages before this one have their room reserved */
+long first;	/* first page to reserve room for */
+off_t start,end;	/* byte range to reserve */
+
+	if (PFcompressed(fd))
+		return;
+	allocend = __atomic_load_n(&PFftab(fd).allocend,__ATOMIC_ACQUIRE);
+	do {
+		if (pagenum < allocend)
+			return;
+		first = (pagenum - allocend < PF_EXTENT_PAGES)? allocend:
+								pagenum;
+	} while (!__atomic_compare_exchange_n(&PFftab(fd).allocend,&allocend,
+			pagenum + PF_EXTENT_PAGES,FALSE,__ATOMIC_ACQ_REL,
+			__ATOMIC_ACQUIRE));
+	start = PFpageOffset(fd,first);
+	end = PFpageOffset(fd,pagenum + PF_EXTENT_PAGES);
+	fallocate(PFftab(fd).unixfd,FALLOC_FL_KEEP_SIZE,start,end-start);
+}
+
+static PFioRuns(fd,runs,nruns,write)
+int fd;		/* file descriptor */
+PFpage_run *runs;	/* runs of adjacent pages */
+int nruns;	/* # of runs */
+int write;	/* TRUE to write the pages, FALSE to read them */
+/****************************************************************************
+SPECIFICATIONS:
+	Read or write the pages of the "nruns" runs of file "fd", each
+	run with one vectored request. All the requests are handed to the
+	I/O backend at once (see PFioSubmitWait()), which returns when
+	they are all over. In a PF_FORMAT_V2 file, a run that goes over a
+	map block takes one request on each side of it. The pages of a
+	PF_FORMAT_COMPRESSED file are not next to each other in the file,
+	and are read or written one by one (see PFzRead()).
+
+RETURN VALUE:
+	PFE_OK	if ok
+	PF error code if not OK.
+*****************************************************************************/
+{
+PFio_req reqbuf[PF_IO_DEPTH];	/* requests, if few */
+struct iovec iovbuf[PF_IO_DEPTH]; /* page buffers, if few */
+PFio_req *reqs;
+struct iovec *iov;
+int npages;	/* # of pages in all the runs */
+int nreqs;	/* # of requests */
+int error;
+int i,j,k,r;
+
+	if (PFcompressed(fd)){
+		for (i=0; i < nruns; i++)
+			for (j=0; j < runs[i].n; j++)
+				if ((error=write?
+					PFzWrite(fd,runs[i].pagenum+j,
+							runs[i].fpages[j]):
+					PFzRead(fd,runs[i].pagenum+j,
+							runs[i].fpages[j]))
+								!= PFE_OK)
+					return(error);
+		return(PFE_OK);
+	}
+
+	for (npages=0, nreqs=0, i=0; i < nruns; i++){
+		if (write)
+			PFpreallocate(fd,runs[i].pagenum+runs[i].n-1);
+		npages += runs[i].n;
+		nreqs += PFv2(fd)? (runs[i].pagenum+runs[i].n-1)/PF_MAP_BITS -
+					runs[i].pagenum/PF_MAP_BITS + 1: 1;
+	}
+	reqs = (nreqs <= PF_IO_DEPTH)? reqbuf:
+				(PFio_req *)malloc(nreqs*sizeof(PFio_req));
+	iov = (npages <= PF_IO_DEPTH)? iovbuf:
+			(struct iovec *)malloc(npages*sizeof(struct iovec));
+	if (reqs == NULL || iov == NULL){
+		error = PFerrno = PFE_NOMEM;
+		goto out;
+	}
+
+	/* one request per run, at the appropriate place. The requests
+	leave the file offset alone, so that threads do not disturb
+	each other */
+	for (k=0, r=-1, i=0; i < nruns; i++)
+		for (j=0; j < runs[i].n; j++, k++){
+			if (j == 0 || (PFv2(fd) &&
+					(runs[i].pagenum+j) % PF_MAP_BITS == 0)){
+				/* start a request */
+				r++;
+				reqs[r].unixfd = PFftab(fd).unixfd;
+				reqs[r].offset = PFpageOffset(fd,
+							runs[i].pagenum+j);
+				reqs[r].iov = &iov[k];
+				reqs[r].iovcnt = 0;
+			}
+			iov[k].iov_base = PFpageIOBase(fd,runs[i].fpages[j]);
+			iov[k].iov_len = PFpageIOSize(fd);
+			reqs[r].iovcnt++;
+		}
+	error = PFioSubmitWait(reqs,nreqs,write);
+
+out:
+	if (reqs != NULL && reqs != reqbuf)
+		free((char *)reqs);
+	if (iov != NULL && iov != iovbuf)
+		free((char *)iov);
+	return(error);
+}
+
+PFreadfcn(fd,pagenum,buf)
+int fd;	/* file descriptor */
+long pagenum; /* page number */
+PFfpage *buf;
+/****************************************************************************
+SPECIFICATIONS:
+	Read the paged numbered "pagenum" from the file indexed by "fd"
+	into the page buffer "buf".
+
+AUTHOR: clc
+
+RETURN VALUE:
+	PFE_OK	if ok
+	PF error code if not OK.
+*****************************************************************************/
+{
+PFpage_run run;
+
+	run.pagenum = pagenum;
+	run.n = 1;
+	run.fpages = &buf;
+	return(PFioRuns(fd,&run,1,FALSE));
+}
+
+PFwritefcn(fd,pagenum,buf)
+int fd;		/* file descriptor */
+long pagenum;	/* page to read */
+PFfpage *buf;	/* buffer where to read the page */
+/****************************************************************************
+SPECIFICATIONS:
+	Write the page numbered "pagenum" from the buffer indexed
+	by "buf" into the file indexed by "fd".
+
+AUTHOR: clc
+
+RETURN VALUE:
+	PFE_OK	if ok.
+	PF errod code if not OK.
+
+*****************************************************************************/
+{
+PFpage_run run;
+
+	run.pagenum = pagenum;
+	run.n = 1;
+	run.fpages = &buf;
+	return(PFioRuns(fd,&run,1,TRUE));
+}
+
+PFreadrunsfcn(fd,runs,nruns)
+int fd;		/* file descriptor */
+PFpage_run *runs;	/* runs of adjacent pages to read */
+int nruns;	/* # of runs */
+/****************************************************************************
+SPECIFICATIONS:
+	Read the runs of adjacent pages "runs" from the file indexed by
+	"fd", each run with one vectored read, all of them at once.
+
+RETURN VALUE:
+	PFE_OK	if ok
+	PF error code if not OK.
+*****************************************************************************/
+{
+	return(PFioRuns(fd,runs,nruns,FALSE));
+}
+
+PFwriterunsfcn(fd,runs,nruns)
+int fd;		/* file descriptor */
+PFpage_run *runs;	/* runs of adjacent pages to write */
+int nruns;	/* # of runs */
+/****************************************************************************
+SPECIFICATIONS:
+	Write the runs of adjacent pages "runs" into the file indexed by
+	"fd", each run with one vectored write, all of them at once.
+
+RETURN VALUE:
+	PFE_OK	if ok.
+	PF error code if not OK.
+*****************************************************************************/
+{
+	return(PFioRuns(fd,runs,nruns,TRUE));
+}
+
+static PFwriteHdr(fd)
+int fd;		/* file descriptor */
+/****************************************************************************
+SPECIFICATIONS:
+	Write the header of file "fd" back to the file if it has changed.
+
+RETURN VALUE:
+	PFE_OK	if ok.
+	PF error code if not OK.
+*****************************************************************************/
+{
+PFhdr_blk hdrblk;	/* header block, for an aligned file */
+char *buf;	/* what to write */
+int size;	/* # of bytes to write */
+int error;
+
+	if (PFftab(fd).hdrchanged){
+		/* the older formats count the pages in an int */
+		if (!PFlongNumpages(PFftab(fd).hdr.format))
+			PFftab(fd).hdr.oldnumpages = PFftab(fd).hdr.numpages;
+
+		/* the block holding the header: the rest of a whole page
+		header is left as it is */
+		size = PFhdrSize(fd) < PF_DIRECT_ALIGN? PFhdrSize(fd):
+							PF_DIRECT_ALIGN;
+		if (PFftab(fd).hdr.format != PF_FORMAT_PACKED){
+			memset(hdrblk.blk,0,PF_DIRECT_ALIGN);
+			hdrblk.hdr = PFftab(fd).hdr;
+			buf = hdrblk.blk;
+		}
+		else	buf = (char *)&PFftab(fd).hdr;
+
+		/* write header at the start of the file */
+		if((error=pwrite(PFftab(fd).unixfd,buf,size,(off_t)0))!=size){
+			if (error <0)
+				PFerrno = PFE_UNIX;
+			else	PFerrno = PFE_HDRWRITE;
+			return(PFerrno);
+		}
+		PFftab(fd).hdrchanged = FALSE;
+	}
+	return(PFE_OK);
+}
+
+static PFbitmapIO(fd,group,write)
+int fd;		/* file descriptor, PF_FORMAT_MAPPED */
+long group;	/* which map page */
+int write;	/* TRUE to write the map page, FALSE to read it */
+/****************************************************************************
+SPECIFICATIONS:
+	Read map page "group" of file "fd" into its part of the allocation
+	bitmap, or write it out from there. The map page is not read
+	through the buffer, and its body is built apart, aligned for
+	O_DIRECT. A PF_FORMAT_V2 file has a map block instead, with no
+	nextfree word; a map block that was never written reads as clear.
+
+RETURN VALUE:
+	PFE_OK	if ok.
+	PF error code if not OK.
+*****************************************************************************/
+{
+PFfpage *fpage;	/* body of the map page */
+char *blk;	/* map block (PF_FORMAT_V2) */
+int count;
+int error;
+
+	if (PFv2(fd)){
+		if (posix_memalign((void **)&blk,PF_DIRECT_ALIGN,
+						PFpageIOSize(fd)) != 0){
+			PFerrno = PFE_NOMEM;
+			return(PFerrno);
+		}
+		memset(blk,0,PFpageIOSize(fd));
+		if (write){
+			memcpy(blk,PFftab(fd).usedmap+group*PF_PAGE_SIZE,
+							PF_PAGE_SIZE);
+			count = pwrite(PFftab(fd).unixfd,blk,PFpageIOSize(fd),
+						PFmapOffset(fd,group));
+		}
+		else	count = pread(PFftab(fd).unixfd,blk,PFpageIOSize(fd),
+						PFmapOffset(fd,group));
+		if (count < 0)
+			error = PFerrno = PFE_UNIX;
+		else if (write && count != PFpageIOSize(fd))
+			error = PFerrno = PFE_INCOMPLETEWRITE;
+		else {
+			error = PFE_OK;
+			if (write)
+				PFftab(fd).mapdirty[group] = FALSE;
+			else	memcpy(PFftab(fd).usedmap+group*PF_PAGE_SIZE,
+							blk,PF_PAGE_SIZE);
+		}
+		free(blk);
+		return(error);
+	}
+
+	if (posix_memalign((void **)&fpage,PF_DIRECT_ALIGN,PFpageIOSize(fd))
+									!= 0){
+		PFerrno = PFE_NOMEM;
+		return(PFerrno);
+	}
+	memset((char *)fpage,0,PFpageIOSize(fd));
+	if (write){
+		fpage->nextfree = PF_PAGE_MAP;
+		memcpy(fpage->pagebuf,PFftab(fd).usedmap+group*PF_PAGE_SIZE,
+							PF_PAGE_SIZE);
+		if ((error=PFwritefcn(fd,group*PF_MAP_BITS,fpage)) == PFE_OK)
+			PFftab(fd).mapdirty[group] = FALSE;
+	}
+	else if ((error=PFreadfcn(fd,group*PF_MAP_BITS,fpage)) == PFE_OK)
+		memcpy(PFftab(fd).usedmap+group*PF_PAGE_SIZE,fpage->pagebuf,
+							PF_PAGE_SIZE);
+	free((char *)fpage);
+	return(error);
+}
+
+static PFbitmapGrow(fd,groups)
+int fd;		/* file descriptor, PF_FORMAT_MAPPED */
+long groups;	/* # of map pages wanted */
+/****************************************************************************
+SPECIFICATIONS:
+	Make the allocation bitmap of file "fd" large enough for "groups"
+	map pages. The new part is clear, but for the bit of the map
+	page itself, and is to be written out. The old bitmap is kept
+	until the file is closed, as other threads may be looking at it
+	without a latch. The caller holds the file table latch.
+
+RETURN VALUE:
+	PFE_OK	if ok.
+	PFE_NOMEM	if no memory.
+*****************************************************************************/
+{
+unsigned char *map;	/* new bitmap */
+char *dirty;		/* new dirty flags */
+PFmap_old *old;
+long g;
+
+	if (groups <= PFftab(fd).mapgroups)
+		return(PFE_OK);
+	map = (unsigned char *)malloc(groups*PF_PAGE_SIZE);
+	dirty = malloc(groups);
+	old = (PFmap_old *)malloc(sizeof(PFmap_old));
+	if (map == NULL || dirty == NULL || old == NULL){
+		if (map != NULL) free((char *)map);
+		if (dirty != NULL) free(dirty);
+		if (old != NULL) free((char *)old);
+		PFerrno = PFE_NOMEM;
+		return(PFerrno);
+	}
+
+	g = PFftab(fd).mapgroups;
+	memset((char *)map+g*PF_PAGE_SIZE,0,(groups-g)*PF_PAGE_SIZE);
+	memset(dirty+g,TRUE,groups-g);
+	if (g > 0){
+		memcpy((char *)map,(char *)PFftab(fd).usedmap,g*PF_PAGE_SIZE);
+		memcpy(dirty,PFftab(fd).mapdirty,g);
+	}
+	if (PFftab(fd).hdr.format == PF_FORMAT_MAPPED)
+		for (; g < groups; g++)
+			map[g*PF_PAGE_SIZE] |= 1;	/* the map page */
+
+	if (PFftab(fd).usedmap != NULL){
+		old->usedmap = PFftab(fd).usedmap;
+		old->next = PFftab(fd).mapold;
+		PFftab(fd).mapold = old;
+	}
+	else	free((char *)old);
+	if (PFftab(fd).mapdirty != NULL)
+		free(PFftab(fd).mapdirty);
+	PFftab(fd).mapdirty = dirty;
+	__atomic_store_n(&PFftab(fd).usedmap,map,__ATOMIC_RELEASE);
+	PFftab(fd).mapgroups = groups;
+	return(PFE_OK);
+}
+
+static int PFzslotCmp(a,b)
+PFzslot *a,*b;	/* slots to compare */
+/****************************************************************************
+SPECIFICATIONS:
+	Compare where two slots are in the file, for qsort().
+*****************************************************************************/
+{
+	return((a->offset > b->offset) - (a->offset < b->offset));
+}
+
+static PFzFindFree(fd,mapoffset,mapsize)
+int fd;		/* file descriptor, PF_FORMAT_COMPRESSED */
+off_t mapoffset;	/* where the page map of the file is */
+ssize_t mapsize;	/* # of bytes of it */
+/****************************************************************************
+SPECIFICATIONS:
+	Work out which room of file "fd" no page uses, from its page map
+	just read: the bytes up to the end of the last slot that are
+	neither in a slot nor in the page map. Room right after the page
+	map is the room of the page map. The largest room the page map
+	fits in is kept for the next one (see PFzmapSave()); the rest
+	become free slots. Older files have their old page maps there.
+
+RETURN VALUE:
+	PFE_OK	if ok.
+	PFE_NOMEM	if no memory.
+*****************************************************************************/
+{
+PFzslot *used;	/* slots of the pages and the page map, by offset */
+long n;		/* # of them */
+off_t end;	/* end of the room seen so far */
+off_t gap;	/* # of bytes of a free room */
+PFzslot spare;	/* largest room the page map fits in */
+long i;
+
+	if ((used=(PFzslot *)malloc((PFftab(fd).hdr.numpages+1)*
+					sizeof(PFzslot))) == NULL){
+		PFerrno = PFE_NOMEM;
+		return(PFerrno);
+	}
+	n = 0;
+	for (i=0; i < PFftab(fd).hdr.numpages; i++)
+		if (PFftab(fd).zmap[i].room > 0)
+			used[n++] = PFftab(fd).zmap[i];
+	used[n].offset = mapoffset;
+	used[n].length = -1;	/* the page map */
+	used[n++].room = mapsize;
+	qsort((char *)used,n,sizeof(PFzslot),PFzslotCmp);
+
+	end = PFhdrSize(fd);
+	spare.offset = 0;
+	spare.room = 0;
+	for (i=0; i < n; i++){
+		gap = used[i].offset - end;
+		if (gap > 0 && i > 0 && used[i-1].length == -1)
+			PFftab(fd).zmaparea.room += gap;
+		else if (gap > spare.room && gap >= mapsize && gap <= INT_MAX){
+			PFzFree(fd,spare.offset,(off_t)spare.room);
+			spare.offset = end;
+			spare.room = gap;
+		}
+		else	PFzFree(fd,end,gap);
+		if (used[i].length == -1){
+			PFftab(fd).zmaparea.offset = used[i].offset;
+			PFftab(fd).zmaparea.room = used[i].room;
+		}
+		if (used[i].offset + used[i].room > end)
+			end = used[i].offset + used[i].room;
+	}
+	PFftab(fd).zspare = spare;
+	PFftab(fd).zend = end;
+	free((char *)used);
+	return(PFE_OK);
+}
+
+static void PFzCoalesce(fd)
+int fd;		/* file descriptor, PF_FORMAT_COMPRESSED */
+/****************************************************************************
+SPECIFICATIONS:
+	Merge the free slots of file "fd" that are next to each other,
+	for a page that outgrows its slot to find room, and give the room
+	at the end of the file back: the file is cut short there. The
+	caller holds the latch of the page map.
+
+IMPLEMENTATION NOTES:
+	Without memory to sort the free slots they are left as they are.
+*****************************************************************************/
+{
+PFzslot *slot;	/* the free slots, by offset */
+long n;		/* # of them */
+off_t offset;	/* start of a run of free slots next to each other */
+off_t end;	/* end of the run */
+long i;
+int c;
+
+	n = 0;
+	for (c=0; c < PFftab(fd).zclasses; c++)
+		n += PFftab(fd).zfree[c].n;
+	if (n == 0 || (slot=(PFzslot *)malloc(n*sizeof(PFzslot))) == NULL)
+		return;
+	n = 0;
+	for (c=0; c < PFftab(fd).zclasses; c++){
+		memcpy((char *)(slot+n),(char *)PFftab(fd).zfree[c].slot,
+				PFftab(fd).zfree[c].n*sizeof(PFzslot));
+		n += PFftab(fd).zfree[c].n;
+		PFftab(fd).zfree[c].n = 0;
+	}
+	qsort((char *)slot,n,sizeof(PFzslot),PFzslotCmp);
+
+	offset = slot[0].offset;
+	end = offset + slot[0].room;
+	for (i=1; i <= n; i++){
+		if (i < n && slot[i].offset == end){
+			end += slot[i].room;
+			continue;
+		}
+
+		/* the run ends here */
+		if (end == PFftab(fd).zend){
+			PFftab(fd).zend = offset;
+			ftruncate(PFftab(fd).unixfd,offset);
+		}
+		else	PFzFree(fd,offset,end-offset);
+		if (i < n){
+			offset = slot[i].offset;
+			end = offset + slot[i].room;
+		}
+	}
+	free((char *)slot);
+}
+
+static PFzmapLoad(fd)
+int fd;		/* file descriptor, PF_FORMAT_COMPRESSED */
+/****************************************************************************
+SPECIFICATIONS:
+	Read the page map and the allocation bitmap of file "fd" into
+	memory. On disk the page map is the # of pages it covers (a long),
+	their PFzslot entries, then the bitmap bytes of those pages; a file
+	with no page map yet has no page written. The room no page uses
+	is found (see PFzFindFree()), for new slots to go there first.
+
+RETURN VALUE:
+	PFE_OK	if ok.
+	PF error code if not OK: PFE_HDRREAD if the page map is not all
+	there.
+*****************************************************************************/
+{
+long numpages;	/* # of pages of the file */
+long npages;	/* # of pages the page map covers */
+ssize_t size;	/* # of bytes of its entries */
+ssize_t nbytes;	/* # of bytes of its bitmap */
+off_t offset;	/* where the page map is */
+long groups;
+int error;
+
+	PFftab(fd).zmap = NULL;
+	PFftab(fd).zfresh = NULL;
+	PFftab(fd).zmapsize = 0;
+	PFftab(fd).zchanged = FALSE;
+	PFftab(fd).zend = PFhdrSize(fd);
+	memset((char *)&PFftab(fd).zpending,0,sizeof(PFzlist));
+	memset((char *)&PFftab(fd).zmaparea,0,sizeof(PFzslot));
+	memset((char *)&PFftab(fd).zspare,0,sizeof(PFzslot));
+	PFftab(fd).zclasses = PFpageSize(PFftab(fd).hdr.pagesize)/PF_Z_GRAIN
+									+ 1;
+	if ((PFftab(fd).zfree=(PFzlist *)calloc(PFftab(fd).zclasses,
+						sizeof(PFzlist))) == NULL){
+		PFerrno = PFE_NOMEM;
+		return(PFerrno);
+	}
+	pthread_mutex_init(&PFftab(fd).zlatch,NULL);
+
+	numpages = PFftab(fd).hdr.numpages;
+	groups = (numpages + PF_MAP_BITS-1)/PF_MAP_BITS;
+	if ((error=PFbitmapGrow(fd,groups > 0? groups: 1)) != PFE_OK ||
+			(error=PFzmapGrow(fd,numpages)) != PFE_OK)
+		return(error);
+	memset(PFftab(fd).mapdirty,FALSE,PFftab(fd).mapgroups);
+	if ((offset=PFftab(fd).hdr.mapoffset) == 0)
+		return(PFE_OK);
+
+	if (pread(PFftab(fd).unixfd,(char *)&npages,sizeof(long),offset)
+				!= sizeof(long) || npages < 0 || npages > numpages){
+		PFerrno = PFE_HDRREAD;
+		return(PFerrno);
+	}
+	size = npages*sizeof(PFzslot);
+	nbytes = (npages+7)/8;
+	if (pread(PFftab(fd).unixfd,(char *)PFftab(fd).zmap,size,
+					offset+sizeof(long)) != size ||
+		pread(PFftab(fd).unixfd,(char *)PFftab(fd).usedmap,nbytes,
+				offset+sizeof(long)+size) != nbytes){
+		PFerrno = PFE_HDRREAD;
+		return(PFerrno);
+	}
+	return(PFzFindFree(fd,offset,sizeof(long)+size+nbytes));
+}
+
+static PFzmapSave(fd)
+int fd;		/* file descriptor, PF_FORMAT_COMPRESSED */
+/****************************************************************************
+SPECIFICATIONS:
+	Write the page map and the allocation bitmap of file "fd", as
+	PFzmapLoad() reads them, if they have changed, and then the header
+	pointing at them. The caller holds the file table latch, or has
+	the file to itself.
+
+RETURN VALUE:
+	PFE_OK	if ok.
+	PF error code if not OK.
+
+IMPLEMENTATION NOTES:
+	The page map the header points to is never written over: until
+	the header is written, it is the one the file is opened with. The
+	new one goes into the other page map area, which is grown, or
+	moved to the end of the file, if it is too small. Once the header
+	points at the new one, the room of the old one is the other area,
+	and the slots given up before the new one was copied are free
+	(see PFzCoalesce()).
+*****************************************************************************/
+{
+char *buf;	/* the page map as it is written */
+long npages;	/* # of pages it covers */
+ssize_t size;	/* # of bytes of its entries */
+ssize_t nbytes;	/* # of bytes of its bitmap */
+ssize_t total;	/* # of bytes of it all */
+PFzslot area;	/* where it goes */
+long pending;	/* # of slots given up before it was copied */
+ssize_t count;
+int changed;
+int error;
+long g;
+long i;
+
+	changed = PFftab(fd).zchanged;
+	for (g=0; g < PFftab(fd).mapgroups; g++)
+		changed |= PFftab(fd).mapdirty[g];
+	if (!changed)
+		return(PFE_OK);
+
+	npages = PFftab(fd).hdr.numpages;
+	size = npages*sizeof(PFzslot);
+	nbytes = (npages+7)/8;
+	total = sizeof(long) + size + nbytes;
+	if ((buf=malloc(total)) == NULL){
+		PFerrno = PFE_NOMEM;
+		return(PFerrno);
+	}
+
+	/* take a copy, and its room, while no page is being written */
+	memcpy(buf,(char *)&npages,sizeof(long));
+	pthread_mutex_lock(&PFftab(fd).zlatch);
+	memcpy(buf+sizeof(long),(char *)PFftab(fd).zmap,size);
+	area = PFftab(fd).zspare;
+	if (area.room < total){
+		if (area.room > 0 &&
+				area.offset + area.room == PFftab(fd).zend)
+			/* grow it in place */
+			PFftab(fd).zend = area.offset;
+		else {
+			PFzFree(fd,area.offset,(off_t)area.room);
+			area.offset = PFftab(fd).zend;
+		}
+		area.room = PFzMapRoom(total);
+		PFftab(fd).zend = area.offset + area.room;
+	}
+	PFftab(fd).zspare.room = 0;
+	pending = PFftab(fd).zpending.n;
+	memset(PFftab(fd).zfresh,FALSE,npages);
+	PFftab(fd).zchanged = FALSE;
+	pthread_mutex_unlock(&PFftab(fd).zlatch);
+	memcpy(buf+sizeof(long)+size,(char *)PFftab(fd).usedmap,nbytes);
+	memset(PFftab(fd).mapdirty,FALSE,PFftab(fd).mapgroups);
+
+	count = pwrite(PFftab(fd).unixfd,buf,total,area.offset);
+	free(buf);
+	if (count != total)
+		PFerrno = (count < 0)? PFE_UNIX: PFE_INCOMPLETEWRITE;
+	else {
+		PFftab(fd).hdr.mapoffset = area.offset;
+		PFftab(fd).hdrchanged = TRUE;
+		if (PFwriteHdr(fd) != PFE_OK)
+			PFftab(fd).hdr.mapoffset = PFftab(fd).zmaparea.offset;
+	}
+	if (PFftab(fd).hdr.mapoffset != area.offset){
+		/* the old page map is still the one */
+		error = PFerrno;
+		pthread_mutex_lock(&PFftab(fd).zlatch);
+		PFftab(fd).zchanged = TRUE;
+		PFftab(fd).zspare = area;
+		pthread_mutex_unlock(&PFftab(fd).zlatch);
+		return(error);
+	}
+
+	pthread_mutex_lock(&PFftab(fd).zlatch);
+	PFftab(fd).zspare = PFftab(fd).zmaparea;
+	PFftab(fd).zmaparea = area;
+	for (i=0; i < pending; i++)
+		PFzFree(fd,PFftab(fd).zpending.slot[i].offset,
+				(off_t)PFftab(fd).zpending.slot[i].room);
+	PFftab(fd).zpending.n -= pending;
+	memmove((char *)PFftab(fd).zpending.slot,
+			(char *)(PFftab(fd).zpending.slot+pending),
+			PFftab(fd).zpending.n*sizeof(PFzslot));
+	PFzCoalesce(fd);
+	pthread_mutex_unlock(&PFftab(fd).zlatch);
+	return(PFE_OK);
+}
+
+static PFbitmapLoad(fd)
+int fd;		/* file descriptor */
+/****************************************************************************
+SPECIFICATIONS:
+	Read the allocation bitmap of file "fd" into memory, if the file
+	has one.
+
+RETURN VALUE:
+	PFE_OK	if ok.
+	PF error code if not OK.
+*****************************************************************************/
+{
+long groups;	/* # of map pages */
+int error;
+long g;
+
+	PFftab(fd).usedmap = NULL;
+	PFftab(fd).mapdirty = NULL;
+	PFftab(fd).mapgroups = 0;
+	PFftab(fd).mapfree = 0;
+	PFftab(fd).mapold = NULL;
+	if (PFcompressed(fd))
+		/* the bitmap is kept with the page map */
+		return(PFzmapLoad(fd));
+	if (PFftab(fd).hdr.format != PF_FORMAT_MAPPED && !PFv2(fd))
+		return(PFE_OK);
+
+	/* an empty file gets its first map page right away */
+	groups = (PFftab(fd).hdr.numpages + PF_MAP_BITS-1)/PF_MAP_BITS;
+	if ((error=PFbitmapGrow(fd,groups > 0? groups: 1)) != PFE_OK)
+		return(error);
+	for (g=0; g < groups; g++)
+		if ((error=PFbitmapIO(fd,g,FALSE)) != PFE_OK)
+			return(error);
+		else	PFftab(fd).mapdirty[g] = FALSE;
+	return(PFE_OK);
+}
+
+static PFbitmapSave(fd)
+int fd;		/* file descriptor */
+/****************************************************************************
+SPECIFICATIONS:
+	Write out the map pages of file "fd" that have changed.
+
+RETURN VALUE:
+	PFE_OK	if ok.
+	PF error code if not OK.
+*****************************************************************************/
+{
+int error;
+long g;
+
+	if (PFcompressed(fd))
+		return(PFzmapSave(fd));
+	for (g=0; g < PFftab(fd).mapgroups; g++)
+		if (PFftab(fd).mapdirty[g] &&
+				(error=PFbitmapIO(fd,g,TRUE)) != PFE_OK)
+			return(error);
+	return(PFE_OK);
+}
+
+static void PFbitmapFree(fd)
+int fd;		/* file descriptor */
+/****************************************************************************
+SPECIFICATIONS:
+	Free the allocation bitmap of file "fd", and the ones it replaced,
+	and the page map and free slots of a PF_FORMAT_COMPRESSED file.
+*****************************************************************************/
+{
+PFmap_old *old;
+long g;
+
+	while ((old=PFftab(fd).mapold) != NULL){
+		PFftab(fd).mapold = old->next;
+		free((char *)old->usedmap);
+		free((char *)old);
+	}
+	if (PFftab(fd).usedmap != NULL)
+		free((char *)PFftab(fd).usedmap);
+	if (PFftab(fd).mapdirty != NULL)
+		free(PFftab(fd).mapdirty);
+	PFftab(fd).usedmap = NULL;
+	PFftab(fd).mapdirty = NULL;
+	PFftab(fd).mapgroups = 0;
+	if (PFcompressed(fd)){
+		if (PFftab(fd).zmap != NULL)
+			free((char *)PFftab(fd).zmap);
+		PFftab(fd).zmap = NULL;
+		PFftab(fd).zmapsize = 0;
+		free(PFftab(fd).zfresh);
+		PFftab(fd).zfresh = NULL;
+		if (PFftab(fd).zfree != NULL)
+			for (g=0; g < PFftab(fd).zclasses; g++)
+				free((char *)PFftab(fd).zfree[g].slot);
+		free((char *)PFftab(fd).zfree);
+		free((char *)PFftab(fd).zpending.slot);
+		PFftab(fd).zfree = NULL;
+		memset((char *)&PFftab(fd).zpending,0,sizeof(PFzlist));
+		pthread_mutex_destroy(&PFftab(fd).zlatch);
+	}
+}
+
+static void PFbitmapSet(fd,pagenum,used)
+int fd;		/* file descriptor, PF_FORMAT_MAPPED */
+long pagenum;	/* page number, covered by the bitmap */
+int used;	/* TRUE if the page is now used, FALSE if free */
+/****************************************************************************
+SPECIFICATIONS:
+	Mark page "pagenum" of file "fd" used or free in the allocation
+	bitmap. The caller holds the file table latch.
+*****************************************************************************/
+{
+unsigned char bit;
+
+	bit = 1 << (pagenum&7);
+	if (used)
+		__atomic_fetch_or(&PFftab(fd).usedmap[pagenum>>3],bit,
+							__ATOMIC_RELEASE);
+	else {
+		__atomic_fetch_and(&PFftab(fd).usedmap[pagenum>>3],
+					(unsigned char)~bit,__ATOMIC_RELEASE);
+		if ((pagenum>>3) < PFftab(fd).mapfree)
+			PFftab(fd).mapfree = pagenum>>3;
+	}
+	PFftab(fd).mapdirty[pagenum/PF_MAP_BITS] = TRUE;
+}
+
+static long PFbitmapFindFree(fd)
+int fd;		/* file descriptor, PF_FORMAT_MAPPED */
+/****************************************************************************
+SPECIFICATIONS:
+	Find the first free page of file "fd" in the allocation bitmap.
+	The caller holds the file table latch.
+
+RETURN VALUE:
+	The page number, or -1 if all the pages are used.
+*****************************************************************************/
+{
+unsigned char *map;
+long nbytes;	/* # of bytes of the bitmap covering the file */
+long i,p;
+
+	map = PFftab(fd).usedmap;
+	nbytes = (PFftab(fd).hdr.numpages+7)>>3;
+	for (i=PFftab(fd).mapfree; i < nbytes && map[i] == 0xff; i++);
+	PFftab(fd).mapfree = i;
+	for (p=i<<3; p < PFftab(fd).hdr.numpages; p++)
+		if (!PFbitIsSet(fd,p))
+			return(p);
+	return(-1);
+}
+
+static long PFbitmapFindNear(fd,hint)
+int fd;		/* file descriptor, PF_FORMAT_MAPPED */
+long hint;	/* page number */
+/****************************************************************************
+SPECIFICATIONS:
+	Find a free page of file "fd" at most PF_EXTENT_PAGES pages away
+	from page "hint", after it if possible. The caller holds the file
+	table latch.
+
+RETURN VALUE:
+	The page number, or -1 if there is none.
+*****************************************************************************/
+{
+long numpages;
+long p;
+
+	numpages = PFftab(fd).hdr.numpages;
+	for (p=hint+1; p <= hint+PF_EXTENT_PAGES && p < numpages; p++)
+		if (!PFbitIsSet(fd,p))
+			return(p);
+	for (p=hint-1; p >= hint-PF_EXTENT_PAGES && p >= 0; p--)
+		if (!PFbitIsSet(fd,p))
+			return(p);
+	return(-1);
+}
+
+static long PFbitmapFindTail(fd)
+int fd;		/* file descriptor, PF_FORMAT_MAPPED */
+/****************************************************************************
+SPECIFICATIONS:
+	Find the first free page among the last PF_EXTENT_PAGES pages of
+	file "fd": what is left of the extent added last. The caller
+	holds the file table latch.
+
+RETURN VALUE:
+	The page number, or -1 if there is none.
+*****************************************************************************/
+{
+long numpages;
+long p;
+
+	numpages = PFftab(fd).hdr.numpages;
+	for (p=(numpages > PF_EXTENT_PAGES)? numpages-PF_EXTENT_PAGES: 0;
+							p < numpages; p++)
+		if (!PFbitIsSet(fd,p))
+			return(p);
+	return(-1);
+}
+
+static long PFbitmapExtend(fd,n)
+int fd;		/* file descriptor, PF_FORMAT_MAPPED */
+int n;		/* # of pages to add */
+/****************************************************************************
+SPECIFICATIONS:
+	Add "n" free pages at the end of file "fd", not counting a map page
+	that falls among them. The caller holds the file table latch.
+
+RETURN VALUE:
+	The number of the first new page, PF error code if error:
+	PFE_FILEFULL if a file whose header counts its pages in an int
+	would get more than PF_OLD_MAXPAGES pages.
+*****************************************************************************/
+{
+long first;	/* first new page */
+long end;	/* new # of pages */
+int error;
+
+	first = PFftab(fd).hdr.numpages;
+	end = first + n;
+	if (PFftab(fd).hdr.format == PF_FORMAT_MAPPED && (PFmapPage(first) ||
+				(end-1)/PF_MAP_BITS != first/PF_MAP_BITS))
+		/* one more map page among them */
+		end++;
+	if (!PFlongNumpages(PFftab(fd).hdr.format) && end > PF_OLD_MAXPAGES){
+		/* past what the header of the file can count */
+		PFerrno = PFE_FILEFULL;
+		return(PFerrno);
+	}
+	if ((error=PFbitmapGrow(fd,(end-1)/PF_MAP_BITS + 1)) != PFE_OK ||
+		(PFcompressed(fd) && (error=PFzmapGrow(fd,end)) != PFE_OK))
+		return(error);
+
+	/* the new part of the bitmap is in place, the pages can be seen */
+	__atomic_store_n(&PFftab(fd).hdr.numpages,end,__ATOMIC_RELEASE);
+	PFftab(fd).hdrchanged = TRUE;
+	return(PFisMapPage(fd,first)? first+1: first);
+}
+
+static long PFnextCandidate(fd,pagenum)
+int fd;		/* file descriptor */
+long pagenum;	/* page number, or -1 */
+/****************************************************************************
+SPECIFICATIONS:
+	Tell which page after "pagenum" PF_GetNextPage() should look at
+	next: the next one, or for a file with an allocation bitmap the
+	next used one, so that free pages are skipped without being read.
+
+RETURN VALUE:
+	The page number, or the # of pages of the file if there is none.
+*****************************************************************************/
+{
+unsigned char *map;
+long numpages;
+
+	numpages = PFftab(fd).hdr.numpages;
+	if ((map=__atomic_load_n(&PFftab(fd).usedmap,__ATOMIC_ACQUIRE))
+								== NULL)
+		return(pagenum+1);
+	for (pagenum++; pagenum < numpages; pagenum++){
+		if ((pagenum&7) == 0)
+			/* skip bytes with no used page */
+			while (pagenum+8 <= numpages && map[pagenum>>3] == 0)
+				pagenum += 8;
+		if (pagenum < numpages && !PFisMapPage(fd,pagenum) &&
+					(map[pagenum>>3] & (1 << (pagenum&7))))
+			break;
+	}
+	return(pagenum < numpages? pagenum: numpages);
+}
+
+static void PFmapAdvise(fd,advice)
+int fd;		/* file descriptor */
+int advice;	/* MADV_xxx */
+/****************************************************************************
+SPECIFICATIONS:
+	Tell the kernel how the mapping of file "fd" is going to be
+	used, unless it has already been told so.
+
+RETURN VALUE: none
+*****************************************************************************/
+{
+	if (PFftab(fd).map != NULL && PFftab(fd).madvice != advice){
+		PFftab(fd).madvice = advice;
+		madvise(PFftab(fd).map,PFftab(fd).maplen,advice);
+	}
+}
+
+static PFmapGet(fd,pagenum,fpage)
+int fd;		/* file descriptor of a file opened with PF_OPEN_MMAP */
+long pagenum;	/* page number, valid */
+PFfpage **fpage;	/* set to the page */
+/****************************************************************************
+SPECIFICATIONS:
+	Set *fpage to point to page "pagenum" of file "fd" in the mapping
+	of the file. Nothing is fixed: the page stays there until the
+	file is closed.
+
+RETURN VALUE:
+	PFE_OK	if the page is used.
+	PFE_INVALIDPAGE	if the page is free.
+*****************************************************************************/
+{
+	/* the body of a PF_FORMAT_V2 page is the page alone: its nextfree
+	word would come before it, and is not to be looked at */
+	*fpage = (PFfpage *)(PFftab(fd).map + PFpageOffset(fd,pagenum) -
+				(PFv2(fd)? sizeof(int): 0));
+	if (!PFpageUsed(fd,pagenum,*fpage)){
+		PFerrno = PFE_INVALIDPAGE;
+		return(PFerrno);
+	}
+	PFfstat(fd,logicalReads,1);
+	return(PFE_OK);
+}
+
+
+/************************* Interface Routines ****************************/
+
+void PF_Init()
+/****************************************************************************
+SPECIFICATIONS:
+	Initialize the PF interface. Must be the first function called
+	in order to use the PF ADT.
+
+AUTHOR: clc
+
+RETURN VALUE: none
+
+GLOBAL VARIABLES MODIFIED:
+	PFftab
+*****************************************************************************/
+{
+int i;
+	/* init the hash table */
+	PFhashInit();
+
+	/* init the file table to be not used*/
+	PFftabfree = -1;
+	for (i=PFftabsize-1; i >= 0; i--){
+		PFftab(i).fname = NULL;
+		PFftab(i).isopen = FALSE;
+		PFftab(i).next = PFftabfree;
+		PFftabfree = i;
+	}
+	for (i=0; i < PF_FTAB_NBUCKETS; i++)
+		PFftabhash[i] = -1;
+
+	PF_ResetStats();
+}
+
+PF_CreateFile(fname)
+char *fname;	/* name of file to create */
+/****************************************************************************
+SPECIFICATIONS:
+	Create a paged file called "fname". The file should not have
+	already existed before.
+
+AUTHOR: clc
+
+RETURN VALUE:
+	PFE_OK	if OK
+	PF error code if error.
+*****************************************************************************/
+{
+	return(PF_CreateFileFlags(fname,0));
+}
+
+PF_CreateFileFlags(fname,flags)
+char *fname;	/* name of file to create */
+int flags;	/* PF_CREATE_xxx, or'ed */
+/****************************************************************************
+SPECIFICATIONS:
+	Create a paged file called "fname", as PF_CreateFile() does.
+	With PF_CREATE_ALIGNED the file gets the aligned layout (see
+	pftypes.h), so that it can be opened with PF_OPEN_DIRECT. On disk
+	it takes a whole page for its header and a map block for each
+	PF_MAP_BITS pages, but no free list word in each page. Such a file
+	also keeps an allocation bitmap, so that free pages are never
+	read: a scan skips them, and allocating or disposing of a page
+	does no I/O on it.
+
+RETURN VALUE:
+	PFE_OK	if OK
+	PF error code if error.
+*****************************************************************************/
+{
+	return(PF_CreateFileSized(fname,flags,PF_PAGE_SIZE));
+}
+
+PF_CreateFileSized(fname,flags,pagesize)
+char *fname;	/* name of file to create */
+int flags;	/* PF_CREATE_xxx, or'ed */
+int pagesize;	/* # of bytes of a page */
+/****************************************************************************
+SPECIFICATIONS:
+	Create a paged file called "fname", as PF_CreateFileFlags() does,
+	whose pages have "pagesize" bytes: a power of 2 from PF_PAGE_SIZE
+	to PF_MAX_PAGE_SIZE. The page size is kept in the file header.
+	Pages larger than PF_PAGE_SIZE need the aligned layout, which the
+	file then gets even without PF_CREATE_ALIGNED. Aligned files are
+	now created in format PF_FORMAT_V3 (see pftypes.h), and files
+	created with PF_CREATE_COMPRESSED in format PF_FORMAT_COMPRESSED.
+
+RETURN VALUE:
+	PFE_OK	if OK
+	PFE_PAGESIZE	if the page size is not one of those.
+	PF error code if error.
+*****************************************************************************/
+{
+int fd;	/* unix file descripotr */
+PFhdr_blk hdrblk;	/* file header */
+int size;	/* size of the file header */
+int error;
+
+	if (PFbadPageSize(pagesize)){
+		PFerrno = PFE_PAGESIZE;
+		return(PFerrno);
+	}
+	if (pagesize != PF_PAGE_SIZE)
+		flags |= PF_CREATE_ALIGNED;
+
+	/* create file for exclusive use */
+	if ((fd=open(fname,O_CREAT|O_EXCL|O_WRONLY,0664))<0){
+		/* unix error on open */
+		PFerrno = PFE_UNIX;
+		return(PFE_UNIX);
+	}
+
+	/* write out the file header */
+	memset(hdrblk.blk,0,PF_DIRECT_ALIGN);
+	hdrblk.hdr.firstfree = PF_PAGE_LIST_END;	/* no free pag yet */
+	hdrblk.hdr.numpages = 0;
+	if (flags & PF_CREATE_COMPRESSED){
+		hdrblk.hdr.magic = PF_HDR_MAGIC;
+		hdrblk.hdr.format = PF_FORMAT_COMPRESSED;
+		hdrblk.hdr.pagesize = pagesize;
+	}
+	else if (flags & PF_CREATE_ALIGNED){
+		hdrblk.hdr.magic = PF_HDR_MAGIC;
+		hdrblk.hdr.format = PF_FORMAT_V3;
+		hdrblk.hdr.pagesize = pagesize;
+	}
+	else	hdrblk.hdr.format = PF_FORMAT_PACKED;
+	size = PF_HDR_SIZE(hdrblk.hdr.format,hdrblk.hdr.pagesize);
+	if (size > PF_DIRECT_ALIGN)
+		size = PF_DIRECT_ALIGN;
+	if ((error=write(fd,hdrblk.blk,size)) != size ||
+			ftruncate(fd,PF_HDR_SIZE(hdrblk.hdr.format,
+					hdrblk.hdr.pagesize)) == -1){
+		/* error while writing. Abort everything. */
+		if (error < 0)
+			PFerrno = PFE_UNIX;
+		else PFerrno = PFE_HDRWRITE;
+		close(fd);
+		unlink(fname);
+		return(PFerrno);
+	}
+
+	if ((error=close(fd)) == -1){
+		PFerrno = PFE_UNIX;
+		return(PFerrno);
+	}
+
+	return(PFE_OK);
+}
+
+
+PF_ConvertFile(oldname,newname)
+char *oldname;	/* name of the file to convert */
+char *newname;	/* name of the file to create */
+/****************************************************************************
+SPECIFICATIONS:
+	Copy paged file "oldname", whatever its format, to a new file
+	"newname" in format PF_FORMAT_V3, with the same page size. Each
+	used page keeps its page number; the pages in between, free pages
+	and the map pages of a PF_FORMAT_MAPPED file, are free in the new
+	file. Free pages after the last used one are dropped. Neither
+	file may be open. A PF_FORMAT_COMPRESSED file is copied to a
+	compressed file, whose pages are written one after the other:
+	the room the old file no longer uses is left out.
+
+RETURN VALUE:
+	PFE_OK	if OK
+	PF error code if error. "newname" is then removed.
+*****************************************************************************/
+{
+int fd;		/* file descriptor of "oldname" */
+int flags;	/* PF_CREATE_xxx of "newname" */
+
+	if ((fd=PF_OpenFile(oldname,NULL)) < 0)
+		return(fd);
+	flags = PFcompressed(PFfileOf(fd))? PF_CREATE_COMPRESSED:
+							PF_CREATE_ALIGNED;
+	PF_CloseFile(fd);
+	return(PF_ConvertFileFlags(oldname,newname,flags));
+}
+
+PF_ConvertFileFlags(oldname,newname,flags)
+char *oldname;	/* name of the file to convert */
+char *newname;	/* name of the file to create */
+int flags;	/* PF_CREATE_xxx of the new file, or'ed */
+/****************************************************************************
+SPECIFICATIONS:
+	Copy paged file "oldname" to a new file "newname" as
+	PF_ConvertFile() does, created with "flags": PF_CREATE_COMPRESSED
+	makes a compressed copy of a file, or an uncompressed one of a
+	compressed file with PF_CREATE_ALIGNED.
+
+RETURN VALUE:
+	PFE_OK	if OK
+	PF error code if error. "newname" is then removed.
+*****************************************************************************/
+{
+int oldfd;	/* file descriptor of "oldname" */
+int newfd;	/* file descriptor of "newname" */
+int pagesize;	/* # of bytes of a page */
+long pagenum;	/* used page of "oldname" */
+long newpage;	/* page allocated in "newname" */
+long prev;	/* used page before "pagenum" */
+char *oldbuf;	/* page buffers */
+char *newbuf;
+int error;
+
+	if ((oldfd=PF_OpenFile(oldname,NULL)) < 0)
+		return(oldfd);
+	pagesize = PF_GetPageSize(oldfd);
+	if ((error=PF_CreateFileSized(newname,flags|PF_CREATE_ALIGNED,
+						pagesize)) != PFE_OK){
+		PF_CloseFile(oldfd);
+		return(error);
+	}
+	if ((newfd=PF_OpenFile(newname,NULL)) < 0){
+		error = newfd;
+		goto fail;
+	}
+
+	/* copy the used pages. The pages before each of them are allocated
+	as well, so that it gets the same number */
+	pagenum = -1;
+	while ((error=PF_GetNextPage(oldfd,&pagenum,&oldbuf)) == PFE_OK){
+		do {
+			if ((error=PF_AllocPage(newfd,&newpage,&newbuf))
+								!= PFE_OK){
+				PF_UnfixPage(oldfd,pagenum,FALSE);
+				goto fail;
+			}
+			if (newpage == pagenum)
+				bcopy(oldbuf,newbuf,pagesize);
+			PF_UnfixPage(newfd,newpage,newpage == pagenum);
+		} while (newpage < pagenum);
+		PF_UnfixPage(oldfd,pagenum,FALSE);
+	}
+	if (error != PFE_EOF)
+		goto fail;
+
+	/* and give back those between the used pages */
+	prev = pagenum = -1;
+	while ((error=PF_GetNextPage(oldfd,&pagenum,&oldbuf)) == PFE_OK){
+		PF_UnfixPage(oldfd,pagenum,FALSE);
+		for (newpage=prev+1; newpage < pagenum; newpage++)
+			if ((error=PF_DisposePage(newfd,newpage)) != PFE_OK)
+				goto fail;
+		prev = pagenum;
+	}
+	if (error != PFE_EOF)
+		goto fail;
+
+	PF_CloseFile(oldfd);
+	if ((error=PF_CloseFile(newfd)) != PFE_OK){
+		unlink(newname);
+		return(error);
+	}
+	return(PFE_OK);
+
+fail:
+	if (newfd >= 0)
+		PF_CloseFile(newfd);
+	PF_CloseFile(oldfd);
+	unlink(newname);
+	PFerrno = error;
+	return(error);
+}
+
+PF_DestroyFile(fname)
+char *fname;		/* file name to destroy */
+/****************************************************************************
+SPECIFICATIONS:
+	Destroy the paged file whose name is "fname". The file should
+	exist, and should not be already open.
+
+AUTHOR:
+	clc
+
+RETURN VALUE:
+	PFE_OK 	if success
+	PF error codes if error
+*****************************************************************************/
+{
+int error;
+struct stat st;	/* to tell which file it is */
+
+	pthread_mutex_lock(&PFftablatch);
+	if (stat(fname,&st) == 0 &&
+			PFftabFindFile(st.st_dev,st.st_ino) != -1){
+		/* file is open */
+		pthread_mutex_unlock(&PFftablatch);
+		PFerrno = PFE_FILEOPEN;
+		return(PFerrno);
+	}
+
+	error = unlink(fname);
+	pthread_mutex_unlock(&PFftablatch);
+	if (error != 0){
+		/* unix error */
+		PFerrno = PFE_UNIX;
+		return(PFerrno);
+	}
+
+	/* success */
+	return(PFE_OK);
+}
+
+///
+static PFopenFile(fd,fname,rep_policy,flags)
+int fd;			/* free entry of the file table to use */
+char *fname;		/* name of the file to open */
+char *rep_policy; // Page replacement policy
+int flags;		/* PF_OPEN_xxx, or'ed */
+// PF_OpenFile(fname)
+// char *fname;		/* name of the file to open */
+/****************************************************************************
+SPECIFICATIONS:
+	Open the paged file whose name is fname.  It is possible to open
+	a file more than once: the file descriptors share the pages of
+	the file in the buffer, and see each other's changes. The file
+	is closed when all of them are. The replacement policy of the
+	file is the one it was first opened with, and so are its
+	PF_OPEN_xxx flags: PFE_FILEOPEN if other flags are asked for
+	while it is open.
 
 AUTHOR: clc
 
 RETURN VALUE:
 	The file descriptor, which is >= 0, if no error.
+	PFE_FILEOPEN	if the file is open with other PF_OPEN_xxx flags.
 	PF error codes otherwise.
 
+	With PF_OPEN_DIRECT the file is read and written with O_DIRECT,
+	bypassing the kernel's page cache. The file must have been created
+	with PF_CREATE_ALIGNED, and live on a file system that supports
+	O_DIRECT with PF_DIRECT_ALIGN alignment; PFE_DIRECT otherwise.
+	With PF_OPEN_MMAP the file is opened read-only and mapped into
+	memory. PF_GetThisPage() and friends return pointers into the
+	mapping, bypassing the buffer; unfixing a page does nothing, and
+	changing the file fails with PFE_READONLY. Pages added to the file
+	through another file descriptor after the open are not seen.
+	PF_OPEN_MMAP can't be combined with PF_OPEN_DIRECT (PFE_DIRECT).
+
 IMPLEMENTATION NOTES:
 	A file opened more than once will have different file descriptors
-	returned. Separate buffers are used.
+	returned, which all use the file entry of the first one (see
+	pftypes.h). The file is told by device and inode, not by name.
+	A file entry has one set of flags: a handle with other flags
+	would need one of its own, with its own header, free pages and
+	buffers, and two such entries would each allocate the same pages.
+	The header is read before O_DIRECT is set, as its layout is not
+	known yet; the first block is then read again with O_DIRECT to
+	make sure the file system takes it.
 *****************************************************************************/
 {
+PFhdr_blk hdrblk;	/* header block */
 int count;	/* # of bytes in read */
-int fd; /* file descriptor */
+struct stat st;	/* to tell which file it is */
+int file;	/* file entry of the file, if already open */
 
-	/* find a free entry in the file table */
-	if ((fd=PFftabFindFree())< 0){
-		/* file table full */
-		PFerrno = PFE_FTABFULL;
+	if ((flags & PF_OPEN_DIRECT) && (flags & PF_OPEN_MMAP)){
+		PFerrno = PFE_DIRECT;
 		return(PFerrno);
 	}
 
 	/* open the file */
-	if ((PFftab[fd].unixfd = open(fname,O_RDWR))< 0){
+	if ((PFftab(fd).unixfd = open(fname,(flags & PF_OPEN_MMAP)?
+						O_RDONLY: O_RDWR))< 0){
 		/* can't open the file */
 		PFerrno = PFE_UNIX;
 		return(PFerrno);
 	}
+	if (fstat(PFftab(fd).unixfd,&st) == -1){
+		close(PFftab(fd).unixfd);
+		PFerrno = PFE_UNIX;
+		return(PFerrno);
+	}
+
+	/* the handle: no scan going on yet */
+	PFftab(fd).flags = flags;
+	PFftab(fd).lastpage = -1;
+	PFftab(fd).seqrun = 0;
+	PFftab(fd).raend = 0;
+	PFftab(fd).rawindow = PF_READAHEAD_MIN;
+	if ((PFftab(fd).fname = savestr(fname)) == NULL){
+		/* no memory */
+		close(PFftab(fd).unixfd);
+		PFerrno = PFE_NOMEM;
+		return(PFerrno);
+	}
+
+	if ((file=PFftabFindFile(st.st_dev,st.st_ino)) >= 0){
+		/* already open: share the file entry */
+		close(PFftab(fd).unixfd);
+		if (PFftab(file).flags != flags){
+			PFerrno = PFE_FILEOPEN;
+			return(PFerrno);
+		}
+		PFftab(fd).file = file;
+		PFftab(file).nhandles++;
+		PFftab(fd).isopen = TRUE;
+		return(fd);
+	}
 
-	/* Read the file header */
-	if ((count=read(PFftab[fd].unixfd,(char *)&PFftab[fd].hdr,PF_HDR_SIZE))
-				!= PF_HDR_SIZE){
+	/* Read the file header. Without the magic number it is the
+	header of a packed file, and the rest is page 0 */
+	if ((count=pread(PFftab(fd).unixfd,(char *)&PFftab(fd).hdr,
+			sizeof(PFhdr_str),(off_t)0)) < (int)PF_HDR_PACKED_SIZE){
 		if (count < 0)
 			/* unix error */
 			PFerrno = PFE_UNIX;
 		else	/* not enough bytes in file */
 			PFerrno = PFE_HDRREAD;
-		close(PFftab[fd].unixfd);
+		close(PFftab(fd).unixfd);
+		return(PFerrno);
+	}
+	if (count < sizeof(PFhdr_str) || PFftab(fd).hdr.magic != PF_HDR_MAGIC){
+		PFftab(fd).hdr.magic = 0;
+		PFftab(fd).hdr.format = PF_FORMAT_PACKED;
+		PFftab(fd).hdr.pagesize = 0;
+	}
+	else if ((PFftab(fd).hdr.format != PF_FORMAT_ALIGNED &&
+			PFftab(fd).hdr.format != PF_FORMAT_MAPPED &&
+			PFftab(fd).hdr.format != PF_FORMAT_V2 &&
+			PFftab(fd).hdr.format != PF_FORMAT_V3 &&
+			PFftab(fd).hdr.format != PF_FORMAT_COMPRESSED) ||
+			(PFftab(fd).hdr.pagesize != 0 &&
+			PFbadPageSize(PFftab(fd).hdr.pagesize))){
+		/* written by a later version */
+		close(PFftab(fd).unixfd);
+		PFerrno = PFE_HDRREAD;
+		return(PFerrno);
+	}
+	if (!PFlongNumpages(PFftab(fd).hdr.format))
+		/* the older formats count the pages in an int */
+		PFftab(fd).hdr.numpages = PFftab(fd).hdr.oldnumpages;
+	if (PFcompressed(fd) && (flags & (PF_OPEN_DIRECT|PF_OPEN_MMAP))){
+		/* the pages are not in the file as they are in memory */
+		close(PFftab(fd).unixfd);
+		PFerrno = PFE_COMPRESSED;
+		return(PFerrno);
+	}
+
+	if (flags & PF_OPEN_DIRECT){
+		if (PFftab(fd).hdr.format == PF_FORMAT_PACKED ||
+			fcntl(PFftab(fd).unixfd,F_SETFL,O_DIRECT) == -1 ||
+			pread(PFftab(fd).unixfd,hdrblk.blk,PF_DIRECT_ALIGN,
+					(off_t)0) != PF_DIRECT_ALIGN){
+			close(PFftab(fd).unixfd);
+			PFerrno = PFE_DIRECT;
+			return(PFerrno);
+		}
+	}
+
+	/* map the file, header and all. Lookups are random until a scan
+	shows up */
+	PFftab(fd).map = NULL;
+	PFftab(fd).maplen = PFpageOffset(fd,PFftab(fd).hdr.numpages);
+	PFftab(fd).madvice = MADV_NORMAL;
+	PFftab(fd).allocend = PFftab(fd).hdr.numpages;
+	if ((flags & PF_OPEN_MMAP) && PFftab(fd).hdr.numpages > 0){
+		if ((PFftab(fd).map=mmap(NULL,PFftab(fd).maplen,PROT_READ,
+			MAP_SHARED,PFftab(fd).unixfd,(off_t)0)) == MAP_FAILED){
+			PFftab(fd).map = NULL;
+			close(PFftab(fd).unixfd);
+			PFerrno = PFE_UNIX;
+			return(PFerrno);
+		}
+		PFmapAdvise(fd,MADV_RANDOM);
+	}
+	if (PFbitmapLoad(fd) != PFE_OK){
+		PFbitmapFree(fd);
+		if (PFftab(fd).map != NULL)
+			munmap(PFftab(fd).map,PFftab(fd).maplen);
+		close(PFftab(fd).unixfd);
 		return(PFerrno);
 	}
 	/* set file header to be not changed */
-	PFftab[fd].hdrchanged = FALSE;
+	PFftab(fd).hdrchanged = FALSE;
+	PFftab(fd).scanhint = 0;
+
+	/* frames large enough for the pages of the file. The pagebuf of a
+	PF_FORMAT_V2 page, which is all that is read and written, starts
+	PF_DIRECT_ALIGN bytes into the frame */
+	if (PFv2(fd))
+		PFbufSetFrameSize(fd,PF_DIRECT_ALIGN + PFpageIOSize(fd),
+					PF_DIRECT_ALIGN - (int)sizeof(int));
+	else	PFbufSetFrameSize(fd,PFpageIOSize(fd),0);
+
+	/// setting page replacement policy, default LRU
+	PFftab(fd).policy = PFpolicyOf(rep_policy);
+
+	/* nothing counted yet: the threads may have counted for an
+	earlier file of the entry */
+	pthread_mutex_lock(&PFstatlatch);
+	PFfileStatsClear(fd,TRUE);
+	pthread_mutex_unlock(&PFstatlatch);
+
+	/* the handle is the file entry of its file */
+	PFftab(fd).file = fd;
+	PFftab(fd).nhandles = 1;
+	PFftab(fd).dev = st.st_dev;
+	PFftab(fd).ino = st.st_ino;
+	PFftabHashInsert(fd);
+	PFftab(fd).isopen = TRUE;
+	return(fd);
+}
 
-	/* save the file name */
-	if ((PFftab[fd].fname = savestr(fname)) == NULL){
-		/* no memory */
-		close(PFftab[fd].unixfd);
-		PFerrno = PFE_NOMEM;
+PF_OpenFile(fname,rep_policy)
+char *fname;		/* name of the file to open */
+char *rep_policy;	/* page replacement policy */
+/****************************************************************************
+SPECIFICATIONS:
+	PFopenFile() with the file table latched.
+*****************************************************************************/
+{
+	return(PF_OpenFileFlags(fname,rep_policy,0));
+}
+
+PF_OpenFileFlags(fname,rep_policy,flags)
+char *fname;		/* name of the file to open */
+char *rep_policy;	/* page replacement policy */
+int flags;		/* PF_OPEN_xxx, or'ed */
+/****************************************************************************
+SPECIFICATIONS:
+	PFopenFile() with the file table latched.
+*****************************************************************************/
+{
+int fd;		/* entry for the file descriptor */
+int ret;	/* file descriptor or error */
+
+	pthread_mutex_lock(&PFftablatch);
+	if ((fd=PFftabFindFree()) < 0)
+		/* file table full */
+		ret = PFerrno;
+	else if ((ret=PFopenFile(fd,fname,rep_policy,flags)) < 0)
+		PFftabRelease(fd);
+	pthread_mutex_unlock(&PFftablatch);
+	return(ret);
+}
+
+static PFcloseFile(fd)
+int fd;		/* file descriptor to close */
+/****************************************************************************
+SPECIFICATIONS:
+	Close the file indexed by file descriptor fd. The file should have
+	been opened with PFopen(). It is an error to close a file
+	with pages still fixed in the buffer.
+	While the file is open through other file descriptors, only fd
+	goes, and the file stays as it is.
+
+AUTHOR: clc
+
+RETURN VALUE:
+	PFE_OK	if OK
+	PF error code if error.
+
+*****************************************************************************/
+{
+int error;
+int handle;	/* the file descriptor being closed */
+PF_FileStats st;	/* its counters */
+
+	if (PFinvalidFd(fd)){
+		/* invalid file descriptor */
+		PFerrno = PFE_FD;
+		return(PFerrno);
+	}
+
+	handle = fd;
+	fd = PFfileOf(handle);
+	if (PFftab(fd).nhandles > 1){
+		/* the other handles go on using the file */
+		PFftab(fd).nhandles--;
+		PFftab(handle).isopen = FALSE;
+		if (handle != fd)
+			PFftabRelease(handle);
+		return(PFE_OK);
+	}
+
+	/* Flush all buffers for this file */
+	if ( (error=PFbufReleaseFile(fd,PFwritefcn,PFwriterunsfcn)) != PFE_OK)
+		return(error);
+
+	/* write the map pages and the header back to the file */
+	if ((error=PFbitmapSave(fd)) != PFE_OK ||
+				(error=PFwriteHdr(fd)) != PFE_OK)
+		return(error);
+	PFbitmapFree(fd);
+
+	if (PFftab(fd).map != NULL){
+		munmap(PFftab(fd).map,PFftab(fd).maplen);
+		PFftab(fd).map = NULL;
+	}
+
+
+		
+	/* close the file */
+	if ((error=close(PFftab(fd).unixfd))== -1){
+		PFerrno = PFE_UNIX;
+		return(PFerrno);
+	}
+
+	/* its counters go on counting for its policy */
+	pthread_mutex_lock(&PFstatlatch);
+	PFfileStatsSum(fd,&st);
+	PFfileStatsAdd(&PFpolicystats[PFftab(fd).policy],&st);
+	pthread_mutex_unlock(&PFstatlatch);
+
+	/* free the entries, and the file name space */
+	PFftabHashDelete(fd);
+	if (handle != fd)
+		PFftabRelease(handle);
+	PFftabRelease(fd);
+
+	return(PFE_OK);
+}
+
+PF_CloseFile(fd)
+int fd;		/* file descriptor to close */
+/****************************************************************************
+SPECIFICATIONS:
+	PFcloseFile() with the file table latched.
+*****************************************************************************/
+{
+int ret;
+
+	pthread_mutex_lock(&PFftablatch);
+	ret = PFcloseFile(fd);
+	pthread_mutex_unlock(&PFftablatch);
+	return(ret);
+}
+
+
+PF_GetFirstPage(fd,pagenum,pagebuf)
+int fd;	/* file descriptor */
+long *pagenum;	/* page number of first page */
+char **pagebuf;	/* pointer to the pointer to buffer */
+/****************************************************************************
+SPECIFICATIONS:
+	Read the first page into memory and set *pagebuf to point to it.
+	Set *pagenum to the page number of the page read.
+	The page read is fixed in the buffer until it is unixed with
+	PFunfix().
+
+AUTHOR: clc
+
+RETURN VALUE:
+	PFE_OK	if no error.
+	PFE_EOF	if end of file reached.(meaning there is no first page. )
+	other PF error code if other error.
+
+*****************************************************************************/
+{
+
+	*pagenum = -1;
+	return(PF_GetNextPage(fd,pagenum,pagebuf));
+}
+
+
+PF_GetNextPage(fd,pagenum,pagebuf)
+int fd;	/* file descriptor of the file */
+long *pagenum;	/* old page number on input, new page number on output */
+char **pagebuf;	/* pointer to pointer to buffer of page data */
+/****************************************************************************
+SPECIFICATIONS:
+	Read the next valid page after *pagenum, the current page number,
+	and set *pagebuf to point to the page data. Set *pagenum
+	to be the new page number. The new page is fixed in memory 
+	until PFunfix() is called.
+	Note that PF_GetNextPage() with *pagenum == -1 will return the 
+	first valid page. PFgetFirst() is just a short hand for this.
+
+AUTHOR: clc
+
+RETURN VALUE:
+	PFE_OK	if success
+	PFE_EOF	if end of file reached without encountering
+		any used page data. 
+	PFE_INVALIDPAGE  if page number is invalid.
+	other PF errors code for other error.
+
+IMPLEMENTATION NOTES:
+	A run of PF_GetNextPage() calls that each go on from the page
+	returned by the previous one (at least PF_SEQ_THRESHOLD of them),
+	or a scan announced with PF_ScanHint(), reads the pages with
+	PF_HINT_SEQ, so that the scan recycles a small ring of buffer
+	pages instead of flushing the whole buffer. For a file opened
+	with PF_OPEN_MMAP, such a scan switches the mapping to
+	MADV_SEQUENTIAL instead, and other calls back to MADV_RANDOM.
+	Such a scan also reads ahead: when it gets past the pages already
+	read ahead, the next rawindow pages of the handle are read into the
+	ring with one vectored read (see PFbufReadAhead()). The window
+	starts at PF_READAHEAD_MIN pages and doubles with each read-ahead
+	while the scan goes on, up to PF_READAHEAD_MAX.
+	The free pages of a file with an allocation bitmap are skipped
+	without being read, and read-ahead stops at the first of them.
+*****************************************************************************/
+{
+long temppage;	/* page number to scan for next valid page */
+int error;	/* error code */
+PFfpage *fpage;	/* pointer to file page */
+int hint;	/* access hint for the buffer manager */
+int n;		/* # of pages read ahead */
+int i;
+int h;		/* the handle: it keeps track of its own scan */
+
+	if (PFinvalidFd(fd)){
+		PFerrno = PFE_FD;
+		return(PFerrno);
+	}
+	h = fd;
+	fd = PFfileOf(h);
+
+
+	if (*pagenum < -1 || *pagenum >= PFftab(fd).hdr.numpages){
+		PFerrno = PFE_INVALIDPAGE;
+		return(PFerrno);
+	}
+
+	/* is the file being scanned? */
+	if (*pagenum != -1 && *pagenum == PFftab(h).lastpage)
+		PFftab(h).seqrun++;
+	else {
+		PFftab(h).seqrun = 0;
+		PFftab(h).raend = 0;
+		PFftab(h).rawindow = PF_READAHEAD_MIN;
+	}
+	hint = (PFftab(fd).scanhint > 0 ||
+		PFftab(h).seqrun >= PF_SEQ_THRESHOLD)? PF_HINT_SEQ: PF_HINT_NONE;
+
+	if (PFmapped(fd)){
+		/* the kernel reads ahead in the mapping for a scan */
+		PFmapAdvise(fd,(hint == PF_HINT_SEQ)? MADV_SEQUENTIAL:
+							MADV_RANDOM);
+		for (temppage=PFnextCandidate(fd,*pagenum);
+				temppage < PFftab(fd).hdr.numpages;
+				temppage=PFnextCandidate(fd,temppage))
+			if (PFmapGet(fd,temppage,&fpage) == PFE_OK){
+				*pagenum = temppage;
+				PFftab(h).lastpage = temppage;
+				*pagebuf = (char *)fpage->pagebuf;
+				return(PFE_OK);
+			}
+		PFftab(h).lastpage = -1;
+		PFerrno = PFE_EOF;
+		return(PFerrno);
+	}
+
+	/* scan the file until a valid used page is found */
+	for (temppage=PFnextCandidate(fd,*pagenum);
+			temppage < PFftab(fd).hdr.numpages;
+			temppage=PFnextCandidate(fd,temppage)){
+		if (hint == PF_HINT_SEQ && temppage >= PFftab(h).raend){
+			/* read ahead; if it fails the page is read below */
+			n = PFftab(h).rawindow;
+			if (n > PFftab(fd).hdr.numpages - temppage)
+				n = PFftab(fd).hdr.numpages - temppage;
+			if (PFftab(fd).usedmap != NULL)
+				/* only as far as the pages are used */
+				for (i=1; i < n; i++)
+					if (!PFbitmapUsed(fd,temppage+i)){
+						n = i;
+						break;
+					}
+			if ((n=PFbufReadAhead(fd,temppage,n,PFreadrunsfcn,
+							PFwritefcn)) < 1)
+				n = 1;
+			PFftab(h).raend = temppage + n;
+			if (2*PFftab(h).rawindow <= PF_READAHEAD_MAX)
+				PFftab(h).rawindow *= 2;
+		}
+		if ( (error=PFbufGet(fd,temppage,&fpage,PFreadfcn,
+					PFwritefcn,hint))!= PFE_OK)
+			return(error);
+		else if (PFpageUsed(fd,temppage,fpage)){
+			/* found a used page */
+			*pagenum = temppage;
+			PFftab(h).lastpage = temppage;
+			*pagebuf = (char *)fpage->pagebuf;
+
+			///
+			PFfstat(fd,logicalReads,1);
+
+			return(PFE_OK);
+		}
+
+		/* page is free, unfix it */
+		if ((error=PFbufUnfix(fd,temppage,FALSE))!= PFE_OK)
+			return(error);
+	}
+
+	/* No valid used page found */
+	PFftab(h).lastpage = -1;
+	PFerrno = PFE_EOF;
+	return(PFerrno);
+
+}
+
+PF_ScanHint(fd,on)
+int fd;		/* file descriptor */
+int on;		/* TRUE when a scan starts, FALSE when it ends */
+/****************************************************************************
+SPECIFICATIONS:
+	Tell the Paged File Interface that a sequential scan of file "fd"
+	with PF_GetNextPage() starts ("on" TRUE) or ends ("on" FALSE).
+	While at least one scan is announced, PF_GetNextPage() reads the
+	pages of the file through its scan ring right away, instead of
+	waiting for a run of PF_SEQ_THRESHOLD sequential calls.
+
+RETURN VALUE:
+	PFE_OK	if no error.
+	PFE_FD	if invalid file descriptor.
+*****************************************************************************/
+{
+	if (PFinvalidFd(fd)){
+		PFerrno = PFE_FD;
+		return(PFerrno);
+	}
+	fd = PFfileOf(fd);
+
+	if (on)
+		__atomic_add_fetch(&PFftab(fd).scanhint,1,__ATOMIC_RELAXED);
+	else if (__atomic_sub_fetch(&PFftab(fd).scanhint,1,__ATOMIC_RELAXED) < 0)
+		/* more ends than starts */
+		__atomic_store_n(&PFftab(fd).scanhint,0,__ATOMIC_RELAXED);
+	return(PFE_OK);
+}
+
+PF_FlushFile(fd)
+int fd;		/* file descriptor */
+/****************************************************************************
+SPECIFICATIONS:
+	Write out the dirty pages of file "fd", its changed map pages,
+	and its header if it has changed, without closing the file or
+	taking its pages out of the buffer. The pages are written in order of page number, each run
+	of adjacent pages with one vectored write.
+
+RETURN VALUE:
+	PFE_OK	if no error.
+	PF error code if error.
+*****************************************************************************/
+{
+int error;
+
+	pthread_mutex_lock(&PFftablatch);
+	if (PFinvalidFd(fd)){
+		/* invalid file descriptor */
+		pthread_mutex_unlock(&PFftablatch);
+		PFerrno = PFE_FD;
+		return(PFerrno);
+	}
+	fd = PFfileOf(fd);
+
+	if ((error=PFbufFlushFile(fd,PFwriterunsfcn)) == PFE_OK &&
+				(error=PFbitmapSave(fd)) == PFE_OK)
+		error = PFwriteHdr(fd);
+	pthread_mutex_unlock(&PFftablatch);
+	return(error);
+}
+
+PF_SetFileQuota(fd,minframes,maxframes)
+int fd;		/* file descriptor */
+int minframes;	/* # of buffer frames reserved for the file, or 0 */
+int maxframes;	/* max # of buffer frames of the file, or 0 for no cap */
+/****************************************************************************
+SPECIFICATIONS:
+	Keep at least "minframes" of the buffer frames for the pages of
+	file "fd", and let its pages take no more than "maxframes" of
+	them, so that a file being loaded or scanned does not push the
+	pages of the other files out. 0, 0 removes the quota. The quota
+	holds until the file is closed. PF_GetFileFrames() tells how
+	many frames a file has.
+
+RETURN VALUE:
+	PFE_OK	if no error.
+	PFE_FD	if invalid file descriptor.
+	PFE_QUOTA	unless 0 <= minframes <= maxframes (or maxframes
+		is 0), and the frames reserved for all the files fit in the
+		buffer.
+*****************************************************************************/
+{
+	if (PFinvalidFd(fd)){
+		PFerrno = PFE_FD;
+		return(PFerrno);
+	}
+	fd = PFfileOf(fd);
+	return(PFbufSetQuota(fd,minframes,maxframes));
+}
+
+PF_GetFileFrames(fd)
+int fd;		/* file descriptor */
+/****************************************************************************
+SPECIFICATIONS:
+	Tell how many buffer frames hold pages of file "fd".
+
+RETURN VALUE:
+	The # of frames, >= 0.
+	PFE_FD	if invalid file descriptor.
+*****************************************************************************/
+{
+	if (PFinvalidFd(fd)){
+		PFerrno = PFE_FD;
 		return(PFerrno);
 	}
-
-	/// setting page replacement policy
-	if(strcmp(rep_policy, "MRU") == 0){
-		PFftab[fd].mru = 1;
-	}
-	else{
-		//default LRU
-		PFftab[fd].mru = 0;
-	}
-
-	return(fd);
+	fd = PFfileOf(fd);
+	return(PFbufFileFrames(fd));
 }
 
-PF_CloseFile(fd)
-int fd;		/* file descriptor to close */
+PF_GetPageSize(fd)
+int fd;		/* file descriptor */
 /****************************************************************************
 SPECIFICATIONS:
-	Close the file indexed by file descriptor fd. The file should have
-	been opened with PFopen(). It is an error to close a file
-	with pages still fixed in the buffer.
-
-AUTHOR: clc
+	Tell how many bytes a page of file "fd" has: PF_PAGE_SIZE, or
+	the size the file was created with by PF_CreateFileSized().
 
 RETURN VALUE:
-	PFE_OK	if OK
-	PF error code if error.
-
+	The page size, > 0.
+	PFE_FD	if invalid file descriptor.
 *****************************************************************************/
 {
-int error;
-
 	if (PFinvalidFd(fd)){
-		/* invalid file descriptor */
 		PFerrno = PFE_FD;
 		return(PFerrno);
 	}
-	
-
-	/* Flush all buffers for this file */
-	if ( (error=PFbufReleaseFile(fd,PFwritefcn)) != PFE_OK)
-		return(error);
+	fd = PFfileOf(fd);
+	return(PFpageSize(PFftab(fd).hdr.pagesize));
+}
 
-	if (PFftab[fd].hdrchanged){
-		/* write the header back to the file */
-		/* First seek to the appropriate place */
-		if ((error=lseek(PFftab[fd].unixfd,(unsigned)0,L_SET)) == -1){
-			/* seek error */
-			PFerrno = PFE_UNIX;
-			return(PFerrno);
-		}
+PF_GetFormat(fd)
+int fd;		/* file descriptor */
+/****************************************************************************
+SPECIFICATIONS:
+	Tell the format of file "fd", PF_FORMAT_xxx. PF_CreateFile()
+	makes a PF_FORMAT_PACKED file, PF_CREATE_ALIGNED a PF_FORMAT_V3
+	one and PF_CREATE_COMPRESSED a PF_FORMAT_COMPRESSED one; other
+	formats are those of files created by earlier versions. A layer
+	that lays out its own data in the pages can tell by it whether a
+	file predates a change of that layout.
 
-		/* write header*/
-		if((error=write(PFftab[fd].unixfd, (char *)&PFftab[fd].hdr,
-				PF_HDR_SIZE))!=PF_HDR_SIZE){
-			if (error <0)
-				PFerrno = PFE_UNIX;
-			else	PFerrno = PFE_HDRWRITE;
-			return(PFerrno);
-		}
-		PFftab[fd].hdrchanged = FALSE;
+RETURN VALUE:
+	The format, > 0.
+	PFE_FD	if invalid file descriptor.
+*****************************************************************************/
+{
+	if (PFinvalidFd(fd)){
+		PFerrno = PFE_FD;
+		return(PFerrno);
 	}
+	fd = PFfileOf(fd);
+	return(PFftab(fd).hdr.format);
+}
 
+PF_SetIOBackend(backend)
+int backend;	/* PF_IO_xxx */
+/****************************************************************************
+SPECIFICATIONS:
+	Do the page I/O with "backend" from now on: PF_IO_SYNC,
+	PF_IO_THREADS or PF_IO_URING (the default). PF_IO_URING falls
+	back to PF_IO_THREADS when io_uring is not available.
 
-		
-	/* close the file */
-	if ((error=close(PFftab[fd].unixfd))== -1){
-		PFerrno = PFE_UNIX;
+RETURN VALUE:
+	The backend in use, PF_IO_xxx.
+	PFE_IOBACKEND	if "backend" is unknown.
+*****************************************************************************/
+{
+	if (backend != PF_IO_SYNC && backend != PF_IO_THREADS &&
+						backend != PF_IO_URING){
+		PFerrno = PFE_IOBACKEND;
 		return(PFerrno);
 	}
+	return(PFioSetBackend(backend));
+}
 
-	/* free the file name space */
-	free((char *)PFftab[fd].fname);
-	PFftab[fd].fname = NULL;
+PF_StartCleaner(lowwater,highwater)
+int lowwater;	/* % of the buffer dirty at which the cleaner stops */
+int highwater;	/* % of the buffer dirty at which the cleaner starts */
+/****************************************************************************
+SPECIFICATIONS:
+	Start the background page cleaner. Whenever more than "highwater"
+	percent of the buffer pages are dirty, or a page miss had to write
+	out a dirty victim itself, the cleaner writes out dirty unfixed
+	pages, those nearest to eviction first, until no more than
+	"lowwater" percent are dirty. PF_CLEAN_LOWWATER and
+	PF_CLEAN_HIGHWATER are reasonable values.
 
-	return(PFE_OK);
+RETURN VALUE:
+	PFE_OK	if no error.
+	PFE_CLEANER	if the cleaner is already running or can't be
+		started, or unless 0 <= lowwater < highwater <= 100.
+*****************************************************************************/
+{
+	return(PFbufStartCleaner(PFwritefcn,lowwater,highwater));
 }
 
-
-PF_GetFirstPage(fd,pagenum,pagebuf)
-int fd;	/* file descriptor */
-int *pagenum;	/* page number of first page */
-char **pagebuf;	/* pointer to the pointer to buffer */
+PF_StopCleaner()
 /****************************************************************************
 SPECIFICATIONS:
-	Read the first page into memory and set *pagebuf to point to it.
-	Set *pagenum to the page number of the page read.
-	The page read is fixed in the buffer until it is unixed with
-	PFunfix().
-
-AUTHOR: clc
+	Stop the page cleaner started by PF_StartCleaner(), once the
+	round it may be doing is over. From then on dirty pages are
+	written out by page misses, and when files are closed.
 
 RETURN VALUE:
 	PFE_OK	if no error.
-	PFE_EOF	if end of file reached.(meaning there is no first page. )
-	other PF error code if other error.
-
+	PFE_CLEANER	if the cleaner is not running.
 *****************************************************************************/
 {
-
-	*pagenum = -1;
-	return(PF_GetNextPage(fd,pagenum,pagebuf));
+	return(PFbufStopCleaner());
 }
 
-
-PF_GetNextPage(fd,pagenum,pagebuf)
-int fd;	/* file descriptor of the file */
-int *pagenum;	/* old page number on input, new page number on output */
-char **pagebuf;	/* pointer to pointer to buffer of page data */
+PF_SetCompressedCache(bytes)
+long bytes;	/* memory budget of the cache, 0 to turn it off */
 /****************************************************************************
 SPECIFICATIONS:
-	Read the next valid page after *pagenum, the current page number,
-	and set *pagebuf to point to the page data. Set *pagenum
-	to be the new page number. The new page is fixed in memory 
-	until PFunfix() is called.
-	Note that PF_GetNextPage() with *pagenum == -1 will return the 
-	first valid page. PFgetFirst() is just a short hand for this.
-
-AUTHOR: clc
+	Keep the pages evicted from the buffer in a compressed page cache
+	of "bytes" bytes (see zcache.c), so that a page evicted not long
+	ago is decompressed instead of read from its file when it is
+	asked for again. The cache is off by default. A smaller budget
+	drops the pages put into the cache longest ago.
 
 RETURN VALUE:
-	PFE_OK	if success
-	PFE_EOF	if end of file reached without encountering
-		any used page data. 
-	PFE_INVALIDPAGE  if page number is invalid.
-	other PF errors code for other error.
+	PFE_OK	if no error.
+	PFE_QUOTA	if "bytes" is negative.
+	PFE_NOMEM	if no memory.
+*****************************************************************************/
+{
+	if (bytes < 0){
+		PFerrno = PFE_QUOTA;
+		return(PFerrno);
+	}
+	return(PFbufSetCacheSize(bytes));
+}
+
+PF_GetPages(fd,pagenums,n,pagebufs)
+int fd;		/* file descriptor */
+long *pagenums;	/* numbers of the pages to read */
+int n;		/* # of pages */
+char **pagebufs;	/* set to the page data */
+/****************************************************************************
+SPECIFICATIONS:
+	Read the "n" pages pagenums[0..n-1] as PF_GetThisPage() does, and
+	set pagebufs[i] to point to the data of page pagenums[i]. The
+	pages missing from the buffer are fetched together, so that the
+	I/O backend can work on them at the same time, and the caller
+	waits only once. Each page is fixed until PF_UnfixPage() is
+	called for it (twice for a page asked for twice). At most
+	PF_MAX_BUFS pages can be asked for.
 
+RETURN VALUE:
+	PFE_OK	if no error.
+	PFE_INVALIDPAGE if a page number is invalid, or a page is free.
+	PF error code if error. No page is fixed then.
 *****************************************************************************/
 {
-int temppage;	/* page number to scan for next valid page */
-int error;	/* error code */
-PFfpage *fpage;	/* pointer to file page */
+PFfpage **fpages;	/* the pages */
+PFfpage *fpage;	/* a mapped page */
+int error;
+int i;
 
 	if (PFinvalidFd(fd)){
 		PFerrno = PFE_FD;
 		return(PFerrno);
 	}
+	fd = PFfileOf(fd);
+	for (i=0; i < n; i++)
+		if (PFinvalidPagenum(fd,pagenums[i])){
+			PFerrno = PFE_INVALIDPAGE;
+			return(PFerrno);
+		}
+	if (PFftab(fd).usedmap != NULL)
+		for (i=0; i < n; i++)
+			if (!PFbitmapUsed(fd,pagenums[i])){
+				/* free: not worth reading */
+				PFerrno = PFE_INVALIDPAGE;
+				return(PFerrno);
+			}
+	if (PFmapped(fd)){
+		PFmapAdvise(fd,MADV_RANDOM);
+		for (i=0; i < n; i++){
+			if ((error=PFmapGet(fd,pagenums[i],&fpage)) != PFE_OK)
+				return(error);
+			pagebufs[i] = fpage->pagebuf;
+		}
+		return(PFE_OK);
+	}
 
-
-	if (*pagenum < -1 || *pagenum >= PFftab[fd].hdr.numpages){
-		PFerrno = PFE_INVALIDPAGE;
+	if ((fpages=(PFfpage **)malloc(n*sizeof(PFfpage *))) == NULL){
+		PFerrno = PFE_NOMEM;
 		return(PFerrno);
 	}
 
-	/* scan the file until a valid used page is found */
-	for (temppage= *pagenum+1;temppage<PFftab[fd].hdr.numpages;temppage++){
-		if ( (error=PFbufGet(fd,temppage,&fpage,PFreadfcn,
-					PFwritefcn))!= PFE_OK)
-			return(error);
-		else if (fpage->nextfree == PF_PAGE_USED){
-			/* found a used page */
-			*pagenum = temppage;
-			*pagebuf = (char *)fpage->pagebuf;
-
-			///
-			PFstats.logicalReads++;
-            // PFstats.pagesAccessed++;
-
-			return(PFE_OK);
+	if ((error=PFbufGetPages(fd,pagenums,n,fpages,PFreadrunsfcn,
+						PFwritefcn)) == PFE_OK){
+		for (i=0; i < n && PFpageUsed(fd,pagenums[i],fpages[i]); i++)
+			pagebufs[i] = fpages[i]->pagebuf;
+		if (i < n){
+			/* a free page: give them all back */
+			for (i=0; i < n; i++)
+				PFbufUnfix(fd,pagenums[i],FALSE);
+			error = PFerrno = PFE_INVALIDPAGE;
 		}
-
-		/* page is free, unfix it */
-		if ((error=PFbufUnfix(fd,temppage,FALSE))!= PFE_OK)
-			return(error);
+		else	PFfstat(fd,logicalReads,n);
 	}
-
-	/* No valid used page found */
-	PFerrno = PFE_EOF;
-	return(PFerrno);
-
+	free((char *)fpages);
+	return(error);
 }
 
-PF_GetThisPage(fd,pagenum,pagebuf)
+static PFgetThisPage(fd,pagenum,pagebuf,hint)
 int fd;		/* file descriptor */
-int pagenum;	/* page number to read */
+long pagenum;	/* page number to read */
 char **pagebuf;	/* pointer to pointer to page data */
+int hint;	/* access hint for the buffer manager */
 /****************************************************************************
 SPECIFICATIONS:
 	Read the page specifeid by "pagenum" and set *pagebuf to point
 	to the page data. The page number should be valid.
+	The page is fixed in memory until PF_UnfixPage() is called.
+	A page already fixed by someone else is shared: it gets one more
+	pin, and each successful call must be matched by one
+	PF_UnfixPage().
 
 AUTHOR: clc
 
 RETURN VALUE:
 	PFE_OK	if no error.
 	PFE_INVALIDPAGE if invalid page number is specified.
-	PFE_PAGEFIXED if page already fixed in memory. In this case,
-		*pagebuf  is still set to point to the buffer that contains
-		the page data.
 	other PF error codes if other error encountered.
 *****************************************************************************/
 {
@@ -570,24 +3102,36 @@ PFfpage *fpage;
 		PFerrno = PFE_FD;
 		return(PFerrno);
 	}
+	fd = PFfileOf(fd);
 
-	if (PFinvalidPagenum(fd,pagenum)){
+	if (PFinvalidPagenum(fd,pagenum) ||
+			(PFftab(fd).usedmap != NULL && !PFbitmapUsed(fd,pagenum))){
+		/* no such page, or a free one: no need to read it */
 		PFerrno = PFE_INVALIDPAGE;
 		return(PFerrno);
 	}
 
-	if ( (error=PFbufGet(fd,pagenum,&fpage,PFreadfcn,PFwritefcn))!= PFE_OK){
+	if (PFmapped(fd)){
+		if (PFftab(fd).scanhint == 0)
+			PFmapAdvise(fd,MADV_RANDOM);
+		if ((error=PFmapGet(fd,pagenum,&fpage)) == PFE_OK)
+			*pagebuf = fpage->pagebuf;
+		return(error);
+	}
+
+	if ( (error=PFbufGet(fd,pagenum,&fpage,PFreadfcn,PFwritefcn,
+						hint))!= PFE_OK){
 		if (error== PFE_PAGEFIXED)
 			*pagebuf = fpage->pagebuf;
 		return(error);
 	}
 
-	if (fpage->nextfree == PF_PAGE_USED){
+	if (PFpageUsed(fd,pagenum,fpage)){
 		/* page is used*/
 		*pagebuf = (char *)fpage->pagebuf;
 
 		///
-		PFstats.logicalReads++;
+		PFfstat(fd,logicalReads,1);
 		// PFstats.pagesAccessed++;
 		return(PFE_OK);
 	}
@@ -602,9 +3146,124 @@ PFfpage *fpage;
 	}
 }
 
-PF_AllocPage(fd,pagenum,pagebuf)
+PF_GetThisPage(fd,pagenum,pagebuf)
+int fd;		/* file descriptor */
+long pagenum;	/* page number to read */
+char **pagebuf;	/* pointer to pointer to page data */
+/****************************************************************************
+SPECIFICATIONS:
+	PFgetThisPage(), leaving the priority of the page alone.
+*****************************************************************************/
+{
+	return(PFgetThisPage(fd,pagenum,pagebuf,PF_HINT_NONE));
+}
+
+PF_GetThisPageHint(fd,pagenum,pagebuf,prio)
+int fd;		/* file descriptor */
+long pagenum;	/* page number to read */
+char **pagebuf;	/* pointer to pointer to page data */
+int prio;	/* PF_PRIO_LOW or PF_PRIO_HIGH */
+/****************************************************************************
+SPECIFICATIONS:
+	PFgetThisPage(), and give the page priority "prio" in the buffer:
+	a PF_PRIO_HIGH page is replaced only when no PF_PRIO_LOW page
+	can be, whatever the replacement policy of the file. Pages are
+	PF_PRIO_LOW unless asked otherwise.
+
+RETURN VALUE:
+	As PF_GetThisPage().
+*****************************************************************************/
+{
+	return(PFgetThisPage(fd,pagenum,pagebuf,
+			(prio == PF_PRIO_HIGH)? PF_HINT_HIGH: PF_HINT_LOW));
+}
+
+PF_SetPagePriority(fd,pagenum,prio)
+int fd;		/* file descriptor */
+long pagenum;	/* page number */
+int prio;	/* PF_PRIO_LOW or PF_PRIO_HIGH */
+/****************************************************************************
+SPECIFICATIONS:
+	Give page "pagenum" of file "fd", which the caller has fixed,
+	priority "prio" in the buffer (see PF_GetThisPageHint()). This is
+	for a page whose priority is only known once it has been read.
+
+RETURN VALUE:
+	PFE_OK	if no error.
+	PF error code if error.
+*****************************************************************************/
+{
+	if (PFinvalidFd(fd)){
+		PFerrno = PFE_FD;
+		return(PFerrno);
+	}
+	fd = PFfileOf(fd);
+	if (PFinvalidPagenum(fd,pagenum)){
+		PFerrno = PFE_INVALIDPAGE;
+		return(PFerrno);
+	}
+	if (PFmapped(fd))
+		/* the kernel decides */
+		return(PFE_OK);
+	return(PFbufSetPriority(fd,pagenum,prio == PF_PRIO_HIGH));
+}
+
+static PFallocMapped(fd,hint,pagenum,pagebuf)
+int fd;		/* file descriptor, with an allocation bitmap */
+long hint;	/* page to allocate near, or -1 */
+long *pagenum;	/* page number */
+char **pagebuf;	/* pointer to pointer to page buffer*/
+/****************************************************************************
+SPECIFICATIONS:
+	PFallocPage() for a file with an allocation bitmap. With a "hint",
+	the page is taken near page "hint"; if there is no free page close
+	enough, from what is left of the last extent of the file, or else
+	from a new extent at the end of the file. An extent is thus only
+	added once the last one is used up, and the file does not grow
+	by a whole extent for each page. Without a "hint" it is the first
+	free page, or one more page at the end of the file.
+
+RETURN VALUE:
+	PFE_OK	if ok
+	PF error codes if not ok.
+*****************************************************************************/
+{
+PFfpage *fpage;	/* pointer to file page */
+int error;
+
+	if (hint >= 0){
+		if ((*pagenum=PFbitmapFindNear(fd,hint)) < 0)
+			*pagenum = PFbitmapFindTail(fd);
+	}
+	else	*pagenum = PFbitmapFindFree(fd);
+	if (*pagenum < 0 && (*pagenum=PFbitmapExtend(fd,
+			(hint >= 0)? PF_EXTENT_PAGES: 1)) < 0)
+		return(*pagenum);
+
+	/* take a buffer page for it. It may still be in the buffer, if
+	the cleaner was writing it out when it was freed */
+	if ((error=PFbufAlloc(fd,*pagenum,&fpage,PFwritefcn)) == PFE_PAGEINBUF)
+		error = PFbufGet(fd,*pagenum,&fpage,PFreadfcn,PFwritefcn,
+							PF_HINT_EXCL);
+	if (error != PFE_OK)
+		return(error);
+	if ((error=PFbufUsed(fd,*pagenum))!= PFE_OK){
+		printf("internal error: PFallocMapped()\n");
+		exit(1);
+	}
+
+	PFbitmapSet(fd,*pagenum,TRUE);
+
+	fpage->nextfree = PF_PAGE_USED;
+	*pagebuf = fpage->pagebuf;
+	PFfstat(fd,logicalWrites,1);
+	return(PFE_OK);
+}
+
+static PFallocPage(fd,hint,pagenum,pagebuf)
 int fd;		/* file descriptor */
-int *pagenum;	/* page number */
+long hint;	/* page to allocate near, or -1 */
+long *pagenum;	/* page number */
 char **pagebuf;	/* pointer to pointer to page buffer*/
 /****************************************************************************
 SPECIFICATIONS:
@@ -619,6 +3278,11 @@ RETURN VALUE:
 	PFE_OK	if ok
 	PF error codes if not ok.
 
+IMPLEMENTATION NOTES:
+	In a file with an allocation bitmap the first free page is
+	taken, or one near "hint". Its old contents don't matter, so it
+	is not read in. A file with a free list has no way to tell which
+	free page is near another one, and ignores "hint".
 *****************************************************************************/
 {
 PFfpage *fpage;	/* pointer to file page */
@@ -628,27 +3292,41 @@ int error;
 		PFerrno= PFE_FD;
 		return(PFerrno);
 	}
+	fd = PFfileOf(fd);
+
+	if (PFmapped(fd)){
+		PFerrno = PFE_READONLY;
+		return(PFerrno);
+	}
+
+	if (PFftab(fd).usedmap != NULL)
+		return(PFallocMapped(fd,hint,pagenum,pagebuf));
 
-	if (PFftab[fd].hdr.firstfree != PF_PAGE_LIST_END){
+	if (PFftab(fd).hdr.firstfree != PF_PAGE_LIST_END){
 		/* get a page from the free list */
-		*pagenum = PFftab[fd].hdr.firstfree;
+		*pagenum = PFftab(fd).hdr.firstfree;
 		if ((error=PFbufGet(fd,*pagenum,&fpage,PFreadfcn,
-					PFwritefcn))!= PFE_OK)
+					PFwritefcn,PF_HINT_EXCL))!= PFE_OK)
 			/* can't get the page */
 			return(error);
-		PFftab[fd].hdr.firstfree = fpage->nextfree;
-		PFftab[fd].hdrchanged = TRUE;
+		PFftab(fd).hdr.firstfree = fpage->nextfree;
+		PFftab(fd).hdrchanged = TRUE;
 	}
 	else {
-		/* Free list empty, allocate one more page from the file */
-		*pagenum = PFftab[fd].hdr.numpages;
+		/* Free list empty, allocate one more page from the file.
+		A file with a free list is of a format before PF_FORMAT_V3 */
+		*pagenum = PFftab(fd).hdr.numpages;
+		if (*pagenum >= PF_OLD_MAXPAGES){
+			PFerrno = PFE_FILEFULL;
+			return(PFerrno);
+		}
 		if ((error=PFbufAlloc(fd,*pagenum,&fpage,PFwritefcn))!= PFE_OK)
 			/* can't allocate a page */
 			return(error);
 	
 		/* increment # of pages for this file */
-		PFftab[fd].hdr.numpages++;
-		PFftab[fd].hdrchanged = TRUE;
+		PFftab(fd).hdr.numpages++;
+		PFftab(fd).hdrchanged = TRUE;
 
 		/* mark this page dirty */
 		if ((error=PFbufUsed(fd,*pagenum))!= PFE_OK){
@@ -661,7 +3339,7 @@ int error;
 	/* zero out the page. Seems to be a nice thing to do,
 	at least for debugging. */
 	/*
-	bzero(fpage->pagebuf,PF_PAGE_SIZE);
+	bzero(fpage->pagebuf,PFpageSize(PFftab(fd).hdr.pagesize));
 	*/
 
 	/* Mark the new page used */
@@ -670,19 +3348,69 @@ int error;
 	/* set return value */
 	*pagebuf = fpage->pagebuf;
 
-	PFstats.logicalWrites++;
+	PFfstat(fd,logicalWrites,1);
     // PFstats.pagesAccessed++;
 	
 	return(PFE_OK);
 }
 
-PF_DisposePage(fd,pagenum)
+PF_AllocPage(fd,pagenum,pagebuf)
+int fd;		/* file descriptor */
+long *pagenum;	/* page number */
+char **pagebuf;	/* pointer to pointer to page buffer*/
+/****************************************************************************
+SPECIFICATIONS:
+	PFallocPage() with the file table latched, so that threads
+	allocating pages do not take the same page.
+*****************************************************************************/
+{
+int ret;
+
+	pthread_mutex_lock(&PFftablatch);
+	ret = PFallocPage(fd,-1L,pagenum,pagebuf);
+	pthread_mutex_unlock(&PFftablatch);
+	return(ret);
+}
+
+PF_AllocPageNear(fd,hint,pagenum,pagebuf)
+int fd;		/* file descriptor */
+long hint;	/* page the new one is to be next to */
+long *pagenum;	/* page number */
+char **pagebuf;	/* pointer to pointer to page buffer*/
+/****************************************************************************
+SPECIFICATIONS:
+	PF_AllocPage(), placing the new page close to page "hint" of the
+	file, if possible: right after it, or else within PF_EXTENT_PAGES
+	pages of it. Pages that are read one after the other, such as
+	the leaves of a B+ tree, can so be kept together in the file.
+	Only a file created with PF_CREATE_ALIGNED can do this; other
+	files take the page PF_AllocPage() would.
+
+RETURN VALUE:
+	As PF_AllocPage(). PFE_INVALIDPAGE if "hint" is not a page of the
+	file.
+*****************************************************************************/
+{
+int ret;
+
+	pthread_mutex_lock(&PFftablatch);
+	if (PFinvalidFd(fd))
+		ret = PFerrno = PFE_FD;
+	else if (PFinvalidPagenum(PFfileOf(fd),hint))
+		ret = PFerrno = PFE_INVALIDPAGE;
+	else	ret = PFallocPage(fd,hint,pagenum,pagebuf);
+	pthread_mutex_unlock(&PFftablatch);
+	return(ret);
+}
+
+static PFdisposePage(fd,pagenum)
 int fd;		/* file descriptor */
-int pagenum;	/* page number */
+long pagenum;	/* page number */
 /****************************************************************************
 SPECIFICATIONS:
 	Dispose the page numbered "pagenum" of the file "fd".
-	Only a page that is not fixed in the buffer can be disposed.
+	Only a page that is not fixed in the buffer can be disposed:
+	PFE_PAGEFIXED is returned if anyone holds a pin on it.
 
 AUTHOR: clc
 
@@ -690,6 +3418,10 @@ RETURN VALUE:
 	PFE_OK	if no error.
 	PF error code if error.
 
+IMPLEMENTATION NOTES:
+	In a file with an allocation bitmap the page is only marked free
+	there and dropped from the buffer: it is neither read nor
+	written.
 *****************************************************************************/
 {
 PFfpage *fpage;	/* pointer to file page */
@@ -699,13 +3431,35 @@ int error;
 		PFerrno = PFE_FD;
 		return(PFerrno);
 	}
+	fd = PFfileOf(fd);
 
-	if (PFinvalidPagenum(fd,pagenum)){
+	if (PFinvalidPagenum(fd,pagenum) ||
+			(PFftab(fd).usedmap != NULL && PFisMapPage(fd,pagenum))){
 		PFerrno = PFE_INVALIDPAGE;
 		return(PFerrno);
 	}
 
-	if ((error=PFbufGet(fd,pagenum,&fpage,PFreadfcn,PFwritefcn))!= PFE_OK)
+	if (PFmapped(fd)){
+		PFerrno = PFE_READONLY;
+		return(PFerrno);
+	}
+
+	if (PFftab(fd).usedmap != NULL){
+		if (!PFbitIsSet(fd,pagenum)){
+			/* this page already freed */
+			PFerrno = PFE_PAGEFREE;
+			return(PFerrno);
+		}
+		if ((error=PFbufDiscard(fd,pagenum)) != PFE_OK)
+			return(error);
+		PFbitmapSet(fd,pagenum,FALSE);
+		PFfstat(fd,logicalWrites,1);
+		return(PFE_OK);
+	}
+
+	/* nobody else may be using the page */
+	if ((error=PFbufGet(fd,pagenum,&fpage,PFreadfcn,PFwritefcn,
+					PF_HINT_EXCL))!= PFE_OK)
 		/* can't get this page */
 		return(error);
 	
@@ -720,27 +3474,47 @@ int error;
 	}
 
 	/* put this page into the free list */
-	fpage->nextfree = PFftab[fd].hdr.firstfree;
-	PFftab[fd].hdr.firstfree = pagenum;
-	PFftab[fd].hdrchanged = TRUE;
+	fpage->nextfree = PFftab(fd).hdr.firstfree;
+	PFftab(fd).hdr.firstfree = pagenum;
+	PFftab(fd).hdrchanged = TRUE;
 
 	/// disposal is effectively a write since page metadata changed
-    PFstats.logicalWrites++;
+    PFfstat(fd,logicalWrites,1);
     // PFstats.pagesAccessed++;
 
 	/* unfix this page */
 	return(PFbufUnfix(fd,pagenum,TRUE));
 }
 
+PF_DisposePage(fd,pagenum)
+int fd;		/* file descriptor */
+long pagenum;	/* page number */
+/****************************************************************************
+SPECIFICATIONS:
+	PFdisposePage() with the file table latched.
+*****************************************************************************/
+{
+int ret;
+
+	pthread_mutex_lock(&PFftablatch);
+	ret = PFdisposePage(fd,pagenum);
+	pthread_mutex_unlock(&PFftablatch);
+	return(ret);
+}
+
 PF_UnfixPage(fd,pagenum,dirty)
 int fd;	/* file descriptor */
-int pagenum;	/* page number */
+long pagenum;	/* page number */
 int dirty;	/* true if file is dirty */
 /****************************************************************************
 SPECIFICATIONS:
 	Tell the Paged File Interface that the page numbered "pagenum"
-	of the file "fd" is no longer needed in the buffer.
+	of the file "fd" is no longer needed in the buffer, by dropping
+	one pin on it. The page can be replaced once all of its pins
+	are dropped.
 	Set the variable "dirty" to TRUE if page has been modified.
+	For a file opened with PF_OPEN_MMAP nothing was fixed: this
+	only checks the arguments, and a dirty page is PFE_READONLY.
 
 AUTHOR: clc
 
@@ -755,17 +3529,26 @@ RETURN VALUE:
 		PFerrno = PFE_FD;
 		return(PFerrno);
 	}
+	fd = PFfileOf(fd);
 
 	if (PFinvalidPagenum(fd,pagenum)){
 		PFerrno = PFE_INVALIDPAGE;
 		return(PFerrno);
 	}
 
+	if (PFmapped(fd)){
+		/* nothing was fixed */
+		if (dirty){
+			PFerrno = PFE_READONLY;
+			return(PFerrno);
+		}
+		return(PFE_OK);
+	}
+
 	///
 	if (dirty) {
-        PFstats.logicalWrites++;
+        PFfstat(fd,logicalWrites,1);
     }
-    PFstats.pagesAccessed++;
 
 	return(PFbufUnfix(fd,pagenum,dirty));
 }
@@ -791,7 +3574,15 @@ static char *PFerrormsg[]={
 "page already unfixed",
 "new page to be allocated already in buffer",
 "hash table entry not found",
-"page already in hash table"
+"page already in hash table",
+"page cleaner already running or not running, or bad water marks",
+"unknown I/O backend",
+"file not aligned for direct I/O, or direct I/O not supported",
+"file is mapped read-only",
+"bad buffer quota",
+"bad page size",
+"file has as many pages as its format can count",
+"file is compressed: no direct I/O nor mapping"
 };
 
 void PF_PrintError(s)
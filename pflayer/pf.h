@@ -1,4 +1,6 @@
 /* pf.h: externs and error codes for Paged File Interface*/
+#ifndef PF_H
+#define PF_H
 #ifndef TRUE
 #define TRUE 1		
 #endif
@@ -30,12 +32,55 @@
 #define PFE_HASHNOTFOUND -18	/* hash table entry not found */
 #define PFE_HASHPAGEEXIST -19	/* page already exist in hash table */
 
+#define PFE_CLEANER	-20	/* page cleaner already running or not running,
+				or bad water marks */
+#define PFE_IOBACKEND	-21	/* unknown I/O backend */
+#define PFE_DIRECT	-22	/* file not aligned for direct I/O, or
+				direct I/O not supported */
+#define PFE_READONLY	-23	/* file is mapped read-only (PF_OPEN_MMAP) */
+#define PFE_QUOTA	-24	/* bad buffer quota */
+#define PFE_PAGESIZE	-25	/* bad page size */
+#define PFE_FILEFULL	-26	/* file has as many pages as its format can
+				count */
+#define PFE_COMPRESSED	-27	/* file is compressed: no PF_OPEN_DIRECT nor
+				PF_OPEN_MMAP */
 
-/* page size */
+
+/* page size, and the largest page size of PF_CreateFileSized() */
 #define PF_PAGE_SIZE	4096
+#define PF_MAX_PAGE_SIZE 65536
+
+/* flags of PF_CreateFileFlags() */
+#define PF_CREATE_ALIGNED 0x1	/* page-aligned layout, for PF_OPEN_DIRECT */
+#define PF_CREATE_COMPRESSED 0x2 /* pages compressed on disk */
+
+/* formats of paged files, see PF_GetFormat() and pftypes.h */
+#define PF_FORMAT_PACKED  1	/* 8 byte header, pages sizeof(PFfpage) apart */
+#define PF_FORMAT_ALIGNED 2	/* header block, pages PF_SLOT_SIZE apart */
+#define PF_FORMAT_MAPPED  3	/* aligned, with an allocation bitmap */
+#define PF_FORMAT_V2	  4	/* whole pages, bitmap in map blocks */
+#define PF_FORMAT_V3	  5	/* PF_FORMAT_V2 with 64 bit page numbers */
+#define PF_FORMAT_COMPRESSED 6	/* compressed pages in slots, page map */
+
+/* flags of PF_OpenFileFlags() */
+#define PF_OPEN_DIRECT	0x1	/* O_DIRECT: no double caching in the kernel */
+#define PF_OPEN_MMAP	0x2	/* read-only, pages straight from a mapping */
+
+/* page priorities, see PF_GetThisPageHint() */
+#define PF_PRIO_LOW	0	/* replaced first (the default) */
+#define PF_PRIO_HIGH	1	/* replaced once no low priority page can be */
+
+/* I/O backends, see PF_SetIOBackend() */
+#define PF_IO_SYNC	0	/* blocking preadv/pwritev, one at a time */
+#define PF_IO_THREADS	1	/* preadv/pwritev by a pool of threads */
+#define PF_IO_URING	2	/* io_uring, or PF_IO_THREADS without it */
+
+/* default water marks of the page cleaner, in % of the buffer that is dirty */
+#define PF_CLEAN_LOWWATER	10
+#define PF_CLEAN_HIGHWATER	30
 
 /* externs from the PF layer */
-extern int PFerrno;		/* error number of last error */
+extern __thread int PFerrno;	/* error number of last error, per thread */
 extern void PF_Init();
 extern void PF_PrintError();
 
@@ -44,10 +89,89 @@ typedef struct { // statistics data
     long logicalWrites;
     long physicalReads;
     long physicalWrites;
-    long pagesAccessed;
+    long pagesAccessed;    // logicalReads + logicalWrites
+    long bufferHits;       // page requests found in the buffer
+    long bufferMisses;     // page requests read from the file
+    double hitRatio;       // bufferHits / (bufferHits + bufferMisses)
+    long arcGhostRecentHits;   // ARC misses on pages remembered in B1
+    long arcGhostFrequentHits; // ARC misses on pages remembered in B2
+    long arcTarget;        // current ARC target size of T1
+    long foregroundDirtyEvictions; // dirty victims written out by a miss
+    long backgroundCleans;         // dirty pages written out by the page cleaner
+    long readAheadHits;    // pages read ahead that were then asked for
+    long readAheadWasted;  // pages read ahead that were evicted unused
+    long compressWrites;   // pages written to compressed files
+    long compressRawBytes;    // their bytes in the buffer
+    long compressStoredBytes; // their bytes in the files
+    double compressRatio;  // compressRawBytes / compressStoredBytes
+    long decompressReads;  // pages read from compressed files
+    long decompressNanos;  // time spent decompressing them
+    double decompressNsPerPage; // decompressNanos / decompressReads
+    long zcacheHits;       // misses served by the compressed page cache
+    long zcacheMisses;     // misses it could not serve, when it is on
+    long zcacheInserts;    // evicted pages put into it
+    long zcacheEvictions;  // pages it dropped to stay within its budget
+    double seconds;        // when taken (CLOCK_MONOTONIC), or time between
+                           // the two snapshots of PF_DiffStats()
 } PF_Stats;
 
+typedef struct { // statistics of a file, or of the files of a policy
+    long logicalReads;
+    long logicalWrites;
+    long physicalReads;
+    long physicalWrites;
+    long bufferHits;       // page requests found in the buffer
+    long bufferMisses;     // page requests read from the file
+    double hitRatio;       // bufferHits / (bufferHits + bufferMisses)
+    long evictions;        // pages of the file evicted to make room
+    long dirtyEvictions;   // those written out first
+    long readAheadHits;    // pages read ahead that were then asked for
+    long readAheadWasted;  // pages read ahead that were evicted unused
+    long pinnedFrames;     // frames of the file pinned now
+    long pinnedHighWater;  // most frames of the file pinned at once, by
+                           // each thread, added up
+    double seconds;        // as in PF_Stats
+} PF_FileStats;
+
 extern PF_Stats PFstats;
 void PF_GetStats(PF_Stats *);
 void PF_ResetStats();
-int PF_MarkDirty(int, int);
\ No newline at end of file
+void PF_DiffStats(PF_Stats *, PF_Stats *, PF_Stats *);
+int PF_GetFileStats(int, PF_FileStats *);
+int PF_GetPolicyStats(char *, PF_FileStats *);
+void PF_DiffFileStats(PF_FileStats *, PF_FileStats *, PF_FileStats *);
+
+/* page numbers are long */
+int PF_CreateFile(char *);
+int PF_DestroyFile(char *);
+int PF_OpenFile(char *, char *);
+int PF_CloseFile(int);
+int PF_GetFirstPage(int, long *, char **);
+int PF_GetNextPage(int, long *, char **);
+int PF_GetThisPage(int, long, char **);
+int PF_AllocPage(int, long *, char **);
+int PF_DisposePage(int, long);
+int PF_UnfixPage(int, long, int);
+int PF_MarkDirty(int, long);
+int PF_ScanHint(int, int);
+int PF_FlushFile(int);
+int PF_CreateFileFlags(char *, int);
+int PF_CreateFileSized(char *, int, int);
+int PF_GetPageSize(int);
+int PF_GetFormat(int);
+int PF_ConvertFile(char *, char *);
+int PF_ConvertFileFlags(char *, char *, int);
+int PF_OpenFileFlags(char *, char *, int);
+int PF_SetFileQuota(int, int, int);
+int PF_GetFileFrames(int);
+int PF_GetThisPageHint(int, long, char **, int);
+int PF_SetPagePriority(int, long, int);
+int PF_GetPages(int, long *, int, char **);
+int PF_AllocPageNear(int, long, long *, char **);
+int PF_SetIOBackend(int);
+int PF_StartCleaner(int, int);
+int PF_StopCleaner();
+int PF_SetCompressedCache(long);
+int set_buffer_size(int); // raises the max # of buffers
+
+#endif /* PF_H */
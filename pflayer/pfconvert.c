@@ -0,0 +1,34 @@
+/* pfconvert.c: convert a paged file to format PF_FORMAT_V3 (see pftypes.h),
+offline.
+	pfconvert [-z] oldfile newfile
+Page numbers are kept, so that an index or a heap file that refers to
+pages by number can be used as it is once "newfile" replaces "oldfile".
+With -z, "newfile" is compressed (PF_CREATE_COMPRESSED). */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "pf.h"
+
+int main(argc,argv)
+int argc;
+char *argv[];
+{
+int flags;	/* PF_CREATE_xxx of the new file */
+
+	flags = PF_CREATE_ALIGNED;
+	if (argc == 4 && strcmp(argv[1],"-z") == 0){
+		flags = PF_CREATE_COMPRESSED;
+		argc--;
+		argv++;
+	}
+	if (argc != 3){
+		fprintf(stderr,"usage: %s [-z] oldfile newfile\n",argv[0]);
+		exit(1);
+	}
+	PF_Init();
+	if (PF_ConvertFileFlags(argv[1],argv[2],flags) != PFE_OK){
+		PF_PrintError(argv[1]);
+		exit(1);
+	}
+	exit(0);
+}
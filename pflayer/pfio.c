@@ -0,0 +1,472 @@
+/* pfio.c: page I/O backends. All the reads and writes of pages go
+through PFioSubmitWait(), which takes a batch of requests, starts them
+all and returns when all of them are over, so that a caller with several
+pages to fetch or write out waits only once. Three backends are
+provided:
+	PF_IO_SYNC	the requests are done one after the other with
+			preadv()/pwritev().
+	PF_IO_URING	the requests are submitted to an io_uring of the
+			calling thread with one system call, and reaped
+			as they complete. The rings are set up with the raw
+			system calls, there is no need for liburing.
+	PF_IO_THREADS	the requests are handed to a pool of
+			PF_IO_NTHREADS threads doing preadv()/pwritev().
+			This is used when io_uring is not available.
+The interface routines are: PFioSetBackend() and PFioSubmitWait(). */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/types.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#ifdef __NR_io_uring_setup
+#include <linux/io_uring.h>
+#endif
+#include "pf.h"
+#include "pftypes.h"
+
+static int PFiobackend = PF_IO_URING;	/* backend in use */
+
+/****************************** io_uring *********************************/
+#ifdef __NR_io_uring_setup
+
+/* io_uring of a thread: the queues shared with the kernel */
+typedef struct PFio_ring {
+	int fd;			/* io_uring file descriptor */
+	unsigned *sqhead;	/* submission queue head, moved by the kernel */
+	unsigned *sqtail;	/* submission queue tail, moved by us */
+	unsigned sqmask;	/* mask of the submission queue indexes */
+	unsigned sqentries;	/* # of entries of the submission queue */
+	unsigned *sqarray;	/* indexes of the submitted sqes */
+	struct io_uring_sqe *sqes; /* submission queue entries */
+	unsigned *cqhead;	/* completion queue head, moved by us */
+	unsigned *cqtail;	/* completion queue tail, moved by the kernel */
+	unsigned cqmask;	/* mask of the completion queue indexes */
+	struct io_uring_cqe *cqes; /* completion queue entries */
+	void *sqmap,*cqmap;	/* mapped queues */
+	size_t sqmapsize,cqmapsize,sqessize; /* and their sizes */
+} PFio_ring;
+
+static __thread PFio_ring *PFmyring = NULL; /* ring of this thread */
+static pthread_key_t PFringkey;		/* to close the ring at thread exit */
+static pthread_once_t PFringonce = PTHREAD_ONCE_INIT;
+
+static void PFioRingFree(arg)
+void *arg;	/* ring to free */
+/****************************************************************************
+SPECIFICATIONS:
+	Unmap and close the io_uring "arg". Called when the thread that
+	set it up exits.
+*****************************************************************************/
+{
+PFio_ring *ring = (PFio_ring *)arg;
+
+	munmap(ring->sqes,ring->sqessize);
+	if (ring->cqmap != ring->sqmap)
+		munmap(ring->cqmap,ring->cqmapsize);
+	munmap(ring->sqmap,ring->sqmapsize);
+	close(ring->fd);
+	free((char *)ring);
+}
+
+static void PFioRingKey()
+{
+	pthread_key_create(&PFringkey,PFioRingFree);
+}
+
+static PFio_ring *PFioRing()
+/****************************************************************************
+SPECIFICATIONS:
+	Return the io_uring of the calling thread, set up with PF_IO_DEPTH
+	entries the first time.
+
+RETURN VALUE:
+	The ring, or NULL if io_uring can't be set up.
+*****************************************************************************/
+{
+struct io_uring_params p;
+PFio_ring *ring;
+char *sq,*cq;
+
+	if (PFmyring != NULL)
+		return(PFmyring);
+
+	if ((ring=(PFio_ring *)malloc(sizeof(PFio_ring))) == NULL)
+		return(NULL);
+	memset((char *)&p,0,sizeof(p));
+	if ((ring->fd=syscall(__NR_io_uring_setup,PF_IO_DEPTH,&p)) < 0){
+		free((char *)ring);
+		return(NULL);
+	}
+
+	/* map the submission and completion queues, in one go if the
+	kernel allows it */
+	ring->sqmapsize = p.sq_off.array + p.sq_entries*sizeof(unsigned);
+	ring->cqmapsize = p.cq_off.cqes +
+				p.cq_entries*sizeof(struct io_uring_cqe);
+	if ((p.features & IORING_FEAT_SINGLE_MMAP) &&
+					ring->cqmapsize > ring->sqmapsize)
+		ring->sqmapsize = ring->cqmapsize;
+	ring->sqmap = mmap(NULL,ring->sqmapsize,PROT_READ|PROT_WRITE,
+			MAP_SHARED|MAP_POPULATE,ring->fd,IORING_OFF_SQ_RING);
+	if (ring->sqmap == MAP_FAILED){
+		close(ring->fd);
+		free((char *)ring);
+		return(NULL);
+	}
+	if (p.features & IORING_FEAT_SINGLE_MMAP)
+		ring->cqmap = ring->sqmap;
+	else if ((ring->cqmap=mmap(NULL,ring->cqmapsize,PROT_READ|PROT_WRITE,
+			MAP_SHARED|MAP_POPULATE,ring->fd,IORING_OFF_CQ_RING))
+							== MAP_FAILED){
+		munmap(ring->sqmap,ring->sqmapsize);
+		close(ring->fd);
+		free((char *)ring);
+		return(NULL);
+	}
+	ring->sqessize = p.sq_entries*sizeof(struct io_uring_sqe);
+	if ((ring->sqes=(struct io_uring_sqe *)mmap(NULL,ring->sqessize,
+			PROT_READ|PROT_WRITE,MAP_SHARED|MAP_POPULATE,
+			ring->fd,IORING_OFF_SQES)) == MAP_FAILED){
+		if (ring->cqmap != ring->sqmap)
+			munmap(ring->cqmap,ring->cqmapsize);
+		munmap(ring->sqmap,ring->sqmapsize);
+		close(ring->fd);
+		free((char *)ring);
+		return(NULL);
+	}
+
+	sq = (char *)ring->sqmap;
+	ring->sqhead = (unsigned *)(sq + p.sq_off.head);
+	ring->sqtail = (unsigned *)(sq + p.sq_off.tail);
+	ring->sqmask = *(unsigned *)(sq + p.sq_off.ring_mask);
+	ring->sqentries = *(unsigned *)(sq + p.sq_off.ring_entries);
+	ring->sqarray = (unsigned *)(sq + p.sq_off.array);
+	cq = (char *)ring->cqmap;
+	ring->cqhead = (unsigned *)(cq + p.cq_off.head);
+	ring->cqtail = (unsigned *)(cq + p.cq_off.tail);
+	ring->cqmask = *(unsigned *)(cq + p.cq_off.ring_mask);
+	ring->cqes = (struct io_uring_cqe *)(cq + p.cq_off.cqes);
+
+	pthread_once(&PFringonce,PFioRingKey);
+	pthread_setspecific(PFringkey,ring);
+	PFmyring = ring;
+	return(ring);
+}
+
+static PFioUringReap(ring,reqs)
+PFio_ring *ring;	/* ring of the thread */
+PFio_req *reqs;		/* requests of the batch in flight */
+/****************************************************************************
+SPECIFICATIONS:
+	Reap the completions in the completion queue of "ring": set the
+	result of the request of "reqs" each one is for.
+
+RETURN VALUE:
+	The # of completions reaped.
+*****************************************************************************/
+{
+struct io_uring_cqe *cqe;
+unsigned head;
+int n;
+
+	n = 0;
+	head = *ring->cqhead;
+	while (head != __atomic_load_n(ring->cqtail,__ATOMIC_ACQUIRE)){
+		cqe = &ring->cqes[head & ring->cqmask];
+		reqs[cqe->user_data].res = cqe->res;
+		head++;
+		n++;
+	}
+	__atomic_store_n(ring->cqhead,head,__ATOMIC_RELEASE);
+	return(n);
+}
+
+static PFioUring(ring,reqs,n)
+PFio_ring *ring;	/* ring of the thread */
+PFio_req *reqs;		/* requests */
+int n;			/* # of requests */
+/****************************************************************************
+SPECIFICATIONS:
+	Do the "n" requests with io_uring "ring": queue as many as the
+	submission queue takes, submit them and wait for at least one
+	completion with a single io_uring_enter(), reap what completed,
+	and go on until every request is over.
+	If io_uring_enter() fails, the requests not submitted yet are
+	taken back from the submission queue, and those in flight are
+	waited for: their completions refer to "reqs", which the caller
+	may free once we return.
+
+RETURN VALUE:
+	PFE_OK	if all the requests were done (reqs[i].res tells how)
+	PFE_UNIX	if io_uring_enter() failed.
+*****************************************************************************/
+{
+struct io_uring_sqe *sqe;
+unsigned tail;
+int queued;	/* # of requests queued so far */
+int done;	/* # of requests completed so far */
+int tosubmit;	/* # of requests queued but not submitted */
+int ret;
+
+	queued = done = tosubmit = 0;
+	while (done < n){
+		/* fill the submission queue */
+		tail = *ring->sqtail;
+		while (queued < n && queued - done < (int)ring->sqentries){
+			sqe = &ring->sqes[tail & ring->sqmask];
+			memset((char *)sqe,0,sizeof(*sqe));
+			sqe->opcode = reqs[queued].write? IORING_OP_WRITEV:
+							IORING_OP_READV;
+			sqe->fd = reqs[queued].unixfd;
+			sqe->addr = (unsigned long)reqs[queued].iov;
+			sqe->len = reqs[queued].iovcnt;
+			sqe->off = reqs[queued].offset;
+			sqe->user_data = queued;
+			ring->sqarray[tail & ring->sqmask] =
+						tail & ring->sqmask;
+			tail++;
+			queued++;
+			tosubmit++;
+		}
+		__atomic_store_n(ring->sqtail,tail,__ATOMIC_RELEASE);
+
+		/* submit, and wait for one completion */
+		ret = syscall(__NR_io_uring_enter,ring->fd,tosubmit,1,
+					IORING_ENTER_GETEVENTS,NULL,0);
+		if (ret < 0){
+			if (errno == EINTR)
+				continue;
+			/* the kernel has not seen the requests not
+			submitted: take them back */
+			__atomic_store_n(ring->sqtail,tail-tosubmit,
+							__ATOMIC_RELEASE);
+			queued -= tosubmit;
+			/* wait for the others */
+			done += PFioUringReap(ring,reqs);
+			while (done < queued){
+				if (syscall(__NR_io_uring_enter,ring->fd,0,1,
+					IORING_ENTER_GETEVENTS,NULL,0) < 0 &&
+								errno != EINTR)
+					/* can't wait: let the kernel run */
+					sched_yield();
+				done += PFioUringReap(ring,reqs);
+			}
+			PFerrno = PFE_UNIX;
+			return(PFerrno);
+		}
+		tosubmit -= ret;
+
+		done += PFioUringReap(ring,reqs);
+	}
+	return(PFE_OK);
+}
+#endif /* __NR_io_uring_setup */
+
+/*************************** thread pool *********************************/
+
+/* a request handed to the pool */
+typedef struct PFio_job {
+	PFio_req *req;		/* the request */
+	int *left;		/* # of requests of its batch not done yet */
+	struct PFio_job *next;	/* next job in the queue */
+} PFio_job;
+
+static PFio_job *PFiojobs = NULL;	/* jobs waiting for a thread */
+static PFio_job *PFiolastjob = NULL;	/* last of them */
+static int PFiothreads = 0;		/* # of threads in the pool */
+static pthread_mutex_t PFiolatch = PTHREAD_MUTEX_INITIALIZER;
+					/* latch of the queue */
+static pthread_cond_t PFiowork = PTHREAD_COND_INITIALIZER;
+					/* a job was queued */
+static pthread_cond_t PFiodone = PTHREAD_COND_INITIALIZER;
+					/* a batch is over */
+
+static void PFioDo(req)
+PFio_req *req;		/* request to do */
+/****************************************************************************
+SPECIFICATIONS:
+	Do request "req" with preadv() or pwritev(), and set its result.
+*****************************************************************************/
+{
+	req->res = req->write?
+		pwritev(req->unixfd,req->iov,req->iovcnt,req->offset):
+		preadv(req->unixfd,req->iov,req->iovcnt,req->offset);
+	if (req->res < 0)
+		req->res = -errno;
+}
+
+static void *PFioWorker(arg)
+void *arg;	/* not used */
+/****************************************************************************
+SPECIFICATIONS:
+	Body of a thread of the pool: do the jobs of the queue, forever.
+*****************************************************************************/
+{
+PFio_job *job;
+
+	pthread_mutex_lock(&PFiolatch);
+	for (;;){
+		while (PFiojobs == NULL)
+			pthread_cond_wait(&PFiowork,&PFiolatch);
+		job = PFiojobs;
+		PFiojobs = job->next;
+		pthread_mutex_unlock(&PFiolatch);
+
+		PFioDo(job->req);
+
+		pthread_mutex_lock(&PFiolatch);
+		if (--*job->left == 0)
+			pthread_cond_broadcast(&PFiodone);
+	}
+	return(NULL);
+}
+
+static PFioPool(reqs,n)
+PFio_req *reqs;		/* requests */
+int n;			/* # of requests */
+/****************************************************************************
+SPECIFICATIONS:
+	Do the "n" requests with the thread pool, starting the threads
+	the first time, and wait for all of them. A single request is
+	done by the caller itself.
+
+RETURN VALUE:
+	PFE_OK	if all the requests were done (reqs[i].res tells how)
+	PFE_NOMEM	if no memory.
+*****************************************************************************/
+{
+PFio_job *jobs;
+pthread_t tid;
+int left;	/* # of requests not done yet */
+int i;
+
+	if (n == 1){
+		PFioDo(&reqs[0]);
+		return(PFE_OK);
+	}
+
+	if ((jobs=(PFio_job *)malloc(n*sizeof(PFio_job))) == NULL){
+		PFerrno = PFE_NOMEM;
+		return(PFerrno);
+	}
+
+	pthread_mutex_lock(&PFiolatch);
+	while (PFiothreads < PF_IO_NTHREADS &&
+			pthread_create(&tid,NULL,PFioWorker,NULL) == 0){
+		pthread_detach(tid);
+		PFiothreads++;
+	}
+
+	/* queue the jobs, and wait */
+	left = n;
+	for (i=0; i < n; i++){
+		jobs[i].req = &reqs[i];
+		jobs[i].left = &left;
+		jobs[i].next = NULL;
+		if (PFiojobs == NULL)
+			PFiojobs = &jobs[i];
+		else	PFiolastjob->next = &jobs[i];
+		PFiolastjob = &jobs[i];
+	}
+	pthread_cond_broadcast(&PFiowork);
+	while (left > 0)
+		pthread_cond_wait(&PFiodone,&PFiolatch);
+	pthread_mutex_unlock(&PFiolatch);
+
+	free((char *)jobs);
+	return(PFE_OK);
+}
+
+/************************* Interface to the PF layer *********************/
+
+PFioSetBackend(backend)
+int backend;	/* PF_IO_xxx */
+/****************************************************************************
+SPECIFICATIONS:
+	Do the page I/O with "backend" from now on. PF_IO_URING falls
+	back to PF_IO_THREADS if io_uring can't be set up.
+
+RETURN VALUE:
+	The backend in use.
+*****************************************************************************/
+{
+	if (backend == PF_IO_URING){
+#ifdef __NR_io_uring_setup
+		if (PFioRing() == NULL)
+#endif
+			backend = PF_IO_THREADS;
+	}
+	PFiobackend = backend;
+	return(backend);
+}
+
+PFioSubmitWait(reqs,n,write)
+PFio_req *reqs;		/* requests */
+int n;			/* # of requests */
+int write;		/* TRUE if the requests are writes */
+/****************************************************************************
+SPECIFICATIONS:
+	Start the "n" requests "reqs" with the backend in use, and wait
+	until they are all over. reqs[i].res is set to the # of bytes
+	transferred, or to -errno.
+
+RETURN VALUE:
+	PFE_OK	if every request transferred all of its bytes.
+	PFE_UNIX	if a request failed.
+	PFE_INCOMPLETEREAD or PFE_INCOMPLETEWRITE if a request came out
+		short.
+	PFE_NOMEM	if no memory.
+*****************************************************************************/
+{
+#ifdef __NR_io_uring_setup
+PFio_ring *ring;
+#endif
+int error;
+long len;	/* # of bytes of a request */
+int i,j;
+
+	for (i=0; i < n; i++)
+		reqs[i].write = write;
+
+	switch (PFiobackend){
+#ifdef __NR_io_uring_setup
+	case PF_IO_URING:
+		if ((ring=PFioRing()) != NULL){
+			error = PFioUring(ring,reqs,n);
+			break;
+		}
+		/* no io_uring for this thread */
+#endif
+	case PF_IO_THREADS:
+		error = PFioPool(reqs,n);
+		break;
+	default:
+		for (i=0; i < n; i++)
+			PFioDo(&reqs[i]);
+		error = PFE_OK;
+	}
+	if (error != PFE_OK)
+		return(error);
+
+	/* see how it went */
+	for (i=0; i < n; i++){
+		for (len=0, j=0; j < reqs[i].iovcnt; j++)
+			len += reqs[i].iov[j].iov_len;
+		if (reqs[i].res < 0){
+			errno = -reqs[i].res;
+			PFerrno = PFE_UNIX;
+			return(PFerrno);
+		}
+		if (reqs[i].res != len){
+			PFerrno = write? PFE_INCOMPLETEWRITE: PFE_INCOMPLETEREAD;
+			return(PFerrno);
+		}
+	}
+	return(PFE_OK);
+}
@@ -0,0 +1,263 @@
+/* pflz.c: the codec of compressed files (see PF_FORMAT_COMPRESSED in
+pftypes.h). A byte oriented LZ77 in the manner of LZ4: fast to decode, and
+good at the runs and repeats of index pages, sorted keys and the blanks
+that pad them. A compressed page is a list of sequences, each of
+
+	token | more literal length | literals | offset | more match length
+
+The high nibble of the token is the # of literals, the low nibble the
+length of the match less PF_LZ_MINMATCH; a nibble of 15 goes on in the
+bytes after it, each adding its value, until one is not 255. The offset
+takes 2 bytes, low byte first, and tells how far back in the page the
+match starts; the match may overlap the bytes it produces. The last
+sequence has literals only, and ends the page. */
+#include <stdio.h>
+#include <string.h>
+#include "pf.h"
+#include "pftypes.h"
+
+#define PF_LZ_MINMATCH	4	/* shortest match */
+#define PF_LZ_HASHLOG	12	/* log2 of the # of entries of the hash */
+#define PF_LZ_SKIP	6	/* after 2^PF_LZ_SKIP misses in a row,
+				step over more bytes at a time */
+
+/* hash of the PF_LZ_MINMATCH bytes at p */
+#define PFlzHash(p)	((PFlzRead32(p) * 2654435761u) >> (32-PF_LZ_HASHLOG))
+
+static unsigned PFlzRead32(p)
+unsigned char *p;
+{
+unsigned v;
+
+	memcpy((char *)&v,(char *)p,sizeof(v));
+	return(v);
+}
+
+static PFlzPutLength(dst,op,cap,len)
+unsigned char *dst;	/* output */
+int op;		/* where the length goes on */
+int cap;	/* size of dst */
+int len;	/* what is left of the length past the nibble */
+/****************************************************************************
+SPECIFICATIONS:
+	Write the bytes that carry on a length of 15 or more, as 255s and
+	a last byte below 255.
+
+RETURN VALUE:
+	Where the output goes on, or -1 if it does not fit in "cap" bytes.
+*****************************************************************************/
+{
+	for (; len >= 255; len -= 255){
+		if (op >= cap)
+			return(-1);
+		dst[op++] = 255;
+	}
+	if (op >= cap)
+		return(-1);
+	dst[op++] = len;
+	return(op);
+}
+
+static PFlzPutSequence(dst,op,cap,lit,nlit,offset,mlen)
+unsigned char *dst;	/* output */
+int op;		/* where the sequence goes */
+int cap;	/* size of dst */
+unsigned char *lit;	/* literals */
+int nlit;	/* # of literals */
+int offset;	/* offset of the match, or 0 for the last sequence */
+int mlen;	/* length of the match */
+/****************************************************************************
+SPECIFICATIONS:
+	Write a sequence: "nlit" literals then a match of "mlen" bytes
+	"offset" bytes back, or the literals alone if "offset" is 0.
+
+RETURN VALUE:
+	Where the output goes on, or -1 if it does not fit in "cap" bytes.
+*****************************************************************************/
+{
+int token;	/* where the token is */
+
+	if (op >= cap)
+		return(-1);
+	token = op++;
+	dst[token] = (nlit < 15? nlit: 15) << 4;
+	if (nlit >= 15 && (op=PFlzPutLength(dst,op,cap,nlit-15)) < 0)
+		return(-1);
+	if (nlit > cap - op)
+		return(-1);
+	memcpy((char *)dst+op,(char *)lit,nlit);
+	op += nlit;
+	if (offset == 0)
+		return(op);
+
+	if (2 > cap - op)
+		return(-1);
+	dst[op++] = offset & 0xff;
+	dst[op++] = offset >> 8;
+	mlen -= PF_LZ_MINMATCH;
+	dst[token] |= (mlen < 15? mlen: 15);
+	if (mlen >= 15 && (op=PFlzPutLength(dst,op,cap,mlen-15)) < 0)
+		return(-1);
+	return(op);
+}
+
+PFlzCompress(src,n,dst,cap)
+unsigned char *src;	/* bytes to compress */
+int n;		/* # of bytes */
+unsigned char *dst;	/* where to put them */
+int cap;	/* # of bytes of dst */
+/****************************************************************************
+SPECIFICATIONS:
+	Compress the "n" bytes at "src" into "dst". Matches are found with
+	a hash of the PF_LZ_MINMATCH bytes at each position, which remembers
+	the last position they were seen at; the match found is taken as
+	long as it goes, with no lazy matching.
+
+RETURN VALUE:
+	The # of bytes put into "dst", or -1 if they would be more than
+	"cap": the bytes are better stored as they are.
+
+IMPLEMENTATION NOTES:
+	The hash keeps positions in an unsigned short. Past 64 KB (a page
+	body in the buffer may be a little larger than a page) a position
+	is taken as the last one before "ip" with the same low 16 bits,
+	so that the offset still fits in 2 bytes; the bytes there are
+	compared anyway.
+*****************************************************************************/
+{
+unsigned short table[1 << PF_LZ_HASHLOG]; /* last position of each hash */
+int ip;		/* position in src */
+int anchor;	/* first literal not written yet */
+int op;		/* position in dst */
+int misses;	/* # of positions without a match since the last one */
+int ref;	/* candidate match */
+int len;	/* its length */
+unsigned h;
+
+	memset((char *)table,0,sizeof(table));
+	ip = anchor = op = misses = 0;
+	while (ip + PF_LZ_MINMATCH <= n){
+		h = PFlzHash(src+ip);
+		ref = table[h] | (ip & ~0xffff);
+		if (ref > ip)
+			ref -= 0x10000;
+		table[h] = ip;
+		if (ref >= ip || PFlzRead32(src+ref) != PFlzRead32(src+ip)){
+			/* no match: the more misses, the longer the step */
+			ip += 1 + (misses++ >> PF_LZ_SKIP);
+			continue;
+		}
+		for (len=PF_LZ_MINMATCH; ip+len < n &&
+					src[ref+len] == src[ip+len]; len++);
+		if ((op=PFlzPutSequence(dst,op,cap,src+anchor,ip-anchor,
+							ip-ref,len)) < 0)
+			return(-1);
+		ip += len;
+		anchor = ip;
+		misses = 0;
+	}
+	return(PFlzPutSequence(dst,op,cap,src+anchor,n-anchor,0,0));
+}
+
+static void PFlzWildCopy(dst,src,n)
+unsigned char *dst;	/* where to copy */
+unsigned char *src;	/* what to copy */
+int n;		/* # of bytes */
+/****************************************************************************
+SPECIFICATIONS:
+	Copy "n" bytes from "src" to "dst" 8 at a time, which is faster for
+	the few bytes of most literals and matches, but reads and writes
+	up to 7 bytes past them: the caller checks that there is room.
+	"src" may be 8 bytes or more before "dst" in the same buffer.
+*****************************************************************************/
+{
+unsigned char *end;
+
+	for (end=dst+n; dst < end; dst += 8, src += 8)
+		memcpy((char *)dst,(char *)src,8);
+}
+
+static PFlzGetLength(src,ip,n,len)
+unsigned char *src;	/* compressed bytes */
+int *ip;	/* where the length goes on; updated */
+int n;		/* # of bytes of src */
+int *len;	/* the length; added to */
+/****************************************************************************
+SPECIFICATIONS:
+	Read the bytes that carry on a length of 15 or more.
+
+RETURN VALUE:
+	0 if ok, -1 if they run past the end of the input.
+*****************************************************************************/
+{
+int b;
+
+	do {
+		if (*ip >= n)
+			return(-1);
+		b = src[(*ip)++];
+		*len += b;
+	} while (b == 255);
+	return(0);
+}
+
+PFlzDecompress(src,n,dst,size)
+unsigned char *src;	/* compressed bytes */
+int n;		/* # of bytes */
+unsigned char *dst;	/* where to put the bytes */
+int size;	/* # of bytes of dst */
+/****************************************************************************
+SPECIFICATIONS:
+	Decompress the "n" bytes at "src", written by PFlzCompress(), into
+	"dst". Every length and offset is checked, so that bytes that are
+	not a compressed page never make it read or write out of bounds.
+
+RETURN VALUE:
+	The # of bytes put into "dst", or -1 if "src" is not a compressed
+	page or would decompress to more than "size" bytes.
+*****************************************************************************/
+{
+int ip;		/* position in src */
+int op;		/* position in dst */
+int token;
+int nlit;	/* # of literals */
+int offset;	/* offset of the match */
+int mlen;	/* length of the match */
+
+	for (ip=op=0; ip < n; ){
+		token = src[ip++];
+		nlit = token >> 4;
+		if (nlit == 15 && PFlzGetLength(src,&ip,n,&nlit) < 0)
+			return(-1);
+		if (nlit > n - ip || nlit > size - op)
+			return(-1);
+		if (nlit + 8 <= n - ip && nlit + 8 <= size - op)
+			PFlzWildCopy(dst+op,src+ip,nlit);
+		else	memcpy((char *)dst+op,(char *)src+ip,nlit);
+		ip += nlit;
+		op += nlit;
+		if (ip == n)
+			/* the last sequence */
+			break;
+
+		if (2 > n - ip)
+			return(-1);
+		offset = src[ip] | (src[ip+1] << 8);
+		ip += 2;
+		mlen = token & 15;
+		if (mlen == 15 && PFlzGetLength(src,&ip,n,&mlen) < 0)
+			return(-1);
+		mlen += PF_LZ_MINMATCH;
+		if (offset == 0 || offset > op || mlen > size - op)
+			return(-1);
+		if (offset >= 8 && mlen + 8 <= size - op){
+			PFlzWildCopy(dst+op,dst+op-offset,mlen);
+			op += mlen;
+		}
+		else	/* a byte at a time: a match closer than 8 bytes
+			repeats the bytes it produces */
+			for (; mlen > 0; mlen--, op++)
+				dst[op] = dst[op-offset];
+	}
+	return(op);
+}
@@ -1,20 +1,154 @@
 /* pftypes.h: declarations for Paged File interface */
+#include <sys/types.h>
+#include <sys/uio.h>
+#include <pthread.h>
 
 /**************************** File Page Decls *********************/
 /* Each file contains a header, which is a integer pointing
 to the first free page, or -1 if no more free pages in the file.
-Followed by this header are the file pages as declared in struct PFfpage */
+Followed by this header are the file pages as declared in struct PFfpage.
+
+There are three layouts. A packed file (the original one) has the 8 byte
+header with firstfree and numpages only, and the pages right after each
+other. An aligned file has a whole PF_DIRECT_ALIGN block for the header,
+which also holds PF_HDR_MAGIC and the format, and each page in a slot
+rounded up to PF_DIRECT_ALIGN bytes, so that it can be opened with
+O_DIRECT. A packed file is told apart by the missing magic number, where
+an aligned file has it: there it would be the nextfree word of page 0.
+
+An aligned file of format PF_FORMAT_MAPPED keeps track of its free pages
+with an allocation bitmap instead of the free list: pages 0,
+PF_MAP_BITS, 2*PF_MAP_BITS, ... are map pages, each holding one bit per
+page for itself and the PF_MAP_BITS-1 pages after it, set if the page
+is used (or is a map page). The whole bitmap is kept in memory while
+the file is open, so that free pages are never read. firstfree is not
+used, and the nextfree word of a page is not kept up to date.
+
+The pages of an aligned file may be larger than PF_PAGE_SIZE: pagesize
+in the header gives the # of bytes of pagebuf, from PF_PAGE_SIZE up to
+PF_MAX_PAGE_SIZE, or 0 for PF_PAGE_SIZE (files written before there was
+a choice). Such a page is a PFfpage whose pagebuf runs on past the end
+of the struct. A map page still keeps track of PF_MAP_BITS pages, with
+the first PF_PAGE_SIZE bytes of its pagebuf. A packed file always has
+pages of PF_PAGE_SIZE bytes.
+
+A file of format PF_FORMAT_V2 has pages of exactly pagesize bytes at
+offsets that are multiples of pagesize, so that a page is one run of
+whole OS pages and device sectors. The header takes a whole page. Only
+pagebuf is written: the nextfree word of a PFfpage lives in the buffer
+alone, and the state of the pages is kept in an allocation bitmap apart
+from them. Each group of PF_MAP_BITS pages is preceded in the file by
+a map block, a page sized block holding its PF_MAP_BITS bits; map blocks
+have no page number, so pages 0, 1, 2, ... are all user pages:
+
+	header | map 0 | pages 0 .. PF_MAP_BITS-1 | map 1 | ...
+
+Page numbers are long. A file of format PF_FORMAT_V3 is laid out as a
+PF_FORMAT_V2 one, and keeps its # of pages in the 64 bit numpages of the
+header; the older formats keep it in the int oldnumpages, and so have
+at most PF_OLD_MAXPAGES pages. In memory numpages is up to date for all
+of them. The free list of the formats that have one links the pages by
+their int nextfree, and so is limited the same way.
+
+A file of format PF_FORMAT_COMPRESSED has a header block as an aligned
+file, and 64 bit numpages as PF_FORMAT_V3, but no fixed place for its
+pages: each page is compressed when written (see pflz.c) into a slot of
+the file, of PF_Z_GRAIN bytes or more, wherever there is one. The page
+map tells for each page where its slot is, how large it is and how many
+bytes of it the page takes: a page that does not compress is kept as it
+is, a page that was never written takes none and reads as zeros. A page
+that no longer fits in its slot, or needs much less, is given a free slot
+of the file, or a new one at the end of it; the old slot is free again
+once no page map on disk points at it. The page map, followed by the
+allocation bitmap, is written in turn into one of two areas of the file,
+and mapoffset in the header tells where the last one is. Whatever no
+slot nor page map takes is found again when the file is opened. */
 typedef struct PFhdr_str {
 	int	firstfree;	/* first free page in the linked list of
 				free pages */
-	int	numpages;	/* # of pages in the file */
+	int	oldnumpages;	/* # of pages in the file, formats before
+				PF_FORMAT_V3 */
+	int	magic;		/* PF_HDR_MAGIC, aligned files only */
+	int	format;		/* PF_FORMAT_xxx */
+	int	pagesize;	/* # of bytes of a page, aligned files
+				only; 0 for PF_PAGE_SIZE */
+	long	numpages;	/* # of pages in the file */
+	long	mapoffset;	/* where the page map is, PF_FORMAT_COMPRESSED
+				only; 0 if there is none yet */
 } PFhdr_str;
 
-#define PF_HDR_SIZE sizeof(PFhdr_str)	/* size of file header */
+#define PF_HDR_MAGIC	0x31484650	/* "PFH1" */
+/* PF_FORMAT_xxx are in pf.h, for PF_GetFormat() */
+#define PFwholePages(format) ((format) == PF_FORMAT_V2 || \
+				(format) == PF_FORMAT_V3)
+#define PFlongNumpages(format) ((format) == PF_FORMAT_V3 || \
+				(format) == PF_FORMAT_COMPRESSED)
+#define PF_OLD_MAXPAGES	0x7fffffffL	/* max # of pages before PF_FORMAT_V3 */
+
+/* alignment of file offsets, I/O sizes and memory for O_DIRECT: the
+logical block size of nearly all devices */
+#define PF_DIRECT_ALIGN	512
+#define PFalign(n)	(((n)+PF_DIRECT_ALIGN-1) & ~(PF_DIRECT_ALIGN-1))
+
+/* size of the file header, and distance between two pages in the file */
+#define PF_HDR_PACKED_SIZE	(2*sizeof(int))	/* firstfree and numpages */
+#define PF_HDR_SIZE(format,pagesize)	(PFwholePages(format)? \
+			PFpageSize(pagesize): (format) != PF_FORMAT_PACKED? \
+			PF_DIRECT_ALIGN: PF_HDR_PACKED_SIZE)
+#define PF_SLOT_SIZE(format,pagesize)	(PFwholePages(format)? \
+			PFpageSize(pagesize): (format) != PF_FORMAT_PACKED? \
+			PFalign(sizeof(int)+PFpageSize(pagesize)): \
+			sizeof(PFfpage))
+
+/* page size of a file whose header says "pagesize" */
+#define PFpageSize(pagesize)	((pagesize) > 0? (pagesize): PF_PAGE_SIZE)
+
+/* allocation bitmap: # of pages a map page keeps track of, and whether
+page p is a map page */
+#define PF_MAP_BITS	(PF_PAGE_SIZE*8)
+#define PFmapPage(p)	((p) % PF_MAP_BITS == 0)
+
+/* a file grows on disk by extents of PF_EXTENT_PAGES pages, reserved
+with fallocate() as its pages are first written. PF_AllocPageNear() looks
+for a free page this close to its hint, and otherwise adds a whole extent
+of free pages to a file with an allocation bitmap, for the pages to be
+allocated near the new one */
+#define PF_EXTENT_PAGES	64
+
+/* an entry of the page map of a PF_FORMAT_COMPRESSED file, as it is kept
+in memory and in the file */
+typedef struct PFzslot {
+	long offset;	/* where the slot of the page is in the file */
+	int length;	/* # of bytes the page takes in it: 0 if the page
+			was never written, the page size if it is kept
+			uncompressed */
+	int room;	/* # of bytes of the slot */
+} PFzslot;
+
+/* a slot is a whole number of PF_Z_GRAIN bytes, an eighth larger than
+the page it is made for (but never larger than a page), so that the page
+still fits once it compresses a bit less after a change */
+#define PF_Z_GRAIN	64
+#define PFzRoom(length,pagesize) ((((length) + (length)/8 + PF_Z_GRAIN-1) & \
+			~(PF_Z_GRAIN-1)) < (pagesize)? (((length) + (length)/8 + \
+			PF_Z_GRAIN-1) & ~(PF_Z_GRAIN-1)): (pagesize))
+
+/* room of a page map of "size" bytes: an eighth more, so that it still
+fits after a few more pages are added */
+#define PFzMapRoom(size) (((size) + (size)/8 + PF_Z_GRAIN-1) & ~(PF_Z_GRAIN-1))
+
+/* a list of slots no page uses, or of page map areas: only their offset
+and room count */
+typedef struct PFzlist {
+	PFzslot *slot;	/* the slots */
+	long n;		/* # of them */
+	long size;	/* # of entries of slot */
+} PFzlist;
 
 /* actual page struct to be written onto the file */
 #define PF_PAGE_LIST_END	-1	/* end of list of free pages */
 #define PF_PAGE_USED		-2	/* page is being used */
+#define PF_PAGE_MAP		-3	/* page is a map page (PF_FORMAT_MAPPED) */
 typedef struct PFfpage {
 	int nextfree;	/* page number of next free page in the linked
 			list of free pages, or PF_PAGE_LIST_END if
@@ -23,63 +157,290 @@ typedef struct PFfpage {
 } PFfpage;
 
 /*************************** Opened File Table **********************/
-#define PF_FTAB_SIZE	20	/* size of open file table */
+/* The table grows by chunks of PF_FTAB_CHUNK entries, up to
+PF_FTAB_MAXCHUNKS of them; entries never move once set up.
+Each open file descriptor (handle) is an entry. Handles on the same file
+opened with the same flags share the entry of the first one, the file
+entry, which holds the state of the file and whose number its pages
+have in the buffer. The file entry lives on until the last handle on
+the file is closed, even if its own handle was closed before. File
+entries are found by device and inode through a hash table of
+PF_FTAB_NBUCKETS buckets. */
+#define PF_FTAB_CHUNK	64	/* # of entries the table grows by */
+#define PF_FTAB_MAXCHUNKS 1024	/* max # of chunks */
+#define PF_FTAB_NBUCKETS 256	/* # of buckets of the file hash, a
+				power of 2 */
 
 /* open file table entry */
 typedef struct PFftab_ele {
 	char *fname;	/* file name, or NULL if entry not used */
+	short isopen;	/* TRUE if the entry is an open handle */
+	int file;	/* file entry of the handle, maybe itself */
+	int nhandles;	/* file entry: # of open handles on the file */
+	dev_t dev;	/* file entry: device of the file */
+	ino_t ino;	/* file entry: inode of the file */
+	int next;	/* next file entry in the same hash bucket, or
+			next free entry; -1 if none */
 	int unixfd;	/* unix file descriptor*/
 	PFhdr_str hdr;	/* file header */
 	short hdrchanged; /* TRUE if file header has changed */
-	int mru;
+	int policy;	/* page replacement policy, one of PF_POLICY_xxx */
+	long lastpage;	/* last page returned by PF_GetNextPage(), or -1 */
+	int seqrun;	/* # of PF_GetNextPage() calls in a row that went
+			on from the last page returned */
+	int scanhint;	/* # of scans that announced themselves with
+			PF_ScanHint() */
+	long raend;	/* page after the last one read ahead */
+	int rawindow;	/* # of pages the next read-ahead asks for */
+	int flags;	/* PF_OPEN_xxx the file was opened with */
+	char *map;	/* mapping of the file (PF_OPEN_MMAP), or NULL */
+	size_t maplen;	/* length of the mapping */
+	int madvice;	/* last madvise() advice for the mapping */
+	long allocend;	/* pages before this one have their room on disk
+			reserved (see PF_EXTENT_PAGES) */
+	unsigned char *usedmap;	/* allocation bitmap (PF_FORMAT_MAPPED),
+				else NULL */
+	char *mapdirty;	/* TRUE for each map page changed since read */
+	long mapgroups;	/* # of map pages */
+	long mapfree;	/* no free page before byte mapfree of usedmap */
+	struct PFmap_old *mapold; /* replaced bitmaps, freed at close */
+	PFzslot *zmap;	/* page map (PF_FORMAT_COMPRESSED), else NULL */
+	long zmapsize;	/* # of entries of zmap */
+	off_t zend;	/* end of the slots and page maps in the file */
+	short zchanged;	/* TRUE if the page map has changed since written */
+	PFzlist *zfree;	/* free slots by room: zfree[room/PF_Z_GRAIN] holds
+			those of room to room+PF_Z_GRAIN-1 bytes */
+	int zclasses;	/* # of entries of zfree */
+	PFzlist zpending; /* slots given up since the page map was last
+			written, which it may still point at */
+	char *zfresh;	/* TRUE for each page whose slot was taken since
+			the page map was last written, NULL if none */
+	PFzslot zmaparea; /* room of the page map the header points at */
+	PFzslot zspare;	/* room of the other page map area, or 0 */
+	pthread_mutex_t zlatch;	/* latch of zmap, zend, zchanged and the
+				free slots: pages are written by the page
+				cleaner as well */
 } PFftab_ele;
 
+/* a bitmap replaced by a larger one, kept until the file is closed for
+the threads that may still be looking at it */
+typedef struct PFmap_old {
+	unsigned char *usedmap;
+	struct PFmap_old *next;
+} PFmap_old;
+/* lastpage, seqrun, raend, rawindow and madvice are only hints about the
+access pattern, and are updated without latching. fname, isopen, file,
+lastpage, seqrun, raend and rawindow belong to each handle; the other
+fields are only used in the file entry */
+
+/* page replacement policies, selected by the rep_policy string of
+PF_OpenFile() */
+#define PF_POLICY_LRU	0	/* least recently used */
+#define PF_POLICY_MRU	1	/* most recently used */
+#define PF_POLICY_CLOCK	2	/* second chance: reference bit + sweeping hand */
+#define PF_POLICY_2Q	3	/* 2Q: probationary FIFO + hot LRU queue */
+#define PF_POLICY_ARC	4	/* adaptive replacement cache */
+#define PF_NUM_POLICIES	5	/* # of policies */
+
 /************************** Buffer Page Decls *********************/
-static int PF_MAX_BUFS = 20;	/* max # of buffers */
+extern int PF_MAX_BUFS;	/* max # of buffers, defined in buf.c */
+
+/* buffer frames. The buffer is an arena of page-aligned frames that
+hold the page bodies (PFfpage); a frame is known by its index.
+The bookkeeping of the frames (fd, page, flags, list links) is kept
+in parallel arrays apart from the bodies, see buf.c */
+#define PF_FRAME_NONE	-1	/* no frame: end of a frame list */
+
+/* frame flags */
+#define PF_FRAME_DIRTY	0x1	/* page is dirty */
+#define PF_FRAME_REF	0x2	/* referenced since the clock hand last
+				passed (CLOCK policy) */
+#define PF_FRAME_HOT	0x4	/* page is in the hot queue: 2Q A1m or
+				ARC T2 */
+#define PF_FRAME_CLEANING 0x8	/* page is being written out by the
+				page cleaner, it can't be evicted */
+#define PF_FRAME_READAHEAD 0x10	/* page was read ahead and has not been
+				asked for yet */
+#define PF_FRAME_PRIO	0x20	/* high priority page, replaced after the
+				others */
+#define PF_FRAME_ZCACHED 0x40	/* page is, as it is in the frame, in the
+				compressed page cache */
+#define PF_FRAME_READING 0x80	/* page is being read in: threads that
+				find it wait until it is there */
+#define PF_FRAME_WRITING 0x100	/* page is being written out as a victim,
+				it can't be evicted by another thread */
+#define PF_FRAME_IOERROR 0x200	/* page could not be read in: the frame
+				goes back to the free list with its last pin */
+
+/* distance between two frames in the arena: a page body rounded up
+to a whole slot of an aligned file, so that a slot can be read into a
+frame with O_DIRECT. It is also a whole number of cache lines */
+#define PF_CACHE_LINE	64
+#define PF_FRAME_SIZE	PFalign(sizeof(PFfpage))
+#define PF_ARENA_ALIGN	4096	/* alignment of the frame arena */
+
+/* most frames the buffer can have: the bookkeeping of this many frames
+is given its room when the buffer is first set up, so that it never moves
+(see PFbufGrow()) */
+#define PF_MAX_FRAMES	(1 << 20)
+
+/* access hints for PFbufGet(), may be or'ed */
+#define PF_HINT_NONE	0	/* random access */
+#define PF_HINT_SEQ	0x1	/* page read by a sequential scan */
+#define PF_HINT_EXCL	0x2	/* the caller must hold the only pin */
+#define PF_HINT_HIGH	0x4	/* give the page high priority */
+#define PF_HINT_LOW	0x8	/* give the page low priority */
+
+#define PF_RING_SIZE	16	/* max # of frames in a file's scan ring */
+#define PF_SEQ_THRESHOLD 4	/* # of PF_GetNextPage() calls in a row
+				before a file is treated as scanned */
+#define PF_CLEAN_BATCH	16	/* max # of pages the page cleaner writes
+				out in one round */
+#define PF_FLUSH_MAXRUN	64	/* max # of adjacent pages written out
+				with one vectored write */
+#define PF_READAHEAD_MIN 2	/* first read-ahead window of a scan */
+#define PF_READAHEAD_MAX 32	/* max read-ahead window; it is also kept
+				to half the scan ring of the file */
+
+
 
-/* buffer page decl */
-typedef struct PFbpage {
-	struct PFbpage *nextpage;	/* next in the linked list of
-					buffer page */
-	struct PFbpage *prevpage;	/* previous in the linked list
-					of buffer pages */
-	short	dirty:1,		/* TRUE if page is dirty */
-		fixed:1;		/* TRUE if page is fixed in buffer*/
-	int	page;			/* page number of this page */
-	int	fd;			/* file desciptor of this page */
-	PFfpage fpage; /* page data from the file */
-} PFbpage;
+/******************** Page I/O Decls ******************************/
+/* a run of adjacent pages of a file, read or written with one vectored
+request */
+typedef struct PFpage_run {
+	long pagenum;		/* first page of the run */
+	int n;			/* # of pages */
+	PFfpage **fpages;	/* buffers of the pages */
+} PFpage_run;
 
+/* a request to an I/O backend (see pfio.c) */
+typedef struct PFio_req {
+	int unixfd;		/* unix file descriptor */
+	int write;		/* TRUE to write, FALSE to read */
+	off_t offset;		/* where in the file */
+	struct iovec *iov;	/* buffers */
+	int iovcnt;		/* # of buffers */
+	long res;		/* # of bytes transferred, or -errno */
+} PFio_req;
 
+#define PF_IO_DEPTH	64	/* # of entries of the io_uring of a thread */
+#define PF_IO_NTHREADS	8	/* # of threads of the PF_IO_THREADS backend */
 
 /******************** Hash Table Decls ****************************/
-#define PF_HASH_TBL_SIZE	20	/* size of PF hash table */
+/* The hash table is split into PF_HASH_NSHARDS shards, each latched
+on its own. A shard is open addressed with linear probing: entries are
+stored in the shard itself, an entry whose frame is PF_FRAME_NONE is
+empty. A shard holds at least PF_HASH_MIN_SIZE entries, or its share of
+twice the number of buffers, rounded up to a power of 2, and it is never
+more than half full. */
+#define PF_HASH_NSHARDS		16	/* # of shards, a power of 2 */
+#define PF_HASH_MIN_SIZE	64	/* min # of entries in a shard */
 
-/* Hash table bucket entries*/
+/* Hash table entries. The page number comes first, so that the entry
+takes 16 bytes without padding */
 typedef struct PFhash_entry {
-	struct PFhash_entry *nextentry; /* next hash table element, or NULL */
-	struct PFhash_entry *preventry;/*previous hash table element,or NULL*/
+	long page;	/* page number */
 	int fd;		/* file descriptor */
-	int page;	/* page number */
-	struct PFbpage *bpage; /* pointer to buffer holding this page */
+	int frame;	/* buffer frame holding this page, or PF_FRAME_NONE */
 } PFhash_entry;
 
-/* Hash function for hash table */
-#define PFhash(fd,page) (((fd)+(page)) % PF_HASH_TBL_SIZE)
+/* Hash function for hash table: mixes fd and page so that the pages of
+a file do not all land on consecutive entries. The high half of the
+page number is folded in, for the pages past 2^32 */
+#define PFhash(fd,page) \
+	((((unsigned)(page) * 0x9e3779b1u) ^ \
+	((unsigned)((unsigned long)(page) >> 32) * 0x27d4eb2fu) ^ \
+	((unsigned)(fd) * 0x85ebca6bu)) * 0xc2b2ae35u)
+
+/******************** Ghost List Decls ****************************/
+/* ghost lists remember recently evicted pages (see ghost.c) */
+#define PF_GHOST_A1OUT	0	/* pages evicted from the 2Q probationary
+				queue */
+#define PF_GHOST_B1	1	/* pages evicted from ARC T1 */
+#define PF_GHOST_B2	2	/* pages evicted from ARC T2 */
+#define PF_GHOST_NLISTS	3	/* # of ghost lists */
+
+/* 2Q queue sizes, as in Johnson and Shasha */
+#define PF_2Q_KIN	(PF_MAX_BUFS/4 > 0 ? PF_MAX_BUFS/4 : 1)
+					/* target size of probationary queue */
+#define PF_2Q_KOUT	(PF_MAX_BUFS/2 > 0 ? PF_MAX_BUFS/2 : 1)
+					/* max # of A1out ghost entries */
 
 /******************* Interface functions from Hash Table ****************/
 extern void PFhashInit();
-extern PFbpage *PFhashFind();
-extern PFhashInsert();
-extern PFhashDelete();
+extern void PFhashLatch(int, long);
+extern void PFhashUnlatch(int, long);
+extern PFhashFind(int, long);
+extern PFhashInsert(int, long, int);
+extern PFhashDelete(int, long);
 extern PFhashPrint();
 
+/******************* Interface functions from Ghost Lists ***************/
+extern PFghostFind(int, long);
+extern PFghostInsert(int, int, long);
+extern void PFghostDelete(int, long);
+extern void PFghostDropOldest();
+extern PFghostCount();
+extern void PFghostReleaseFile();
+
+/************ Interface functions from the Compressed Page Cache ********/
+extern PFzcacheSetSize();
+extern void PFzcachePut(int, long, char *, int);
+extern PFzcacheTouch(int, long);
+extern PFzcacheGet(int, long, char *, int);
+extern void PFzcacheDelete(int, long);
+extern void PFzcacheReleaseFile();
+
 /****************** Interface functions from Buffer Manager *************/
-extern PFbufGet();
-extern PFbufUnfix();
-extern PFbufalloc();
+/* those taking page numbers have prototypes, as page numbers are long */
+extern PFbufGet(int, long, PFfpage **, int (*)(), int (*)(), int);
+extern PFbufUnfix(int, long, int);
+extern PFbufAlloc(int, long, PFfpage **, int (*)());
+extern PFbufUsed(int, long);
 extern PFbufReleaseFile();
+extern PFbufFlushFile();
+extern PFbufReadAhead(int, long, int, int (*)(), int (*)());
+extern PFbufGetPages(int, long *, int, PFfpage **, int (*)(), int (*)());
+extern PFbufStartCleaner();
+extern PFbufStopCleaner();
+extern PFbufSetQuota();
+extern PFbufSetPriority(int, long, int);
+extern PFbufDiscard(int, long);
+extern PFbufFileFrames();
+extern PFbufSetFiles();
+extern void PFbufSetFrameSize();
+extern PFbufSetCacheSize();
+
+/****************** Interface functions from the LZ codec ***************/
+extern PFlzCompress();
+extern PFlzDecompress();
+
+/****************** Interface functions from Page I/O *******************/
+extern PFioSetBackend();
+extern PFioSubmitWait();
+
+/******************* Statistics ******************************************/
+/* the counters of PF_Stats are kept per thread, and summed up by
+PF_GetStats(). PFstat(f) is counter f of the calling thread */
+extern __thread PF_Stats *PFmystats;
+extern PF_Stats *PFstatsSlot();
+#define PFstat(f)	((PFmystats != NULL? PFmystats: PFstatsSlot())->f)
+
+/* the counters of PF_FileStats are kept per thread as well, for each file
+entry, and summed up by PF_GetFileStats(). PFfileStats(fd) are the
+counters of file entry fd of the calling thread. PFfstat(fd,f,n) adds n
+to counter f of the thread and of file fd, PFfcount(fd,f,n) to the
+counter of the file alone */
+extern __thread PF_FileStats **PFmyfiles;
+extern PF_FileStats *PFfileStatsSlot();
+#define PFfileStats(fd)	((PFmyfiles != NULL && \
+			PFmyfiles[(fd)/PF_FTAB_CHUNK] != NULL)? \
+			&PFmyfiles[(fd)/PF_FTAB_CHUNK][(fd)%PF_FTAB_CHUNK]: \
+			PFfileStatsSlot(fd))
+#define PFfcount(fd,f,n) (PFfileStats(fd)->f += (n))
+#define PFfstat(fd,f,n)	(PFstat(f) += (n), PFfcount(fd,f,n))
 
 ///
 PFftab_ele get_PFftab(int); // return file
+int PFfilePolicy(int); // return the policy of a file
 int set_buffer_size(int); // changes max buffer pool size
\ No newline at end of file
@@ -46,8 +46,8 @@ int SP_InitPage(char *pagebuf) {
 /* Try to find a page with enough free space, scanning all used pages.
    If none found, returns PFE_EOF. On success returns PFE_OK and leaves
    the page pinned (i.e., do NOT unfix). Caller must unfix or write changes. */
-static int find_page_with_space(int fd, int reqBytes, int *outPage, char **outPageBuf) {
-    int pagenum;
+static int find_page_with_space(int fd, int reqBytes, long *outPage, char **outPageBuf) {
+    long pagenum;
     char *pagebuf;
     int rc;
 
@@ -78,7 +78,7 @@ static int find_page_with_space(int fd, int reqBytes, int *outPage, char **outPa
 int SP_InsertRecord(int fd, const void *rec, int len, RecordID *rid) {
     if (!rec || len <= 0 || !rid) return -1;
     int reqBytes = len + SP_SLOT_SIZE;
-    int pagenum;
+    long pagenum;
     char *pagebuf;
     int rc;
 
@@ -197,7 +197,7 @@ int SP_DeleteRecord(int fd, RecordID rid) {
 typedef struct {
     int in_use;
     int fd;
-    int curPage;
+    long curPage;
     int curSlot;
     int lastPagePinned; /* 1 if curPage is pinned */
     char *pagebuf;      /* pointer from PF_GetThisPage / GetNextPage when pinned */
@@ -216,6 +216,8 @@ int SP_OpenScan(int fd, SP_ScanHandle *sh) {
     sp_scans[si].curSlot = 0;
     sp_scans[si].lastPagePinned = 0;
     sp_scans[si].pagebuf = NULL;
+    /* the scan reads the file front to back: keep it in the scan ring */
+    PF_ScanHint(fd, TRUE);
     *sh = si;
     return PFE_OK;
 }
@@ -225,7 +227,7 @@ int SP_GetNext(int sh, void **outbuf, int *outlen, RecordID *rid) {
     if (sh < 0 || sh >= SP_MAX_SCANS) return -1;
     if (!sp_scans[sh].in_use) return -1;
     int fd = sp_scans[sh].fd;
-    int pnum = sp_scans[sh].curPage;
+    long pnum = sp_scans[sh].curPage;
     char *pagebuf = NULL;
     int rc;
 
@@ -255,6 +257,7 @@ int SP_GetNext(int sh, void **outbuf, int *outlen, RecordID *rid) {
             void *buf = malloc(slots[sidx].length);
             if (!buf) {
                 PF_UnfixPage(fd, sp_scans[sh].curPage, FALSE);
+                PF_ScanHint(fd, FALSE);
                 sp_scans[sh].in_use = 0;
                 return PFE_NOMEM;
             }
@@ -272,7 +275,7 @@ int SP_GetNext(int sh, void **outbuf, int *outlen, RecordID *rid) {
             sp_scans[sh].pagebuf = NULL;
         }
         /* move to next page */
-        int nextp = sp_scans[sh].curPage;
+        long nextp = sp_scans[sh].curPage;
         rc = PF_GetNextPage(fd, &nextp, &pagebuf);
         if (rc == PFE_EOF) return PFE_EOF;
         if (rc != PFE_OK) return rc;
@@ -293,6 +296,7 @@ int SP_CloseScan(int sh) {
         sp_scans[sh].lastPagePinned = 0;
         sp_scans[sh].pagebuf = NULL;
     }
+    PF_ScanHint(sp_scans[sh].fd, FALSE);
     sp_scans[sh].in_use = 0;
     return PFE_OK;
 }
@@ -22,7 +22,7 @@ typedef struct {
 
 /* Record identifier returned to caller */
 typedef struct {
-    int pageNum;
+    long pageNum;
     int slotNum;
 } RecordID;
 
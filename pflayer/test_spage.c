@@ -83,7 +83,7 @@ void compute_slotted_storage() {
     }
 
     /* Now compute slotted page utilization */
-    int pagenum = -1;
+    long pagenum = -1;
     char *pagebuf;
     int rc;
 
@@ -98,7 +98,7 @@ void compute_slotted_storage() {
         int usedBytes;
         SP_PageUtilization(pagebuf, &util, &usedBytes);
 
-        printf(" Page %d: %d bytes (%.2f%%)\n", pagenum, usedBytes, util);
+        printf(" Page %ld: %d bytes (%.2f%%)\n", pagenum, usedBytes, util);
 
         totalPages++;
         totalUsed += usedBytes;
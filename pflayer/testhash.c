@@ -1,10 +1,26 @@
 /* testhash.c: tests the hash table functions */
 #include <stdio.h>
+#include <stdlib.h>
 #include "pf.h"
+#include "pftypes.h"
+
+static void check(fd,page,frame)
+int fd;
+long page;
+int frame;	/* frame the page should be in, or PF_FRAME_NONE */
+{
+int k;
+
+	k = PFhashFind(fd,page);
+	if (k != frame){
+		printf("PFhashFind(%d,%ld) gave %d, not %d\n",fd,page,k,frame);
+		exit(1);
+	}
+}
 
 main()
 {
-int i,k;
+int i;
 long j;
 
 	PFhashInit();
@@ -16,27 +32,62 @@ long j;
 				exit(1);
 			}
 		}
+	if (PFhashInsert(3,4L,0) != PFE_HASHPAGEEXIST){
+		printf("PFhashInsert of a page already there did not fail\n");
+		exit(1);
+	}
 
 	/* Now, find all the entries */
 	for (i=1; i < 11; i++)
-		for (j=1; j < 11; j++){
-			k = PFhashFind(i,j);
-			if (k == NULL){
-				printf("PFfind failed at %d %d\n",i,j);
+		for (j=1; j < 11; j++)
+			check(i,j,(int)(i+j));
+	check(11,1L,PF_FRAME_NONE);
+
+	/* delete every other entry: the entries after each hole are
+	shifted back, and must still be found */
+	for (i=1; i < 11; i++)
+		for (j=1; j < 11; j++)
+			if ((i+j) % 2 == 0 && PFhashDelete(i,j) != PFE_OK){
+				printf("PFhashDelete failed at %d %ld\n",i,j);
 				exit(1);
 			}
-			else
-			printf("found \n");
-		}
+	for (i=1; i < 11; i++)
+		for (j=1; j < 11; j++)
+			check(i,j,((i+j) % 2 == 0)? PF_FRAME_NONE: (int)(i+j));
+	if (PFhashDelete(2,2L) != PFE_HASHNOTFOUND){
+		printf("PFhashDelete of a missing page did not fail\n");
+		exit(1);
+	}
 
-	/* Now, delete them in reverse */
+	/* Now, delete the rest in reverse */
 	for (j =10; j > 0; j--)
 		for (i=10; i > 0; i--)
-			if (PFhashDelete(i,j) != PFE_OK){
-				printf("PFhashDelete failed at %d %d",i,j);
+			if ((i+j) % 2 != 0 && PFhashDelete(i,j) != PFE_OK){
+				printf("PFhashDelete failed at %d %ld\n",i,j);
+				exit(1);
+			}
+
+	/* enough entries for the shards to grow, with page numbers past
+	2^32 */
+	for (i=1; i < 5; i++)
+		for (j=0; j < 5000; j++)
+			if (PFhashInsert(i,j << 20,(int)j) != PFE_OK){
+				printf("PFhashInsert failed at %d %ld\n",i,j);
+				exit(1);
+			}
+	for (i=1; i < 5; i++)
+		for (j=0; j < 5000; j++)
+			check(i,j << 20,(int)j);
+	for (i=1; i < 5; i++)
+		for (j=0; j < 5000; j++)
+			if (PFhashDelete(i,j << 20) != PFE_OK){
+				printf("PFhashDelete failed at %d %ld\n",i,j);
 				exit(1);
 			}
+	check(1,0L,PF_FRAME_NONE);
 
 	/* print the hash table out */
 	PFhashPrint();
+	printf("testhash done!\n");
+	exit(0);
 }
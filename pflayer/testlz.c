@@ -0,0 +1,159 @@
+/* testlz.c: tests the codec of compressed files, PFlzCompress() and
+PFlzDecompress(): what is compressed comes back as it was, and bytes that
+are not a compressed page, or a damaged one, are refused without reading
+or writing out of bounds */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "pf.h"
+#include "pftypes.h"
+
+#define MAXBYTES	(PF_MAX_PAGE_SIZE + 64)	/* a page body, and a bit */
+#define GUARD		64	/* bytes checked past the output */
+#define FUZZCASES	20000	/* # of garbage inputs to decode */
+
+static unsigned char src[MAXBYTES];
+static unsigned char packed[MAXBYTES];
+static unsigned char out[MAXBYTES + GUARD];
+
+static fill(kind,n)
+int kind;	/* what the bytes look like */
+int n;		/* # of bytes */
+/****************************************************************************
+SPECIFICATIONS:
+	Fill the first "n" bytes of src with one kind of data: zeros,
+	random bytes, sorted keys padded with blanks, runs of random
+	length, or random bytes with repeats far apart.
+*****************************************************************************/
+{
+int i, j;
+
+	switch (kind){
+	case 0:
+		memset(src,0,n);
+		break;
+	case 1:
+		for (i=0; i < n; i++)
+			src[i] = rand();
+		break;
+	case 2:
+		for (i=0; i < n; i++)
+			src[i] = ' ';
+		for (i=0, j=0; i + 16 <= n; i += 16, j += 3)
+			sprintf((char *)src + i,"key%08d",j);
+		break;
+	case 3:
+		for (i=0; i < n; ){
+			j = rand() % 300 + 1;
+			memset(src + i,rand(),(i + j <= n)? j: n - i);
+			i += j;
+		}
+		break;
+	default:
+		for (i=0; i < n; i++)
+			src[i] = (i >= 40000 && rand() % 8)? src[i - 40000]:
+								rand();
+		break;
+	}
+}
+
+static roundtrip(n)
+int n;		/* # of bytes of src */
+/****************************************************************************
+SPECIFICATIONS:
+	Compress the "n" bytes of src and decompress them again. They must
+	come back as they were, nothing past them may be written, and an
+	output one byte too short must be refused. Bytes that do not
+	compress may be refused by PFlzCompress().
+*****************************************************************************/
+{
+int m;		/* # of compressed bytes */
+int k;
+
+	if ((m=PFlzCompress(src,n,packed,n)) < 0)
+		return;
+	memset(out,0xa5,n + GUARD);
+	if (PFlzDecompress(packed,m,out,n) != n ||
+			memcmp(src,out,n) != 0){
+		printf("%d bytes do not come back\n",n);
+		exit(1);
+	}
+	for (k=n; k < n + GUARD; k++)
+		if (out[k] != 0xa5){
+			printf("decompressing %d bytes wrote past them\n",n);
+			exit(1);
+		}
+	if (n > 0 && PFlzDecompress(packed,m,out,n - 1) != -1){
+		printf("%d bytes were put into %d\n",n,n - 1);
+		exit(1);
+	}
+}
+
+static decode(n,size)
+int n;		/* # of bytes of packed */
+int size;	/* room for the output */
+/****************************************************************************
+SPECIFICATIONS:
+	Decompress whatever the "n" bytes of packed hold into "size" bytes:
+	the result must be -1 or fit, and nothing past it may be written.
+*****************************************************************************/
+{
+int r;
+int k;
+
+	memset(out + size,0xa5,GUARD);
+	r = PFlzDecompress(packed,n,out,size);
+	if (r < -1 || r > size){
+		printf("decompressing garbage gave %d for %d bytes\n",r,size);
+		exit(1);
+	}
+	for (k=size; k < size + GUARD; k++)
+		if (out[k] != 0xa5){
+			printf("decompressing garbage wrote past %d bytes\n",
+									size);
+			exit(1);
+		}
+}
+
+main()
+{
+static int sizes[] = { 0, 1, 4, 15, 16, 19, 300, PF_PAGE_SIZE,
+			16384, PF_MAX_PAGE_SIZE, MAXBYTES };
+int kind, i, n, m, k;
+
+	srand(1);
+
+	/* round trips of each kind of data, at each size */
+	for (kind=0; kind < 5; kind++)
+		for (i=0; i < sizeof(sizes)/sizeof(sizes[0]); i++){
+			fill(kind,sizes[i]);
+			roundtrip(sizes[i]);
+		}
+	fill(0,PF_PAGE_SIZE);
+	if (PFlzCompress(src,PF_PAGE_SIZE,packed,PF_PAGE_SIZE) <= 0){
+		printf("a page of zeros does not compress\n");
+		exit(1);
+	}
+	fill(1,PF_PAGE_SIZE);
+	if (PFlzCompress(src,PF_PAGE_SIZE,packed,PF_PAGE_SIZE/2) != -1){
+		printf("random bytes compress to half\n");
+		exit(1);
+	}
+
+	/* garbage: random bytes, and compressed pages damaged at random */
+	for (i=0; i < FUZZCASES; i++){
+		n = rand() % 512;
+		for (k=0; k < n; k++)
+			packed[k] = (i % 2)? rand(): rand() % 16 * 17;
+		decode(n,rand() % PF_PAGE_SIZE);
+
+		fill(i % 5,PF_PAGE_SIZE);
+		if ((m=PFlzCompress(src,PF_PAGE_SIZE,packed,PF_PAGE_SIZE)) <= 0)
+			continue;
+		for (k=rand() % 4; k >= 0; k--)
+			packed[rand() % m] ^= 1 << (rand() % 8);
+		decode((i % 3)? m: rand() % m,PF_PAGE_SIZE);
+	}
+
+	printf("testlz done!\n");
+}
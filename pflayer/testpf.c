@@ -496,6 +496,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 #include "pf.h"
 #include "pftypes.h"
 
@@ -504,7 +505,7 @@
 // -------------------------------------------------------------
 void do_write(int fd)
 {
-    int pagenum;
+    long pagenum;
     char *pagebuf;
 
     // Allocate a page
@@ -519,7 +520,7 @@ void do_write(int fd)
 // -------------------------------------------------------------
 void do_read(int fd)
 {
-    int pagenum;
+    long pagenum;
     char *pagebuf;
 
     if (PF_GetFirstPage(fd, &pagenum, &pagebuf) == PFE_OK) {
@@ -578,6 +579,893 @@ void run_mix(int mix, int operations)
     );
 }
 
+// -------------------------------------------------------------
+// Behaviour checks: each prints "ok" or "FAILED"
+// -------------------------------------------------------------
+static int failures = 0;
+
+void check(char *what, int ok)
+{
+    printf("%s: %s\n", what, ok ? "ok" : "FAILED");
+    if (!ok)
+        failures++;
+}
+
+// Create file "name" afresh with "npages" pages and open it
+int fresh_file(char *name, char *policy, int npages)
+{
+    int fd, i;
+    long pagenum;
+    char *pagebuf;
+
+    unlink(name);
+    if (PF_CreateFile(name) != PFE_OK || (fd = PF_OpenFile(name, policy)) < 0) {
+        PF_PrintError(name);
+        exit(1);
+    }
+    for (i = 0; i < npages; i++) {
+        if (PF_AllocPage(fd, &pagenum, &pagebuf) != PFE_OK) {
+            PF_PrintError("alloc");
+            exit(1);
+        }
+        sprintf(pagebuf, "page %d", i);
+        PF_UnfixPage(fd, pagenum, TRUE);
+    }
+    return fd;
+}
+
+// Fix and unfix a page, checking that it holds what fresh_file() put there
+void touch(int fd, long pagenum)
+{
+    char *pagebuf;
+
+    if (PF_GetThisPage(fd, pagenum, &pagebuf) != PFE_OK) {
+        PF_PrintError("touch");
+        exit(1);
+    }
+    if (atol(pagebuf + 5) != pagenum) {
+        printf("page %ld holds \"%.20s\"\n", pagenum, pagebuf);
+        exit(1);
+    }
+    PF_UnfixPage(fd, pagenum, FALSE);
+}
+
+// Pages read from the files so far
+long misses()
+{
+    PF_Stats stats;
+
+    PF_GetStats(&stats);
+    return stats.physicalReads;
+}
+
+void close_file(int fd, char *name)
+{
+    if (PF_CloseFile(fd) != PFE_OK || PF_DestroyFile(name) != PFE_OK) {
+        PF_PrintError(name);
+        exit(1);
+    }
+}
+
+// CLOCK gives a referenced page a second chance. Reading PF_MAX_BUFS new
+// pages fills the buffer in clock hand order, all referenced; the next
+// miss clears every reference bit and takes the oldest page. The pages
+// after it would be the next victims, unless they are referenced again.
+void check_clock()
+{
+    int fd, i, n = PF_MAX_BUFS;
+    long before;
+
+    fd = fresh_file("clockfile.db", "CLOCK", 3 * n);
+    for (i = n; i < 2 * n; i++)
+        touch(fd, i);
+    touch(fd, 0);
+    for (i = n + 1; i <= n + 5; i++)
+        touch(fd, i);
+    for (i = 1; i <= 5; i++)
+        touch(fd, i);
+
+    before = misses();
+    for (i = n + 1; i <= n + 5; i++)
+        touch(fd, i);
+    check("CLOCK: referenced pages get a second chance", misses() == before);
+    close_file(fd, "clockfile.db");
+}
+
+// A hot set must stay in the buffer through a one-pass scan. ARC makes
+// a page hot on its second use, 2Q once it is used again after having
+// left A1in, so the hot set is used twice, then again after a while.
+void check_scan(char *policy)
+{
+    int fd, i;
+    long before;
+    char what[80];
+
+    fd = fresh_file("scanfile.db", policy, 300);
+    for (i = 0; i < 10; i++)
+        touch(fd, i % 5);
+    for (i = 100; i < 100 + PF_MAX_BUFS; i++)
+        touch(fd, i);
+    for (i = 0; i < 5; i++)
+        touch(fd, i);
+    for (i = 100 + PF_MAX_BUFS; i < 300; i++)
+        touch(fd, i);
+
+    before = misses();
+    for (i = 0; i < 5; i++)
+        touch(fd, i);
+    sprintf(what, "%s: hot pages survive a scan", policy);
+    check(what, misses() == before);
+    close_file(fd, "scanfile.db");
+}
+
+// With PF_ScanHint() on, PF_GetNextPage() reads through the file's scan
+// ring from the first page on. The ring takes at most a quarter of the
+// buffer, so a scan of the whole file leaves the other three quarters,
+// the pages used before it, in the buffer even under LRU. Without the
+// hint the first PF_SEQ_THRESHOLD pages of the scan would push some out.
+void check_scan_ring(char *policy)
+{
+    int fd, i, hot = PF_MAX_BUFS - PF_MAX_BUFS / 4;
+    long pagenum, before;
+    char *pagebuf, what[80];
+
+    fd = fresh_file("ringfile.db", policy, 300);
+    for (i = 100; i < 100 + PF_MAX_BUFS; i++)
+        touch(fd, i);
+    for (i = 200; i < 200 + hot; i++)
+        touch(fd, i);
+
+    PF_ScanHint(fd, TRUE);
+    pagenum = -1;
+    while (PF_GetNextPage(fd, &pagenum, &pagebuf) == PFE_OK)
+        PF_UnfixPage(fd, pagenum, FALSE);
+    PF_ScanHint(fd, FALSE);
+
+    before = misses();
+    for (i = 200; i < 200 + hot; i++)
+        touch(fd, i);
+    sprintf(what, "%s: hot pages survive a hinted scan", policy);
+    check(what, misses() == before);
+    close_file(fd, "ringfile.db");
+}
+
+// A file capped by PF_SetFileQuota() never holds more frames than its cap,
+// whether it grows, is read at random or is scanned
+void check_quota(char *policy)
+{
+    int a, b, i, most = 0;
+    long pagenum;
+    char *pagebuf, what[80];
+
+    a = fresh_file("quota_a.db", policy, PF_MAX_BUFS);
+    b = fresh_file("quota_b.db", policy, 0);
+    if (PF_SetFileQuota(b, 0, 5) != PFE_OK) {
+        PF_PrintError("quota");
+        exit(1);
+    }
+    for (i = 0; i < 200; i++) {
+        if (PF_AllocPage(b, &pagenum, &pagebuf) != PFE_OK) {
+            PF_PrintError("alloc");
+            exit(1);
+        }
+        sprintf(pagebuf, "page %d", i);
+        PF_UnfixPage(b, pagenum, TRUE);
+        if (PF_GetFileFrames(b) > most)
+            most = PF_GetFileFrames(b);
+        touch(b, rand() % (i + 1));
+        touch(a, rand() % PF_MAX_BUFS);
+        if (PF_GetFileFrames(b) > most)
+            most = PF_GetFileFrames(b);
+    }
+    pagenum = -1;
+    while (PF_GetNextPage(b, &pagenum, &pagebuf) == PFE_OK) {
+        PF_UnfixPage(b, pagenum, FALSE);
+        if (PF_GetFileFrames(b) > most)
+            most = PF_GetFileFrames(b);
+    }
+
+    sprintf(what, "%s: a file keeps within its quota", policy);
+    check(what, most > 0 && most <= 5);
+    close_file(a, "quota_a.db");
+    close_file(b, "quota_b.db");
+}
+
+// PF_PRIO_HIGH pages stay in the buffer while low priority pages come and
+// go, whether given their priority when fixed or afterwards
+void check_priority(char *policy)
+{
+    int fd, i;
+    long before;
+    char *pagebuf, what[80];
+
+    fd = fresh_file("priofile.db", policy, 200);
+    if (PF_GetThisPageHint(fd, 0, &pagebuf, PF_PRIO_HIGH) != PFE_OK) {
+        PF_PrintError("hint");
+        exit(1);
+    }
+    PF_UnfixPage(fd, 0, FALSE);
+    if (PF_GetThisPage(fd, 1, &pagebuf) != PFE_OK ||
+            PF_SetPagePriority(fd, 1, PF_PRIO_HIGH) != PFE_OK) {
+        PF_PrintError("priority");
+        exit(1);
+    }
+    PF_UnfixPage(fd, 1, FALSE);
+    for (i = 2; i < 200; i++)
+        touch(fd, i);
+
+    before = misses();
+    touch(fd, 0);
+    touch(fd, 1);
+    sprintf(what, "%s: high priority pages outlive low ones", policy);
+    check(what, misses() == before);
+    close_file(fd, "priofile.db");
+}
+
+// Two handles on one file share its buffered pages: each sees what the
+// other wrote, new pages included, without reading the file again. A
+// handle with other PF_OPEN_xxx flags would not, and is refused.
+void check_shared()
+{
+    int a, b, ok;
+    long pagenum;
+    char *pagebuf;
+    PF_Stats before, after;
+
+    a = fresh_file("sharefile.db", "LRU", 5);
+    if ((b = PF_OpenFile("sharefile.db", "LRU")) < 0) {
+        PF_PrintError("open");
+        exit(1);
+    }
+    PF_GetStats(&before);
+
+    PF_GetThisPage(a, 3, &pagebuf);
+    strcpy(pagebuf, "page 3 written by a");
+    PF_UnfixPage(a, 3, TRUE);
+    PF_GetThisPage(b, 3, &pagebuf);
+    ok = strcmp(pagebuf, "page 3 written by a") == 0;
+    strcpy(pagebuf, "page 3 written by b");
+    PF_UnfixPage(b, 3, TRUE);
+    PF_GetThisPage(a, 3, &pagebuf);
+    ok = ok && strcmp(pagebuf, "page 3 written by b") == 0;
+    PF_UnfixPage(a, 3, FALSE);
+
+    PF_AllocPage(b, &pagenum, &pagebuf);
+    strcpy(pagebuf, "page 5");
+    PF_UnfixPage(b, pagenum, TRUE);
+    ok = ok && pagenum == 5;
+    touch(a, 5);
+
+    PF_GetStats(&after);
+    check("two handles on a file see each other's writes",
+        ok && after.physicalReads == before.physicalReads);
+    check("a file open with other flags is not opened again",
+        PF_OpenFileFlags("sharefile.db", "LRU", PF_OPEN_MMAP) == PFE_FILEOPEN);
+    if (PF_CloseFile(b) != PFE_OK) {
+        PF_PrintError("close");
+        exit(1);
+    }
+    close_file(a, "sharefile.db");
+}
+
+// A page fixed twice, here by the same caller, stays fixed until it is
+// unfixed twice, and cannot be disposed of while it is fixed
+void check_pins()
+{
+    int fd, ok;
+    char *pagebuf, *again;
+
+    fd = fresh_file("pinfile.db", "LRU", 2);
+    ok = PF_GetThisPage(fd, 1, &pagebuf) == PFE_OK &&
+        PF_GetThisPage(fd, 1, &again) == PFE_OK && again == pagebuf;
+    check("a fixed page can be fixed again", ok);
+
+    ok = PF_DisposePage(fd, 1) == PFE_PAGEFIXED;
+    ok = ok && PF_UnfixPage(fd, 1, FALSE) == PFE_OK;
+    ok = ok && PF_DisposePage(fd, 1) == PFE_PAGEFIXED;
+    ok = ok && PF_UnfixPage(fd, 1, FALSE) == PFE_OK;
+    ok = ok && PF_UnfixPage(fd, 1, FALSE) == PFE_PAGEUNFIXED;
+    ok = ok && PF_DisposePage(fd, 1) == PFE_OK;
+    check("a page fixed twice needs two unfixes before it is disposed of", ok);
+    close_file(fd, "pinfile.db");
+}
+
+// Rewrite pages of file "fd" at random, dirtying a third of those it
+// fixes, and return how many dirty victims the page misses had to write
+// out themselves. rev[] keeps what each page last got.
+long dirty_run(int fd, int npages, int *rev)
+{
+    int i;
+    long pagenum;
+    char *pagebuf;
+    PF_Stats before, after;
+
+    PF_GetStats(&before);
+    srand(1);
+    for (i = 1; i <= 5000; i++) {
+        pagenum = rand() % npages;
+        if (PF_GetThisPage(fd, pagenum, &pagebuf) != PFE_OK) {
+            PF_PrintError("dirty run");
+            exit(1);
+        }
+        if (i % 3 == 0) {
+            sprintf(pagebuf, "page %ld rev %d", pagenum, i);
+            rev[pagenum] = i;
+        }
+        PF_UnfixPage(fd, pagenum, i % 3 == 0);
+        if (i % 50 == 0)
+            usleep(100);
+    }
+    PF_GetStats(&after);
+    return after.foregroundDirtyEvictions - before.foregroundDirtyEvictions;
+}
+
+// The page cleaner writes out dirty pages before misses have to, and
+// what it writes out is what the pages hold
+void check_cleaner()
+{
+    int fd, i, ok, rev[100];
+    long plain, cleaned, cleans;
+    char *pagebuf, want[40];
+    PF_Stats before, after;
+
+    check("bad water marks are refused",
+        PF_StartCleaner(30, 10) == PFE_CLEANER &&
+        PF_StartCleaner(-1, 10) == PFE_CLEANER &&
+        PF_StartCleaner(10, 101) == PFE_CLEANER &&
+        PF_StopCleaner() == PFE_CLEANER);
+
+    fd = fresh_file("cleanfile.db", "LRU", 100);
+    memset(rev, 0, sizeof(rev));
+    plain = dirty_run(fd, 100, rev);
+    if (PF_StartCleaner(PF_CLEAN_LOWWATER, PF_CLEAN_HIGHWATER) != PFE_OK) {
+        PF_PrintError("cleaner");
+        exit(1);
+    }
+    PF_GetStats(&before);
+    cleaned = dirty_run(fd, 100, rev);
+    PF_GetStats(&after);
+    cleans = after.backgroundCleans - before.backgroundCleans;
+    if (PF_StopCleaner() != PFE_OK) {
+        PF_PrintError("cleaner");
+        exit(1);
+    }
+    check("the cleaner takes dirty writes off page misses",
+        cleans > 0 && cleaned < plain);
+
+    if (PF_CloseFile(fd) != PFE_OK ||
+            (fd = PF_OpenFile("cleanfile.db", "LRU")) < 0) {
+        PF_PrintError("reopen");
+        exit(1);
+    }
+    ok = TRUE;
+    for (i = 0; i < 100; i++) {
+        if (rev[i] != 0)
+            sprintf(want, "page %d rev %d", i, rev[i]);
+        else
+            sprintf(want, "page %d", i);
+        if (PF_GetThisPage(fd, i, &pagebuf) != PFE_OK) {
+            PF_PrintError("cleaned page");
+            exit(1);
+        }
+        ok = ok && strcmp(pagebuf, want) == 0;
+        PF_UnfixPage(fd, i, FALSE);
+    }
+    check("pages written out by the cleaner read back", ok);
+    close_file(fd, "cleanfile.db");
+}
+
+// TRUE if file "name" holds the bytes of string "what"
+int on_disk(char *name, char *what)
+{
+    FILE *f;
+    char *data;
+    long size, i, len = strlen(what);
+    int found = FALSE;
+
+    if ((f = fopen(name, "rb")) == NULL) {
+        perror(name);
+        exit(1);
+    }
+    fseek(f, 0, SEEK_END);
+    size = ftell(f);
+    rewind(f);
+    data = malloc(size > 0 ? size : 1);
+    if (data == NULL || fread(data, 1, size, f) != size) {
+        perror(name);
+        exit(1);
+    }
+    for (i = 0; i + len <= size && !found; i++)
+        found = memcmp(data + i, what, len) == 0;
+    free(data);
+    fclose(f);
+    return found;
+}
+
+// PF_FlushFile() puts the dirty pages of a file in the file and leaves
+// them in the buffer, clean: reading them reads nothing, and closing
+// the file writes nothing more
+void check_flush()
+{
+    int fd, i, ok;
+    char *pagebuf, text[40];
+    PF_Stats before, after;
+
+    fd = fresh_file("flushfile.db", "LRU", 10);
+    for (i = 0; i < 10; i++) {
+        PF_GetThisPage(fd, i, &pagebuf);
+        sprintf(pagebuf, "page %d flushed", i);
+        PF_UnfixPage(fd, i, TRUE);
+    }
+    ok = PF_FlushFile(fd) == PFE_OK;
+    for (i = 0; i < 10; i++) {
+        sprintf(text, "page %d flushed", i);
+        ok = ok && on_disk("flushfile.db", text);
+    }
+    check("a flush writes the dirty pages to the file", ok);
+
+    PF_GetStats(&before);
+    for (i = 0; i < 10; i++)
+        touch(fd, i);
+    if (PF_CloseFile(fd) != PFE_OK) {
+        PF_PrintError("close");
+        exit(1);
+    }
+    PF_GetStats(&after);
+    check("flushed pages stay in the buffer, clean",
+        after.physicalReads == before.physicalReads &&
+        after.physicalWrites == before.physicalWrites);
+
+    if ((fd = PF_OpenFile("flushfile.db", "LRU")) < 0) {
+        PF_PrintError("reopen");
+        exit(1);
+    }
+    ok = TRUE;
+    for (i = 0; i < 10; i++) {
+        sprintf(text, "page %d flushed", i);
+        PF_GetThisPage(fd, i, &pagebuf);
+        ok = ok && strcmp(pagebuf, text) == 0;
+        PF_UnfixPage(fd, i, FALSE);
+    }
+    check("a reopened file reads the flushed pages", ok);
+    close_file(fd, "flushfile.db");
+}
+
+// A scan of a file that is not in the buffer reads pages ahead of
+// PF_GetNextPage(), and asks for every one of them before they go
+void check_read_ahead()
+{
+    int fd, ok = TRUE;
+    long pagenum;
+    char *pagebuf;
+    PF_Stats before, after;
+
+    fd = fresh_file("rafile.db", "LRU", 300);
+    PF_DisposePage(fd, 100);
+    PF_DisposePage(fd, 250);
+    if (PF_CloseFile(fd) != PFE_OK ||
+            (fd = PF_OpenFile("rafile.db", "LRU")) < 0) {
+        PF_PrintError("reopen");
+        exit(1);
+    }
+    PF_GetStats(&before);
+    pagenum = -1;
+    while (PF_GetNextPage(fd, &pagenum, &pagebuf) == PFE_OK) {
+        ok = ok && atol(pagebuf + 5) == pagenum;
+        PF_UnfixPage(fd, pagenum, FALSE);
+    }
+    PF_GetStats(&after);
+    check("a scan reads ahead and uses all it read",
+        ok && PFerrno == PFE_EOF &&
+        after.readAheadHits - before.readAheadHits > 0 &&
+        after.readAheadWasted == before.readAheadWasted);
+    close_file(fd, "rafile.db");
+}
+
+// PF_OPEN_DIRECT needs a file created with PF_CREATE_ALIGNED; such a
+// file reads back through O_DIRECT what was written through it, where
+// the file system has O_DIRECT at all
+void check_direct()
+{
+    int fd, i, ok = TRUE;
+    long pagenum;
+    char *pagebuf;
+
+    unlink("directfile.db");
+    if (PF_CreateFile("directfile.db") != PFE_OK) {
+        PF_PrintError("create");
+        exit(1);
+    }
+    check("a packed file is not opened with PF_OPEN_DIRECT",
+        PF_OpenFileFlags("directfile.db", "LRU", PF_OPEN_DIRECT) == PFE_DIRECT);
+    check("PF_OPEN_DIRECT does not go with PF_OPEN_MMAP",
+        PF_OpenFileFlags("directfile.db", "LRU",
+            PF_OPEN_DIRECT | PF_OPEN_MMAP) == PFE_DIRECT);
+    PF_DestroyFile("directfile.db");
+
+    if (PF_CreateFileFlags("directfile.db", PF_CREATE_ALIGNED) != PFE_OK) {
+        PF_PrintError("create");
+        exit(1);
+    }
+    if ((fd = PF_OpenFileFlags("directfile.db", "LRU", PF_OPEN_DIRECT)) < 0) {
+        printf("an aligned file round-trips with PF_OPEN_DIRECT: "
+            "skipped, no O_DIRECT here\n");
+        PF_DestroyFile("directfile.db");
+        return;
+    }
+    for (i = 0; i < 100; i++) {
+        if (PF_AllocPage(fd, &pagenum, &pagebuf) != PFE_OK) {
+            PF_PrintError("alloc");
+            exit(1);
+        }
+        sprintf(pagebuf, "page %ld", pagenum);
+        pagebuf[PF_PAGE_SIZE - 1] = pagenum;
+        PF_UnfixPage(fd, pagenum, TRUE);
+    }
+    if (PF_CloseFile(fd) != PFE_OK ||
+            (fd = PF_OpenFileFlags("directfile.db", "LRU", PF_OPEN_DIRECT)) < 0) {
+        PF_PrintError("reopen");
+        exit(1);
+    }
+    for (i = 0; i < 100; i++) {
+        PF_GetThisPage(fd, i, &pagebuf);
+        ok = ok && atol(pagebuf + 5) == i && pagebuf[PF_PAGE_SIZE - 1] == i;
+        PF_UnfixPage(fd, i, FALSE);
+    }
+    check("an aligned file round-trips with PF_OPEN_DIRECT", ok);
+    close_file(fd, "directfile.db");
+}
+
+// A file opened with PF_OPEN_MMAP reads as it was written, but it can't
+// be changed, and its free pages can't be read
+void check_mmap()
+{
+    int fd, ok = TRUE;
+    long pagenum;
+    char *pagebuf;
+
+    fd = fresh_file("mmapfile.db", "LRU", 50);
+    PF_DisposePage(fd, 7);
+    if (PF_CloseFile(fd) != PFE_OK ||
+            (fd = PF_OpenFileFlags("mmapfile.db", "LRU", PF_OPEN_MMAP)) < 0) {
+        PF_PrintError("mmap");
+        exit(1);
+    }
+    pagenum = -1;
+    while (PF_GetNextPage(fd, &pagenum, &pagebuf) == PFE_OK) {
+        ok = ok && pagenum != 7 && atol(pagebuf + 5) == pagenum;
+        PF_UnfixPage(fd, pagenum, FALSE);
+    }
+    check("a mapped file reads as it was written", ok && PFerrno == PFE_EOF);
+    check("a free page of a mapped file is not read",
+        PF_GetThisPage(fd, 7, &pagebuf) == PFE_INVALIDPAGE);
+
+    ok = PF_AllocPage(fd, &pagenum, &pagebuf) == PFE_READONLY;
+    ok = ok && PF_GetThisPage(fd, 8, &pagebuf) == PFE_OK;
+    ok = ok && PF_UnfixPage(fd, 8, TRUE) == PFE_READONLY;
+    check("a mapped file can't be changed", ok);
+    close_file(fd, "mmapfile.db");
+}
+
+// An aligned file tells its free pages by the bits of its map blocks:
+// neither a scan nor PF_AllocPage() reads a free page to find out
+void check_bitmap()
+{
+    int fd, i, ok = TRUE;
+    long pagenum, before, reads;
+    char *pagebuf;
+
+    unlink("bitmapfile.db");
+    if (PF_CreateFileFlags("bitmapfile.db", PF_CREATE_ALIGNED) != PFE_OK ||
+            (fd = PF_OpenFile("bitmapfile.db", "LRU")) < 0) {
+        PF_PrintError("create");
+        exit(1);
+    }
+    for (i = 0; i < 100; i++) {
+        PF_AllocPage(fd, &pagenum, &pagebuf);
+        sprintf(pagebuf, "page %ld", pagenum);
+        PF_UnfixPage(fd, pagenum, TRUE);
+    }
+    for (i = 10; i < 90; i++)
+        PF_DisposePage(fd, i);
+    if (PF_CloseFile(fd) != PFE_OK ||
+            (fd = PF_OpenFile("bitmapfile.db", "LRU")) < 0) {
+        PF_PrintError("reopen");
+        exit(1);
+    }
+
+    before = misses();
+    pagenum = -1;
+    while (PF_GetNextPage(fd, &pagenum, &pagebuf) == PFE_OK) {
+        ok = ok && (pagenum < 10 || pagenum >= 90) &&
+            atol(pagebuf + 5) == pagenum;
+        PF_UnfixPage(fd, pagenum, FALSE);
+    }
+    reads = misses() - before;
+    check("a scan of an aligned file reads no free page", ok && reads == 20);
+
+    before = misses();
+    ok = PF_AllocPage(fd, &pagenum, &pagebuf) == PFE_OK &&
+        pagenum >= 10 && pagenum < 90;
+    PF_UnfixPage(fd, pagenum, TRUE);
+    check("an aligned file reuses a free page without reading it",
+        ok && misses() == before);
+    close_file(fd, "bitmapfile.db");
+}
+
+// TRUE if file "name" holds the pages convert_source() left in use, in
+// its page numbers, and has the others free: page 55 is the first one
+// past the end of the file
+int converted(char *name)
+{
+    int fd, ok = TRUE, n = 0;
+    long pagenum;
+    char *pagebuf;
+
+    if ((fd = PF_OpenFile(name, "LRU")) < 0) {
+        PF_PrintError(name);
+        exit(1);
+    }
+    pagenum = -1;
+    while (PF_GetNextPage(fd, &pagenum, &pagebuf) == PFE_OK) {
+        ok = ok && pagenum % 3 != 0 && pagenum < 55 &&
+            atol(pagebuf + 5) == pagenum;
+        PF_UnfixPage(fd, pagenum, FALSE);
+        n++;
+    }
+    ok = ok && PFerrno == PFE_EOF && n == 36;
+    for (n = 0; n < 19; n++) {
+        ok = ok && PF_AllocPage(fd, &pagenum, &pagebuf) == PFE_OK &&
+            pagenum % 3 == 0 && pagenum < 55;
+        PF_UnfixPage(fd, pagenum, TRUE);
+    }
+    ok = ok && PF_AllocPage(fd, &pagenum, &pagebuf) == PFE_OK &&
+        pagenum == 55;
+    PF_UnfixPage(fd, pagenum, TRUE);
+    if (PF_CloseFile(fd) != PFE_OK) {
+        PF_PrintError(name);
+        exit(1);
+    }
+    return ok;
+}
+
+// Make a packed file of 60 pages, with every third page and the last
+// five disposed of
+void convert_source(char *name)
+{
+    int fd, i;
+
+    fd = fresh_file(name, "LRU", 60);
+    for (i = 0; i < 60; i++)
+        if (i % 3 == 0 || i >= 55)
+            PF_DisposePage(fd, i);
+    if (PF_CloseFile(fd) != PFE_OK) {
+        PF_PrintError(name);
+        exit(1);
+    }
+}
+
+// PF_ConvertFile() keeps the page numbers and contents of the pages in
+// use, frees the others and drops the free pages at the end; so does
+// PF_ConvertFileFlags() to and from a compressed file
+void check_convert()
+{
+    unlink("convnew.db");
+    unlink("convz.db");
+    unlink("convback.db");
+    convert_source("convold.db");
+    check("a packed file converts to format v3",
+        PF_ConvertFile("convold.db", "convnew.db") == PFE_OK &&
+        converted("convnew.db"));
+    check("a file is not converted over an existing one",
+        PF_ConvertFile("convold.db", "convnew.db") != PFE_OK);
+    check("a file converts to a compressed one and back",
+        PF_ConvertFileFlags("convold.db", "convz.db",
+            PF_CREATE_COMPRESSED) == PFE_OK &&
+        PF_ConvertFileFlags("convz.db", "convback.db",
+            PF_CREATE_ALIGNED) == PFE_OK &&
+        converted("convback.db"));
+    PF_DestroyFile("convold.db");
+    PF_DestroyFile("convnew.db");
+    PF_DestroyFile("convz.db");
+    PF_DestroyFile("convback.db");
+}
+
+// Fill a page of "size" bytes as page "pagenum" of round "round": a
+// stretch of random bytes, whose length changes from round to round, and
+// then a run of one byte. Its compressed size grows or shrinks with the
+// stretch, from a few bytes to the whole page.
+void zfill(char *pagebuf, int size, long pagenum, int round)
+{
+    unsigned seed = pagenum * 7919 + round * 104729 + 1;
+    int i, k = (pagenum * 13 + round * 29) % 8 * size / 7;
+
+    for (i = 0; i < size; i++) {
+        seed = seed * 1103515245u + 12345u;
+        pagebuf[i] = i < k ? (char)(seed >> 16) : (char)(pagenum + round);
+    }
+}
+
+// A compressed file with pages of "size" bytes gives back what was
+// written, as its pages are rewritten larger and smaller, some are
+// disposed of, and the file is closed and opened again
+void check_compressed(int size)
+{
+    int fd, round, ok = TRUE;
+    long pagenum, n;
+    char *pagebuf, *want, what[80];
+    PF_Stats before, after;
+
+    want = malloc(size);
+    unlink("zfile.db");
+    if (want == NULL ||
+            PF_CreateFileSized("zfile.db", PF_CREATE_COMPRESSED, size) != PFE_OK ||
+            (fd = PF_OpenFile("zfile.db", "LRU")) < 0) {
+        PF_PrintError("compressed");
+        exit(1);
+    }
+    PF_GetStats(&before);
+    for (n = 0; n < 40; n++) {
+        PF_AllocPage(fd, &pagenum, &pagebuf);
+        zfill(pagebuf, size, pagenum, 0);
+        PF_UnfixPage(fd, pagenum, TRUE);
+    }
+    for (pagenum = 3; pagenum < 40; pagenum += 7)
+        PF_DisposePage(fd, pagenum);
+
+    for (round = 1; round <= 4; round++) {
+        if (PF_CloseFile(fd) != PFE_OK ||
+                (fd = PF_OpenFile("zfile.db", "LRU")) < 0) {
+            PF_PrintError("reopen");
+            exit(1);
+        }
+        n = 0;
+        pagenum = -1;
+        while (PF_GetNextPage(fd, &pagenum, &pagebuf) == PFE_OK) {
+            zfill(want, size, pagenum, round - 1);
+            ok = ok && pagenum % 7 != 3 && memcmp(pagebuf, want, size) == 0;
+            if (round < 4)
+                zfill(pagebuf, size, pagenum, round);
+            PF_UnfixPage(fd, pagenum, round < 4);
+            if (pagenum == 20)
+                PF_FlushFile(fd);
+            n++;
+        }
+        ok = ok && n == 40 - 6;
+    }
+    ok = ok && PF_GetPageSize(fd) == size &&
+        PF_AllocPage(fd, &pagenum, &pagebuf) == PFE_OK && pagenum % 7 == 3;
+    PF_UnfixPage(fd, pagenum, TRUE);
+    PF_GetStats(&after);
+    sprintf(what, "a compressed file of %d byte pages reads back", size);
+    check(what, ok && after.compressWrites > before.compressWrites &&
+        after.decompressReads > before.decompressReads);
+    close_file(fd, "zfile.db");
+    free(want);
+}
+
+// With the compressed page cache on, a clean page evicted not long ago
+// comes back from the cache, not from its file; and a page written after
+// it went into the cache never comes back as it was before
+void check_zcache()
+{
+    int fd, i, ok = TRUE;
+    char *pagebuf, text[40];
+    PF_Stats before, after;
+
+    fd = fresh_file("zcachefile.db", "LRU", 100);
+    if (PF_SetCompressedCache(1L << 22) != PFE_OK) {
+        PF_PrintError("zcache");
+        exit(1);
+    }
+    for (i = 0; i < 100; i++)
+        touch(fd, i);
+
+    PF_GetStats(&before);
+    for (i = 0; i < 50; i++)
+        touch(fd, i);
+    PF_GetStats(&after);
+    check("evicted pages come back from the compressed cache",
+        after.zcacheHits - before.zcacheHits == 50 &&
+        after.physicalReads == before.physicalReads);
+
+    for (i = 0; i < 50; i++) {
+        PF_GetThisPage(fd, i, &pagebuf);
+        sprintf(pagebuf, "page %d rewritten", i);
+        PF_UnfixPage(fd, i, TRUE);
+        if (i == 25)
+            PF_FlushFile(fd);
+    }
+    for (i = 50; i < 100; i++)
+        touch(fd, i);
+    for (i = 0; i < 100; i++) {
+        if (i < 50)
+            sprintf(text, "page %d rewritten", i);
+        else
+            sprintf(text, "page %d", i);
+        PF_GetThisPage(fd, i, &pagebuf);
+        ok = ok && strcmp(pagebuf, text) == 0;
+        PF_UnfixPage(fd, i, FALSE);
+    }
+    check("the compressed cache gives no stale page", ok);
+    PF_SetCompressedCache(0);
+    close_file(fd, "zcachefile.db");
+}
+
+// TRUE if the counters "a" and "b" hold the same counts
+int same_counts(PF_FileStats *a, PF_FileStats *b)
+{
+    return a->logicalReads == b->logicalReads &&
+        a->logicalWrites == b->logicalWrites &&
+        a->physicalReads == b->physicalReads &&
+        a->physicalWrites == b->physicalWrites &&
+        a->bufferHits == b->bufferHits &&
+        a->bufferMisses == b->bufferMisses;
+}
+
+// The counters of the files add up to the global ones; those of a policy
+// keep the counts of its files once they are closed; and the difference
+// of two snapshots is what was counted in between
+void check_stats()
+{
+    int a, b, i;
+    PF_Stats global, then, delta;
+    PF_FileStats sa, sb, sum, policy, closed, fthen, fdelta;
+
+    PF_ResetStats();
+    a = fresh_file("statsfile_a.db", "MRU", 60);
+    b = fresh_file("statsfile_b.db", "CLOCK", 60);
+    srand(2);
+    for (i = 0; i < 500; i++) {
+        touch(a, rand() % 60);
+        touch(b, rand() % 60);
+    }
+    PF_GetStats(&global);
+    PF_GetFileStats(a, &sa);
+    PF_GetFileStats(b, &sb);
+    sum = sa;
+    sum.logicalReads += sb.logicalReads;
+    sum.logicalWrites += sb.logicalWrites;
+    sum.physicalReads += sb.physicalReads;
+    sum.physicalWrites += sb.physicalWrites;
+    sum.bufferHits += sb.bufferHits;
+    sum.bufferMisses += sb.bufferMisses;
+    check("the counters of the files add up to the global ones",
+        sum.logicalReads == global.logicalReads &&
+        sum.logicalWrites == global.logicalWrites &&
+        sum.physicalReads == global.physicalReads &&
+        sum.physicalWrites == global.physicalWrites &&
+        sum.bufferHits == global.bufferHits &&
+        sum.bufferMisses == global.bufferMisses &&
+        sa.logicalReads == 500);
+
+    PF_GetPolicyStats("MRU", &policy);
+    if (PF_CloseFile(a) != PFE_OK) {
+        PF_PrintError("close");
+        exit(1);
+    }
+    PF_GetPolicyStats("MRU", &closed);
+    check("the counters of a policy keep those of its closed files",
+        same_counts(&policy, &sa) && same_counts(&closed, &sa));
+
+    PF_GetStats(&then);
+    PF_GetFileStats(b, &fthen);
+    for (i = 0; i < 10; i++)
+        touch(b, 7);
+    PF_GetStats(&global);
+    PF_GetFileStats(b, &sb);
+    PF_DiffStats(&global, &then, &delta);
+    PF_DiffFileStats(&sb, &fthen, &fdelta);
+    check("the difference of two snapshots counts what came between",
+        delta.logicalReads == 10 && fdelta.logicalReads == 10 &&
+        delta.bufferHits + delta.bufferMisses == 10 &&
+        fdelta.bufferHits == delta.bufferHits &&
+        fdelta.physicalReads == delta.physicalReads);
+
+    PF_DestroyFile("statsfile_a.db");
+    close_file(b, "statsfile_b.db");
+}
+
 int main()
 {
     PF_Init();
@@ -592,5 +1480,33 @@ int main()
     run_mix(75,  500);    // 75% writes
     run_mix(100, 500);    // 100% writes
 
-    return 0;
+    check_clock();
+    check_scan("2Q");
+    check_scan("ARC");
+    check_scan_ring("LRU");
+    check_scan_ring("CLOCK");
+    check_quota("LRU");
+    check_quota("CLOCK");
+    check_quota("2Q");
+    check_quota("ARC");
+    check_priority("LRU");
+    check_priority("MRU");
+    check_priority("CLOCK");
+    check_priority("2Q");
+    check_priority("ARC");
+    check_shared();
+    check_pins();
+    check_cleaner();
+    check_flush();
+    check_read_ahead();
+    check_direct();
+    check_mmap();
+    check_bitmap();
+    check_convert();
+    check_compressed(PF_PAGE_SIZE);
+    check_compressed(PF_MAX_PAGE_SIZE);
+    check_zcache();
+    check_stats();
+
+    return failures != 0;
 }
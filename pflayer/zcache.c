@@ -0,0 +1,339 @@
+/* zcache.c: the compressed page cache, a second tier below the buffer.
+A page evicted from the buffer, once clean (see PFbufPickFrame()), is
+kept here compressed with the codec of compressed files (see pflz.c),
+and a page miss looks here before it reads the page from its file: a
+page evicted not long ago then costs a decompression instead of a read.
+The cache has a memory budget of its own (see PF_SetCompressedCache()),
+0 by default, which turns it off; past the budget the pages put in
+longest ago are dropped.
+What is kept here is what the file holds. A page found here stays, so
+that evicting it again while its frame is still clean (PF_FRAME_ZCACHED,
+see buf.c) costs no compression; a page brought into the buffer any
+other way is dropped from it, and so is a page that is written.
+All of it is protected by the pool latch, which the callers hold.
+The interface routines are:
+PFzcacheSetSize(), PFzcachePut(), PFzcacheTouch(), PFzcacheGet(),
+PFzcacheDelete() and PFzcacheReleaseFile(). */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "pf.h"
+#include "pftypes.h"
+
+/* a page in the cache. Entries are linked in the order they were put in,
+newest first, and in the chains of the hash buckets */
+typedef struct PFzcache_entry {
+	long page;	/* page number */
+	int fd;		/* file descriptor */
+	int size;	/* # of bytes of the page body */
+	int length;	/* # of bytes of data: size if kept as it is */
+	struct PFzcache_entry *hnext;	/* next in the same hash bucket */
+	struct PFzcache_entry *next;	/* next (older) entry */
+	struct PFzcache_entry *prev;	/* previous (newer) entry */
+	unsigned char data[1];	/* the page, "length" bytes */
+} PFzcache_entry;
+
+static long PFzcachemax = 0;	/* memory budget in bytes, 0 if off */
+static long PFzcachebytes = 0;	/* memory taken by the entries */
+static PFzcache_entry **PFzcachebucket = NULL;	/* hash buckets */
+static long PFzcachenbuckets = 0;	/* # of buckets, a power of 2 */
+static PFzcache_entry *PFzcachehead = NULL;	/* newest entry */
+static PFzcache_entry *PFzcachetail = NULL;	/* oldest entry */
+static unsigned char *PFzcachebuf = NULL; /* room to compress a page */
+static int PFzcachebufsize = 0;	/* # of bytes of PFzcachebuf */
+
+/* memory taken by an entry holding "length" bytes of data */
+#define PFzcacheFootprint(length) (sizeof(PFzcache_entry) + (length))
+
+/* bucket of page "page" of file "fd" */
+#define PFzcacheBucket(fd,page)	(PFhash(fd,page) & (PFzcachenbuckets-1))
+
+
+static PFzcache_entry **PFzcacheLink(fd,page)
+int fd;		/* file descriptor */
+long page;	/* page number */
+/****************************************************************************
+SPECIFICATIONS:
+	Find page "page" of file "fd" in the hash buckets.
+
+RETURN VALUE:
+	The link that points to its entry, or to NULL at the end of its
+	bucket if it is not in the cache.
+*****************************************************************************/
+{
+PFzcache_entry **link;
+
+	for (link= &PFzcachebucket[PFzcacheBucket(fd,page)]; *link != NULL;
+						link= &(*link)->hnext)
+		if ((*link)->fd == fd && (*link)->page == page)
+			break;
+	return(link);
+}
+
+static void PFzcacheRemove(link)
+PFzcache_entry **link;	/* link to the entry in its hash bucket */
+/****************************************************************************
+SPECIFICATIONS:
+	Take the entry "link" points to out of the cache, and free it.
+
+GLOBAL VARIABLES MODIFIED:
+	PFzcachehead, PFzcachetail, PFzcachebytes
+*****************************************************************************/
+{
+PFzcache_entry *ent;
+
+	ent = *link;
+	*link = ent->hnext;
+	if (ent->prev != NULL)
+		ent->prev->next = ent->next;
+	else	PFzcachehead = ent->next;
+	if (ent->next != NULL)
+		ent->next->prev = ent->prev;
+	else	PFzcachetail = ent->prev;
+	PFzcachebytes -= PFzcacheFootprint(ent->length);
+	free((char *)ent);
+}
+
+static void PFzcacheTrim(max)
+long max;	/* # of bytes the entries may take */
+/****************************************************************************
+SPECIFICATIONS:
+	Drop the oldest entries until the cache takes at most "max"
+	bytes.
+*****************************************************************************/
+{
+	while (PFzcachetail != NULL && PFzcachebytes > max){
+		PFzcacheRemove(PFzcacheLink(PFzcachetail->fd,
+						PFzcachetail->page));
+		PFstat(zcacheEvictions)++;
+	}
+}
+
+PFzcacheSetSize(bytes)
+long bytes;	/* memory budget, 0 to turn the cache off */
+/****************************************************************************
+SPECIFICATIONS:
+	Give the cache a budget of "bytes" bytes, dropping the oldest
+	pages if it takes more. There is about a bucket per KB of budget.
+
+RETURN VALUE:
+	PFE_OK	if OK
+	PFE_NOMEM	if no memory: the cache is left as it was.
+
+GLOBAL VARIABLES MODIFIED:
+	PFzcachemax, PFzcachebucket, PFzcachenbuckets
+*****************************************************************************/
+{
+PFzcache_entry **bucket;	/* new hash buckets */
+PFzcache_entry *ent;
+long nbuckets;	/* # of them */
+long b;
+
+	PFzcacheTrim(bytes);
+	if (bytes == 0){
+		if (PFzcachebucket != NULL)
+			free((char *)PFzcachebucket);
+		PFzcachebucket = NULL;
+		PFzcachenbuckets = 0;
+		PFzcachemax = 0;
+		return(PFE_OK);
+	}
+
+	for (nbuckets=64; nbuckets < bytes/1024; nbuckets *= 2);
+	if (nbuckets != PFzcachenbuckets){
+		/* rehash the entries into new buckets */
+		if ((bucket=(PFzcache_entry **)calloc(nbuckets,
+				sizeof(PFzcache_entry *))) == NULL){
+			PFerrno = PFE_NOMEM;
+			return(PFerrno);
+		}
+		if (PFzcachebucket != NULL)
+			free((char *)PFzcachebucket);
+		PFzcachebucket = bucket;
+		PFzcachenbuckets = nbuckets;
+		for (ent=PFzcachehead; ent != NULL; ent=ent->next){
+			b = PFzcacheBucket(ent->fd,ent->page);
+			ent->hnext = PFzcachebucket[b];
+			PFzcachebucket[b] = ent;
+		}
+	}
+	PFzcachemax = bytes;
+	return(PFE_OK);
+}
+
+void PFzcachePut(fd,page,body,size)
+int fd;		/* file descriptor */
+long page;	/* page number */
+char *body;	/* the page body, as read by the file's read function */
+int size;	/* # of bytes of it */
+/****************************************************************************
+SPECIFICATIONS:
+	Keep page "page" of file "fd", just evicted from the buffer and
+	clean, in the cache: compressed, or as it is if it does not
+	compress. The oldest pages are dropped to make room for it. A
+	page that takes more than the whole budget is not kept. Nothing
+	is done if the cache is off.
+
+IMPLEMENTATION NOTES:
+	The page is compressed into PFzcachebuf first, so that the entry
+	takes no more than it needs; the pool latch keeps it to a thread
+	at a time.
+*****************************************************************************/
+{
+PFzcache_entry **link;
+PFzcache_entry *ent;
+unsigned char *data;	/* what to keep */
+int length;	/* # of bytes of it */
+long b;
+
+	if (PFzcachemax == 0)
+		return;
+	if (size > PFzcachebufsize){
+		if (PFzcachebuf != NULL)
+			free((char *)PFzcachebuf);
+		if ((PFzcachebuf=(unsigned char *)malloc(size)) == NULL){
+			PFzcachebufsize = 0;
+			return;
+		}
+		PFzcachebufsize = size;
+	}
+	if ((length=PFlzCompress(body,size,PFzcachebuf,size-1)) > 0)
+		data = PFzcachebuf;
+	else {
+		data = (unsigned char *)body;
+		length = size;
+	}
+	if (PFzcacheFootprint(length) > PFzcachemax)
+		return;
+
+	/* a copy left behind would be older */
+	if (*(link=PFzcacheLink(fd,page)) != NULL)
+		PFzcacheRemove(link);
+	PFzcacheTrim(PFzcachemax - PFzcacheFootprint(length));
+	if ((ent=(PFzcache_entry *)malloc(PFzcacheFootprint(length)))
+								== NULL)
+		return;
+	ent->page = page;
+	ent->fd = fd;
+	ent->size = size;
+	ent->length = length;
+	memcpy((char *)ent->data,(char *)data,length);
+
+	b = PFzcacheBucket(fd,page);
+	ent->hnext = PFzcachebucket[b];
+	PFzcachebucket[b] = ent;
+	ent->prev = NULL;
+	ent->next = PFzcachehead;
+	if (PFzcachehead != NULL)
+		PFzcachehead->prev = ent;
+	else	PFzcachetail = ent;
+	PFzcachehead = ent;
+	PFzcachebytes += PFzcacheFootprint(length);
+	PFstat(zcacheInserts)++;
+}
+
+PFzcacheGet(fd,page,body,size)
+int fd;		/* file descriptor */
+long page;	/* page number */
+char *body;	/* where to put the page body */
+int size;	/* # of bytes of it */
+/****************************************************************************
+SPECIFICATIONS:
+	Look for page "page" of file "fd" in the cache. If it is there,
+	decompress it into "body". The entry is left in the cache: see
+	PFzcacheTouch().
+
+RETURN VALUE:
+	TRUE	if the page was found, and is in "body".
+	FALSE	if it was not: it is to be read from the file.
+*****************************************************************************/
+{
+PFzcache_entry **link;
+PFzcache_entry *ent;
+int ok;
+
+	if (PFzcachemax == 0)
+		return(FALSE);
+	if ((ent= *(link=PFzcacheLink(fd,page))) == NULL){
+		PFstat(zcacheMisses)++;
+		return(FALSE);
+	}
+	if (ent->size != size)
+		ok = FALSE;
+	else if (ent->length == size){
+		memcpy(body,(char *)ent->data,size);
+		ok = TRUE;
+	}
+	else	ok = (PFlzDecompress(ent->data,ent->length,body,size) == size);
+	if (!ok){
+		/* not the page a frame of the file holds: read it */
+		PFzcacheRemove(link);
+		PFstat(zcacheMisses)++;
+		return(FALSE);
+	}
+	PFstat(zcacheHits)++;
+	return(TRUE);
+}
+
+PFzcacheTouch(fd,page)
+int fd;		/* file descriptor */
+long page;	/* page number */
+/****************************************************************************
+SPECIFICATIONS:
+	Page "page" of file "fd", found in the cache by PFzcacheGet(), is
+	evicted from the buffer again, unchanged: make its entry the
+	newest, as PFzcachePut() would.
+
+RETURN VALUE:
+	TRUE	if the page is in the cache.
+	FALSE	if it was dropped meanwhile: the caller puts it back.
+*****************************************************************************/
+{
+PFzcache_entry *ent;
+
+	if (PFzcachemax == 0 || (ent= *PFzcacheLink(fd,page)) == NULL)
+		return(FALSE);
+	if (ent->prev != NULL){
+		ent->prev->next = ent->next;
+		if (ent->next != NULL)
+			ent->next->prev = ent->prev;
+		else	PFzcachetail = ent->prev;
+		ent->prev = NULL;
+		ent->next = PFzcachehead;
+		PFzcachehead->prev = ent;
+		PFzcachehead = ent;
+	}
+	return(TRUE);
+}
+
+void PFzcacheDelete(fd,page)
+int fd;		/* file descriptor */
+long page;	/* page number */
+/****************************************************************************
+SPECIFICATIONS:
+	Drop page "page" of file "fd" from the cache, if it is there.
+*****************************************************************************/
+{
+PFzcache_entry **link;
+
+	if (PFzcachemax > 0 && *(link=PFzcacheLink(fd,page)) != NULL)
+		PFzcacheRemove(link);
+}
+
+void PFzcacheReleaseFile(fd)
+int fd;		/* file descriptor */
+/****************************************************************************
+SPECIFICATIONS:
+	Drop the pages of file "fd" from the cache: the file is being
+	closed, and its descriptor may be reused.
+*****************************************************************************/
+{
+PFzcache_entry *ent;
+PFzcache_entry *next;
+
+	for (ent=PFzcachehead; ent != NULL; ent=next){
+		next = ent->next;
+		if (ent->fd == fd)
+			PFzcacheRemove(PFzcacheLink(fd,ent->page));
+	}
+}